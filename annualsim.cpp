@@ -0,0 +1,106 @@
+#include "annualsim.h"
+
+#include <algorithm>
+
+#include "workpool.h"
+
+namespace {
+
+// Rooms evaluated together for each hour; their running totals stay in L1
+const size_t SimulationChunk = 256;
+
+struct ChunkState
+{
+    double lossPerKelvin[SimulationChunk];
+    double target[SimulationChunk];
+    double heatingWh[SimulationChunk];
+    double coolingWh[SimulationChunk];
+    double heatingKh[SimulationChunk];
+    double coolingKh[SimulationChunk];
+    double peakHeating[SimulationChunk];
+    double peakCooling[SimulationChunk];
+    int peakHeatingHour[SimulationChunk];
+    int peakCoolingHour[SimulationChunk];
+};
+
+void simulateChunk(const WeatherYear &weather, const RoomInput *rooms, AnnualResult *results, size_t count)
+{
+    ChunkState state;
+    for (size_t r = 0; r < count; ++r) {
+        state.lossPerKelvin[r] = heatLossCoefficients(rooms[r]).total();
+        state.target[r] = rooms[r].targetTemp;
+        state.heatingWh[r] = 0;
+        state.coolingWh[r] = 0;
+        state.heatingKh[r] = 0;
+        state.coolingKh[r] = 0;
+        state.peakHeating[r] = 0;
+        state.peakCooling[r] = 0;
+        state.peakHeatingHour[r] = -1;
+        state.peakCoolingHour[r] = -1;
+    }
+
+    const int hours = static_cast<int>(weather.hours());
+    const float *outside = weather.dryBulb.data();
+    for (int hour = 0; hour < hours; ++hour) {
+        const double external = outside[hour];
+        for (size_t r = 0; r < count; ++r) {
+            double below = std::max(state.target[r] - external, 0.0);
+            double above = std::max(external - state.target[r], 0.0);
+            double heatingWatt = state.lossPerKelvin[r] * below;
+            double coolingWatt = state.lossPerKelvin[r] * above;
+
+            state.heatingKh[r] += below;
+            state.coolingKh[r] += above;
+            state.heatingWh[r] += heatingWatt;
+            state.coolingWh[r] += coolingWatt;
+            if (heatingWatt > state.peakHeating[r]) {
+                state.peakHeating[r] = heatingWatt;
+                state.peakHeatingHour[r] = hour;
+            }
+            if (coolingWatt > state.peakCooling[r]) {
+                state.peakCooling[r] = coolingWatt;
+                state.peakCoolingHour[r] = hour;
+            }
+        }
+    }
+
+    for (size_t r = 0; r < count; ++r) {
+        AnnualResult &result = results[r];
+        result.heatingKWh = state.heatingWh[r] / 1000;
+        result.coolingKWh = state.coolingWh[r] / 1000;
+        result.peakHeatingWatt = state.peakHeating[r];
+        result.peakCoolingWatt = state.peakCooling[r];
+        result.peakHeatingHour = state.peakHeatingHour[r];
+        result.peakCoolingHour = state.peakCoolingHour[r];
+        result.heatingDegreeHours = state.heatingKh[r];
+        result.coolingDegreeHours = state.coolingKh[r];
+    }
+}
+
+} // namespace
+
+
+void simulateAnnual(const WeatherYear &weather, const RoomInput *rooms, AnnualResult *results, size_t count)
+{
+    for (size_t begin = 0; begin < count; begin += SimulationChunk)
+        simulateChunk(weather, rooms + begin, results + begin, std::min(SimulationChunk, count - begin));
+}
+
+void simulateAnnual(const WeatherYear &weather, const std::vector<RoomInput> &rooms,
+                    std::vector<AnnualResult> &results, unsigned threads)
+{
+    results.resize(rooms.size());
+    if (rooms.size() <= SimulationChunk || threads == 1) {
+        simulateAnnual(weather, rooms.data(), results.data(), rooms.size());
+        return;
+    }
+
+    WorkPool pool(threads);
+    for (size_t begin = 0; begin < rooms.size(); begin += SimulationChunk) {
+        const size_t count = std::min(SimulationChunk, rooms.size() - begin);
+        pool.submit([&, begin, count]() {
+            simulateChunk(weather, rooms.data() + begin, results.data() + begin, count);
+        });
+    }
+    pool.wait();
+}
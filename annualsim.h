@@ -0,0 +1,35 @@
+#ifndef ANNUALSIM_H
+#define ANNUALSIM_H
+
+#include <cstddef>
+#include <vector>
+
+#include "loadcalc.h"
+#include "weather.h"
+
+// Hour by hour heating and cooling over a weather year. Each hour applies the
+// transmission, ventilation and leakage terms of calculateHeatingLoads() to that
+// hour's outdoor temperature: heating below the room's target temperature and
+// cooling (envelope gain) above it. Design margins (heatAdjust/coolAdjust) are
+// for sizing and are not applied.
+
+struct AnnualResult
+{
+    double heatingKWh = 0;
+    double coolingKWh = 0;
+    double peakHeatingWatt = 0;
+    double peakCoolingWatt = 0;
+    int peakHeatingHour = -1; // hour of the year from 0, -1 when never needed
+    int peakCoolingHour = -1;
+    double heatingDegreeHours = 0; // K·h below the target temperature
+    double coolingDegreeHours = 0; // K·h above it
+};
+
+// Simulates rooms [0, count) on the calling thread
+void simulateAnnual(const WeatherYear &weather, const RoomInput *rooms, AnnualResult *results, size_t count);
+
+// Splits the rooms across threads (0 = one per hardware thread), resizing results to match
+void simulateAnnual(const WeatherYear &weather, const std::vector<RoomInput> &rooms,
+                    std::vector<AnnualResult> &results, unsigned threads = 0);
+
+#endif // ANNUALSIM_H
@@ -0,0 +1,518 @@
+#include "arrowwriter.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <string_view>
+
+namespace {
+
+const char FileMagic[8] = {'A', 'R', 'R', 'O', 'W', '1', 0, 0};
+const int16_t MetadataVersionV5 = 4;
+const size_t BufferAlignment = 64;
+const size_t MaxIdTextBytes = size_t(1) << 26; // a batch is cut short before its ids outgrow this
+
+enum MessageHeader : uint8_t { SchemaHeader = 1, RecordBatchHeader = 3 };
+enum TypeId : uint8_t { IntType = 2, FloatingPointType = 3, Utf8Type = 5 };
+
+// The columns after the id, in RoomLoads order
+const struct
+{
+    const char *name;
+    double RoomLoads::*value;
+    int RoomLoads::*count;
+} resultColumns[] = {
+    {"roomWatt", &RoomLoads::roomWatt, nullptr},
+    {"windowCoolWatt", &RoomLoads::windowCoolWatt, nullptr},
+    {"occupantWatt", &RoomLoads::occupantWatt, nullptr},
+    {"equipmentWatt", &RoomLoads::equipmentWatt, nullptr},
+    {"lightingWatt", &RoomLoads::lightingWatt, nullptr},
+    {"totalCoolingWatt", &RoomLoads::totalCoolingWatt, nullptr},
+    {"peakCoolingWatt", &RoomLoads::peakCoolingWatt, nullptr},
+    {"coolingUnits", nullptr, &RoomLoads::coolingUnits},
+    {"wallWatt", &RoomLoads::wallWatt, nullptr},
+    {"windowHeatWatt", &RoomLoads::windowHeatWatt, nullptr},
+    {"ceilingWatt", &RoomLoads::ceilingWatt, nullptr},
+    {"floorWatt", &RoomLoads::floorWatt, nullptr},
+    {"transmissionWatt", &RoomLoads::transmissionWatt, nullptr},
+    {"ventWatt", &RoomLoads::ventWatt, nullptr},
+    {"leakWatt", &RoomLoads::leakWatt, nullptr},
+    {"totalHeatingWatt", &RoomLoads::totalHeatingWatt, nullptr},
+    {"peakHeatingWatt", &RoomLoads::peakHeatingWatt, nullptr},
+    {"heatingUnits", nullptr, &RoomLoads::heatingUnits},
+};
+
+// Just enough of a FlatBuffers builder for Arrow's metadata. Like the reference
+// builder it works from the back, so whatever an object refers to is added
+// before it, and objects are named by their distance from the end.
+class FlatBuilder
+{
+public:
+    size_t size() const { return reversed.size(); }
+
+    template <class T>
+    void prepend(T value)
+    {
+        align(0, sizeof(T));
+        prependBytes(&value, sizeof(T));
+    }
+
+    void prependBytes(const void *data, size_t size)
+    {
+        const uint8_t *bytes = static_cast<const uint8_t *>(data);
+        for (size_t i = size; i-- > 0;)
+            reversed.push_back(bytes[i]);
+    }
+
+    // Pads so that after another `extra` bytes the size is a multiple of alignment
+    void align(size_t extra, size_t alignment)
+    {
+        maxAlignment = std::max(maxAlignment, alignment);
+        while ((size() + extra) % alignment)
+            reversed.push_back(0);
+    }
+
+    void prependOffset(size_t object)
+    {
+        align(0, 4);
+        prepend(uint32_t(size() + 4 - object));
+    }
+
+    size_t string(std::string_view text)
+    {
+        align(text.size() + 1, 4);
+        reversed.push_back(0);
+        prependBytes(text.data(), text.size());
+        prepend(uint32_t(text.size()));
+        return size();
+    }
+
+    size_t offsetVector(const std::vector<size_t> &objects)
+    {
+        align(objects.size() * 4, 4);
+        for (size_t i = objects.size(); i-- > 0;)
+            prependOffset(objects[i]);
+        prepend(uint32_t(objects.size()));
+        return size();
+    }
+
+    // Structs of 8 byte fields, given as their bytes back to back
+    size_t structVector(const void *data, size_t count, size_t structSize)
+    {
+        align(count * structSize, 4);
+        align(count * structSize, 8);
+        prependBytes(data, count * structSize);
+        prepend(uint32_t(count));
+        return size();
+    }
+
+    void startTable()
+    {
+        fields.clear();
+        tableStart = size();
+    }
+
+    template <class T>
+    void field(int id, T value)
+    {
+        prepend(value);
+        fields.emplace_back(id, size());
+    }
+
+    void offsetField(int id, size_t object)
+    {
+        prependOffset(object);
+        fields.emplace_back(id, size());
+    }
+
+    size_t endTable()
+    {
+        prepend(int32_t(0));
+        const size_t table = size();
+        int count = 0;
+        for (const auto &entry : fields)
+            count = std::max(count, entry.first + 1);
+        std::vector<uint16_t> slots(count, 0);
+        for (const auto &entry : fields)
+            slots[entry.first] = uint16_t(table - entry.second);
+        for (size_t i = slots.size(); i-- > 0;)
+            prepend(slots[i]);
+        prepend(uint16_t(table - tableStart));
+        prepend(uint16_t(4 + 2 * count));
+        // The table's first word is the distance back to its vtable
+        const int32_t toVtable = int32_t(size() - table);
+        uint8_t bytes[4];
+        std::memcpy(bytes, &toVtable, sizeof(bytes));
+        for (size_t i = 0; i < 4; ++i)
+            reversed[table - 1 - i] = bytes[i];
+        return table;
+    }
+
+    std::vector<uint8_t> finish(size_t root)
+    {
+        align(4, maxAlignment);
+        prependOffset(root);
+        return std::vector<uint8_t>(reversed.rbegin(), reversed.rend());
+    }
+
+private:
+    std::vector<uint8_t> reversed;
+    std::vector<std::pair<int, size_t>> fields;
+    size_t tableStart = 0;
+    size_t maxAlignment = 8;
+};
+
+size_t addSchema(FlatBuilder &builder)
+{
+    auto addField = [&builder](std::string_view name, TypeId type, int bits) {
+        const size_t nameOffset = builder.string(name);
+        const size_t children = builder.offsetVector({});
+        builder.startTable();
+        if (type == IntType) {
+            builder.field(0, int32_t(bits));
+            builder.field(1, uint8_t(1)); // signed
+        } else if (type == FloatingPointType) {
+            builder.field(0, int16_t(2)); // double
+        }
+        const size_t typeOffset = builder.endTable();
+
+        builder.startTable();
+        builder.offsetField(0, nameOffset);
+        builder.field(1, uint8_t(0)); // not nullable
+        builder.field(2, uint8_t(type));
+        builder.offsetField(3, typeOffset);
+        builder.offsetField(5, children);
+        return builder.endTable();
+    };
+
+    std::vector<size_t> fields;
+    fields.push_back(addField("id", Utf8Type, 0));
+    for (size_t c = 0; c < std::size(resultColumns); ++c)
+        fields.push_back(addField(resultColumns[c].name, resultColumns[c].value ? FloatingPointType : IntType, 32));
+    const size_t fieldVector = builder.offsetVector(fields);
+    builder.startTable();
+    builder.field(0, int16_t(0)); // little endian
+    builder.offsetField(1, fieldVector);
+    return builder.endTable();
+}
+
+std::vector<uint8_t> messageMetadata(MessageHeader type, size_t header, FlatBuilder &builder, int64_t bodyLength)
+{
+    builder.startTable();
+    builder.field(3, bodyLength);
+    builder.offsetField(2, header);
+    builder.field(0, MetadataVersionV5);
+    builder.field(1, uint8_t(type));
+    return builder.finish(builder.endTable());
+}
+
+uint32_t rotateLeft(uint32_t value, int bits)
+{
+    return (value << bits) | (value >> (32 - bits));
+}
+
+// XXH32 of fewer than 16 bytes, as the LZ4 frame header checksum needs
+uint32_t shortXxHash32(const uint8_t *data, size_t size)
+{
+    const uint32_t prime1 = 2654435761u, prime2 = 2246822519u, prime3 = 3266489917u, prime4 = 668265263u,
+                   prime5 = 374761393u;
+    uint32_t hash = prime5 + uint32_t(size);
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+        uint32_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        hash = rotateLeft(hash + word * prime3, 17) * prime4;
+    }
+    for (; i < size; ++i)
+        hash = rotateLeft(hash + data[i] * prime5, 11) * prime1;
+    hash ^= hash >> 15;
+    hash *= prime2;
+    hash ^= hash >> 13;
+    hash *= prime3;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+// One LZ4 block: greedy matching against the last position with the same four bytes
+void lz4Block(const uint8_t *input, size_t size, std::vector<uint8_t> &out)
+{
+    const size_t MinMatch = 4;
+    const size_t LastLiterals = 5; // the format ends every block with at least this many literals
+    const size_t MatchLimit = 12; // and starts no match closer than this to the end
+    const int HashBits = 14;
+    std::vector<int32_t> table(size_t(1) << HashBits, -1);
+
+    auto read32 = [input](size_t at) {
+        uint32_t word;
+        std::memcpy(&word, input + at, sizeof(word));
+        return word;
+    };
+    auto appendLength = [&out](size_t length) {
+        for (; length >= 255; length -= 255)
+            out.push_back(255);
+        out.push_back(uint8_t(length));
+    };
+    auto sequence = [&](size_t literalsBegin, size_t literalsEnd, size_t distance, size_t matchLength) {
+        const size_t literals = literalsEnd - literalsBegin;
+        const size_t extraMatch = matchLength ? matchLength - MinMatch : 0;
+        out.push_back(uint8_t((std::min<size_t>(literals, 15) << 4) | std::min<size_t>(extraMatch, 15)));
+        if (literals >= 15)
+            appendLength(literals - 15);
+        out.insert(out.end(), input + literalsBegin, input + literalsEnd);
+        if (!matchLength)
+            return;
+        out.push_back(uint8_t(distance));
+        out.push_back(uint8_t(distance >> 8));
+        if (extraMatch >= 15)
+            appendLength(extraMatch - 15);
+    };
+
+    size_t anchor = 0;
+    size_t at = 0;
+    while (at + MatchLimit < size) {
+        const uint32_t word = read32(at);
+        const size_t slot = (word * 2654435761u) >> (32 - HashBits);
+        const int32_t candidate = table[slot];
+        table[slot] = int32_t(at);
+        if (candidate < 0 || at - size_t(candidate) > 65535 || read32(candidate) != word) {
+            ++at;
+            continue;
+        }
+        size_t length = MinMatch;
+        while (at + length < size - LastLiterals && input[candidate + length] == input[at + length])
+            ++length;
+        sequence(anchor, at, at - candidate, length);
+        at += length;
+        anchor = at;
+    }
+    sequence(anchor, size, 0, 0);
+}
+
+// An LZ4 frame of independent blocks without checksums of the content
+void lz4Frame(const uint8_t *input, size_t size, std::vector<uint8_t> &out)
+{
+    const size_t MaxBlock = size_t(4) << 20;
+    const uint8_t header[] = {0x60, 0x70}; // version 1, independent blocks; 4 MB blocks
+    const uint8_t magic[] = {0x04, 0x22, 0x4D, 0x18};
+    out.assign(magic, magic + 4);
+    out.insert(out.end(), header, header + 2);
+    out.push_back(uint8_t(shortXxHash32(header, 2) >> 8));
+
+    std::vector<uint8_t> block;
+    for (size_t begin = 0; begin < size; begin += MaxBlock) {
+        const size_t length = std::min(MaxBlock, size - begin);
+        block.clear();
+        lz4Block(input + begin, length, block);
+        // A block that does not shrink is stored as it is, flagged by the top bit
+        const bool stored = block.size() >= length;
+        const uint32_t word = stored ? uint32_t(length) | 0x80000000u : uint32_t(block.size());
+        for (int shift = 0; shift < 32; shift += 8)
+            out.push_back(uint8_t(word >> shift));
+        if (stored)
+            out.insert(out.end(), input + begin, input + begin + length);
+        else
+            out.insert(out.end(), block.begin(), block.end());
+    }
+    out.insert(out.end(), 4, 0);
+}
+
+size_t padded(size_t size, size_t alignment)
+{
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+
+bool isArrowPath(const std::string &path)
+{
+    auto endsWith = [&path](const char *suffix) {
+        const size_t length = std::strlen(suffix);
+        return path.size() >= length && path.compare(path.size() - length, length, suffix) == 0;
+    };
+    return endsWith(".arrow") || endsWith(".feather") || endsWith(".arrows");
+}
+
+ArrowResultWriter::ArrowResultWriter(std::FILE *file, ArrowCompression compression, size_t batchRows)
+    : file(file)
+    , compression(compression)
+    , batchRows(std::max<size_t>(1, batchRows))
+    , values(std::size(resultColumns))
+    , counts(std::size(resultColumns))
+{
+    idOffsets.reserve(this->batchRows + 1);
+    idOffsets.push_back(0);
+    for (size_t c = 0; c < std::size(resultColumns); ++c) {
+        if (resultColumns[c].value)
+            values[c].reserve(this->batchRows);
+        else
+            counts[c].reserve(this->batchRows);
+    }
+
+    writeBytes(FileMagic, sizeof(FileMagic));
+    FlatBuilder builder;
+    const size_t schema = addSchema(builder);
+    writeMessage(messageMetadata(SchemaHeader, schema, builder, 0), {}, 0);
+}
+
+void ArrowResultWriter::write(const std::string &id, const RoomLoads &loads)
+{
+    idText += id;
+    idOffsets.push_back(int32_t(idText.size()));
+    for (size_t c = 0; c < std::size(resultColumns); ++c) {
+        if (resultColumns[c].value)
+            values[c].push_back(loads.*resultColumns[c].value);
+        else
+            counts[c].push_back(loads.*resultColumns[c].count);
+    }
+    if (++heldRows == batchRows || idText.size() >= MaxIdTextBytes)
+        writeBatch();
+}
+
+void ArrowResultWriter::writeBatch()
+{
+    struct FieldNode
+    {
+        int64_t length;
+        int64_t nullCount;
+    };
+    struct Buffer
+    {
+        int64_t offset;
+        int64_t length;
+    };
+
+    // Every column has an empty validity buffer, as nothing is null
+    std::vector<std::pair<const void *, size_t>> raw;
+    raw.emplace_back(nullptr, 0);
+    raw.emplace_back(idOffsets.data(), idOffsets.size() * sizeof(int32_t));
+    raw.emplace_back(idText.data(), idText.size());
+    for (size_t c = 0; c < std::size(resultColumns); ++c) {
+        raw.emplace_back(nullptr, 0);
+        if (resultColumns[c].value)
+            raw.emplace_back(values[c].data(), values[c].size() * sizeof(double));
+        else
+            raw.emplace_back(counts[c].data(), counts[c].size() * sizeof(int32_t));
+    }
+
+    // A compressed buffer starts with its uncompressed length, or -1 when it is stored as it is
+    std::vector<std::pair<const void *, size_t>> body;
+    compressed.resize(raw.size());
+    for (size_t b = 0; b < raw.size(); ++b) {
+        const auto &[data, size] = raw[b];
+        if (compression == ArrowCompression::None || size == 0) {
+            body.push_back(raw[b]);
+            continue;
+        }
+        std::vector<uint8_t> frame;
+        lz4Frame(static_cast<const uint8_t *>(data), size, frame);
+        const bool stored = frame.size() >= size;
+        const int64_t length = stored ? -1 : int64_t(size);
+        std::vector<uint8_t> &out = compressed[b];
+        out.resize(sizeof(length));
+        std::memcpy(out.data(), &length, sizeof(length));
+        if (stored)
+            out.insert(out.end(), static_cast<const uint8_t *>(data), static_cast<const uint8_t *>(data) + size);
+        else
+            out.insert(out.end(), frame.begin(), frame.end());
+        body.emplace_back(out.data(), out.size());
+    }
+
+    std::vector<Buffer> buffers;
+    int64_t bodyLength = 0;
+    for (const auto &part : body) {
+        buffers.push_back({bodyLength, int64_t(part.second)});
+        bodyLength += int64_t(padded(part.second, BufferAlignment));
+    }
+    const std::vector<FieldNode> nodes(std::size(resultColumns) + 1, FieldNode{int64_t(heldRows), 0});
+
+    FlatBuilder builder;
+    size_t compressionTable = 0;
+    if (compression == ArrowCompression::Lz4) {
+        builder.startTable();
+        builder.field(0, uint8_t(0)); // LZ4_FRAME
+        builder.field(1, uint8_t(0)); // each buffer on its own
+        compressionTable = builder.endTable();
+    }
+    const size_t bufferVector = builder.structVector(buffers.data(), buffers.size(), sizeof(Buffer));
+    const size_t nodeVector = builder.structVector(nodes.data(), nodes.size(), sizeof(FieldNode));
+    builder.startTable();
+    builder.field(0, int64_t(heldRows));
+    builder.offsetField(1, nodeVector);
+    builder.offsetField(2, bufferVector);
+    if (compressionTable)
+        builder.offsetField(3, compressionTable);
+    const size_t batch = builder.endTable();
+    writeMessage(messageMetadata(RecordBatchHeader, batch, builder, bodyLength), body, bodyLength);
+
+    rowsWritten += heldRows;
+    heldRows = 0;
+    idOffsets.resize(1);
+    idText.clear();
+    for (std::vector<double> &column : values)
+        column.clear();
+    for (std::vector<int32_t> &column : counts)
+        column.clear();
+}
+
+void ArrowResultWriter::writeMessage(const std::vector<uint8_t> &metadata,
+                                     const std::vector<std::pair<const void *, size_t>> &body, int64_t bodyLength)
+{
+    // The metadata is padded so that the body, and with it every buffer, starts 64 byte aligned
+    const uint64_t start = position;
+    const size_t metadataLength = padded(start + 8 + metadata.size(), BufferAlignment) - start - 8;
+    const int32_t prefix[2] = {-1, int32_t(metadataLength)};
+    writeBytes(prefix, sizeof(prefix));
+    writeBytes(metadata.data(), metadata.size());
+    const char zeros[BufferAlignment] = {};
+    writeBytes(zeros, metadataLength - metadata.size());
+    for (const auto &[data, size] : body) {
+        writeBytes(data, size);
+        writeBytes(zeros, padded(size, BufferAlignment) - size);
+    }
+    if (bodyLength)
+        blocks.push_back({int64_t(start), int32_t(8 + metadataLength), bodyLength});
+}
+
+void ArrowResultWriter::writeBytes(const void *data, size_t size)
+{
+    if (size && !failed && std::fwrite(data, 1, size, file) != size)
+        failed = true;
+    position += size;
+}
+
+bool ArrowResultWriter::finish()
+{
+    if (finished)
+        return ok();
+    finished = true;
+    if (heldRows)
+        writeBatch();
+    const int32_t endOfStream[2] = {-1, 0};
+    writeBytes(endOfStream, sizeof(endOfStream));
+
+    // Blocks are written as the format's 24 byte struct, with 4 bytes of padding after the length
+    std::vector<uint8_t> blockBytes(blocks.size() * 24, 0);
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        std::memcpy(&blockBytes[i * 24], &blocks[i].offset, 8);
+        std::memcpy(&blockBytes[i * 24 + 8], &blocks[i].metadataLength, 4);
+        std::memcpy(&blockBytes[i * 24 + 16], &blocks[i].bodyLength, 8);
+    }
+    FlatBuilder builder;
+    const size_t recordBatches = builder.structVector(blockBytes.data(), blocks.size(), 24);
+    const size_t dictionaries = builder.structVector(nullptr, 0, 24);
+    const size_t schema = addSchema(builder);
+    builder.startTable();
+    builder.offsetField(1, schema);
+    builder.offsetField(2, dictionaries);
+    builder.offsetField(3, recordBatches);
+    builder.field(0, MetadataVersionV5);
+    const std::vector<uint8_t> footer = builder.finish(builder.endTable());
+    writeBytes(footer.data(), footer.size());
+    const int32_t footerLength = int32_t(footer.size());
+    writeBytes(&footerLength, sizeof(footerLength));
+    writeBytes(FileMagic, 6);
+    if (std::fflush(file) != 0)
+        failed = true;
+    return ok();
+}
@@ -0,0 +1,78 @@
+#ifndef ARROWWRITER_H
+#define ARROWWRITER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "loadcalc.h"
+
+// Room results as an Arrow IPC file (Feather v2), for loading into dataframes.
+// There is one typed column per RoomLoads term, named as in the struct, after a
+// utf8 id column. Rows are held until a record batch is full and then written,
+// so memory stays the same however many rooms a run has, and the file is never
+// sought in (it can go to a pipe).
+//
+// Uncompressed buffers are 64 byte aligned in the file, so a reader can map the
+// file and use the columns in place. With LZ4 each buffer is an LZ4 frame, which
+// is smaller but has to be decompressed to be read.
+
+enum class ArrowCompression { None, Lz4 };
+
+// True for .arrow, .feather and .arrows paths
+bool isArrowPath(const std::string &path);
+
+class ArrowResultWriter
+{
+public:
+    static const size_t DefaultBatchRows = 65536;
+
+    explicit ArrowResultWriter(std::FILE *file, ArrowCompression compression = ArrowCompression::None,
+                               size_t batchRows = DefaultBatchRows);
+
+    ArrowResultWriter(const ArrowResultWriter &) = delete;
+    ArrowResultWriter &operator=(const ArrowResultWriter &) = delete;
+
+    void write(const std::string &id, const RoomLoads &loads);
+
+    // Writes the rows still held and the footer, without which the file cannot be read
+    bool finish();
+
+    bool ok() const { return !failed; }
+    uint64_t rows() const { return rowsWritten + heldRows; }
+    size_t batches() const { return blocks.size(); }
+    uint64_t bytes() const { return position; }
+
+private:
+    struct Block
+    {
+        int64_t offset;
+        int32_t metadataLength;
+        int64_t bodyLength;
+    };
+
+    void writeBatch();
+    void writeMessage(const std::vector<uint8_t> &metadata, const std::vector<std::pair<const void *, size_t>> &body,
+                      int64_t bodyLength);
+    void writeBytes(const void *data, size_t size);
+
+    std::FILE *file;
+    ArrowCompression compression;
+    size_t batchRows;
+    bool failed = false;
+    bool finished = false;
+    uint64_t position = 0;
+    uint64_t rowsWritten = 0;
+    size_t heldRows = 0;
+
+    std::vector<int32_t> idOffsets;
+    std::string idText;
+    std::vector<std::vector<double>> values; // per double column
+    std::vector<std::vector<int32_t>> counts; // per int column
+    std::vector<std::vector<uint8_t>> compressed; // per buffer of the batch being written
+    std::vector<Block> blocks;
+};
+
+#endif // ARROWWRITER_H
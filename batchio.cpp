@@ -0,0 +1,806 @@
+#include "batchio.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+
+namespace {
+
+const size_t BlockSize = 1 << 20;
+const int IdField = -2;
+
+struct FieldSpec
+{
+    const char *name;
+    double RoomInput::*number;
+    bool RoomInput::*flag;
+    std::optional<double> RoomInput::*area;
+    OutputUnit RoomInput::*unit;
+    bool positive = false; // zero or less is invalid
+    double lowest = 0; // physically, for values drawn rather than read
+};
+
+FieldSpec numberField(const char *name, double RoomInput::*member) { return {name, member, nullptr, nullptr, nullptr}; }
+FieldSpec flagField(const char *name, bool RoomInput::*member) { return {name, nullptr, member, nullptr, nullptr}; }
+FieldSpec areaField(const char *name, std::optional<double> RoomInput::*member) { return {name, nullptr, nullptr, member, nullptr}; }
+FieldSpec unitField(const char *name, OutputUnit RoomInput::*member) { return {name, nullptr, nullptr, nullptr, member}; }
+FieldSpec positiveField(const char *name, double RoomInput::*member) { return {name, member, nullptr, nullptr, nullptr, true}; }
+FieldSpec temperatureField(const char *name, double RoomInput::*member) { return {name, member, nullptr, nullptr, nullptr, false, -HUGE_VAL}; }
+FieldSpec latitudeField(const char *name, std::optional<double> RoomInput::*member) { return {name, nullptr, nullptr, member, nullptr, false, -90}; }
+
+const FieldSpec roomFields[] = {
+    numberField("length", &RoomInput::length),
+    numberField("width", &RoomInput::width),
+    numberField("height", &RoomInput::height),
+    numberField("northWindowArea", &RoomInput::northWindowArea),
+    numberField("eastWindowArea", &RoomInput::eastWindowArea),
+    numberField("southWindowArea", &RoomInput::southWindowArea),
+    numberField("westWindowArea", &RoomInput::westWindowArea),
+    flagField("northShaded", &RoomInput::northShaded),
+    flagField("eastShaded", &RoomInput::eastShaded),
+    flagField("southShaded", &RoomInput::southShaded),
+    flagField("westShaded", &RoomInput::westShaded),
+    numberField("occupants", &RoomInput::occupants),
+    numberField("equipmentWatt", &RoomInput::equipmentWatt),
+    numberField("lightingWatt", &RoomInput::lightingWatt),
+    numberField("lightingMult", &RoomInput::lightingMult),
+    numberField("coolAdjust", &RoomInput::coolAdjust),
+    positiveField("coolCapacity", &RoomInput::coolCapacity),
+    unitField("coolUnits", &RoomInput::coolUnits),
+    areaField("wallArea", &RoomInput::wallArea),
+    areaField("windowArea", &RoomInput::windowArea),
+    areaField("ceilingArea", &RoomInput::ceilingArea),
+    areaField("floorArea", &RoomInput::floorArea),
+    numberField("wallU", &RoomInput::wallU),
+    numberField("windowU", &RoomInput::windowU),
+    numberField("ceilingU", &RoomInput::ceilingU),
+    numberField("floorU", &RoomInput::floorU),
+    temperatureField("targetTemp", &RoomInput::targetTemp),
+    temperatureField("externalTemp", &RoomInput::externalTemp),
+    numberField("ventilationAch", &RoomInput::ventilationAch),
+    numberField("leakageAch", &RoomInput::leakageAch),
+    numberField("heatAdjust", &RoomInput::heatAdjust),
+    positiveField("heatCapacity", &RoomInput::heatCapacity),
+    unitField("heatUnits", &RoomInput::heatUnits),
+    latitudeField("latitude", &RoomInput::latitude),
+    numberField("windowG", &RoomInput::windowG),
+};
+
+const int roomFieldCount = sizeof(roomFields) / sizeof(roomFields[0]);
+
+// Output columns use the GUI's result box names
+struct OutputColumn
+{
+    const char *name;
+    double (*value)(const RoomLoads &loads);
+};
+
+const OutputColumn outputColumns[] = {
+    {"OutRoomHeatHC", [](const RoomLoads &l) { return l.roomWatt; }},
+    {"OutWindowHeatHC", [](const RoomLoads &l) { return l.windowCoolWatt; }},
+    {"OutOccupantHeatHC", [](const RoomLoads &l) { return l.occupantWatt; }},
+    {"OutEquipmentHeatHC", [](const RoomLoads &l) { return l.equipmentWatt; }},
+    {"OutLightHeatHC", [](const RoomLoads &l) { return l.lightingWatt; }},
+    {"OutTotalCoolHC", [](const RoomLoads &l) { return l.totalCoolingWatt; }},
+    {"OutPeakCoolHC", [](const RoomLoads &l) { return l.peakCoolingWatt; }},
+    {"OutCoolUnitsHC", [](const RoomLoads &l) { return double(l.coolingUnits); }},
+    {"OutWallLossHC", [](const RoomLoads &l) { return l.wallWatt; }},
+    {"OutWindowLossHC", [](const RoomLoads &l) { return l.windowHeatWatt; }},
+    {"OutCeilingLossHC", [](const RoomLoads &l) { return l.ceilingWatt; }},
+    {"OutFloorLossHC", [](const RoomLoads &l) { return l.floorWatt; }},
+    {"OutTransmissionLossHC", [](const RoomLoads &l) { return l.transmissionWatt; }},
+    {"OutVentilationLossHC", [](const RoomLoads &l) { return l.ventWatt; }},
+    {"OutLeakageLossHC", [](const RoomLoads &l) { return l.leakWatt; }},
+    {"OutTotalHeatHC", [](const RoomLoads &l) { return l.totalHeatingWatt; }},
+    {"OutPeakHeatHC", [](const RoomLoads &l) { return l.peakHeatingWatt; }},
+    {"OutHeatUnitsHC", [](const RoomLoads &l) { return double(l.heatingUnits); }},
+};
+
+std::string_view trimmed(std::string_view text)
+{
+    while (!text.empty() && (text.front() == ' ' || text.front() == '\t'))
+        text.remove_prefix(1);
+    while (!text.empty() && (text.back() == ' ' || text.back() == '\t'))
+        text.remove_suffix(1);
+    return text;
+}
+
+bool equalsIgnoreCase(std::string_view a, std::string_view b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        char x = a[i] >= 'A' && a[i] <= 'Z' ? a[i] - 'A' + 'a' : a[i];
+        char y = b[i] >= 'A' && b[i] <= 'Z' ? b[i] - 'A' + 'a' : b[i];
+        if (x != y)
+            return false;
+    }
+    return true;
+}
+
+bool parseFlag(std::string_view text, bool &value)
+{
+    if (text == "1" || equalsIgnoreCase(text, "true") || equalsIgnoreCase(text, "yes")) {
+        value = true;
+        return true;
+    }
+    if (text == "0" || equalsIgnoreCase(text, "false") || equalsIgnoreCase(text, "no")) {
+        value = false;
+        return true;
+    }
+    return false;
+}
+
+bool parseUnit(std::string_view text, OutputUnit &unit)
+{
+    if (equalsIgnoreCase(text, "BTU")) {
+        unit = OutputUnit::BTU;
+        return true;
+    }
+    if (equalsIgnoreCase(text, "Watts") || equalsIgnoreCase(text, "W")) {
+        unit = OutputUnit::Watts;
+        return true;
+    }
+    return false;
+}
+
+// Splits a CSV line in place, unquoting quoted cells
+void splitCsv(char *begin, char *end, std::vector<std::string_view> &cells)
+{
+    cells.clear();
+    char *p = begin;
+    while (true) {
+        if (p < end && *p == '"') {
+            char *out = p;
+            char *start = p;
+            ++p;
+            while (p < end) {
+                if (*p == '"') {
+                    if (p + 1 < end && p[1] == '"') {
+                        *out++ = '"';
+                        p += 2;
+                        continue;
+                    }
+                    ++p;
+                    break;
+                }
+                *out++ = *p++;
+            }
+            cells.emplace_back(start, out - start);
+            while (p < end && *p != ',')
+                ++p;
+        } else {
+            char *start = p;
+            while (p < end && *p != ',')
+                ++p;
+            cells.emplace_back(start, p - start);
+        }
+        if (p >= end)
+            break;
+        ++p;
+    }
+}
+
+void skipSpace(char *&p, char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+        ++p;
+}
+
+// Reads a JSON string starting at the opening quote, unescaping in place
+bool readJsonString(char *&p, char *end, std::string_view &text)
+{
+    if (p >= end || *p != '"')
+        return false;
+    ++p;
+    char *out = p;
+    char *start = p;
+    while (p < end && *p != '"') {
+        if (*p == '\\') {
+            if (++p >= end)
+                return false;
+            switch (*p) {
+            case 'n': *out++ = '\n'; break;
+            case 't': *out++ = '\t'; break;
+            case 'r': *out++ = '\r'; break;
+            case 'b': *out++ = '\b'; break;
+            case 'f': *out++ = '\f'; break;
+            case 'u': return false; // not needed for room data
+            default: *out++ = *p; break;
+            }
+            ++p;
+        } else {
+            *out++ = *p++;
+        }
+    }
+    if (p >= end)
+        return false;
+    ++p;
+    text = std::string_view(start, out - start);
+    return true;
+}
+
+void appendCsvText(std::string &buffer, const std::string &text)
+{
+    if (text.find_first_of(",\"\n") == std::string::npos) {
+        buffer += text;
+        return;
+    }
+    buffer += '"';
+    for (char c : text) {
+        if (c == '"')
+            buffer += '"';
+        buffer += c;
+    }
+    buffer += '"';
+}
+
+void appendJsonText(std::string &buffer, const std::string &text)
+{
+    buffer += '"';
+    for (char c : text) {
+        switch (c) {
+        case '"': buffer += "\\\""; break;
+        case '\\': buffer += "\\\\"; break;
+        case '\n': buffer += "\\n"; break;
+        case '\t': buffer += "\\t"; break;
+        case '\r': buffer += "\\r"; break;
+        default: buffer += c; break;
+        }
+    }
+    buffer += '"';
+}
+
+void appendFixed(std::string &out, RecordFormat format, double value, int decimals)
+{
+    if (!std::isfinite(value)) {
+        out += format == RecordFormat::JsonLines ? "null" : "";
+        return;
+    }
+    char text[64];
+    auto result = std::to_chars(text, text + sizeof(text), value, std::chars_format::fixed, decimals);
+    out.append(text, result.ptr);
+}
+
+} // namespace
+
+
+RecordFormat formatForPath(const std::string &path)
+{
+    auto endsWith = [&](std::string_view suffix) {
+        return path.size() >= suffix.size()
+               && equalsIgnoreCase(std::string_view(path).substr(path.size() - suffix.size()), suffix);
+    };
+    return endsWith(".jsonl") || endsWith(".ndjson") ? RecordFormat::JsonLines : RecordFormat::Csv;
+}
+
+bool parseNumber(std::string_view text, double &value)
+{
+    text = trimmed(text);
+    if (!text.empty() && text.front() == '+')
+        text.remove_prefix(1);
+    if (text.empty())
+        return false;
+    const char *end = text.data() + text.size();
+    auto result = std::from_chars(text.data(), end, value);
+    return result.ec == std::errc() && result.ptr == end;
+}
+
+int roomFieldIndex(std::string_view name)
+{
+    name = trimmed(name);
+    if (name == "id")
+        return IdField;
+    for (int i = 0; i < roomFieldCount; ++i) {
+        if (name == roomFields[i].name)
+            return i;
+    }
+    return -1;
+}
+
+bool setRoomField(RoomInput &input, int field, std::string_view value)
+{
+    if (field < 0 || field >= roomFieldCount)
+        return true;
+
+    value = trimmed(value);
+    if (value.empty())
+        return true;
+
+    const FieldSpec &spec = roomFields[field];
+    if (spec.flag)
+        return parseFlag(value, input.*spec.flag);
+    if (spec.unit)
+        return parseUnit(value, input.*spec.unit);
+
+    double number = 0;
+    if (!parseNumber(value, number) || (spec.positive && !(number > 0)))
+        return false;
+    if (spec.area)
+        input.*spec.area = number;
+    else
+        input.*spec.number = number;
+    return true;
+}
+
+
+void setRoomFieldValue(RoomInput &input, int field, double value)
+{
+    if (field < 0 || field >= roomFieldCount)
+        return;
+
+    const FieldSpec &spec = roomFields[field];
+    if (spec.flag)
+        input.*spec.flag = value != 0;
+    else if (spec.unit)
+        input.*spec.unit = value != 0 ? OutputUnit::BTU : OutputUnit::Watts;
+    else if (spec.area)
+        input.*spec.area = value;
+    else
+        input.*spec.number = value;
+}
+
+const char *roomFieldName(int field)
+{
+    return field >= 0 && field < roomFieldCount ? roomFields[field].name : nullptr;
+}
+
+double roomFieldLowest(int field)
+{
+    return field >= 0 && field < roomFieldCount ? roomFields[field].lowest : 0;
+}
+
+double roomFieldValue(const RoomInput &input, int field)
+{
+    if (field < 0 || field >= roomFieldCount)
+        return std::nan("");
+
+    const FieldSpec &spec = roomFields[field];
+    if (spec.flag)
+        return input.*spec.flag ? 1 : 0;
+    if (spec.unit)
+        return input.*spec.unit == OutputUnit::BTU ? 1 : 0;
+    if (spec.area)
+        return (input.*spec.area).value_or(std::nan(""));
+    return input.*spec.number;
+}
+
+void appendRoomField(std::string &out, RecordFormat format, const RoomInput &input, int field)
+{
+    if (field < 0 || field >= roomFieldCount)
+        return;
+
+    const FieldSpec &spec = roomFields[field];
+    if (spec.flag) {
+        out += input.*spec.flag ? "true" : "false";
+    } else if (spec.unit) {
+        const char *name = input.*spec.unit == OutputUnit::BTU ? "BTU" : "Watts";
+        if (format == RecordFormat::JsonLines)
+            appendJsonText(out, name);
+        else
+            out += name;
+    } else {
+        appendExactNumber(out, format, roomFieldValue(input, field));
+    }
+}
+
+const char *resultFieldName(int field)
+{
+    return field >= 0 && field < int(std::size(outputColumns)) ? outputColumns[field].name : nullptr;
+}
+
+double resultFieldValue(const RoomLoads &loads, int field)
+{
+    return field >= 0 && field < int(std::size(outputColumns)) ? outputColumns[field].value(loads) : std::nan("");
+}
+
+void appendExactNumber(std::string &out, RecordFormat format, double value)
+{
+    if (!std::isfinite(value)) {
+        out += format == RecordFormat::JsonLines ? "null" : "";
+        return;
+    }
+    char text[64];
+    auto result = std::to_chars(text, text + sizeof(text), value);
+    out.append(text, result.ptr);
+}
+
+void appendText(std::string &out, RecordFormat format, const std::string &text)
+{
+    if (format == RecordFormat::JsonLines)
+        appendJsonText(out, text);
+    else
+        appendCsvText(out, text);
+}
+
+bool splitCsvFields(std::string_view line, std::vector<std::string> &fields)
+{
+    fields.clear();
+    size_t i = 0;
+    for (;;) {
+        std::string cell;
+        while (i < line.size() && (line[i] == ' ' || line[i] == '\t'))
+            ++i;
+        if (i < line.size() && line[i] == '"') {
+            for (++i;; ++i) {
+                if (i >= line.size())
+                    return false;
+                if (line[i] == '"') {
+                    if (i + 1 < line.size() && line[i + 1] == '"')
+                        ++i;
+                    else
+                        break;
+                }
+                cell += line[i];
+            }
+            ++i;
+            while (i < line.size() && line[i] != ',')
+                ++i;
+        } else {
+            const size_t comma = std::min(line.find(',', i), line.size());
+            cell = std::string(line.substr(i, comma - i));
+            while (!cell.empty() && (cell.back() == ' ' || cell.back() == '\t'))
+                cell.pop_back();
+            i = comma;
+        }
+        fields.push_back(std::move(cell));
+        if (i >= line.size())
+            return true;
+        ++i;
+    }
+}
+
+bool takeLine(char *&cursor, char *end, char *&lineBegin, char *&lineEnd)
+{
+    if (cursor >= end)
+        return false;
+    char *newline = static_cast<char *>(std::memchr(cursor, '\n', end - cursor));
+    lineBegin = cursor;
+    lineEnd = newline ? newline : end;
+    cursor = newline ? newline + 1 : end;
+    if (lineEnd > lineBegin && lineEnd[-1] == '\r')
+        --lineEnd;
+    return true;
+}
+
+
+RecordParser::RecordParser(RecordFormat format)
+    : format(format)
+{
+}
+
+bool RecordParser::parseHeader(char *begin, char *end, size_t line)
+{
+    // Tolerate a UTF-8 byte order mark from spreadsheet exports
+    if (end - begin >= 3 && std::memcmp(begin, "\xEF\xBB\xBF", 3) == 0)
+        begin += 3;
+
+    headerRead = true;
+    splitCsv(begin, end, cells);
+    columns.clear();
+    bool known = false;
+    for (std::string_view cell : cells) {
+        int field = roomFieldIndex(cell);
+        columns.push_back(field);
+        known = known || field >= 0;
+    }
+    if (!known) {
+        lastError = "line " + std::to_string(line) + ": header has no known room fields";
+        return false;
+    }
+    return true;
+}
+
+ReadStatus RecordParser::parse(char *begin, char *end, size_t line, RoomRecord &record)
+{
+    record.id.clear();
+    record.input = RoomInput();
+    ReadStatus status = format == RecordFormat::Csv ? parseCsv(begin, end, line, record)
+                                                    : parseJson(begin, end, line, record);
+    if (status == ReadStatus::Ok && record.id.empty())
+        record.id = std::to_string(line);
+    return status;
+}
+
+ReadStatus RecordParser::parseCsv(char *begin, char *end, size_t line, RoomRecord &record)
+{
+    splitCsv(begin, end, cells);
+    const size_t count = std::min(cells.size(), columns.size());
+    for (size_t i = 0; i < count; ++i) {
+        if (columns[i] == IdField) {
+            record.id.assign(cells[i]);
+        } else if (!setRoomField(record.input, columns[i], cells[i])) {
+            lastError = "line " + std::to_string(line) + ": invalid value '" + std::string(cells[i])
+                        + "' for " + roomFields[columns[i]].name;
+            return ReadStatus::Invalid;
+        }
+    }
+    return ReadStatus::Ok;
+}
+
+ReadStatus RecordParser::parseJson(char *begin, char *end, size_t line, RoomRecord &record)
+{
+    auto fail = [&](const char *reason) {
+        lastError = "line " + std::to_string(line) + ": " + reason;
+        return ReadStatus::Invalid;
+    };
+
+    char *p = begin;
+    auto skip = [&]() { skipSpace(p, end); };
+    skip();
+    if (p >= end || *p != '{')
+        return fail("expected a JSON object");
+    ++p;
+    skip();
+    if (p < end && *p == '}')
+        return ReadStatus::Ok;
+
+    while (p < end) {
+        std::string_view key;
+        skip();
+        if (!readJsonString(p, end, key))
+            return fail("expected a string key");
+        skip();
+        if (p >= end || *p != ':')
+            return fail("expected ':'");
+        ++p;
+        skip();
+
+        std::string_view value;
+        if (p < end && *p == '"') {
+            if (!readJsonString(p, end, value))
+                return fail("unterminated string");
+        } else {
+            char *start = p;
+            while (p < end && *p != ',' && *p != '}')
+                ++p;
+            value = trimmed(std::string_view(start, p - start));
+            if (value == "null")
+                value = std::string_view();
+            else if (!value.empty() && (value.front() == '{' || value.front() == '['))
+                return fail("nested values are not supported");
+        }
+
+        int field = roomFieldIndex(key);
+        if (field == IdField) {
+            record.id.assign(value);
+        } else if (!setRoomField(record.input, field, value)) {
+            return fail(("invalid value for " + std::string(key)).c_str());
+        }
+
+        skip();
+        if (p < end && *p == ',') {
+            ++p;
+            continue;
+        }
+        if (p < end && *p == '}')
+            return ReadStatus::Ok;
+        return fail("expected ',' or '}'");
+    }
+    return fail("unterminated object");
+}
+
+
+RecordReader::RecordReader(std::FILE *file, RecordFormat format)
+    : file(file)
+    , parser(format)
+    , buffer(BlockSize)
+{
+}
+
+// Keeps any partial line and reads more behind it, growing only for lines longer than a block
+bool RecordReader::fill()
+{
+    if (eof)
+        return false;
+    size_t remaining = bufferEnd - bufferStart;
+    std::memmove(buffer.data(), buffer.data() + bufferStart, remaining);
+    bufferStart = 0;
+    bufferEnd = remaining;
+    if (bufferEnd == buffer.size())
+        buffer.resize(buffer.size() * 2);
+    size_t got = std::fread(buffer.data() + bufferEnd, 1, buffer.size() - bufferEnd, file);
+    bufferEnd += got;
+    totalBytes += got;
+    if (got == 0)
+        eof = true;
+    return got != 0;
+}
+
+bool RecordReader::readLine(char *&begin, char *&end)
+{
+    while (true) {
+        char *data = buffer.data();
+        bool complete = std::memchr(data + bufferStart, '\n', bufferEnd - bufferStart) != nullptr;
+        if (complete || (eof && bufferStart < bufferEnd)) {
+            char *cursor = data + bufferStart;
+            takeLine(cursor, data + bufferEnd, begin, end);
+            bufferStart = cursor - data;
+            ++line;
+            return true;
+        }
+        if (!fill() && bufferStart == bufferEnd)
+            return false;
+    }
+}
+
+bool RecordReader::readHeader()
+{
+    char *begin = nullptr;
+    char *end = nullptr;
+    while (parser.needsHeader() && readLine(begin, end)) {
+        if (!trimmed(std::string_view(begin, end - begin)).empty())
+            return parser.parseHeader(begin, end, line);
+    }
+    return true;
+}
+
+ReadStatus RecordReader::next(RoomRecord &record)
+{
+    if (parser.needsHeader() && !readHeader())
+        return ReadStatus::Invalid;
+
+    char *begin = nullptr;
+    char *end = nullptr;
+    while (readLine(begin, end)) {
+        if (trimmed(std::string_view(begin, end - begin)).empty())
+            continue;
+        return parser.parse(begin, end, line, record);
+    }
+    return ReadStatus::End;
+}
+
+bool RecordReader::readBlock(std::vector<char> &block, size_t &firstLine, size_t maxBytes)
+{
+    while (true) {
+        char *data = buffer.data();
+        size_t available = bufferEnd - bufferStart;
+        if (available >= maxBytes || eof) {
+            // Cut after the last complete line within maxBytes, or after the first one if it is longer
+            char *begin = data + bufferStart;
+            char *cut = nullptr;
+            for (char *p = begin + std::min(available, maxBytes); p > begin; --p) {
+                if (p[-1] == '\n') {
+                    cut = p;
+                    break;
+                }
+            }
+            if (!cut) {
+                char *newline = static_cast<char *>(std::memchr(begin, '\n', available));
+                cut = newline ? newline + 1 : nullptr;
+            }
+            if (!cut && eof && available > 0)
+                cut = data + bufferEnd;
+
+            if (cut) {
+                block.assign(begin, cut);
+                bufferStart = cut - data;
+                firstLine = line + 1;
+                line += std::count(block.begin(), block.end(), '\n');
+                if (block.back() != '\n')
+                    ++line;
+                return true;
+            }
+            if (eof)
+                return false;
+        }
+        if (!fill() && bufferStart == bufferEnd)
+            return false;
+    }
+}
+
+
+void ResultFormatter::appendNumber(std::string &out, double value) const
+{
+    appendFixed(out, format, value, 2);
+}
+
+void ResultFormatter::appendHeader(std::string &out) const
+{
+    if (format != RecordFormat::Csv)
+        return;
+    out += "id";
+    for (const OutputColumn &column : outputColumns) {
+        out += ',';
+        out += column.name;
+    }
+    out += '\n';
+}
+
+void ResultFormatter::append(std::string &out, const RoomRecord &record, const RoomLoads &loads) const
+{
+    appendId(out, record);
+    appendColumns(out, loads);
+}
+
+void ResultFormatter::appendId(std::string &out, const RoomRecord &record) const
+{
+    if (format == RecordFormat::Csv) {
+        appendCsvText(out, record.id);
+    } else {
+        out += "{\"id\":";
+        appendJsonText(out, record.id);
+    }
+}
+
+void ResultFormatter::appendColumns(std::string &out, const RoomLoads &loads) const
+{
+    if (format == RecordFormat::Csv) {
+        for (const OutputColumn &column : outputColumns) {
+            out += ',';
+            appendNumber(out, column.value(loads));
+        }
+    } else {
+        for (const OutputColumn &column : outputColumns) {
+            out += ",\"";
+            out += column.name;
+            out += "\":";
+            appendNumber(out, column.value(loads));
+        }
+        out += '}';
+    }
+    out += '\n';
+}
+
+
+void ColumnFormatter::appendHeader(std::string &out) const
+{
+    if (format != RecordFormat::Csv)
+        return;
+    out += "id";
+    for (const Column &column : columns) {
+        out += ',';
+        out += column.name;
+    }
+    out += '\n';
+}
+
+void ColumnFormatter::append(std::string &out, const std::string &id, const double *values) const
+{
+    if (format == RecordFormat::Csv) {
+        appendCsvText(out, id);
+        for (size_t i = 0; i < columns.size(); ++i) {
+            out += ',';
+            appendFixed(out, format, values[i], columns[i].decimals);
+        }
+    } else {
+        out += "{\"id\":";
+        appendJsonText(out, id);
+        for (size_t i = 0; i < columns.size(); ++i) {
+            out += ",\"";
+            out += columns[i].name;
+            out += "\":";
+            appendFixed(out, format, values[i], columns[i].decimals);
+        }
+        out += '}';
+    }
+    out += '\n';
+}
+
+
+ColumnWriter::ColumnWriter(std::FILE *file, RecordFormat format, std::vector<ColumnFormatter::Column> columns)
+    : file(file)
+    , formatter(format, std::move(columns))
+{
+    buffer.reserve(BlockSize + 4096);
+    formatter.appendHeader(buffer);
+}
+
+void ColumnWriter::write(const std::string &id, const double *values)
+{
+    formatter.append(buffer, id, values);
+    if (buffer.size() >= BlockSize) {
+        failed |= std::fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size();
+        buffer.clear();
+    }
+}
+
+bool ColumnWriter::flush()
+{
+    failed |= !buffer.empty() && std::fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size();
+    buffer.clear();
+    failed |= std::fflush(file) != 0;
+    return !failed;
+}
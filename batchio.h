@@ -0,0 +1,196 @@
+#ifndef BATCHIO_H
+#define BATCHIO_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "loadcalc.h"
+
+// Streaming CSV / JSON Lines reading and writing of rooms for batch runs.
+// Input is read in fixed size blocks so memory use does not grow with file size.
+
+enum class RecordFormat { Csv, JsonLines };
+
+// Picks JSON Lines for .jsonl/.ndjson paths, CSV otherwise
+RecordFormat formatForPath(const std::string &path);
+
+struct RoomRecord
+{
+    std::string id;
+    RoomInput input;
+};
+
+enum class ReadStatus { Ok, Invalid, End };
+
+// Index of a RoomInput field by its column / key name, -1 if unknown
+int roomFieldIndex(std::string_view name);
+
+// Applies one field to a room. Empty values keep the default, as an empty line edit does.
+bool setRoomField(RoomInput &input, int field, std::string_view value);
+
+// Sets a field from a number: flags are set when non-zero and units are BTU when non-zero
+void setRoomFieldValue(RoomInput &input, int field, double value);
+
+// Column / key name of a field index, nullptr if out of range
+const char *roomFieldName(int field);
+
+// Lowest value a field can physically take: zero for sizes, loads and rates,
+// -90 for latitude and no limit for temperatures
+double roomFieldLowest(int field);
+
+// A field as a number, the inverse of setRoomFieldValue(); unset areas are NaN
+double roomFieldValue(const RoomInput &input, int field);
+
+// Appends a field as text that setRoomField() reads back exactly: flags as true/false,
+// units as Watts/BTU and unset areas as an empty cell (null in JSON)
+void appendRoomField(std::string &out, RecordFormat format, const RoomInput &input, int field);
+
+// Result column name (the GUI's output box) and value of an index, nullptr if out of range
+const char *resultFieldName(int field);
+double resultFieldValue(const RoomLoads &loads, int field);
+
+// Shortest text that reads back as the same double; non-finite values are empty (null in JSON)
+void appendExactNumber(std::string &out, RecordFormat format, double value);
+
+// Appends text quoted as the format requires
+void appendText(std::string &out, RecordFormat format, const std::string &text);
+
+// Locale independent numeric parsing (accepts a leading '+')
+bool parseNumber(std::string_view text, double &value);
+
+// Splits one CSV line into its fields, honouring double quoted fields with "" escapes
+bool splitCsvFields(std::string_view line, std::vector<std::string> &fields);
+
+// Splits the next line off a block of text, dropping the line ending
+bool takeLine(char *&cursor, char *end, char *&lineBegin, char *&lineEnd);
+
+// Turns single lines into rooms. Parsing works in place on the line's characters.
+// Copies are independent, so each worker thread can own one.
+class RecordParser
+{
+public:
+    explicit RecordParser(RecordFormat format);
+
+    bool needsHeader() const { return format == RecordFormat::Csv && !headerRead; }
+    bool parseHeader(char *begin, char *end, size_t line);
+
+    // Parses one non-empty line. The room id defaults to the line number.
+    ReadStatus parse(char *begin, char *end, size_t line, RoomRecord &record);
+
+    const std::string &error() const { return lastError; }
+
+private:
+    ReadStatus parseCsv(char *begin, char *end, size_t line, RoomRecord &record);
+    ReadStatus parseJson(char *begin, char *end, size_t line, RoomRecord &record);
+
+    RecordFormat format;
+    bool headerRead = false;
+    std::vector<int> columns;
+    std::vector<std::string_view> cells;
+    std::string lastError;
+};
+
+class RecordReader
+{
+public:
+    RecordReader(std::FILE *file, RecordFormat format);
+
+    // Reads the next room. Invalid rows are reported and can be skipped by calling again.
+    ReadStatus next(RoomRecord &record);
+
+    // Consumes the CSV header (if any) so that the parser can be copied to other threads
+    bool readHeader();
+
+    // Reads whole lines, roughly maxBytes worth, for parsing elsewhere
+    bool readBlock(std::vector<char> &block, size_t &firstLine, size_t maxBytes);
+
+    const RecordParser &recordParser() const { return parser; }
+    const std::string &error() const { return parser.error(); }
+    size_t lineNumber() const { return line; }
+    uint64_t bytesRead() const { return totalBytes; }
+
+private:
+    bool readLine(char *&begin, char *&end);
+    bool fill();
+
+    std::FILE *file;
+    RecordParser parser;
+    std::vector<char> buffer;
+    size_t bufferStart = 0;
+    size_t bufferEnd = 0;
+    bool eof = false;
+    size_t line = 0;
+    uint64_t totalBytes = 0;
+};
+
+class ResultFormatter
+{
+public:
+    explicit ResultFormatter(RecordFormat format) : format(format) {}
+
+    RecordFormat recordFormat() const { return format; }
+
+    // Column names for CSV output, nothing for JSON Lines
+    void appendHeader(std::string &out) const;
+    void append(std::string &out, const RoomRecord &record, const RoomLoads &loads) const;
+
+    // The two halves of append(): the room id, then the result columns and line end.
+    // The columns depend only on the loads, so they can be kept and reused.
+    void appendId(std::string &out, const RoomRecord &record) const;
+    void appendColumns(std::string &out, const RoomLoads &loads) const;
+
+private:
+    void appendNumber(std::string &out, double value) const;
+
+    RecordFormat format;
+};
+
+// Rows of named numeric columns keyed by room id, for results other than RoomLoads
+class ColumnFormatter
+{
+public:
+    struct Column
+    {
+        const char *name;
+        int decimals;
+    };
+
+    ColumnFormatter(RecordFormat format, std::vector<Column> columns)
+        : format(format)
+        , columns(std::move(columns))
+    {
+    }
+
+    void appendHeader(std::string &out) const;
+
+    // values holds one number per column
+    void append(std::string &out, const std::string &id, const double *values) const;
+
+private:
+    RecordFormat format;
+    std::vector<Column> columns;
+};
+
+// Writes a ColumnFormatter's header and then its rows to a file in 1 MiB blocks.
+// flush() writes what is left and is false once any write has failed; call it
+// before closing the file.
+class ColumnWriter
+{
+public:
+    ColumnWriter(std::FILE *file, RecordFormat format, std::vector<ColumnFormatter::Column> columns);
+
+    void write(const std::string &id, const double *values);
+    bool flush();
+
+private:
+    std::FILE *file;
+    ColumnFormatter formatter;
+    std::string buffer;
+    bool failed = false;
+};
+
+#endif // BATCHIO_H
@@ -0,0 +1,576 @@
+// Performance benchmarks for the calculation engine, the form and PDF export.
+//
+//   btucalc_bench [--out results.json] [--filter text] [--repetitions n] [--min-time seconds]
+//   btucalc_bench --baseline baseline.json [--threshold percent] [--out results.json]
+//
+// Every benchmark reports nanoseconds per operation; the median of the
+// repetitions is what a comparison looks at. With --baseline the run exits
+// with status 3 when any benchmark is slower than the baseline by more than
+// the threshold (10% unless given).
+
+#include <QApplication>
+#include <QFile>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QKeyEvent>
+#include <QLineEdit>
+#include <QPainter>
+#include <QPicture>
+#include <QTemporaryDir>
+#include <QTextBrowser>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "arrowwriter.h"
+#include "building.h"
+#include "loadbatch.h"
+#include "loadcalc.h"
+#include "mainwindow.h"
+#include "monitor.h"
+#include "reportassets.h"
+#include "reportwriter.h"
+#include "scenario.h"
+#include "workpool.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const int FormatVersion = 1;
+
+struct BenchOptions
+{
+    QString outputPath;
+    QString baselinePath;
+    QString filter;
+    int repetitions = 5;
+    double minTime = 0.2; // seconds per repetition
+    double threshold = 10; // percent
+
+    bool wants(const QString &name) const { return filter.isEmpty() || name.contains(filter); }
+};
+
+struct Measurement
+{
+    QString name;
+    double median = 0; // ns per operation
+    double min = 0;
+    double max = 0;
+    double p99 = -1; // only for benchmarks timed one operation at a time
+    uint64_t iterations = 0;
+    int repetitions = 0;
+};
+
+volatile double sink;
+
+double nanoseconds(Clock::duration duration)
+{
+    return std::chrono::duration<double, std::nano>(duration).count();
+}
+
+double median(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    const size_t middle = values.size() / 2;
+    return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+}
+
+// Runs body (which does opsPerCall operations) often enough for each
+// repetition to last about minTime, after one warm-up call
+Measurement measure(const BenchOptions &options, const QString &name, double opsPerCall,
+                    const std::function<void()> &body)
+{
+    Measurement result;
+    result.name = name;
+    body();
+
+    // Double the count until a run takes a quarter of the target, then scale it up to the target
+    const double target = options.minTime * 1e9;
+    uint64_t iterations = 1;
+    for (;;) {
+        const Clock::time_point started = Clock::now();
+        for (uint64_t i = 0; i < iterations; ++i)
+            body();
+        const double elapsed = nanoseconds(Clock::now() - started);
+        if (elapsed >= target / 4) {
+            iterations = std::max(iterations, uint64_t(iterations * target / elapsed));
+            break;
+        }
+        iterations *= 2;
+    }
+
+    std::vector<double> perOperation;
+    for (int repetition = 0; repetition < options.repetitions; ++repetition) {
+        const Clock::time_point started = Clock::now();
+        for (uint64_t i = 0; i < iterations; ++i)
+            body();
+        perOperation.push_back(nanoseconds(Clock::now() - started) / (iterations * opsPerCall));
+    }
+    result.median = median(perOperation);
+    result.min = *std::min_element(perOperation.begin(), perOperation.end());
+    result.max = *std::max_element(perOperation.begin(), perOperation.end());
+    result.iterations = iterations;
+    result.repetitions = options.repetitions;
+    return result;
+}
+
+// Same mix of rooms on every run
+std::vector<RoomInput> sampleRooms(size_t count)
+{
+    std::vector<RoomInput> rooms(count);
+    uint32_t state = 12345;
+    auto next = [&state](double low, double high) {
+        state = state * 1664525u + 1013904223u;
+        return low + (high - low) * (state >> 8) / double(1 << 24);
+    };
+    for (RoomInput &room : rooms) {
+        room.length = next(2, 12);
+        room.width = next(2, 10);
+        room.height = next(2.2, 3.5);
+        room.northWindowArea = next(0, 4);
+        room.eastWindowArea = next(0, 4);
+        room.southWindowArea = next(0, 6);
+        room.westWindowArea = next(0, 4);
+        room.southShaded = next(0, 1) < 0.5;
+        room.occupants = std::floor(next(1, 8));
+        room.equipmentWatt = next(0, 800);
+        room.lightingWatt = next(0, 300);
+        room.lightingMult = 2.8;
+        room.coolAdjust = 10;
+        room.coolCapacity = 2500;
+        room.wallU = next(0.3, 2);
+        room.windowU = next(1, 5.8);
+        room.ceilingU = next(0.2, 3);
+        room.floorU = next(0.25, 1);
+        room.targetTemp = 21;
+        room.externalTemp = next(-5, 5);
+        room.ventilationAch = next(0.5, 4);
+        room.leakageAch = next(0.2, 1);
+        room.heatAdjust = 10;
+        room.heatCapacity = 1500;
+    }
+    return rooms;
+}
+
+// A 20 storey block of 25 x 20 rooms, every fifth column of rooms an unheated corridor
+std::vector<RoomInput> sampleBuilding(BuildingLayout &layout)
+{
+    const int across = 25, deep = 20, storeys = 20;
+    auto zone = [&](int x, int y, int z) { return (z * deep + y) * across + x; };
+    std::vector<RoomInput> rooms(across * deep * storeys);
+    layout = BuildingLayout();
+    for (int z = 0; z < storeys; ++z) {
+        for (int y = 0; y < deep; ++y) {
+            for (int x = 0; x < across; ++x) {
+                RoomInput &room = rooms[zone(x, y, z)];
+                room.length = 5;
+                room.width = 4;
+                room.height = 2.7;
+                room.northWindowArea = y == deep - 1 ? 1.5 : 0;
+                room.southWindowArea = y == 0 ? 1.5 : 0;
+                room.eastWindowArea = x == across - 1 ? 1.5 : 0;
+                room.westWindowArea = x == 0 ? 1.5 : 0;
+                room.externalTemp = -3;
+                if (x + 1 < across)
+                    layout.partitions.push_back({zone(x, y, z), zone(x + 1, y, z), 10.8, 1.8, PartitionKind::Wall});
+                if (y + 1 < deep)
+                    layout.partitions.push_back({zone(x, y, z), zone(x, y + 1, z), 13.5, 1.8, PartitionKind::Wall});
+                if (z + 1 < storeys)
+                    layout.partitions.push_back({zone(x, y, z + 1), zone(x, y, z), 20, 1.2, PartitionKind::Floor});
+                if (x % 5 == 2)
+                    layout.unheated.push_back(zone(x, y, z));
+            }
+        }
+    }
+    return rooms;
+}
+
+RoomReport sampleReport()
+{
+    RoomReport room;
+    room.name = "Living Room";
+    room.input = sampleRooms(1).front();
+    room.loads = calculateRoomLoads(room.input);
+    room.lightType = "Florescent";
+    room.wallMaterial = "Cavity Wall (Insulated)";
+    room.windowMaterial = "Double Glazed (modern, low-e)";
+    room.ceilingMaterial = "Insulated Ceiling";
+    room.floorMaterial = "Insulated Ground-Bearing Slab";
+    return room;
+}
+
+void runCalculationBenchmarks(const BenchOptions &options, const std::function<void(Measurement)> &report)
+{
+    const std::vector<RoomInput> rooms = sampleRooms(1024);
+    size_t next = 0;
+    if (options.wants("calc.single_room")) {
+        report(measure(options, "calc.single_room", 1, [&]() {
+            sink = calculateRoomLoads(rooms[next++ & 1023]).peakCoolingWatt;
+        }));
+    }
+
+    // The same rooms with the window gains from the sun, the tables already built
+    if (options.wants("calc.solar_room")) {
+        std::vector<RoomInput> sunnyRooms = rooms;
+        for (size_t i = 0; i < sunnyRooms.size(); ++i)
+            sunnyRooms[i].latitude = 50 + double(i % 8);
+        for (const RoomInput &room : sunnyRooms)
+            sink = calculateRoomLoads(room).peakCoolingWatt;
+        report(measure(options, "calc.solar_room", 1, [&]() {
+            sink = calculateRoomLoads(sunnyRooms[next++ & 1023]).peakCoolingWatt;
+        }));
+    }
+
+    // The whole building from scratch, then again after one room changes
+    if (options.wants("calc.building_solve") || options.wants("calc.building_update")) {
+        BuildingLayout layout;
+        const std::vector<RoomInput> buildingRooms = sampleBuilding(layout);
+        BuildingModel model;
+        std::string error;
+        model.build(buildingRooms, layout, error);
+        if (options.wants("calc.building_solve")) {
+            report(measure(options, "calc.building_solve", 1, [&]() {
+                model.build(buildingRooms, layout, error);
+                sink = double(model.solve().iterations);
+            }));
+        }
+        if (options.wants("calc.building_update")) {
+            model.solve();
+            size_t changes = 0;
+            report(measure(options, "calc.building_update", 1, [&]() {
+                const size_t zone = changes++ % buildingRooms.size();
+                RoomInput room = model.room(zone);
+                room.targetTemp = room.targetTemp == 19 ? 22 : 19;
+                model.updateZone(zone, room, error);
+                sink = double(model.solve().iterations);
+            }));
+        }
+    }
+
+    // One field typed into the active scenario of 32, then every scenario's results for the comparison
+    if (options.wants("calc.scenario_edit")) {
+        ScenarioSet scenarios("Scenario 1", {InputSnapshot(rooms[0]), {}});
+        for (int i = 1; i < 32; ++i) {
+            scenarios.duplicate(0, "Scenario");
+            RoomInput room = scenarios.state(i).input.input();
+            room.windowU = 0.8 + 0.1 * i;
+            scenarios.edit(i, {scenarios.state(i).input.with(room), {}});
+        }
+        size_t edits = 0;
+        report(measure(options, "calc.scenario_edit", 1, [&]() {
+            const size_t active = edits % scenarios.size();
+            RoomInput room = scenarios.state(active).input.input();
+            room.length = 3 + double(edits++ % 7);
+            scenarios.edit(active, {scenarios.state(active).input.with(room), scenarios.state(active).selections});
+            for (size_t i = 0; i < scenarios.size(); ++i)
+                sink = scenarios.loads(i).totalHeatingWatt;
+        }));
+    }
+
+    // Sensor readings for 10,000 rooms, each room read about every 6 s, with its minutes completing as it goes
+    if (options.wants("calc.monitor_ingest")) {
+        const size_t roomCount = 10000;
+        const size_t readingCount = 100000;
+        std::vector<std::string> ids(roomCount);
+        std::vector<RoomInput> inputs(roomCount);
+        for (size_t i = 0; i < roomCount; ++i) {
+            ids[i] = "room" + std::to_string(i);
+            inputs[i] = rooms[i & 1023];
+        }
+        LoadMonitor monitor(ids, inputs);
+        std::vector<MonitorEvent> events;
+        Reading reading;
+        uint64_t sent = 0;
+        report(measure(options, "calc.monitor_ingest", readingCount, [&]() {
+            for (size_t i = 0; i < readingCount; ++i, ++sent) {
+                reading.time = double(sent) * 6.0 / roomCount;
+                reading.room = ids[sent % roomCount];
+                reading.indoor = 21 + double(sent % 5);
+                reading.outdoor = -5 + double(sent % 30);
+                monitor.add(reading, events);
+            }
+            events.clear();
+            sink = double(monitor.stats().minutes);
+        }));
+    }
+
+    const size_t batchSize = 100000;
+    RoomBatch batch;
+    batch.reserve(batchSize);
+    for (size_t i = 0; i < batchSize; ++i)
+        batch.append(rooms[i & 1023]);
+    LoadBatch loads;
+    loads.resize(batchSize);
+    if (options.wants("calc.batch")) {
+        report(measure(options, "calc.batch", batchSize, [&]() {
+            calculateLoadBatch(batch, loads, 0, batchSize);
+            sink = loads.columns[LoadBatch::PeakCoolingWatt][batchSize - 1];
+        }));
+    }
+
+    if (options.wants("calc.batch_parallel")) {
+        WorkPool pool;
+        const size_t chunk = 4096;
+        report(measure(options, "calc.batch_parallel", batchSize, [&]() {
+            for (size_t begin = 0; begin < batchSize; begin += chunk)
+                pool.submit([&, begin]() { calculateLoadBatch(batch, loads, begin, std::min(batchSize, begin + chunk)); });
+            pool.wait();
+            sink = loads.columns[LoadBatch::PeakCoolingWatt][batchSize - 1];
+        }));
+    }
+
+    // Columnar export of the batch's results, to a file that is rewritten each time
+    if (options.wants("calc.arrow_export")) {
+        calculateLoadBatch(batch, loads, 0, batchSize);
+        if (std::FILE *file = std::tmpfile()) {
+            const std::string id = "room";
+            report(measure(options, "calc.arrow_export", batchSize, [&]() {
+                std::rewind(file);
+                ArrowResultWriter writer(file);
+                for (size_t i = 0; i < batchSize; ++i)
+                    writer.write(id, loads.at(i));
+                sink = double(writer.finish());
+            }));
+            std::fclose(file);
+        }
+    }
+}
+
+// Time from a key press in the length box to the new room heat load being shown.
+// Alternates typing a digit and deleting it so every keystroke changes the result.
+void runFormBenchmarks(const BenchOptions &options, const std::function<void(Measurement)> &report)
+{
+    if (!options.wants("gui.keystroke"))
+        return;
+
+    // The form calculates nothing until its catalog is loaded, after the first paint
+    MainWindow window;
+    bool interactive = false;
+    QObject::connect(&window, &MainWindow::interactive, [&interactive]() { interactive = true; });
+    window.show();
+    for (int pass = 0; pass < 1000 && !interactive; ++pass)
+        QApplication::processEvents();
+    if (!interactive) {
+        std::fprintf(stderr, "gui.keystroke: the window never became interactive\n");
+        return;
+    }
+    QLineEdit *length = window.findChild<QLineEdit *>("LELengthHC");
+    QLineEdit *width = window.findChild<QLineEdit *>("LEWidthHC");
+    QTextBrowser *output = window.findChild<QTextBrowser *>("OutRoomHeatHC");
+    if (!length || !width || !output) {
+        std::fprintf(stderr, "gui.keystroke: form widgets not found\n");
+        return;
+    }
+    width->setText("4");
+    length->setText("3");
+    length->setFocus();
+    length->end(false);
+    QApplication::processEvents();
+
+    bool typeDigit = true;
+    auto keystroke = [&]() {
+        const QString before = output->toPlainText();
+        const int key = typeDigit ? Qt::Key_5 : Qt::Key_Backspace;
+        const QString text = typeDigit ? QStringLiteral("5") : QString();
+        typeDigit = !typeDigit;
+
+        const Clock::time_point started = Clock::now();
+        QKeyEvent press(QEvent::KeyPress, key, Qt::NoModifier, text);
+        QKeyEvent release(QEvent::KeyRelease, key, Qt::NoModifier, text);
+        QApplication::sendEvent(length, &press);
+        QApplication::sendEvent(length, &release);
+        for (int pass = 0; pass < 1000 && output->toPlainText() == before; ++pass)
+            QApplication::processEvents();
+        return nanoseconds(Clock::now() - started);
+    };
+
+    Measurement result = measure(options, "gui.keystroke", 1, [&]() { keystroke(); });
+
+    // One keystroke at a time for the tail
+    std::vector<double> latencies;
+    for (int i = 0; i < 1000; ++i)
+        latencies.push_back(keystroke());
+    std::sort(latencies.begin(), latencies.end());
+    result.p99 = latencies[latencies.size() * 99 / 100];
+    report(result);
+}
+
+void runPdfBenchmarks(const BenchOptions &options, const std::function<void(Measurement)> &report)
+{
+    // A4 at the 300 dpi ReportWriter prints at, with the default 100 dpi watermark
+    const QSize page(2480, 3508);
+    const int dpi = 300;
+
+    if (options.wants("pdf.decode")) {
+        report(measure(options, "pdf.decode", 1, [&]() {
+            sink = ReportAssets::decodeSources().logo.width();
+        }));
+    }
+
+    if (options.wants("pdf.transform")) {
+        const ReportAssets::Sources decoded = ReportAssets::decodeSources();
+        report(measure(options, "pdf.transform", 1, [&]() {
+            ReportAssets::Sources sources = decoded;
+            sink = ReportAssets::buildPageImages(sources, page, dpi, ReportAssets::WatermarkDpi).watermark.width();
+        }));
+    }
+
+    const RoomReport room = sampleReport();
+    if (options.wants("pdf.text_layout")) {
+        report(measure(options, "pdf.text_layout", 1, [&]() {
+            QPicture picture;
+            QPainter painter(&picture);
+            ReportWriter::drawRoomText(painter, page, room);
+            painter.end();
+            sink = picture.size();
+        }));
+    }
+
+    // The whole export, with the branding images already cached as they are after the first one
+    if (options.wants("pdf.export_room")) {
+        QTemporaryDir directory;
+        const QString fileName = directory.filePath("bench.pdf");
+        report(measure(options, "pdf.export_room", 1, [&]() {
+            ReportWriter writer(fileName, {room}, false, nullptr);
+            writer.render();
+        }));
+    }
+}
+
+QJsonObject toJson(const Measurement &measurement)
+{
+    QJsonObject object;
+    object["name"] = measurement.name;
+    object["unit"] = "ns";
+    object["median"] = std::round(measurement.median * 10) / 10;
+    object["min"] = std::round(measurement.min * 10) / 10;
+    object["max"] = std::round(measurement.max * 10) / 10;
+    if (measurement.p99 >= 0)
+        object["p99"] = std::round(measurement.p99 * 10) / 10;
+    object["iterations"] = double(measurement.iterations);
+    object["repetitions"] = measurement.repetitions;
+    return object;
+}
+
+// Prints each benchmark against the baseline; returns false when any regressed past the threshold
+bool compareWithBaseline(const QJsonArray &results, const QJsonObject &baseline, double threshold)
+{
+    QHash<QString, double> before;
+    for (const QJsonValue &value : baseline["benchmarks"].toArray())
+        before.insert(value["name"].toString(), value["median"].toDouble());
+
+    bool ok = true;
+    std::fprintf(stderr, "%-24s %14s %14s %9s\n", "benchmark", "baseline ns", "current ns", "change");
+    for (const QJsonValue &value : results) {
+        const QString name = value["name"].toString();
+        const double current = value["median"].toDouble();
+        if (!before.contains(name) || before.value(name) <= 0) {
+            std::fprintf(stderr, "%-24s %14s %14.1f %9s\n", qPrintable(name), "-", current, "new");
+            continue;
+        }
+        const double change = (current / before.value(name) - 1) * 100;
+        const bool regressed = change > threshold;
+        ok = ok && !regressed;
+        std::fprintf(stderr, "%-24s %14.1f %14.1f %+8.1f%%%s\n", qPrintable(name), before.value(name), current,
+                     change, regressed ? "  REGRESSED" : "");
+    }
+    return ok;
+}
+
+bool parseOptions(const QStringList &arguments, BenchOptions &options)
+{
+    for (int i = 1; i < arguments.size(); ++i) {
+        const QString &arg = arguments.at(i);
+        const bool hasValue = i + 1 < arguments.size();
+        if (arg == "--out" && hasValue)
+            options.outputPath = arguments.at(++i);
+        else if (arg == "--baseline" && hasValue)
+            options.baselinePath = arguments.at(++i);
+        else if (arg == "--filter" && hasValue)
+            options.filter = arguments.at(++i);
+        else if (arg == "--repetitions" && hasValue)
+            options.repetitions = std::max(1, arguments.at(++i).toInt());
+        else if (arg == "--min-time" && hasValue)
+            options.minTime = std::max(0.001, arguments.at(++i).toDouble());
+        else if (arg == "--threshold" && hasValue)
+            options.threshold = arguments.at(++i).toDouble();
+        else
+            return false;
+    }
+    return true;
+}
+
+} // namespace
+
+
+int main(int argc, char *argv[])
+{
+    // Needs no display; the form is driven through an offscreen window
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication application(argc, argv);
+
+    BenchOptions options;
+    if (!parseOptions(application.arguments(), options)) {
+        std::fprintf(stderr,
+                     "Usage: btucalc_bench [--out <results.json>] [--filter <text>] [--repetitions <n>]\n"
+                     "                     [--min-time <seconds>] [--baseline <results.json> [--threshold <percent>]]\n");
+        return 1;
+    }
+
+    QJsonObject baseline;
+    if (!options.baselinePath.isEmpty()) {
+        QFile file(options.baselinePath);
+        QJsonParseError error;
+        if (file.open(QIODevice::ReadOnly))
+            baseline = QJsonDocument::fromJson(file.readAll(), &error).object();
+        if (!file.isOpen() || error.error != QJsonParseError::NoError || baseline["version"].toInt() != FormatVersion) {
+            std::fprintf(stderr, "Cannot read baseline %s\n", qPrintable(options.baselinePath));
+            return 1;
+        }
+    }
+
+    QJsonArray results;
+    const std::function<void(Measurement)> report = [&](const Measurement &measurement) {
+        std::fprintf(stderr, "%-24s %12.1f ns\n", qPrintable(measurement.name), measurement.median);
+        results.append(toJson(measurement));
+    };
+    runCalculationBenchmarks(options, report);
+    runFormBenchmarks(options, report);
+    runPdfBenchmarks(options, report);
+
+    QJsonObject context;
+    context["kernel"] = kernelIsaName(activeKernelIsa());
+    context["qt"] = qVersion();
+    context["threads"] = int(std::thread::hardware_concurrency());
+    QJsonObject document;
+    document["version"] = FormatVersion;
+    document["context"] = context;
+    document["benchmarks"] = results;
+    const QByteArray json = QJsonDocument(document).toJson(QJsonDocument::Indented);
+
+    if (options.outputPath.isEmpty() || options.outputPath == "-") {
+        std::fwrite(json.constData(), 1, json.size(), stdout);
+    } else {
+        QFile file(options.outputPath);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(json) != json.size()) {
+            std::fprintf(stderr, "Cannot write %s\n", qPrintable(options.outputPath));
+            return 1;
+        }
+    }
+
+    if (!baseline.isEmpty() && !compareWithBaseline(results, baseline, options.threshold))
+        return 3;
+    return 0;
+}
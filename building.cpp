@@ -0,0 +1,451 @@
+#include "building.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
+
+#include "batchio.h"
+#include "mappedfile.h"
+
+namespace {
+
+const double SecondsPerStep = SecondsPerHour; // one step per hour of weather
+const double RelativeTolerance = 1e-10; // of the residual against the right hand side
+const double AreaSlack = 1e-9; // shared areas may round a little past the room's own
+
+std::string lineError(size_t line, const std::string &message)
+{
+    return "line " + std::to_string(line) + ": " + message;
+}
+
+bool findZone(const std::unordered_map<std::string_view, int> &zones, const std::string &id, int &zone)
+{
+    const auto found = zones.find(id);
+    if (found == zones.end())
+        return false;
+    zone = found->second;
+    return true;
+}
+
+} // namespace
+
+
+bool parseBuildingLayout(const char *begin, const char *end, const std::vector<std::string> &zoneIds,
+                         BuildingLayout &layout, std::string &error)
+{
+    layout = BuildingLayout();
+    if (end - begin >= 3 && std::memcmp(begin, "\xEF\xBB\xBF", 3) == 0)
+        begin += 3;
+
+    // A repeated id names its first room
+    std::unordered_map<std::string_view, int> zones;
+    for (size_t i = 0; i < zoneIds.size(); ++i)
+        zones.emplace(zoneIds[i], int(i));
+
+    std::vector<std::string> fields;
+    size_t line = 0;
+    for (const char *cursor = begin; cursor < end;) {
+        const char *newline = static_cast<const char *>(std::memchr(cursor, '\n', end - cursor));
+        std::string_view text(cursor, (newline ? newline : end) - cursor);
+        cursor = newline ? newline + 1 : end;
+        ++line;
+        if (!text.empty() && text.back() == '\r')
+            text.remove_suffix(1);
+        if (text.find_first_not_of(" \t,") == std::string_view::npos || text.front() == '#')
+            continue;
+
+        if (!splitCsvFields(text, fields) || fields.size() < 2) {
+            error = lineError(line, "expected kind,first,second,area,u");
+            return false;
+        }
+        int first;
+        if (fields[0] == "unheated") {
+            if (!findZone(zones, fields[1], first)) {
+                error = lineError(line, "unknown room \"" + fields[1] + "\"");
+                return false;
+            }
+            layout.unheated.push_back(first);
+            continue;
+        }
+
+        Partition partition;
+        if (fields[0] == "wall") {
+            partition.kind = PartitionKind::Wall;
+        } else if (fields[0] == "floor") {
+            partition.kind = PartitionKind::Floor;
+        } else if (fields[0] == "kind" && layout.partitions.empty() && layout.unheated.empty()) {
+            continue; // header
+        } else {
+            error = lineError(line, "unknown kind \"" + fields[0] + "\"");
+            return false;
+        }
+        if (fields.size() != 5) {
+            error = lineError(line, "expected kind,first,second,area,u");
+            return false;
+        }
+        for (int side : {1, 2}) {
+            if (!findZone(zones, fields[side], side == 1 ? partition.first : partition.second)) {
+                error = lineError(line, "unknown room \"" + fields[side] + "\"");
+                return false;
+            }
+        }
+        if (!parseNumber(fields[3], partition.area) || !parseNumber(fields[4], partition.uValue)) {
+            error = lineError(line, "bad area or u value");
+            return false;
+        }
+        layout.partitions.push_back(partition);
+    }
+    return true;
+}
+
+bool loadBuildingLayout(const std::string &path, const std::vector<std::string> &zoneIds, BuildingLayout &layout,
+                        std::string &error)
+{
+    MappedFile file;
+    if (!file.open(path)) {
+        error = "cannot open " + path;
+        return false;
+    }
+    if (!parseBuildingLayout(file.data(), file.data() + file.size(), zoneIds, layout, error)) {
+        error = path + ": " + error;
+        return false;
+    }
+    return true;
+}
+
+bool BuildingModel::build(const std::vector<RoomInput> &rooms, const BuildingLayout &layout, std::string &error)
+{
+    zones.assign(rooms.size(), Zone());
+    const int count = int(rooms.size());
+    std::vector<size_t> degree(rooms.size() + 1, 0);
+    for (size_t p = 0; p < layout.partitions.size(); ++p) {
+        const Partition &partition = layout.partitions[p];
+        if (partition.first < 0 || partition.first >= count || partition.second < 0 || partition.second >= count
+            || partition.first == partition.second) {
+            error = "partition " + std::to_string(p + 1) + ": must join two different rooms";
+            return false;
+        }
+        if (!(partition.area >= 0) || !(partition.uValue >= 0) || !std::isfinite(partition.area * partition.uValue)) {
+            error = "partition " + std::to_string(p + 1) + ": bad area or u value";
+            return false;
+        }
+        Zone &first = zones[partition.first];
+        Zone &second = zones[partition.second];
+        if (partition.kind == PartitionKind::Wall) {
+            first.sharedWall += partition.area;
+            second.sharedWall += partition.area;
+        } else {
+            first.sharedFloor += partition.area;
+            second.sharedCeiling += partition.area;
+        }
+        ++degree[partition.first];
+        ++degree[partition.second];
+    }
+
+    // Each partition appears in the rows of both its zones
+    rowStart.assign(rooms.size() + 1, 0);
+    for (size_t i = 0; i < rooms.size(); ++i)
+        rowStart[i + 1] = rowStart[i] + degree[i];
+    neighbour.resize(rowStart.back());
+    conductance.resize(rowStart.back());
+    std::vector<size_t> next(rowStart.begin(), rowStart.end() - 1);
+    for (const Partition &partition : layout.partitions) {
+        const double value = partition.area * partition.uValue;
+        neighbour[next[partition.first]] = partition.second;
+        conductance[next[partition.first]++] = value;
+        neighbour[next[partition.second]] = partition.first;
+        conductance[next[partition.second]++] = value;
+        zones[partition.first].partitionConductance += value;
+        zones[partition.second].partitionConductance += value;
+    }
+
+    temperature.resize(rooms.size());
+    results.assign(rooms.size(), ZoneLoads());
+    for (size_t i = 0; i < rooms.size(); ++i) {
+        zones[i].room = rooms[i];
+        if (!refreshZone(zones[i], error)) {
+            error = "room " + std::to_string(i + 1) + ": " + error;
+            return false;
+        }
+        temperature[i] = rooms[i].targetTemp;
+    }
+    for (int zone : layout.unheated) {
+        if (zone < 0 || zone >= count) {
+            error = "unheated room " + std::to_string(zone + 1) + " is not in the building";
+            return false;
+        }
+        zones[zone].heated = false;
+    }
+    floatingDirty = true;
+    return true;
+}
+
+bool BuildingModel::refreshZone(Zone &zone, std::string &error) const
+{
+    const SurfaceAreas areas = resolveSurfaceAreas(zone.room);
+    auto remaining = [&error](double area, double shared, const char *surface, double &left) {
+        left = area - shared;
+        if (left >= -AreaSlack * std::max(1.0, std::fabs(area))) {
+            left = std::max(0.0, left);
+            return true;
+        }
+        error = std::string("shared ") + surface + " area is larger than the room's " + surface + " area";
+        return false;
+    };
+
+    // Only what is left of each surface faces the outside
+    RoomInput outside = zone.room;
+    double wall, floor, ceiling;
+    if (!remaining(areas.wall, zone.sharedWall, "wall", wall)
+        || !remaining(areas.floor, zone.sharedFloor, "floor", floor)
+        || !remaining(areas.ceiling, zone.sharedCeiling, "ceiling", ceiling))
+        return false;
+    outside.wallArea = wall;
+    outside.floorArea = floor;
+    outside.ceilingArea = ceiling;
+    zone.outsideConductance = heatLossCoefficients(outside).total();
+    zone.capacitance = massPerFloorArea * areas.floor;
+    return true;
+}
+
+bool BuildingModel::updateZone(size_t zone, const RoomInput &room, std::string &error)
+{
+    Zone changed = zones[zone];
+    changed.room = room;
+    if (!refreshZone(changed, error))
+        return false;
+    const bool joined = zones[zone].outsideConductance + zones[zone].partitionConductance > 0;
+    zones[zone] = changed;
+    if (floatingDirty)
+        return true;
+
+    // An unheated zone's own row is rebuilt by every solve, so only a heated zone's new
+    // target needs passing on to the unheated zones next to it
+    if (!changed.heated) {
+        floatingDirty = joined != (changed.outsideConductance + changed.partitionConductance > 0);
+        return true;
+    }
+    temperature[zone] = room.targetTemp;
+    for (size_t e = rowStart[zone]; e < rowStart[zone + 1]; ++e) {
+        const int k = floatingIndex[neighbour[e]];
+        if (k >= 0)
+            floating.fixedInflow[k] = fixedInflow(neighbour[e]);
+    }
+    return true;
+}
+
+void BuildingModel::setHeated(size_t zone, bool heated)
+{
+    zones[zone].heated = heated;
+    floatingDirty = true;
+}
+
+void BuildingModel::prepareFloating()
+{
+    const size_t count = zones.size();
+    floatingIndex.assign(count, -1);
+    floating.zones.clear();
+    for (size_t i = 0; i < count; ++i) {
+        const Zone &zone = zones[i];
+        if (zone.heated) {
+            temperature[i] = zone.room.targetTemp;
+        } else if (zone.outsideConductance + zone.partitionConductance > 0) {
+            // A zone joined to nothing keeps its temperature
+            floatingIndex[i] = int(floating.zones.size());
+            floating.zones.push_back(int(i));
+        }
+    }
+
+    // Heated neighbours are known, so their share moves to the right hand side
+    const size_t unknowns = floating.zones.size();
+    floating.rowStart.assign(1, 0);
+    floating.neighbour.clear();
+    floating.conductance.clear();
+    floating.fixedInflow.assign(unknowns, 0);
+    for (size_t k = 0; k < unknowns; ++k) {
+        const int i = floating.zones[k];
+        for (size_t e = rowStart[i]; e < rowStart[i + 1]; ++e) {
+            if (floatingIndex[neighbour[e]] >= 0) {
+                floating.neighbour.push_back(floatingIndex[neighbour[e]]);
+                floating.conductance.push_back(conductance[e]);
+            }
+        }
+        floating.rowStart.push_back(floating.neighbour.size());
+        floating.fixedInflow[k] = fixedInflow(i);
+    }
+    for (auto *vector : {&floating.diagonal, &floating.rhs, &floating.solution, &floating.residual,
+                         &floating.scaled, &floating.direction, &floating.product})
+        vector->assign(unknowns, 0);
+    floatingDirty = false;
+}
+
+double BuildingModel::fixedInflow(int zone) const
+{
+    double inflow = 0;
+    for (size_t e = rowStart[zone]; e < rowStart[zone + 1]; ++e) {
+        if (floatingIndex[neighbour[e]] < 0)
+            inflow += conductance[e] * temperature[neighbour[e]];
+    }
+    return inflow;
+}
+
+SolveStats BuildingModel::solveFloating(const std::vector<double> &outside, const std::vector<double> &previous,
+                                    double stepSeconds)
+{
+    if (floatingDirty)
+        prepareFloating();
+    SolveStats stats;
+    const size_t unknowns = floating.zones.size();
+    stats.unknowns = unknowns;
+    if (unknowns == 0)
+        return stats;
+
+    double *x = floating.solution.data();
+    double *r = floating.residual.data();
+    double *z = floating.scaled.data();
+    double *p = floating.direction.data();
+    double *q = floating.product.data();
+    const double *d = floating.diagonal.data();
+    for (size_t k = 0; k < unknowns; ++k) {
+        const int i = floating.zones[k];
+        const Zone &zone = zones[i];
+        const double storage = stepSeconds > 0 ? zone.capacitance / stepSeconds : 0;
+        floating.diagonal[k] = zone.outsideConductance + zone.partitionConductance + storage;
+        floating.rhs[k] = zone.outsideConductance * outside[i] + floating.fixedInflow[k]
+                    + (storage > 0 ? storage * previous[i] : 0);
+        x[k] = temperature[i];
+    }
+    auto multiply = [this, unknowns, d](const double *in, double *out) {
+        for (size_t k = 0; k < unknowns; ++k) {
+            double sum = d[k] * in[k];
+            for (size_t e = floating.rowStart[k]; e < floating.rowStart[k + 1]; ++e)
+                sum -= floating.conductance[e] * in[floating.neighbour[e]];
+            out[k] = sum;
+        }
+    };
+    auto dot = [unknowns](const double *a, const double *b) {
+        double sum = 0;
+        for (size_t k = 0; k < unknowns; ++k)
+            sum += a[k] * b[k];
+        return sum;
+    };
+
+    // Nothing drives the floating zones, so they settle at zero, which no limit relative to
+    // the right hand side would accept
+    const double rhsSquared = dot(floating.rhs.data(), floating.rhs.data());
+    if (rhsSquared == 0) {
+        for (size_t k = 0; k < unknowns; ++k)
+            temperature[floating.zones[k]] = 0;
+        return stats;
+    }
+
+    // Conjugate gradients preconditioned by the diagonal, starting from the current temperatures
+    multiply(x, q);
+    for (size_t k = 0; k < unknowns; ++k) {
+        r[k] = floating.rhs[k] - q[k];
+        z[k] = r[k] / d[k];
+        p[k] = z[k];
+    }
+    const double limit = RelativeTolerance * RelativeTolerance * rhsSquared;
+    double rz = dot(r, z);
+    const int maxIterations = int(std::min<size_t>(4 * unknowns + 100, 100000));
+    while (dot(r, r) > limit) {
+        if (stats.iterations == maxIterations) {
+            stats.converged = false;
+            break;
+        }
+        ++stats.iterations;
+        multiply(p, q);
+        const double curvature = dot(p, q);
+        if (!(curvature > 0))
+            break;
+        const double step = rz / curvature;
+        for (size_t k = 0; k < unknowns; ++k) {
+            x[k] += step * p[k];
+            r[k] -= step * q[k];
+            z[k] = r[k] / d[k];
+        }
+        const double nextRz = dot(r, z);
+        const double beta = nextRz / rz;
+        rz = nextRz;
+        for (size_t k = 0; k < unknowns; ++k)
+            p[k] = z[k] + beta * p[k];
+    }
+    for (size_t k = 0; k < unknowns; ++k)
+        temperature[floating.zones[k]] = x[k];
+    return stats;
+}
+
+double BuildingModel::heatFlow(size_t zone, double outside, double &toOutside, double &toNeighbours) const
+{
+    const double own = temperature[zone];
+    toOutside = zones[zone].outsideConductance * (own - outside);
+    toNeighbours = 0;
+    for (size_t k = rowStart[zone]; k < rowStart[zone + 1]; ++k)
+        toNeighbours += conductance[k] * (own - temperature[neighbour[k]]);
+    return toOutside + toNeighbours;
+}
+
+SolveStats BuildingModel::solve()
+{
+    std::vector<double> outside(zones.size());
+    for (size_t i = 0; i < zones.size(); ++i)
+        outside[i] = zones[i].room.externalTemp;
+    const SolveStats stats = solveFloating(outside, {}, 0);
+
+    for (size_t i = 0; i < zones.size(); ++i) {
+        const RoomInput &room = zones[i].room;
+        ZoneLoads &result = results[i];
+        result = ZoneLoads();
+        result.temperature = temperature[i];
+        const double flow = heatFlow(i, outside[i], result.outsideWatt, result.partitionWatt);
+        if (!zones[i].heated)
+            continue;
+        // A room its neighbours keep warmer than its target needs no heating
+        result.totalHeatingWatt = std::max(0.0, flow);
+        result.peakHeatingWatt = result.totalHeatingWatt * (1 + room.heatAdjust / 100);
+        result.heatingUnits = unitsRequired(Watts(result.peakHeatingWatt), room.heatCapacity, room.heatUnits);
+    }
+    return stats;
+}
+
+SolveStats BuildingModel::simulate(const std::vector<float> &outdoor, std::vector<ZoneTransient> &transient)
+{
+    transient.assign(zones.size(), ZoneTransient());
+    SolveStats total;
+    if (outdoor.empty())
+        return total;
+
+    std::vector<double> outside(zones.size(), outdoor[0]);
+    total = solveFloating(outside, {}, 0);
+    for (size_t i = 0; i < zones.size(); ++i)
+        transient[i].minTemperature = transient[i].maxTemperature = temperature[i];
+
+    std::vector<double> previous;
+    for (size_t hour = 0; hour < outdoor.size(); ++hour) {
+        previous = temperature;
+        std::fill(outside.begin(), outside.end(), outdoor[hour]);
+        const SolveStats step = solveFloating(outside, previous, SecondsPerStep);
+        total.iterations += step.iterations;
+        total.converged = total.converged && step.converged;
+
+        for (size_t i = 0; i < zones.size(); ++i) {
+            ZoneTransient &result = transient[i];
+            result.minTemperature = std::min(result.minTemperature, temperature[i]);
+            result.maxTemperature = std::max(result.maxTemperature, temperature[i]);
+            if (!zones[i].heated)
+                continue;
+            // A heated zone's own temperature does not change, so nothing goes into storage
+            double toOutside, toNeighbours;
+            const double heating = std::max(0.0, heatFlow(i, outside[i], toOutside, toNeighbours));
+            result.heatingKWh += heating / 1000; // over one hour
+            if (heating > result.peakHeatingWatt) {
+                result.peakHeatingWatt = heating;
+                result.peakHeatingHour = int(hour);
+            }
+        }
+    }
+    return total;
+}
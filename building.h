@@ -0,0 +1,148 @@
+#ifndef BUILDING_H
+#define BUILDING_H
+
+#include <string>
+#include <vector>
+
+#include "loadcalc.h"
+
+// Rooms of one building calculated together. Each room is a zone and every
+// surface two rooms share is a conductance between them rather than a loss to
+// the outside, so a room between heated neighbours only pays for its own
+// outside walls, windows and air.
+//
+// Heated zones are held at their target temperature and unheated ones (halls,
+// stores) settle wherever the heat flowing through them leaves them. Those
+// temperatures are the solution of a sparse symmetric positive definite system,
+// one row per unheated zone, solved by conjugate gradients with the
+// previous solution as the starting point; after one room changes only a few
+// iterations are needed. The heating of each heated zone then follows from its
+// row directly.
+//
+// The transient model gives every zone a thermal capacitance and steps it
+// through an hourly outdoor temperature with implicit Euler steps, each one
+// the same kind of solve.
+
+enum class PartitionKind { Wall, Floor };
+
+// A surface shared by two zones. A floor partition is the floor of first and
+// the ceiling of second.
+struct Partition
+{
+    int first = 0;
+    int second = 0;
+    double area = 0; // m2
+    double uValue = 0; // W/m2.K
+    PartitionKind kind = PartitionKind::Wall;
+};
+
+struct BuildingLayout
+{
+    std::vector<Partition> partitions;
+    std::vector<int> unheated; // zones left to float
+};
+
+// Reads a layout from CSV text with the columns kind,first,second,area,u where
+// kind is wall, floor or unheated (which only names first). Zones are named by
+// their room ids. A header line and lines starting with '#' are skipped.
+bool parseBuildingLayout(const char *begin, const char *end, const std::vector<std::string> &zoneIds,
+                         BuildingLayout &layout, std::string &error);
+bool loadBuildingLayout(const std::string &path, const std::vector<std::string> &zoneIds, BuildingLayout &layout,
+                        std::string &error);
+
+struct ZoneLoads
+{
+    double temperature = 0;
+    double outsideWatt = 0; // through the zone's own envelope and air
+    double partitionWatt = 0; // to the neighbouring zones, negative when they heat it
+    double totalHeatingWatt = 0; // zero for an unheated zone
+    double peakHeatingWatt = 0;
+    int heatingUnits = 0;
+};
+
+struct ZoneTransient
+{
+    double heatingKWh = 0;
+    double peakHeatingWatt = 0;
+    int peakHeatingHour = -1;
+    double minTemperature = 0;
+    double maxTemperature = 0;
+};
+
+struct SolveStats
+{
+    size_t unknowns = 0; // unheated zones
+    int iterations = 0; // conjugate gradient iterations, summed over the steps of a simulation
+    bool converged = true;
+};
+
+class BuildingModel
+{
+public:
+    // Thermal mass per m2 of floor for the transient model, a medium weight construction
+    double massPerFloorArea = 165000; // J/m2.K
+
+    // Fails when a partition names a missing zone or joins a zone to itself, or when a
+    // zone's shared surfaces are larger than the surfaces it has
+    bool build(const std::vector<RoomInput> &rooms, const BuildingLayout &layout, std::string &error);
+
+    size_t zoneCount() const { return zones.size(); }
+    const RoomInput &room(size_t zone) const { return zones[zone].room; }
+
+    // Replaces one room's inputs; partitions and their conductances stay as they are.
+    // The next solve() starts from the temperatures of the last one.
+    bool updateZone(size_t zone, const RoomInput &room, std::string &error);
+    void setHeated(size_t zone, bool heated);
+
+    // Steady state at each room's own external temperature
+    SolveStats solve();
+    const ZoneLoads &loads(size_t zone) const { return results[zone]; }
+
+    // Starts from the steady state at the first hour's temperature and takes one step per hour
+    SolveStats simulate(const std::vector<float> &outdoor, std::vector<ZoneTransient> &transient);
+
+private:
+    struct Zone
+    {
+        RoomInput room;
+        double sharedWall = 0;
+        double sharedFloor = 0;
+        double sharedCeiling = 0;
+        double outsideConductance = 0; // W/K
+        double capacitance = 0; // J/K
+        double partitionConductance = 0; // sum over the zone's neighbours
+        bool heated = true;
+    };
+
+    // The unheated zones' part of the network numbered in the order of zones, rebuilt
+    // after a change to any zone and reused by every step of a simulation
+    struct FloatingSystem
+    {
+        std::vector<int> zones;
+        std::vector<size_t> rowStart;
+        std::vector<int> neighbour;
+        std::vector<double> conductance;
+        std::vector<double> fixedInflow; // W from the heated neighbours at their targets
+        // Per solve, kept to save allocating them each step
+        std::vector<double> diagonal, rhs, solution, residual, scaled, direction, product;
+    };
+
+    bool refreshZone(Zone &zone, std::string &error) const;
+    void prepareFloating();
+    double fixedInflow(int zone) const;
+    SolveStats solveFloating(const std::vector<double> &outside, const std::vector<double> &previous, double stepSeconds);
+    double heatFlow(size_t zone, double outside, double &toOutside, double &toNeighbours) const;
+
+    std::vector<Zone> zones;
+    // Neighbours and conductances of zone i are at [rowStart[i], rowStart[i + 1])
+    std::vector<size_t> rowStart;
+    std::vector<int> neighbour;
+    std::vector<double> conductance;
+    std::vector<double> temperature;
+    std::vector<ZoneLoads> results;
+    FloatingSystem floating;
+    std::vector<int> floatingIndex; // each zone's row in floating, -1 when it has none
+    bool floatingDirty = true;
+};
+
+#endif // BUILDING_H
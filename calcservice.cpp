@@ -0,0 +1,788 @@
+#include "calcservice.h"
+
+#include "batchio.h"
+
+namespace {
+
+int countFields(const char *(*name)(int))
+{
+    int count = 0;
+    while (name(count))
+        ++count;
+    return count;
+}
+
+// Counted on first use; the field tables are not ready yet while statics are being initialised
+int roomFieldCount()
+{
+    static const int count = countFields(roomFieldName);
+    return count;
+}
+
+int resultFieldCount()
+{
+    static const int count = countFields(resultFieldName);
+    return count;
+}
+
+} // namespace
+
+
+BinaryHello binaryHello()
+{
+    return {BinaryProtocolVersion, uint32_t(roomFieldCount()), uint32_t(resultFieldCount())};
+}
+
+#ifdef _WIN32
+
+ServeStats runCalcServer(const std::string &, const ServeOptions &, std::string &error)
+{
+    error = "The calculation service needs Unix domain sockets, which this build does not support";
+    ServeStats stats;
+    stats.ok = false;
+    return stats;
+}
+
+LoadStats runLoadGenerator(const std::string &, const std::vector<RoomInput> &, const LoadOptions &,
+                           std::string &error)
+{
+    error = "The load generator needs Unix domain sockets, which this build does not support";
+    LoadStats stats;
+    stats.ok = false;
+    return stats;
+}
+
+#else
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "loadbatch.h"
+#include "resultcache.h"
+#include "workpool.h"
+
+namespace {
+
+// A client that takes longer than this to make room for an answer is dropped
+const int WriteTimeoutMs = 5000;
+// How often the accept/read loop looks for a stop request
+const int PollIntervalMs = 200;
+const size_t ReadChunk = 1 << 16;
+
+volatile std::sig_atomic_t stopRequested = 0;
+
+void requestStop(int)
+{
+    stopRequested = 1;
+}
+
+std::string describeHello(const BinaryHello &hello)
+{
+    return "version " + std::to_string(hello.version) + " with " + std::to_string(hello.roomFields)
+           + " room fields and " + std::to_string(hello.resultFields) + " result fields";
+}
+
+bool setAddress(const std::string &path, sockaddr_un &address, std::string &error)
+{
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        error = "Socket path is empty or too long: " + path;
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+int connectTo(const std::string &path, std::string &error)
+{
+    sockaddr_un address;
+    if (!setAddress(path, address, error))
+        return -1;
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0) {
+        error = "Cannot connect to " + path + ": " + std::strerror(errno);
+        if (fd >= 0)
+            ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Writes the whole buffer, waiting while the socket is full
+bool writeAll(int fd, const char *data, size_t size)
+{
+    while (size > 0) {
+        const ssize_t written = ::send(fd, data, size, 0);
+        if (written > 0) {
+            data += written;
+            size -= size_t(written);
+        } else if (written < 0 && errno == EINTR) {
+            continue;
+        } else if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            pollfd waiting = {fd, POLLOUT, 0};
+            if (::poll(&waiting, 1, WriteTimeoutMs) <= 0)
+                return false;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Appends a frame header now and fills in its length once the payload follows it
+size_t beginFrame(std::string &out, uint32_t id, FrameType type)
+{
+    const size_t start = out.size();
+    const FrameHeader header = {0, id, uint32_t(type)};
+    out.append(reinterpret_cast<const char *>(&header), sizeof(header));
+    return start;
+}
+
+void endFrame(std::string &out, size_t start)
+{
+    const uint32_t length = uint32_t(out.size() - start - sizeof(FrameHeader));
+    std::memcpy(&out[start], &length, sizeof(length));
+}
+
+// Takes the next complete frame off the front of a buffer
+bool takeFrame(const std::vector<char> &buffer, size_t &offset, FrameHeader &header)
+{
+    if (buffer.size() - offset < sizeof(FrameHeader))
+        return false;
+    std::memcpy(&header, buffer.data() + offset, sizeof(header));
+    if (header.length > MaxFramePayload)
+        return true; // the caller rejects it before looking for the payload
+    if (buffer.size() - offset - sizeof(FrameHeader) < header.length)
+        return false;
+    offset += sizeof(FrameHeader);
+    return true;
+}
+
+ProbeSummary probeSummary(const char *name)
+{
+    for (const ProbeSummary &probe : Instrumentation::summary()) {
+        if (probe.name == name)
+            return probe;
+    }
+    ProbeSummary empty;
+    empty.name = name;
+    return empty;
+}
+
+struct Connection
+{
+    explicit Connection(int fd) : fd(fd) {}
+    ~Connection() { ::close(fd); }
+
+    Connection(const Connection &) = delete;
+    Connection &operator=(const Connection &) = delete;
+
+    const int fd;
+    std::mutex writeMutex;
+    bool broken = false; // guarded by writeMutex; set when a write fails
+
+    // Read side, touched only by the accept/read loop
+    std::vector<char> input;
+    bool closing = false;
+    bool binaryAgreed = false; // the client's Hello matched ours
+};
+
+struct Request
+{
+    std::shared_ptr<Connection> connection;
+    uint32_t id = 0;
+    FrameType type = FrameType::Json;
+    uint64_t received = 0;
+    std::string payload;
+    std::string refused; // answered with this as an Error frame without being looked at
+};
+
+struct ServerState
+{
+    explicit ServerState(const ServeOptions &options)
+        : options(options)
+        , pool(options.threads)
+    {
+    }
+
+    const ServeOptions options;
+    WorkPool pool;
+    std::mutex mutex;
+    std::deque<Request> pending;
+    unsigned busy = 0; // batches being calculated
+    uint64_t requests = 0;
+    uint64_t rejected = 0;
+    uint64_t batches = 0;
+    size_t largestBatch = 0;
+};
+
+// The parse error without the "line N: " the batch reader puts in front of it
+std::string requestError(const std::string &message)
+{
+    const size_t colon = message.find(": ");
+    return message.compare(0, 5, "line ") == 0 && colon != std::string::npos ? message.substr(colon + 2) : message;
+}
+
+// Calculates a batch in one kernel call and answers each connection with one write
+void processBatch(ServerState &state, std::vector<Request> &batch)
+{
+    static const int requestProbe = Instrumentation::probe("serve.request");
+    thread_local RecordParser parser(RecordFormat::JsonLines);
+    thread_local RoomBatch rooms;
+    thread_local LoadBatch loads;
+    thread_local std::vector<RoomRecord> records;
+    thread_local std::vector<std::string> errors;
+    thread_local std::vector<char> cached;
+    thread_local std::vector<RoomKey> keys;
+    thread_local std::vector<RoomLoads> cachedLoads;
+    thread_local std::vector<std::string> cachedColumns;
+    thread_local std::string columns;
+    const ResultFormatter formatter(RecordFormat::JsonLines);
+    ResultCache *cache = state.options.cache;
+
+    rooms.clear();
+    records.resize(batch.size());
+    errors.assign(batch.size(), std::string());
+    cached.assign(batch.size(), 0);
+    if (cache) {
+        keys.resize(batch.size());
+        cachedLoads.resize(batch.size());
+        cachedColumns.resize(batch.size());
+    }
+    for (size_t i = 0; i < batch.size(); ++i) {
+        Request &request = batch[i];
+        RoomRecord &record = records[i];
+        if (!request.refused.empty()) {
+            errors[i] = request.refused;
+        } else if (request.type == FrameType::Json) {
+            char *begin = &request.payload[0];
+            if (parser.parse(begin, begin + request.payload.size(), request.id, record) != ReadStatus::Ok)
+                errors[i] = requestError(parser.error());
+        } else if (request.type == FrameType::Binary && request.payload.size() == roomFieldCount() * sizeof(double)) {
+            record.input = RoomInput();
+            for (int field = 0; field < roomFieldCount(); ++field) {
+                double value;
+                std::memcpy(&value, request.payload.data() + field * sizeof(double), sizeof(value));
+                if (!std::isnan(value))
+                    setRoomFieldValue(record.input, field, value);
+            }
+        } else {
+            errors[i] = request.type == FrameType::Binary
+                            ? "binary requests hold " + std::to_string(roomFieldCount()) + " doubles"
+                            : "unknown request type " + std::to_string(uint32_t(request.type));
+        }
+        if (!errors[i].empty())
+            continue;
+        if (cache) {
+            keys[i] = roomKey(record.input);
+            cached[i] = cache->find(keys[i], cachedLoads[i], RecordFormat::JsonLines, &cachedColumns[i]);
+        }
+        if (!cached[i])
+            rooms.append(record.input);
+    }
+    calculateLoadBatch(rooms, loads);
+
+    // Answers are grouped by connection in batch order; clients are few, so a linear search will do
+    std::vector<std::pair<Connection *, std::string>> answers;
+    size_t calculated = 0;
+    uint64_t rejected = 0;
+    for (size_t i = 0; i < batch.size(); ++i) {
+        const Request &request = batch[i];
+        auto answer = std::find_if(answers.begin(), answers.end(),
+                                   [&](const auto &entry) { return entry.first == request.connection.get(); });
+        if (answer == answers.end()) {
+            answers.emplace_back(request.connection.get(), std::string());
+            answer = answers.end() - 1;
+        }
+        std::string &out = answer->second;
+
+        if (!errors[i].empty()) {
+            const size_t frame = beginFrame(out, request.id, FrameType::Error);
+            out += errors[i];
+            endFrame(out, frame);
+            ++rejected;
+            continue;
+        }
+        const RoomLoads result = cached[i] ? cachedLoads[i] : loads.at(calculated++);
+        const size_t frame = beginFrame(out, request.id, request.type);
+        if (request.type == FrameType::Json) {
+            formatter.appendId(out, records[i]);
+            if (cached[i] && !cachedColumns[i].empty()) {
+                out += cachedColumns[i];
+            } else {
+                columns.clear();
+                formatter.appendColumns(columns, result);
+                out += columns;
+                if (cache)
+                    cache->insert(keys[i], result, RecordFormat::JsonLines, &columns);
+            }
+        } else {
+            if (cache && !cached[i])
+                cache->insert(keys[i], result);
+            for (int field = 0; field < resultFieldCount(); ++field) {
+                const double value = resultFieldValue(result, field);
+                out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+            }
+        }
+        endFrame(out, frame);
+    }
+
+    for (auto &[connection, out] : answers) {
+        std::lock_guard<std::mutex> lock(connection->writeMutex);
+        if (connection->broken)
+            continue;
+        if (!writeAll(connection->fd, out.data(), out.size())) {
+            // Stop reading from it too; the read loop drops it on the next poll
+            connection->broken = true;
+            ::shutdown(connection->fd, SHUT_RDWR);
+            continue;
+        }
+        const uint64_t written = Instrumentation::now();
+        for (const Request &request : batch) {
+            if (request.connection.get() == connection)
+                Instrumentation::record(requestProbe, request.received, written - request.received);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.requests += batch.size();
+    state.rejected += rejected;
+    ++state.batches;
+    state.largestBatch = std::max(state.largestBatch, batch.size());
+}
+
+// Hands waiting requests to idle workers, splitting them evenly; called with state.mutex held
+void dispatch(ServerState &state)
+{
+    const unsigned threads = state.pool.threadCount();
+    while (!state.pending.empty() && state.busy < threads) {
+        const size_t idle = threads - state.busy;
+        const size_t count = std::min(state.options.maxBatch, (state.pending.size() + idle - 1) / idle);
+        auto batch = std::make_shared<std::vector<Request>>(std::make_move_iterator(state.pending.begin()),
+                                                            std::make_move_iterator(state.pending.begin() + count));
+        state.pending.erase(state.pending.begin(), state.pending.begin() + count);
+        ++state.busy;
+        state.pool.submit([&state, batch]() {
+            processBatch(state, *batch);
+            batch->clear(); // lets go of the connections before waiting on the lock
+            std::lock_guard<std::mutex> lock(state.mutex);
+            --state.busy;
+            dispatch(state);
+        });
+    }
+}
+
+// Binds the socket, replacing a stale one left by a server that did not shut down cleanly
+int listenOn(const std::string &path, std::string &error)
+{
+    sockaddr_un address;
+    if (!setAddress(path, address, error))
+        return -1;
+
+    struct stat status;
+    if (::stat(path.c_str(), &status) == 0) {
+        if (!S_ISSOCK(status.st_mode)) {
+            error = path + " exists and is not a socket";
+            return -1;
+        }
+        std::string ignored;
+        const int existing = connectTo(path, ignored);
+        if (existing >= 0) {
+            ::close(existing);
+            error = "Another server is listening on " + path;
+            return -1;
+        }
+        ::unlink(path.c_str());
+    }
+
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || ::bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0
+        || ::listen(fd, SOMAXCONN) != 0) {
+        error = "Cannot listen on " + path + ": " + std::strerror(errno);
+        if (fd >= 0)
+            ::close(fd);
+        return -1;
+    }
+    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+// Reads what a client has sent and queues its complete frames; false once it should be dropped
+bool readRequests(const std::shared_ptr<Connection> &connection, std::vector<Request> &requests)
+{
+    Connection &client = *connection;
+    bool open = true;
+    while (true) {
+        const size_t used = client.input.size();
+        client.input.resize(used + ReadChunk);
+        const ssize_t received = ::recv(client.fd, client.input.data() + used, ReadChunk, 0);
+        client.input.resize(used + size_t(std::max<ssize_t>(received, 0)));
+        if (received > 0)
+            continue;
+        if (received < 0 && errno == EINTR)
+            continue;
+        open = received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+        break;
+    }
+
+    const uint64_t now = Instrumentation::now();
+    size_t offset = 0;
+    FrameHeader header;
+    auto answerNow = [&client](uint32_t id, FrameType type, const std::string &payload) {
+        std::string out;
+        const size_t frame = beginFrame(out, id, type);
+        out += payload;
+        endFrame(out, frame);
+        std::lock_guard<std::mutex> lock(client.writeMutex);
+        if (!client.broken)
+            writeAll(client.fd, out.data(), out.size());
+    };
+    while (takeFrame(client.input, offset, header)) {
+        if (header.length > MaxFramePayload) {
+            // The stream cannot be resynchronised after a bad length, so answer and hang up
+            answerNow(header.id, FrameType::Error, "frame longer than " + std::to_string(MaxFramePayload) + " bytes");
+            return false;
+        }
+        if (header.type == uint32_t(FrameType::Hello)) {
+            const BinaryHello ours = binaryHello();
+            BinaryHello theirs = {0, 0, 0};
+            if (header.length == sizeof(theirs))
+                std::memcpy(&theirs, client.input.data() + offset, sizeof(theirs));
+            client.binaryAgreed = std::memcmp(&theirs, &ours, sizeof(ours)) == 0;
+            if (client.binaryAgreed) {
+                answerNow(header.id, FrameType::Hello,
+                          std::string(reinterpret_cast<const char *>(&ours), sizeof(ours)));
+            } else {
+                answerNow(header.id, FrameType::Error,
+                          "the server speaks binary " + describeHello(ours) + ", not " + describeHello(theirs));
+            }
+            offset += header.length;
+            continue;
+        }
+        Request request;
+        request.connection = connection;
+        request.id = header.id;
+        request.type = FrameType(header.type);
+        request.received = now;
+        request.payload.assign(client.input.data() + offset, header.length);
+        if (request.type == FrameType::Binary && !client.binaryAgreed)
+            request.refused = "binary requests need a matching Hello frame first";
+        requests.push_back(std::move(request));
+        offset += header.length;
+    }
+    client.input.erase(client.input.begin(), client.input.begin() + offset);
+    return open;
+}
+
+// Sends our Hello and waits for the server's answer to it
+bool agreeBinary(int fd, std::string &error)
+{
+    const BinaryHello hello = binaryHello();
+    std::string out;
+    const size_t frame = beginFrame(out, 0, FrameType::Hello);
+    out.append(reinterpret_cast<const char *>(&hello), sizeof(hello));
+    endFrame(out, frame);
+    if (!writeAll(fd, out.data(), out.size())) {
+        error = std::string("Cannot send to the server: ") + std::strerror(errno);
+        return false;
+    }
+
+    std::vector<char> input;
+    size_t offset = 0;
+    FrameHeader header;
+    while (!takeFrame(input, offset, header)) {
+        const size_t used = input.size();
+        input.resize(used + ReadChunk);
+        const ssize_t count = ::recv(fd, input.data() + used, ReadChunk, 0);
+        input.resize(used + size_t(std::max<ssize_t>(count, 0)));
+        if (count == 0 || (count < 0 && errno != EINTR)) {
+            error = "The server closed the connection before answering its Hello";
+            return false;
+        }
+    }
+    if (header.length > MaxFramePayload || input.size() != offset + header.length) {
+        error = "The server sent a malformed answer to its Hello";
+        return false;
+    }
+    if (header.type != uint32_t(FrameType::Hello)) {
+        error = header.type == uint32_t(FrameType::Error) ? std::string(input.data() + offset, header.length)
+                                                          : "The server does not take binary requests";
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+
+ServeStats runCalcServer(const std::string &socketPath, const ServeOptions &options, std::string &error)
+{
+    ServeStats stats;
+    const auto started = std::chrono::steady_clock::now();
+    const int listener = listenOn(socketPath, error);
+    if (listener < 0) {
+        stats.ok = false;
+        return stats;
+    }
+
+    stopRequested = 0;
+    std::signal(SIGINT, requestStop);
+    std::signal(SIGTERM, requestStop);
+    std::signal(SIGPIPE, SIG_IGN);
+    Instrumentation::setEnabled(true);
+
+    ServerState state(options);
+    stats.threads = state.pool.threadCount();
+    std::vector<std::shared_ptr<Connection>> connections;
+    std::vector<pollfd> polled;
+    std::vector<Request> requests;
+    while (!stopRequested) {
+        // Leave clients unread while the queue is full, so they wait instead of the server growing
+        bool reading;
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            reading = state.pending.size() < options.maxQueued;
+        }
+        polled.assign(1, {listener, POLLIN, 0});
+        for (const auto &connection : connections)
+            polled.push_back({connection->fd, short(reading ? POLLIN : 0), 0});
+        if (::poll(polled.data(), polled.size(), PollIntervalMs) < 0 && errno != EINTR) {
+            error = std::string("poll failed: ") + std::strerror(errno);
+            stats.ok = false;
+            break;
+        }
+
+        for (size_t i = 1; i < polled.size(); ++i) {
+            if (reading && polled[i].revents && !readRequests(connections[i - 1], requests))
+                connections[i - 1]->closing = true;
+        }
+        if (!requests.empty()) {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            std::move(requests.begin(), requests.end(), std::back_inserter(state.pending));
+            dispatch(state);
+        }
+        requests.clear();
+        // Answers still on their way hold a reference, so the socket closes after the last one
+        connections.erase(std::remove_if(connections.begin(), connections.end(),
+                                         [](const auto &connection) { return connection->closing; }),
+                          connections.end());
+
+        if (polled[0].revents & POLLIN) {
+            int fd;
+            while ((fd = ::accept(listener, nullptr, nullptr)) >= 0) {
+                ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+                connections.push_back(std::make_shared<Connection>(fd));
+                ++stats.connections;
+            }
+        }
+    }
+
+    ::close(listener);
+    ::unlink(socketPath.c_str());
+    state.pool.wait();
+    connections.clear();
+
+    stats.requests = state.requests;
+    stats.rejected = state.rejected;
+    stats.batches = state.batches;
+    stats.largestBatch = state.largestBatch;
+    stats.latency = probeSummary("serve.request");
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    return stats;
+}
+
+LoadStats runLoadGenerator(const std::string &socketPath, const std::vector<RoomInput> &rooms,
+                           const LoadOptions &options, std::string &error)
+{
+    LoadStats stats;
+    if (rooms.empty() || options.connections == 0 || options.pipeline == 0) {
+        error = "Nothing to send";
+        stats.ok = false;
+        return stats;
+    }
+    std::signal(SIGPIPE, SIG_IGN);
+
+    // Every room's request and the answer it should get, worked out up front
+    const FrameType type = options.binary ? FrameType::Binary : FrameType::Json;
+    const ResultFormatter formatter(RecordFormat::JsonLines);
+    std::vector<std::string> payloads(rooms.size());
+    std::vector<std::string> expected(rooms.size());
+    for (size_t r = 0; r < rooms.size(); ++r) {
+        const RoomLoads loads = calculateRoomLoads(rooms[r]);
+        if (options.binary) {
+            for (int field = 0; field < roomFieldCount(); ++field) {
+                const double value = roomFieldValue(rooms[r], field);
+                payloads[r].append(reinterpret_cast<const char *>(&value), sizeof(value));
+            }
+            for (int field = 0; field < resultFieldCount(); ++field) {
+                const double value = resultFieldValue(loads, field);
+                expected[r].append(reinterpret_cast<const char *>(&value), sizeof(value));
+            }
+        } else {
+            RoomRecord record;
+            record.id = std::to_string(r);
+            record.input = rooms[r];
+            payloads[r] = "{\"id\":\"" + record.id + '"';
+            for (int field = 0; field < roomFieldCount(); ++field) {
+                payloads[r] += ",\"";
+                payloads[r] += roomFieldName(field);
+                payloads[r] += "\":";
+                appendRoomField(payloads[r], RecordFormat::JsonLines, rooms[r], field);
+            }
+            payloads[r] += '}';
+            formatter.append(expected[r], record, loads);
+        }
+    }
+
+    struct Client
+    {
+        int fd = -1;
+        uint64_t requests = 0;
+        std::mutex mutex;
+        std::condition_variable answered;
+        uint64_t sent = 0;
+        uint64_t received = 0;
+        bool failed = false;
+        std::vector<uint64_t> sentAt;
+        uint64_t rejected = 0;
+        uint64_t mismatches = 0;
+    };
+    std::vector<std::unique_ptr<Client>> clients;
+    for (unsigned c = 0; c < options.connections; ++c) {
+        auto client = std::make_unique<Client>();
+        client->fd = connectTo(socketPath, error);
+        if (client->fd < 0 || (options.binary && !agreeBinary(client->fd, error))) {
+            if (client->fd >= 0)
+                ::close(client->fd);
+            for (const auto &open : clients)
+                ::close(open->fd);
+            stats.ok = false;
+            return stats;
+        }
+        client->requests = options.requests / options.connections + (c < options.requests % options.connections);
+        client->sentAt.resize(client->requests);
+        clients.push_back(std::move(client));
+    }
+
+    static const int requestProbe = Instrumentation::probe("loadgen.request");
+    Instrumentation::setEnabled(true);
+    Instrumentation::reset();
+    const auto started = std::chrono::steady_clock::now();
+
+    // Request k on connection c is room (c + k * connections), so every connection sees every kind of room
+    auto roomOf = [&](unsigned c, uint64_t k) { return size_t((c + k * options.connections) % rooms.size()); };
+
+    std::vector<std::thread> threads;
+    for (unsigned c = 0; c < options.connections; ++c) {
+        Client &client = *clients[c];
+        threads.emplace_back([&, c]() {
+            std::string out;
+            while (true) {
+                uint64_t first;
+                uint64_t last;
+                {
+                    // Sends whatever the pipeline has room for in one write
+                    std::unique_lock<std::mutex> lock(client.mutex);
+                    client.answered.wait(lock, [&] {
+                        return client.failed || client.sent == client.requests
+                               || client.sent - client.received < options.pipeline;
+                    });
+                    if (client.failed || client.sent == client.requests)
+                        return;
+                    first = client.sent;
+                    last = std::min(client.requests, client.received + options.pipeline);
+                    const uint64_t now = Instrumentation::now();
+                    for (uint64_t k = first; k < last; ++k)
+                        client.sentAt[k] = now;
+                    client.sent = last;
+                }
+                out.clear();
+                for (uint64_t k = first; k < last; ++k) {
+                    const size_t frame = beginFrame(out, uint32_t(k), type);
+                    out += payloads[roomOf(c, k)];
+                    endFrame(out, frame);
+                }
+                if (!writeAll(client.fd, out.data(), out.size())) {
+                    std::lock_guard<std::mutex> lock(client.mutex);
+                    client.failed = true;
+                    return;
+                }
+            }
+        });
+        threads.emplace_back([&, c]() {
+            std::vector<char> input;
+            size_t offset = 0;
+            uint64_t received = 0;
+            while (received < client.requests) {
+                FrameHeader header;
+                if (!takeFrame(input, offset, header)) {
+                    input.erase(input.begin(), input.begin() + offset);
+                    offset = 0;
+                    const size_t used = input.size();
+                    input.resize(used + ReadChunk);
+                    const ssize_t count = ::recv(client.fd, input.data() + used, ReadChunk, 0);
+                    input.resize(used + size_t(std::max<ssize_t>(count, 0)));
+                    if (count > 0 || (count < 0 && errno == EINTR))
+                        continue;
+                    break;
+                }
+                if (header.length > MaxFramePayload || header.id >= client.requests)
+                    break;
+                const char *payload = input.data() + offset;
+                offset += header.length;
+                const uint64_t now = Instrumentation::now();
+
+                const std::string &answer = expected[roomOf(c, header.id)];
+                if (header.type == uint32_t(FrameType::Error))
+                    ++client.rejected;
+                else if (header.length != answer.size() || std::memcmp(payload, answer.data(), answer.size()) != 0)
+                    ++client.mismatches;
+
+                std::lock_guard<std::mutex> lock(client.mutex);
+                Instrumentation::record(requestProbe, client.sentAt[header.id], now - client.sentAt[header.id]);
+                client.received = ++received;
+                client.answered.notify_one();
+            }
+            std::lock_guard<std::mutex> lock(client.mutex);
+            if (received < client.requests)
+                client.failed = true;
+            client.answered.notify_one();
+        });
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    for (const auto &client : clients) {
+        ::close(client->fd);
+        stats.requests += client->received;
+        stats.rejected += client->rejected;
+        stats.mismatches += client->mismatches;
+        if (client->failed) {
+            error = "The server closed a connection or sent a malformed answer";
+            stats.ok = false;
+        }
+    }
+    stats.latency = probeSummary("loadgen.request");
+    return stats;
+}
+
+#endif
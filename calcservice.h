@@ -0,0 +1,105 @@
+#ifndef CALCSERVICE_H
+#define CALCSERVICE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "instrumentation.h"
+#include "loadcalc.h"
+
+class ResultCache;
+
+// Local calculation service on a Unix domain socket, for programs on the same
+// machine that need load figures on demand, plus a load generator to test it.
+//
+// Every message is a FrameHeader (native byte order) followed by length bytes
+// of payload. A Json request is one object with the --batch JSON Lines keys and
+// is answered with the --batch JSON Lines result line. A Binary request is one
+// double per room field in roomFieldName() order, NaN leaving an area unset, and
+// is answered with one double per resultFieldName() column. Those field lists
+// grow as the calculation does, so a connection has to send a Hello frame with
+// the BinaryHello it was built for before its first Binary request. The server
+// answers with its own BinaryHello, or with an Error frame when they differ and
+// then rejects the connection's Binary requests. Clients may send
+// many requests without waiting; answers carry the request's id and can arrive
+// in any order. A request that cannot be calculated gets an Error frame holding
+// the reason as text.
+//
+// Requests that arrive while every worker is busy are calculated together in
+// one batch kernel call, so batches grow with load and an idle server answers
+// at once.
+
+enum class FrameType : uint32_t { Json = 1, Binary = 2, Error = 3, Hello = 4 };
+
+struct FrameHeader
+{
+    uint32_t length; // payload bytes
+    uint32_t id; // chosen by the client, echoed in the answer
+    uint32_t type; // FrameType
+};
+
+const uint32_t MaxFramePayload = 1 << 16;
+
+// Raised whenever a Binary payload changes other than by its field counts
+const uint32_t BinaryProtocolVersion = 1;
+
+// Payload of a Hello frame
+struct BinaryHello
+{
+    uint32_t version; // BinaryProtocolVersion
+    uint32_t roomFields; // doubles in a request
+    uint32_t resultFields; // doubles in an answer
+};
+
+// What this build sends and expects
+BinaryHello binaryHello();
+
+struct ServeOptions
+{
+    unsigned threads = 0; // 0 = one per hardware thread
+    size_t maxBatch = 1024;
+    size_t maxQueued = 65536; // waiting requests at which reading from clients pauses
+    ResultCache *cache = nullptr; // answers repeat requests without calculating them
+};
+
+struct ServeStats
+{
+    bool ok = true;
+    unsigned threads = 0;
+    size_t connections = 0;
+    uint64_t requests = 0;
+    uint64_t rejected = 0;
+    uint64_t batches = 0;
+    size_t largestBatch = 0;
+    ProbeSummary latency; // from a request being read to its answer being written
+    double seconds = 0;
+};
+
+// Serves until SIGINT or SIGTERM. Refuses a path another server is listening on.
+ServeStats runCalcServer(const std::string &socketPath, const ServeOptions &options, std::string &error);
+
+struct LoadOptions
+{
+    unsigned connections = 4;
+    unsigned pipeline = 16; // requests in flight per connection
+    uint64_t requests = 100000;
+    bool binary = false;
+};
+
+struct LoadStats
+{
+    bool ok = true;
+    uint64_t requests = 0;
+    uint64_t rejected = 0;
+    uint64_t mismatches = 0; // answers that differ from calculateRoomLoads()
+    ProbeSummary latency; // from a request being written to its answer being read
+    double seconds = 0;
+};
+
+// Sends the rooms round robin over several connections and checks every answer
+LoadStats runLoadGenerator(const std::string &socketPath, const std::vector<RoomInput> &rooms,
+                           const LoadOptions &options, std::string &error);
+
+#endif // CALCSERVICE_H
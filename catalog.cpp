@@ -0,0 +1,430 @@
+#include "catalog.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+#include "batchio.h"
+
+namespace {
+
+const char IndexMagic[4] = {'B', 'T', 'U', 'C'};
+const uint32_t IndexVersion = 1;
+const int CategoryCount = int(CatalogCategory::Count);
+
+// The entries that used to be hard-coded in the main window, in the same order
+const char BuiltInCatalog[] =
+    "category,name,value\n"
+    "light,Incandescent,4.25\n"
+    "light,Florescent,2.8\n"
+    "light,LED,2\n"
+    "wall,Solid Brick Wall,2\n"
+    "wall,Cavity Wall (No Insulation),1.5\n"
+    "wall,Cavity Wall (Insulated),0.55\n"
+    "wall,Modern Insulated Wall,0.3\n"
+    "wall,Timber Frame Wall (with Insulation),0.3\n"
+    "window,Single Glazed,5.8\n"
+    "window,\"Double Glazed (old, air filled)\",3\n"
+    "window,\"Double Glazed (modern, low-e)\",1.6\n"
+    "window,Triple Glazed,1\n"
+    "ceiling,Uninsulated Loft,3\n"
+    "ceiling,Insulated Ceiling,0.4\n"
+    "ceiling,Modern Insulated Roof,0.2\n"
+    "ceiling,Warm Flata Roof (Insulated),0.25\n"
+    "floor,Uninsulated Solid Floor,1\n"
+    "floor,Suspended Timber Floor,1\n"
+    "floor,Insulated Ground-Bearing Slab,0.25\n"
+    "floor,Retrofit Insulated Timber Floor,0.3\n";
+
+const struct
+{
+    const char *name;
+    CatalogCategory category;
+} categoryNames[] = {
+    {"wall", CatalogCategory::Wall},
+    {"window", CatalogCategory::Window},
+    {"glazing", CatalogCategory::Window},
+    {"ceiling", CatalogCategory::Ceiling},
+    {"roof", CatalogCategory::Ceiling},
+    {"floor", CatalogCategory::Floor},
+    {"light", CatalogCategory::Light},
+    {"lighting", CatalogCategory::Light},
+};
+
+struct IndexHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t entries;
+    uint32_t stringBytes;
+    uint32_t categoryFirst[CategoryCount];
+    uint32_t categoryCount[CategoryCount];
+    uint64_t sourceSize;
+    int64_t sourceTime;
+};
+
+struct IndexRecord
+{
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    double value;
+};
+
+static_assert(sizeof(IndexHeader) % alignof(IndexRecord) == 0, "records follow the header");
+
+const IndexRecord &recordAt(const char *base, CatalogId id)
+{
+    return reinterpret_cast<const IndexRecord *>(base + sizeof(IndexHeader))[id];
+}
+
+struct Row
+{
+    CatalogCategory category;
+    std::string name;
+    double value;
+};
+
+char foldChar(char c)
+{
+    return c >= 'A' && c <= 'Z' ? char(c - 'A' + 'a') : c;
+}
+
+std::string fold(std::string_view text)
+{
+    std::string folded(text);
+    for (char &c : folded)
+        c = foldChar(c);
+    return folded;
+}
+
+bool findCategory(std::string_view name, CatalogCategory &category)
+{
+    const std::string folded = fold(name);
+    for (const auto &entry : categoryNames) {
+        if (folded == entry.name) {
+            category = entry.category;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parseRows(const char *begin, const char *end, std::vector<Row> &rows, std::string &error)
+{
+    if (end - begin >= 3 && std::memcmp(begin, "\xEF\xBB\xBF", 3) == 0)
+        begin += 3;
+
+    std::vector<std::string> fields;
+    size_t line = 0;
+    for (const char *cursor = begin; cursor < end;) {
+        const char *newline = static_cast<const char *>(std::memchr(cursor, '\n', end - cursor));
+        std::string_view text(cursor, (newline ? newline : end) - cursor);
+        cursor = newline ? newline + 1 : end;
+        ++line;
+        if (!text.empty() && text.back() == '\r')
+            text.remove_suffix(1);
+        if (text.find_first_not_of(" \t,") == std::string_view::npos || text.front() == '#')
+            continue;
+
+        Row row;
+        if (!splitCsvFields(text, fields) || fields.size() != 3) {
+            error = "line " + std::to_string(line) + ": expected category,name,value";
+            return false;
+        }
+        if (!parseNumber(fields[2], row.value)) {
+            if (rows.empty() && fold(fields[0]) == "category")
+                continue; // header
+            error = "line " + std::to_string(line) + ": bad value \"" + fields[2] + "\"";
+            return false;
+        }
+        if (!findCategory(fields[0], row.category)) {
+            error = "line " + std::to_string(line) + ": unknown category \"" + fields[0] + "\"";
+            return false;
+        }
+        if (fields[1].empty()) {
+            error = "line " + std::to_string(line) + ": empty name";
+            return false;
+        }
+        row.name = std::move(fields[1]);
+        rows.push_back(std::move(row));
+    }
+    return true;
+}
+
+void addBuiltInFallbacks(std::vector<Row> &rows)
+{
+    bool present[CategoryCount] = {};
+    for (const Row &row : rows)
+        present[int(row.category)] = true;
+
+    std::vector<Row> builtIn;
+    std::string error;
+    parseRows(BuiltInCatalog, BuiltInCatalog + sizeof(BuiltInCatalog) - 1, builtIn, error);
+    for (Row &row : builtIn) {
+        if (!present[int(row.category)])
+            rows.push_back(std::move(row));
+    }
+}
+
+template <typename T>
+void appendBytes(std::vector<char> &image, const T *data, size_t count)
+{
+    const char *bytes = reinterpret_cast<const char *>(data);
+    image.insert(image.end(), bytes, bytes + count * sizeof(T));
+}
+
+// Lays out header, records, name-sorted ids, names and folded names.
+// Records stay grouped by category in source order.
+void compile(std::vector<Row> rows, uint64_t sourceSize, int64_t sourceTime, std::vector<char> &image)
+{
+    std::stable_sort(rows.begin(), rows.end(),
+                     [](const Row &a, const Row &b) { return a.category < b.category; });
+
+    IndexHeader header = {};
+    std::memcpy(header.magic, IndexMagic, sizeof(IndexMagic));
+    header.version = IndexVersion;
+    header.entries = static_cast<uint32_t>(rows.size());
+    header.sourceSize = sourceSize;
+    header.sourceTime = sourceTime;
+
+    IndexRecord record;
+    std::vector<IndexRecord> records;
+    std::string names;
+    std::string folded;
+    for (uint32_t id = 0; id < rows.size(); ++id) {
+        const Row &row = rows[id];
+        if (header.categoryCount[int(row.category)]++ == 0)
+            header.categoryFirst[int(row.category)] = id;
+        record.nameOffset = static_cast<uint32_t>(names.size());
+        record.nameLength = static_cast<uint32_t>(row.name.size());
+        record.value = row.value;
+        records.push_back(record);
+        names += row.name;
+        folded += fold(row.name);
+    }
+    header.stringBytes = static_cast<uint32_t>(names.size());
+
+    std::vector<uint32_t> sorted(rows.size());
+    for (uint32_t id = 0; id < sorted.size(); ++id)
+        sorted[id] = id;
+    auto foldedName = [&](uint32_t id) {
+        return std::string_view(folded).substr(records[id].nameOffset, records[id].nameLength);
+    };
+    for (int category = 0; category < CategoryCount; ++category) {
+        auto first = sorted.begin() + header.categoryFirst[category];
+        std::stable_sort(first, first + header.categoryCount[category],
+                         [&](uint32_t a, uint32_t b) { return foldedName(a) < foldedName(b); });
+    }
+
+    image.clear();
+    appendBytes(image, &header, 1);
+    appendBytes(image, records.data(), records.size());
+    appendBytes(image, sorted.data(), sorted.size());
+    appendBytes(image, names.data(), names.size());
+    appendBytes(image, folded.data(), folded.size());
+}
+
+// Written to a temporary name first so a reader never maps half an index
+void writeIndex(const std::string &indexPath, const std::vector<char> &image)
+{
+    const std::string temporaryPath = indexPath + ".tmp";
+    std::FILE *file = std::fopen(temporaryPath.c_str(), "wb");
+    if (!file)
+        return;
+    bool ok = std::fwrite(image.data(), 1, image.size(), file) == image.size();
+    ok = std::fclose(file) == 0 && ok;
+
+    std::error_code ec;
+    if (ok)
+        std::filesystem::rename(temporaryPath, indexPath, ec);
+    if (!ok || ec)
+        std::filesystem::remove(temporaryPath, ec);
+}
+
+int64_t modificationTime(const std::filesystem::path &path, std::error_code &ec)
+{
+    return static_cast<int64_t>(std::filesystem::last_write_time(path, ec).time_since_epoch().count());
+}
+
+} // namespace
+
+
+void Catalog::clear()
+{
+    mapped.close();
+    owned.clear();
+    base = nullptr;
+    entryCount = 0;
+    std::fill(std::begin(categoryFirst), std::end(categoryFirst), 0);
+    std::fill(std::begin(categoryCount), std::end(categoryCount), 0);
+}
+
+// Checks the layout of an index image and points the accessors into it
+bool Catalog::attach(const char *data, size_t length)
+{
+    IndexHeader header;
+    if (length < sizeof(header))
+        return false;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, IndexMagic, sizeof(IndexMagic)) != 0 || header.version != IndexVersion)
+        return false;
+
+    const size_t entries = header.entries;
+    const size_t strings = header.stringBytes;
+    if (length != sizeof(header) + entries * (sizeof(IndexRecord) + sizeof(uint32_t)) + 2 * strings)
+        return false;
+    for (int category = 0; category < CategoryCount; ++category) {
+        if (size_t(header.categoryFirst[category]) + header.categoryCount[category] > entries)
+            return false;
+    }
+
+    const size_t sortedAt = sizeof(header) + entries * sizeof(IndexRecord);
+    const IndexRecord *records = reinterpret_cast<const IndexRecord *>(data + sizeof(header));
+    const uint32_t *order = reinterpret_cast<const uint32_t *>(data + sortedAt);
+    for (size_t id = 0; id < entries; ++id) {
+        if (size_t(records[id].nameOffset) + records[id].nameLength > strings || order[id] >= entries)
+            return false;
+    }
+
+    base = data;
+    entryCount = entries;
+    sortedOffset = sortedAt;
+    namesOffset = sortedAt + entries * sizeof(uint32_t);
+    foldedOffset = namesOffset + strings;
+    std::copy(std::begin(header.categoryFirst), std::end(header.categoryFirst), categoryFirst);
+    std::copy(std::begin(header.categoryCount), std::end(header.categoryCount), categoryCount);
+    return true;
+}
+
+const uint32_t *Catalog::sorted() const
+{
+    return reinterpret_cast<const uint32_t *>(base + sortedOffset);
+}
+
+std::string_view Catalog::name(CatalogId id) const
+{
+    if (id >= entryCount)
+        return {};
+    return std::string_view(base + namesOffset + recordAt(base, id).nameOffset, recordAt(base, id).nameLength);
+}
+
+std::string_view Catalog::folded(CatalogId id) const
+{
+    return std::string_view(base + foldedOffset + recordAt(base, id).nameOffset, recordAt(base, id).nameLength);
+}
+
+double Catalog::value(CatalogId id) const
+{
+    return id < entryCount ? recordAt(base, id).value : 0;
+}
+
+void Catalog::loadBuiltIn()
+{
+    std::string error;
+    parse(BuiltInCatalog, BuiltInCatalog + sizeof(BuiltInCatalog) - 1, error);
+}
+
+bool Catalog::parse(const char *begin, const char *end, std::string &error)
+{
+    clear();
+    std::vector<Row> rows;
+    if (!parseRows(begin, end, rows, error))
+        return false;
+    addBuiltInFallbacks(rows);
+    compile(std::move(rows), 0, 0, owned);
+    return attach(owned.data(), owned.size());
+}
+
+bool Catalog::load(const std::string &path, std::string &error, bool useIndex)
+{
+    clear();
+    std::error_code ec;
+    const uint64_t sourceSize = std::filesystem::file_size(path, ec);
+    if (ec) {
+        error = "cannot open " + path;
+        return false;
+    }
+    const int64_t sourceTime = modificationTime(path, ec);
+    const std::string indexPath = catalogIndexPath(path);
+    if (useIndex && !ec && mapped.open(indexPath)) {
+        IndexHeader header;
+        if (mapped.size() >= sizeof(header)) {
+            std::memcpy(&header, mapped.data(), sizeof(header));
+            if (header.sourceSize == sourceSize && header.sourceTime == sourceTime
+                && attach(mapped.data(), mapped.size()))
+                return true;
+        }
+        mapped.close();
+    }
+
+    MappedFile source;
+    std::vector<Row> rows;
+    if (!source.open(path)) {
+        error = "cannot open " + path;
+        return false;
+    }
+    if (!parseRows(source.data(), source.data() + source.size(), rows, error)) {
+        error = path + ": " + error;
+        return false;
+    }
+    addBuiltInFallbacks(rows);
+    compile(std::move(rows), sourceSize, sourceTime, owned);
+    if (useIndex && !ec)
+        writeIndex(indexPath, owned);
+    return attach(owned.data(), owned.size());
+}
+
+CatalogId Catalog::find(CatalogCategory category, std::string_view name) const
+{
+    if (!base)
+        return NoCatalogId;
+    const std::string key = fold(name);
+    const uint32_t *first = sorted() + categoryFirst[int(category)];
+    const uint32_t *last = first + categoryCount[int(category)];
+    const uint32_t *found = std::lower_bound(first, last, key, [this](uint32_t id, const std::string &key) {
+        return folded(id) < key;
+    });
+    return found != last && folded(*found) == key ? *found : NoCatalogId;
+}
+
+void Catalog::search(CatalogCategory category, std::string_view text, size_t limit, std::vector<CatalogId> &ids) const
+{
+    ids.clear();
+    if (!base)
+        return;
+    const std::string key = fold(text);
+    const size_t wanted = limit ? limit : entryCount;
+
+    const uint32_t *first = sorted() + categoryFirst[int(category)];
+    const uint32_t *last = first + categoryCount[int(category)];
+    const uint32_t *prefixed = std::lower_bound(first, last, key, [this](uint32_t id, const std::string &key) {
+        return folded(id) < key;
+    });
+    for (; prefixed != last && ids.size() < wanted && folded(*prefixed).substr(0, key.size()) == key; ++prefixed)
+        ids.push_back(*prefixed);
+    if (key.empty())
+        return;
+
+    const CatalogId end = categoryFirst[int(category)] + categoryCount[int(category)];
+    for (CatalogId id = categoryFirst[int(category)]; id < end && ids.size() < wanted; ++id) {
+        const std::string_view name = folded(id);
+        if (name.size() > key.size() && name.compare(0, key.size(), key) != 0 && name.find(key) != std::string_view::npos)
+            ids.push_back(id);
+    }
+}
+
+const char *catalogCategoryName(CatalogCategory category)
+{
+    for (const auto &entry : categoryNames) {
+        if (entry.category == category)
+            return entry.name;
+    }
+    return "";
+}
+
+std::string catalogIndexPath(const std::string &path)
+{
+    return path + ".btuc";
+}
@@ -0,0 +1,83 @@
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "mappedfile.h"
+
+// Construction and equipment catalog: named products with the value they put
+// into the calculation (U-value, or lighting multiplier for lamps).
+//
+// The source is a CSV of category,name,value rows. It is compiled into a
+// binary index next to it (<file>.btuc) that is memory-mapped on later starts
+// while the source's size and modification time are unchanged. Entries are
+// referred to by interned ids, positions in the index, so a lookup is one array
+// access and no names are copied out of the mapping.
+
+enum class CatalogCategory { Wall, Window, Ceiling, Floor, Light, Count };
+
+typedef uint32_t CatalogId;
+const CatalogId NoCatalogId = 0xffffffff;
+
+class Catalog
+{
+public:
+    Catalog() = default;
+
+    Catalog(const Catalog &) = delete;
+    Catalog &operator=(const Catalog &) = delete;
+
+    // The products the calculator has always offered
+    void loadBuiltIn();
+
+    // Parses catalog text. Categories with no rows keep their built-in entries.
+    bool parse(const char *begin, const char *end, std::string &error);
+
+    // Maps the index when it is current, otherwise parses path and rewrites the
+    // index. Both leave the catalog empty on failure.
+    bool load(const std::string &path, std::string &error, bool useIndex = true);
+
+    bool fromIndex() const { return mapped.isOpen(); }
+    size_t size() const { return entryCount; }
+
+    // Entries of a category are consecutive ids, in source file order
+    CatalogId first(CatalogCategory category) const { return categoryFirst[int(category)]; }
+    size_t count(CatalogCategory category) const { return categoryCount[int(category)]; }
+
+    std::string_view name(CatalogId id) const;
+    double value(CatalogId id) const;
+
+    // Exact, case insensitive match; NoCatalogId when absent
+    CatalogId find(CatalogCategory category, std::string_view name) const;
+
+    // Case insensitive type-ahead: names starting with text in name order, then
+    // names containing it in file order, at most limit ids (0 = no limit)
+    void search(CatalogCategory category, std::string_view text, size_t limit, std::vector<CatalogId> &ids) const;
+
+private:
+    void clear();
+    bool attach(const char *data, size_t length);
+    const uint32_t *sorted() const;
+    std::string_view folded(CatalogId id) const;
+
+    MappedFile mapped;
+    std::vector<char> owned;
+    const char *base = nullptr;
+    size_t entryCount = 0;
+    size_t sortedOffset = 0;
+    size_t namesOffset = 0;
+    size_t foldedOffset = 0;
+    CatalogId categoryFirst[int(CatalogCategory::Count)] = {};
+    uint32_t categoryCount[int(CatalogCategory::Count)] = {};
+};
+
+// Lower case name used in the source file ("wall", "window", ...)
+const char *catalogCategoryName(CatalogCategory category);
+
+std::string catalogIndexPath(const std::string &path);
+
+#endif // CATALOG_H
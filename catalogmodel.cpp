@@ -0,0 +1,126 @@
+#include "catalogmodel.h"
+
+#include <QComboBox>
+#include <QCompleter>
+#include <QLineEdit>
+#include <QListView>
+
+#include <algorithm>
+
+CatalogModel::CatalogModel(const Catalog *catalog, CatalogCategory category, QObject *parent)
+    : QAbstractListModel(parent)
+    , catalog(catalog)
+    , category(category)
+{
+}
+
+int CatalogModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return static_cast<int>(filtered ? matches.size() : catalog->count(category));
+}
+
+QVariant CatalogModel::data(const QModelIndex &index, int role) const
+{
+    const CatalogId entry = id(index.row());
+    if (entry == NoCatalogId)
+        return QVariant();
+    switch (role) {
+    case Qt::DisplayRole:
+    case Qt::EditRole: {
+        const std::string_view name = catalog->name(entry);
+        return QString::fromUtf8(name.data(), static_cast<qsizetype>(name.size()));
+    }
+    case Qt::ToolTipRole:
+        return (category == CatalogCategory::Light ? tr("Multiplier %1") : tr("U-value %1"))
+            .arg(catalog->value(entry), 0, 'f', 2);
+    case IdRole:
+        return entry;
+    }
+    return QVariant();
+}
+
+CatalogId CatalogModel::id(int row) const
+{
+    if (row < 0 || row >= rowCount())
+        return NoCatalogId;
+    return filtered ? matches[row] : catalog->first(category) + static_cast<CatalogId>(row);
+}
+
+int CatalogModel::row(CatalogId id) const
+{
+    if (filtered) {
+        auto found = std::find(matches.begin(), matches.end(), id);
+        return found == matches.end() ? -1 : static_cast<int>(found - matches.begin());
+    }
+    const CatalogId first = catalog->first(category);
+    return id >= first && id - first < catalog->count(category) ? static_cast<int>(id - first) : -1;
+}
+
+CatalogId CatalogModel::find(std::string_view name) const
+{
+    return catalog->find(category, name);
+}
+
+void CatalogModel::setFilter(const QString &text)
+{
+    beginResetModel();
+    filtered = !text.isEmpty();
+    if (filtered)
+        catalog->search(category, text.toStdString(), 0, matches);
+    else
+        matches.clear();
+    endResetModel();
+}
+
+
+void setupCatalogCombo(QComboBox *combo, const Catalog *catalog, CatalogCategory category)
+{
+    combo->setModel(new CatalogModel(catalog, category, combo));
+    if (QListView *view = qobject_cast<QListView *>(combo->view()))
+        view->setUniformItemSizes(true);
+    combo->setEditable(true);
+    combo->setInsertPolicy(QComboBox::NoInsert);
+
+    // Filter before the completer reads the model for the same keystroke
+    CatalogModel *matches = new CatalogModel(catalog, category, combo);
+    QLineEdit *edit = combo->lineEdit();
+    QObject::connect(edit, &QLineEdit::textEdited, matches, &CatalogModel::setFilter);
+
+    QCompleter *completer = new QCompleter(matches, combo);
+    completer->setCompletionMode(QCompleter::UnfilteredPopupCompletion);
+    completer->setCaseSensitivity(Qt::CaseInsensitive);
+    if (QListView *popup = qobject_cast<QListView *>(completer->popup()))
+        popup->setUniformItemSizes(true);
+    combo->setCompleter(completer);
+
+    QObject::connect(completer, QOverload<const QModelIndex &>::of(&QCompleter::activated), combo,
+                     [combo](const QModelIndex &index) {
+                         const CatalogModel *model = static_cast<CatalogModel *>(combo->model());
+                         const int row = model->row(index.data(CatalogModel::IdRole).toUInt());
+                         if (row >= 0)
+                             combo->setCurrentIndex(row);
+                     });
+
+    // Leaving half typed text shows the selection again rather than a name that is not in the catalog
+    QObject::connect(edit, &QLineEdit::editingFinished, combo, [combo]() {
+        combo->setEditText(combo->itemText(combo->currentIndex()));
+    });
+}
+
+CatalogId catalogId(const QComboBox *combo)
+{
+    const CatalogModel *model = qobject_cast<const CatalogModel *>(combo->model());
+    return model ? model->id(combo->currentIndex()) : NoCatalogId;
+}
+
+bool selectCatalogName(QComboBox *combo, std::string_view name)
+{
+    const CatalogModel *model = qobject_cast<const CatalogModel *>(combo->model());
+    const int row = model ? model->row(model->find(name)) : -1;
+    if (row < 0)
+        return false;
+    combo->setCurrentIndex(row);
+    return true;
+}
@@ -0,0 +1,54 @@
+#ifndef CATALOGMODEL_H
+#define CATALOGMODEL_H
+
+#include <QAbstractListModel>
+
+#include <string_view>
+#include <vector>
+
+#include "catalog.h"
+
+class QComboBox;
+
+// One category of the catalog as a list model. Rows are read straight out of
+// the index when the view asks for them, so even a category of tens of
+// thousands of products is shown without copying it into the combo box.
+class CatalogModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    static const int IdRole = Qt::UserRole;
+
+    CatalogModel(const Catalog *catalog, CatalogCategory category, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    CatalogId id(int row) const;
+    int row(CatalogId id) const;
+
+    // Entry of the category with this name, NoCatalogId when there is none
+    CatalogId find(std::string_view name) const;
+
+    // Narrows the rows to Catalog::search() matches; empty text shows the whole category
+    void setFilter(const QString &text);
+
+private:
+    const Catalog *catalog;
+    CatalogCategory category;
+    bool filtered = false;
+    std::vector<CatalogId> matches;
+};
+
+// Fills an editable combo box with a catalog category. Typing filters a popup
+// of matches and picking one selects it in the combo.
+void setupCatalogCombo(QComboBox *combo, const Catalog *catalog, CatalogCategory category);
+
+// Interned id of the combo's selection, NoCatalogId when nothing is selected
+CatalogId catalogId(const QComboBox *combo);
+
+// Selects the entry with this name (case insensitive); false, keeping the selection, if there is none
+bool selectCatalogName(QComboBox *combo, std::string_view name);
+
+#endif // CATALOGMODEL_H
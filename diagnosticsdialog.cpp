@@ -0,0 +1,131 @@
+#include "diagnosticsdialog.h"
+
+#include <QCheckBox>
+#include <QFile>
+#include <QFileDialog>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QPushButton>
+#include <QStandardPaths>
+#include <QTableWidget>
+#include <QTimer>
+#include <QVBoxLayout>
+
+#include "instrumentation.h"
+
+namespace {
+
+enum ProbeColumn { NameColumn, CountColumn, MeanColumn, P50Column, P90Column, P99Column, MaxColumn, ColumnCount };
+
+// Durations in the unit that keeps them readable
+QString duration(double ns)
+{
+    if (ns >= 1e6)
+        return QString::number(ns / 1e6, 'f', 2) + " ms";
+    if (ns >= 1e3)
+        return QString::number(ns / 1e3, 'f', 1) + " µs";
+    return QString::number(ns, 'f', 0) + " ns";
+}
+
+} // namespace
+
+
+DiagnosticsDialog::DiagnosticsDialog(QWidget *parent)
+    : QDialog(parent)
+{
+    setWindowTitle(tr("Performance diagnostics"));
+    resize(760, 480);
+    QVBoxLayout *layout = new QVBoxLayout(this);
+
+    enabledBox = new QCheckBox(tr("Record timings"), this);
+    enabledBox->setChecked(Instrumentation::enabled());
+    layout->addWidget(enabledBox);
+
+    probeTable = new QTableWidget(0, ColumnCount, this);
+    probeTable->setHorizontalHeaderLabels({tr("Probe"), tr("Count"), tr("Mean"), tr("P50"), tr("P90"), tr("P99"), tr("Max")});
+    probeTable->horizontalHeader()->setSectionResizeMode(NameColumn, QHeaderView::Stretch);
+    probeTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    probeTable->verticalHeader()->hide();
+    layout->addWidget(probeTable, 1);
+
+    statusLabel = new QLabel(this);
+    layout->addWidget(statusLabel);
+
+    QHBoxLayout *buttons = new QHBoxLayout;
+    QPushButton *resetButton = new QPushButton(tr("Reset"), this);
+    QPushButton *jsonButton = new QPushButton(tr("Save JSON..."), this);
+    QPushButton *traceButton = new QPushButton(tr("Save Chrome trace..."), this);
+    buttons->addWidget(resetButton);
+    buttons->addStretch(1);
+    buttons->addWidget(jsonButton);
+    buttons->addWidget(traceButton);
+    layout->addLayout(buttons);
+
+    refreshTimer = new QTimer(this);
+    refreshTimer->setInterval(500);
+
+    connect(enabledBox, &QCheckBox::toggled, this, [](bool checked) { Instrumentation::setEnabled(checked); });
+    connect(resetButton, &QPushButton::clicked, this, [this]() {
+        Instrumentation::reset();
+        refresh();
+    });
+    connect(jsonButton, &QPushButton::clicked, this, &DiagnosticsDialog::saveJson);
+    connect(traceButton, &QPushButton::clicked, this, &DiagnosticsDialog::saveTrace);
+    connect(refreshTimer, &QTimer::timeout, this, &DiagnosticsDialog::refresh);
+    refreshTimer->start();
+    refresh();
+}
+
+void DiagnosticsDialog::refresh()
+{
+    const std::vector<ProbeSummary> probes = Instrumentation::summary();
+    probeTable->setRowCount(static_cast<int>(probes.size()));
+    for (int row = 0; row < probeTable->rowCount(); ++row) {
+        const ProbeSummary &probe = probes[row];
+        const QString cells[ColumnCount] = {
+            QString::fromStdString(probe.name),
+            QString::number(probe.count),
+            probe.timer && probe.count ? duration(probe.totalNs / probe.count) : QString(),
+            probe.timer && probe.count ? duration(probe.p50Ns) : QString(),
+            probe.timer && probe.count ? duration(probe.p90Ns) : QString(),
+            probe.timer && probe.count ? duration(probe.p99Ns) : QString(),
+            probe.timer && probe.count ? duration(probe.maxNs) : QString(),
+        };
+        for (int column = 0; column < ColumnCount; ++column) {
+            QTableWidgetItem *item = probeTable->item(row, column);
+            if (!item) {
+                item = new QTableWidgetItem;
+                if (column != NameColumn)
+                    item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+                probeTable->setItem(row, column, item);
+            }
+            if (item->text() != cells[column])
+                item->setText(cells[column]);
+        }
+    }
+}
+
+QString DiagnosticsDialog::askFileName(const QString &title, const QString &defaultName, const QString &filter)
+{
+    return QFileDialog::getSaveFileName(
+        this, title, QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation) + "/" + defaultName, filter);
+}
+
+void DiagnosticsDialog::saveJson()
+{
+    const QString fileName = askFileName(tr("Save diagnostics"), "btucalc-diagnostics.json", tr("JSON Files (*.json)"));
+    if (fileName.isEmpty())
+        return;
+    const bool saved = Instrumentation::writeJson(QFile::encodeName(fileName).toStdString());
+    statusLabel->setText(saved ? tr("Saved %1").arg(fileName) : tr("Could not write %1").arg(fileName));
+}
+
+void DiagnosticsDialog::saveTrace()
+{
+    const QString fileName = askFileName(tr("Save Chrome trace"), "btucalc-trace.json", tr("JSON Files (*.json)"));
+    if (fileName.isEmpty())
+        return;
+    const bool saved = Instrumentation::writeChromeTrace(QFile::encodeName(fileName).toStdString());
+    statusLabel->setText(saved ? tr("Saved %1").arg(fileName) : tr("Could not write %1").arg(fileName));
+}
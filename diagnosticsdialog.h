@@ -0,0 +1,35 @@
+#ifndef DIAGNOSTICSDIALOG_H
+#define DIAGNOSTICSDIALOG_H
+
+#include <QDialog>
+
+class QCheckBox;
+class QLabel;
+class QTableWidget;
+class QTimer;
+
+// Hidden performance panel (Ctrl+Shift+D in the main window): turns the
+// instrumentation on and off, shows every probe's histogram summary while the
+// app is used, and saves it as JSON or a Chrome trace to send back from site.
+class DiagnosticsDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit DiagnosticsDialog(QWidget *parent = nullptr);
+
+private slots:
+    void refresh();
+    void saveJson();
+    void saveTrace();
+
+private:
+    QString askFileName(const QString &title, const QString &defaultName, const QString &filter);
+
+    QCheckBox *enabledBox;
+    QTableWidget *probeTable;
+    QLabel *statusLabel;
+    QTimer *refreshTimer;
+};
+
+#endif // DIAGNOSTICSDIALOG_H
@@ -0,0 +1,1179 @@
+#include "headless.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "annualsim.h"
+#include "arrowwriter.h"
+#include "batchio.h"
+#include "building.h"
+#include "calcservice.h"
+#include "catalog.h"
+#include "loadbatch.h"
+#include "monitor.h"
+#include "montecarlo.h"
+#include "parallelbatch.h"
+#include "projectfile.h"
+#include "resultcache.h"
+#include "sweep.h"
+#include "weather.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+namespace {
+
+enum class HeadlessMode {
+    Batch, Simulate, Sweep, MonteCarlo, Building, Catalog, Project, Serve, LoadGenerator, Monitor, Replay
+};
+
+// Options that select a mode; each takes the rooms (or catalog, project, socket or readings) path
+const struct
+{
+    const char *option;
+    HeadlessMode mode;
+} modeOptions[] = {
+    {"--batch", HeadlessMode::Batch},
+    {"--simulate", HeadlessMode::Simulate},
+    {"--sweep", HeadlessMode::Sweep},
+    {"--montecarlo", HeadlessMode::MonteCarlo},
+    {"--building", HeadlessMode::Building},
+    {"--catalog", HeadlessMode::Catalog},
+    {"--project", HeadlessMode::Project},
+    {"--serve", HeadlessMode::Serve},
+    {"--loadgen", HeadlessMode::LoadGenerator},
+    {"--monitor", HeadlessMode::Monitor},
+    {"--replay", HeadlessMode::Replay},
+};
+
+bool findMode(const char *arg, HeadlessMode &mode)
+{
+    for (const auto &entry : modeOptions) {
+        if (std::strcmp(arg, entry.option) == 0) {
+            mode = entry.mode;
+            return true;
+        }
+    }
+    return false;
+}
+
+struct HeadlessOptions
+{
+    HeadlessMode mode = HeadlessMode::Batch;
+    std::string inputPath;
+    std::string weatherPath;
+    std::string layoutPath;
+    bool weatherCache = true;
+    bool catalogIndex = true;
+    std::string find;
+    std::string addPath;
+    std::string exportPath;
+    bool compact = false;
+    std::string socketPath;
+    unsigned connections = 4;
+    unsigned pipeline = 16;
+    uint64_t requests = 100000;
+    bool binary = false;
+    size_t maxBatch = 1024;
+    double p99TargetMs = 0;
+    std::string readingsPath;
+    std::string summaryPath;
+    size_t historyMinutes = 60;
+    int sustainMinutes = 3;
+    double speed = 1;
+    std::string cachePath;
+    size_t cacheSize = 0;
+    std::vector<std::string> axes;
+    bool allCombinations = false;
+    std::vector<std::string> distributions;
+    uint64_t samples = 1000000;
+    uint64_t seed = 1;
+    int coolingUnits = -1;
+    int heatingUnits = -1;
+    std::string outputPath = "-";
+    RecordFormat inputFormat = RecordFormat::Csv;
+    RecordFormat outputFormat = RecordFormat::Csv;
+    bool arrowOutput = false;
+    ArrowCompression compression = ArrowCompression::None;
+    unsigned threads = 0;
+};
+
+void printUsage()
+{
+    std::fprintf(stderr,
+                 "Usage: BTUCalcV6 --batch <in.csv|in.jsonl|-> [--out <results.csv|results.jsonl|results.arrow|->]\n"
+                 "                 [--in-format csv|jsonl] [--out-format csv|jsonl|arrow] [--compress lz4]\n"
+                 "                 [--threads <n>]\n"
+                 "                 [--cache <file>] [--cache-size <rooms>]\n"
+                 "       BTUCalcV6 --simulate <rooms.csv|rooms.jsonl|-> --weather <file.epw|file.csv>\n"
+                 "                 [--out <annual.csv|annual.jsonl|->] [--no-weather-cache] [--threads <n>]\n"
+                 "       BTUCalcV6 --sweep <rooms.csv|rooms.jsonl|-> --axis <field=value@cost,...> [--axis ...]\n"
+                 "                 [--axis <field=min..max/step@costPerUnit>] [--all] [--out <front.csv|front.jsonl|->]\n"
+                 "                 [--threads <n>]\n"
+                 "       BTUCalcV6 --montecarlo <rooms.csv|rooms.jsonl|-> --vary <field=normal(mean,sd)> [--vary ...]\n"
+                 "                 [--samples <n>] [--seed <n>] [--units <n> | --cooling-units <n> --heating-units <n>]\n"
+                 "                 [--out <risk.csv|risk.jsonl|->] [--threads <n>]\n"
+                 "                 distributions: uniform(low,high) normal(mean,sd) triangular(low,mode,high)\n"
+                 "                 lognormal(median,gsd)\n"
+                 "       BTUCalcV6 --building <rooms.csv|rooms.jsonl|-> --layout <layout.csv>\n"
+                 "                 [--weather <file.epw|file.csv>] [--no-weather-cache] [--out <zones.csv|zones.jsonl|->]\n"
+                 "                 layout rows: wall,<room>,<room>,<area>,<u> floor,<upper room>,<lower room>,<area>,<u>\n"
+                 "                 unheated,<room>\n"
+                 "       BTUCalcV6 --catalog <catalog.csv> [--find <text>] [--no-catalog-index]\n"
+                 "       BTUCalcV6 --project <file.btup> [--add <rooms.csv|rooms.jsonl>]\n"
+                 "                 [--export <rooms.csv|rooms.jsonl|->] [--compact]\n"
+                 "       BTUCalcV6 --serve <socket> [--threads <n>] [--max-batch <n>] [--p99-target <ms>]\n"
+                 "                 [--cache <file>] [--cache-size <rooms>]\n"
+                 "       BTUCalcV6 --loadgen <rooms.csv|rooms.jsonl> --socket <socket> [--connections <n>]\n"
+                 "                 [--pipeline <n>] [--requests <n>] [--binary] [--p99-target <ms>]\n"
+                 "       BTUCalcV6 --monitor <rooms.csv|rooms.jsonl> --readings <readings.csv|->\n"
+                 "                 [--history <minutes>] [--sustain <minutes>]\n"
+                 "                 [--units <n> | --cooling-units <n> --heating-units <n>]\n"
+                 "                 [--out <events.csv|events.jsonl|->] [--summary <rooms.csv|rooms.jsonl>]\n"
+                 "                 reading lines: <unix time>,<room>,<indoor C>,<outdoor C>; room * is the site\n"
+                 "       BTUCalcV6 --replay <readings.csv|-> [--speed <x>] [--out <readings.csv|->]\n"
+                 "                 writes the readings at the pace of their times, --speed 0 as fast as possible\n"
+                 "       BTUCalcV6 [--startup-trace]\n"
+                 "                 opens the window, printing how long each step of starting took\n");
+}
+
+bool parseFormat(const char *text, RecordFormat &format)
+{
+    if (std::strcmp(text, "csv") == 0)
+        format = RecordFormat::Csv;
+    else if (std::strcmp(text, "jsonl") == 0)
+        format = RecordFormat::JsonLines;
+    else
+        return false;
+    return true;
+}
+
+bool parseOptions(int argc, char *argv[], HeadlessOptions &options)
+{
+    bool inputFormatSet = false;
+    bool outputFormatSet = false;
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (findMode(arg, options.mode) && value) {
+            options.inputPath = value;
+            ++i;
+        } else if (std::strcmp(arg, "--axis") == 0 && value) {
+            options.axes.push_back(value);
+            ++i;
+        } else if (std::strcmp(arg, "--all") == 0) {
+            options.allCombinations = true;
+        } else if (std::strcmp(arg, "--vary") == 0 && value) {
+            options.distributions.push_back(value);
+            ++i;
+        } else if (std::strcmp(arg, "--samples") == 0 && value) {
+            options.samples = std::strtoull(value, nullptr, 10);
+            ++i;
+        } else if (std::strcmp(arg, "--seed") == 0 && value) {
+            options.seed = std::strtoull(value, nullptr, 10);
+            ++i;
+        } else if (std::strcmp(arg, "--units") == 0 && value) {
+            options.coolingUnits = options.heatingUnits = std::atoi(value);
+            ++i;
+        } else if (std::strcmp(arg, "--cooling-units") == 0 && value) {
+            options.coolingUnits = std::atoi(value);
+            ++i;
+        } else if (std::strcmp(arg, "--heating-units") == 0 && value) {
+            options.heatingUnits = std::atoi(value);
+            ++i;
+        } else if (std::strcmp(arg, "--weather") == 0 && value) {
+            options.weatherPath = value;
+            ++i;
+        } else if (std::strcmp(arg, "--layout") == 0 && value) {
+            options.layoutPath = value;
+            ++i;
+        } else if (std::strcmp(arg, "--no-weather-cache") == 0) {
+            options.weatherCache = false;
+        } else if (std::strcmp(arg, "--find") == 0 && value) {
+            options.find = value;
+            ++i;
+        } else if (std::strcmp(arg, "--no-catalog-index") == 0) {
+            options.catalogIndex = false;
+        } else if (std::strcmp(arg, "--add") == 0 && value) {
+            options.addPath = value;
+            ++i;
+        } else if (std::strcmp(arg, "--export") == 0 && value) {
+            options.exportPath = value;
+            ++i;
+        } else if (std::strcmp(arg, "--compact") == 0) {
+            options.compact = true;
+        } else if (std::strcmp(arg, "--socket") == 0 && value) {
+            options.socketPath = value;
+            ++i;
+        } else if (std::strcmp(arg, "--connections") == 0 && value) {
+            options.connections = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+            ++i;
+        } else if (std::strcmp(arg, "--pipeline") == 0 && value) {
+            options.pipeline = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+            ++i;
+        } else if (std::strcmp(arg, "--requests") == 0 && value) {
+            options.requests = std::strtoull(value, nullptr, 10);
+            ++i;
+        } else if (std::strcmp(arg, "--binary") == 0) {
+            options.binary = true;
+        } else if (std::strcmp(arg, "--max-batch") == 0 && value) {
+            options.maxBatch = std::strtoull(value, nullptr, 10);
+            ++i;
+        } else if (std::strcmp(arg, "--p99-target") == 0 && value) {
+            options.p99TargetMs = std::atof(value);
+            ++i;
+        } else if (std::strcmp(arg, "--readings") == 0 && value) {
+            options.readingsPath = value;
+            ++i;
+        } else if (std::strcmp(arg, "--summary") == 0 && value) {
+            options.summaryPath = value;
+            ++i;
+        } else if (std::strcmp(arg, "--history") == 0 && value) {
+            options.historyMinutes = std::strtoull(value, nullptr, 10);
+            ++i;
+        } else if (std::strcmp(arg, "--sustain") == 0 && value) {
+            options.sustainMinutes = std::atoi(value);
+            ++i;
+        } else if (std::strcmp(arg, "--speed") == 0 && value) {
+            options.speed = std::atof(value);
+            ++i;
+        } else if (std::strcmp(arg, "--cache") == 0 && value) {
+            options.cachePath = value;
+            ++i;
+        } else if (std::strcmp(arg, "--cache-size") == 0 && value) {
+            options.cacheSize = std::strtoull(value, nullptr, 10);
+            ++i;
+        } else if (std::strcmp(arg, "--out") == 0 && value) {
+            options.outputPath = value;
+            ++i;
+        } else if (std::strcmp(arg, "--in-format") == 0 && value) {
+            if (!parseFormat(value, options.inputFormat))
+                return false;
+            inputFormatSet = true;
+            ++i;
+        } else if (std::strcmp(arg, "--out-format") == 0 && value) {
+            options.arrowOutput = std::strcmp(value, "arrow") == 0;
+            if (!options.arrowOutput && !parseFormat(value, options.outputFormat))
+                return false;
+            outputFormatSet = true;
+            ++i;
+        } else if (std::strcmp(arg, "--compress") == 0 && value) {
+            if (std::strcmp(value, "lz4") == 0)
+                options.compression = ArrowCompression::Lz4;
+            else if (std::strcmp(value, "none") != 0)
+                return false;
+            ++i;
+        } else if (std::strcmp(arg, "--threads") == 0 && value) {
+            options.threads = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+            ++i;
+        } else {
+            std::fprintf(stderr, "Unknown or incomplete option: %s\n", arg);
+            return false;
+        }
+    }
+    if (options.inputPath.empty())
+        return false;
+    if (options.mode == HeadlessMode::Simulate && options.weatherPath.empty())
+        return false;
+    if (options.mode == HeadlessMode::Sweep && options.axes.empty())
+        return false;
+    if (options.mode == HeadlessMode::MonteCarlo && (options.distributions.empty() || options.samples == 0))
+        return false;
+    if (options.mode == HeadlessMode::Building && options.layoutPath.empty())
+        return false;
+    if (options.mode == HeadlessMode::Serve && options.maxBatch == 0)
+        return false;
+    if (options.mode == HeadlessMode::LoadGenerator
+        && (options.socketPath.empty() || options.connections == 0 || options.pipeline == 0))
+        return false;
+    if (options.mode == HeadlessMode::Monitor
+        && (options.readingsPath.empty() || options.historyMinutes == 0 || options.sustainMinutes <= 0))
+        return false;
+    if (options.mode == HeadlessMode::Replay && options.speed < 0)
+        return false;
+    // A project's rooms come in through --add and go out through --export
+    const bool project = options.mode == HeadlessMode::Project;
+    if (!inputFormatSet)
+        options.inputFormat = formatForPath(project ? options.addPath : options.inputPath);
+    if (!outputFormatSet) {
+        options.outputFormat = formatForPath(project ? options.exportPath : options.outputPath);
+        options.arrowOutput = !project && isArrowPath(options.outputPath);
+    }
+    if (options.arrowOutput && options.mode != HeadlessMode::Batch) {
+        std::fprintf(stderr, "Arrow output is only written by --batch\n");
+        return false;
+    }
+    return true;
+}
+
+// The result cache asked for with --cache or --cache-size, if any. savePath is where to
+// save it afterwards, left empty when --cache names something that is not a cache.
+std::unique_ptr<ResultCache> openResultCache(const HeadlessOptions &options, std::string &savePath)
+{
+    if (options.cachePath.empty() && options.cacheSize == 0)
+        return nullptr;
+    auto cache = std::make_unique<ResultCache>(options.cacheSize ? options.cacheSize : 100000);
+    std::string error;
+    savePath = options.cachePath;
+    if (!savePath.empty() && !cache->load(savePath, error)) {
+        std::fprintf(stderr, "%s; the cache will not be saved\n", error.c_str());
+        savePath.clear();
+    }
+    return cache;
+}
+
+// Prints the cache's hit rate and saves it when it has a file
+bool closeResultCache(ResultCache *cache, const std::string &savePath)
+{
+    if (!cache)
+        return true;
+    const ResultCacheStats stats = cache->stats();
+    std::fprintf(stderr, "cache: %llu hits, %llu misses (%.1f%% hit), %llu evicted, %zu of %zu rooms kept\n",
+                 (unsigned long long)stats.hits, (unsigned long long)stats.misses, stats.hitRate() * 100,
+                 (unsigned long long)stats.evictions, stats.size, stats.capacity);
+    std::string error;
+    if (!savePath.empty() && !cache->save(savePath, error)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return false;
+    }
+    return true;
+}
+
+// The file to write to, stdout for "-"; null, having said why, when it cannot be created
+std::FILE *openOutput(const std::string &path)
+{
+    std::FILE *output = path == "-" ? stdout : std::fopen(path.c_str(), "wb");
+    if (!output)
+        std::fprintf(stderr, "Cannot create %s\n", path.c_str());
+    return output;
+}
+
+// Flushes stdout or closes a file; false, having said so, when this or an earlier write failed
+bool closeOutput(std::FILE *output, const std::string &path, bool writeFailed)
+{
+    writeFailed |= output == stdout ? std::fflush(output) != 0 : std::fclose(output) != 0;
+    if (writeFailed)
+        std::fprintf(stderr, "Failed writing %s\n", path.c_str());
+    return !writeFailed;
+}
+
+int runBatch(const HeadlessOptions &options)
+{
+    std::FILE *input = options.inputPath == "-" ? stdin : std::fopen(options.inputPath.c_str(), "rb");
+    if (!input) {
+        std::fprintf(stderr, "Cannot open %s\n", options.inputPath.c_str());
+        return 1;
+    }
+    std::FILE *output = openOutput(options.outputPath);
+    if (!output) {
+        if (input != stdin)
+            std::fclose(input);
+        return 1;
+    }
+
+    std::string cachePath;
+    const std::unique_ptr<ResultCache> cache = openResultCache(options, cachePath);
+    std::unique_ptr<ArrowResultWriter> arrow;
+    if (options.arrowOutput)
+        arrow = std::make_unique<ArrowResultWriter>(output, options.compression);
+    BatchRunOptions runOptions;
+    runOptions.threads = options.threads;
+    runOptions.cache = cache.get();
+    runOptions.arrow = arrow.get();
+    BatchRunStats stats = runParallelBatch(input, options.inputFormat, output, options.outputFormat,
+                                           runOptions, stderr);
+    if (arrow && !arrow->finish())
+        stats.writeFailed = true;
+
+    if (input != stdin)
+        std::fclose(input);
+    if (!closeOutput(output, options.outputPath, stats.writeFailed) || !stats.ok)
+        return 1;
+
+    const double seconds = std::max(stats.seconds, 1e-9);
+    std::fprintf(stderr,
+                 "%zu rooms calculated, %zu rejected in %.3f s (%.0f rooms/s, %.1f MB/s)\n"
+                 "%u threads, %s kernel, %zu blocks, %zu stolen, at most %zu in flight\n",
+                 stats.rooms, stats.rejected, stats.seconds, stats.rooms / seconds,
+                 stats.inputBytes / seconds / 1e6, stats.threads, kernelIsaName(activeKernelIsa()),
+                 stats.blocks, stats.steals, stats.peakBlocksInFlight);
+    if (arrow)
+        std::fprintf(stderr, "%zu Arrow record batches, %.1f MB%s\n", arrow->batches(), arrow->bytes() / 1e6,
+                     options.compression == ArrowCompression::Lz4 ? " (LZ4)" : "");
+    if (!closeResultCache(cache.get(), cachePath))
+        return 1;
+    return stats.rejected == 0 ? 0 : 2;
+}
+
+// Reads every room up front, for modes that need the whole set; invalid rows are reported and skipped
+bool readRooms(const std::string &path, RecordFormat format, std::vector<std::string> &ids,
+               std::vector<RoomInput> &rooms, size_t &rejected)
+{
+    std::FILE *input = path == "-" ? stdin : std::fopen(path.c_str(), "rb");
+    if (!input) {
+        std::fprintf(stderr, "Cannot open %s\n", path.c_str());
+        return false;
+    }
+    RecordReader reader(input, format);
+    RoomRecord record;
+    for (ReadStatus status; (status = reader.next(record)) != ReadStatus::End;) {
+        if (status == ReadStatus::Invalid) {
+            std::fprintf(stderr, "%s\n", reader.error().c_str());
+            ++rejected;
+            continue;
+        }
+        ids.push_back(record.id);
+        rooms.push_back(record.input);
+    }
+    if (input != stdin)
+        std::fclose(input);
+    return true;
+}
+
+int runSimulation(const HeadlessOptions &options)
+{
+    const auto started = std::chrono::steady_clock::now();
+    auto secondsSince = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    WeatherYear weather;
+    std::string error;
+    if (!loadWeather(options.weatherPath, weather, error, options.weatherCache)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    const double weatherSeconds = secondsSince(started);
+
+    std::vector<std::string> ids;
+    std::vector<RoomInput> rooms;
+    size_t rejected = 0;
+    if (!readRooms(options.inputPath, options.inputFormat, ids, rooms, rejected))
+        return 1;
+
+    const auto simulationStarted = std::chrono::steady_clock::now();
+    std::vector<AnnualResult> results;
+    simulateAnnual(weather, rooms, results, options.threads);
+    const double simulationSeconds = std::max(secondsSince(simulationStarted), 1e-9);
+
+    std::FILE *output = openOutput(options.outputPath);
+    if (!output)
+        return 1;
+    ColumnWriter writer(output, options.outputFormat, {
+        {"HeatingKWh", 2}, {"CoolingKWh", 2},
+        {"PeakHeatingW", 2}, {"PeakHeatingHour", 0},
+        {"PeakCoolingW", 2}, {"PeakCoolingHour", 0},
+        {"HeatingDegreeHours", 1}, {"CoolingDegreeHours", 1},
+    });
+    for (size_t i = 0; i < results.size(); ++i) {
+        const AnnualResult &result = results[i];
+        // Peak hours are written 1 based, as EPW numbers its hours (0 = never needed)
+        const double values[] = {
+            result.heatingKWh, result.coolingKWh,
+            result.peakHeatingWatt, double(result.peakHeatingHour + 1),
+            result.peakCoolingWatt, double(result.peakCoolingHour + 1),
+            result.heatingDegreeHours, result.coolingDegreeHours,
+        };
+        writer.write(ids[i], values);
+    }
+    if (!closeOutput(output, options.outputPath, !writer.flush()))
+        return 1;
+
+    const double roomHours = double(rooms.size()) * weather.hours();
+    std::fprintf(stderr,
+                 "%zu rooms x %zu hours simulated, %zu rejected in %.3f s (%.0f room-hours/s)\n"
+                 "weather %s in %.3f s\n",
+                 rooms.size(), weather.hours(), rejected, simulationSeconds, roomHours / simulationSeconds,
+                 weather.fromCache ? "read from cache" : "parsed", weatherSeconds);
+    return rejected == 0 ? 0 : 2;
+}
+
+int runSweepMode(const HeadlessOptions &options)
+{
+    std::vector<SweepAxis> axes(options.axes.size());
+    for (size_t i = 0; i < axes.size(); ++i) {
+        std::string error;
+        if (!parseSweepAxis(options.axes[i], axes[i], error)) {
+            std::fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+    }
+    if (sweepCombinations(axes) == 0) {
+        std::fprintf(stderr, "Sweep grid is too large\n");
+        return 1;
+    }
+
+    std::vector<std::string> ids;
+    std::vector<RoomInput> rooms;
+    size_t rejected = 0;
+    if (!readRooms(options.inputPath, options.inputFormat, ids, rooms, rejected))
+        return 1;
+
+    std::FILE *output = openOutput(options.outputPath);
+    if (!output)
+        return 1;
+
+    // One column per axis holding the chosen value, then the objectives
+    std::vector<ColumnFormatter::Column> columns = {{"combination", 0}};
+    for (const SweepAxis &axis : axes)
+        columns.push_back({roomFieldName(axis.field), 4});
+    columns.insert(columns.end(), {{"Cost", 2}, {"CoolingUnits", 0}, {"HeatingUnits", 0}, {"Units", 0},
+                                   {"PeakCoolingW", 2}, {"PeakHeatingW", 2}});
+    std::vector<double> values(columns.size());
+    ColumnWriter writer(output, options.outputFormat, std::move(columns));
+
+    std::vector<int> choices;
+    auto appendPoints = [&](const std::string &id, const SweepPoint *points, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            const SweepPoint &point = points[i];
+            decodeCombination(axes, point.combination, choices);
+            size_t column = 0;
+            values[column++] = double(point.combination);
+            for (size_t a = 0; a < axes.size(); ++a)
+                values[column++] = axes[a].options[choices[a]].value;
+            values[column++] = point.cost;
+            values[column++] = point.coolingUnits;
+            values[column++] = point.heatingUnits;
+            values[column++] = point.units();
+            values[column++] = point.peakCoolingWatt;
+            values[column++] = point.peakHeatingWatt;
+            writer.write(id, values.data());
+        }
+    };
+
+    SweepOptions sweepOptions;
+    sweepOptions.threads = options.threads;
+    sweepOptions.prune = !options.allCombinations;
+    SweepStats total;
+    size_t frontPoints = 0;
+    for (size_t r = 0; r < rooms.size(); ++r) {
+        SweepSink sink;
+        if (options.allCombinations)
+            sink = [&](const SweepPoint *points, size_t count) { appendPoints(ids[r], points, count); };
+        SweepStats stats;
+        std::vector<SweepPoint> front = runSweep(rooms[r], axes, sweepOptions, sink, stats);
+        if (!options.allCombinations)
+            appendPoints(ids[r], front.data(), front.size());
+        frontPoints += front.size();
+        total.combinations += stats.combinations;
+        total.evaluated += stats.evaluated;
+        total.skipped += stats.skipped;
+        total.prunedBranches += stats.prunedBranches;
+        total.seconds += stats.seconds;
+    }
+    if (!closeOutput(output, options.outputPath, !writer.flush()))
+        return 1;
+
+    const double seconds = std::max(total.seconds, 1e-9);
+    std::fprintf(stderr,
+                 "%zu rooms, %llu combinations: %llu evaluated, %llu skipped in %llu pruned branches, "
+                 "%zu on the front, %.3f s (%.0f combinations/s)\n",
+                 rooms.size(), (unsigned long long)total.combinations, (unsigned long long)total.evaluated,
+                 (unsigned long long)total.skipped, (unsigned long long)total.prunedBranches, frontPoints,
+                 total.seconds, total.combinations / seconds);
+    return rejected == 0 ? 0 : 2;
+}
+
+int runMonteCarloMode(const HeadlessOptions &options)
+{
+    std::vector<InputDistribution> distributions(options.distributions.size());
+    for (size_t i = 0; i < distributions.size(); ++i) {
+        std::string error;
+        if (!parseDistribution(options.distributions[i], distributions[i], error)) {
+            std::fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+    }
+
+    std::vector<std::string> ids;
+    std::vector<RoomInput> rooms;
+    size_t rejected = 0;
+    if (!readRooms(options.inputPath, options.inputFormat, ids, rooms, rejected))
+        return 1;
+
+    std::FILE *output = openOutput(options.outputPath);
+    if (!output)
+        return 1;
+    ColumnWriter writer(output, options.outputFormat, {
+        {"PeakCoolingP50W", 2}, {"PeakCoolingP90W", 2}, {"PeakCoolingP99W", 2},
+        {"PeakHeatingP50W", 2}, {"PeakHeatingP90W", 2}, {"PeakHeatingP99W", 2},
+        {"CoolingUnits", 0}, {"CoolingUnitsEnough", 4},
+        {"HeatingUnits", 0}, {"HeatingUnitsEnough", 4},
+    });
+
+    MonteCarloOptions monteCarloOptions;
+    monteCarloOptions.samples = options.samples;
+    monteCarloOptions.seed = options.seed;
+    monteCarloOptions.threads = options.threads;
+    monteCarloOptions.coolingUnits = options.coolingUnits;
+    monteCarloOptions.heatingUnits = options.heatingUnits;
+
+    const auto started = std::chrono::steady_clock::now();
+    for (size_t r = 0; r < rooms.size(); ++r) {
+        const MonteCarloResult result = runMonteCarlo(rooms[r], r, distributions, monteCarloOptions);
+        const double values[] = {
+            result.peakCoolingP50, result.peakCoolingP90, result.peakCoolingP99,
+            result.peakHeatingP50, result.peakHeatingP90, result.peakHeatingP99,
+            double(result.coolingUnits), result.coolingUnitsEnough,
+            double(result.heatingUnits), result.heatingUnitsEnough,
+        };
+        writer.write(ids[r], values);
+    }
+    if (!closeOutput(output, options.outputPath, !writer.flush()))
+        return 1;
+
+    const double seconds
+        = std::max(std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count(), 1e-9);
+    const double samples = double(rooms.size()) * options.samples;
+    std::fprintf(stderr, "%zu rooms x %llu samples, %zu rejected in %.3f s (%.0f samples/s), seed %llu\n",
+                 rooms.size(), (unsigned long long)options.samples, rejected, seconds, samples / seconds,
+                 (unsigned long long)options.seed);
+    return rejected == 0 ? 0 : 2;
+}
+
+// Solves the rooms as one building: the steady state at each room's own conditions, or
+// a year of hourly steps through --weather
+int runBuildingMode(const HeadlessOptions &options)
+{
+    const auto started = std::chrono::steady_clock::now();
+    auto secondsSince = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    WeatherYear weather;
+    std::string error;
+    if (!options.weatherPath.empty() && !loadWeather(options.weatherPath, weather, error, options.weatherCache)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    std::vector<std::string> ids;
+    std::vector<RoomInput> rooms;
+    size_t rejected = 0;
+    if (!readRooms(options.inputPath, options.inputFormat, ids, rooms, rejected))
+        return 1;
+    BuildingLayout layout;
+    BuildingModel model;
+    if (!loadBuildingLayout(options.layoutPath, ids, layout, error) || !model.build(rooms, layout, error)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    const double buildSeconds = secondsSince(started);
+
+    const auto solveStarted = std::chrono::steady_clock::now();
+    const bool transient = !options.weatherPath.empty();
+    std::vector<ZoneTransient> hourly;
+    const SolveStats stats = transient ? model.simulate(weather.dryBulb, hourly) : model.solve();
+    const double solveSeconds = secondsSince(solveStarted);
+
+    std::FILE *output = openOutput(options.outputPath);
+    if (!output)
+        return 1;
+    ColumnWriter writer(output, options.outputFormat, transient
+        ? std::vector<ColumnFormatter::Column>{
+              {"HeatingKWh", 2}, {"PeakHeatingW", 2}, {"PeakHeatingHour", 0},
+              {"MinTemperatureC", 2}, {"MaxTemperatureC", 2},
+          }
+        : std::vector<ColumnFormatter::Column>{
+              {"TemperatureC", 2}, {"OutsideW", 2}, {"PartitionW", 2},
+              {"TotalHeatingW", 2}, {"PeakHeatingW", 2}, {"HeatingUnits", 0},
+              {"IsolatedPeakHeatingW", 2},
+          });
+    for (size_t i = 0; i < rooms.size(); ++i) {
+        if (transient) {
+            // Peak hours are written 1 based, as EPW numbers its hours (0 = never needed)
+            const ZoneTransient &result = hourly[i];
+            const double values[] = {
+                result.heatingKWh, result.peakHeatingWatt, double(result.peakHeatingHour + 1),
+                result.minTemperature, result.maxTemperature,
+            };
+            writer.write(ids[i], values);
+        } else {
+            // The room on its own, every wall a loss to the outside, for comparison
+            RoomLoads isolated;
+            calculateHeatingLoads(rooms[i], isolated);
+            const ZoneLoads &result = model.loads(i);
+            const double values[] = {
+                result.temperature, result.outsideWatt, result.partitionWatt,
+                result.totalHeatingWatt, result.peakHeatingWatt, double(result.heatingUnits),
+                isolated.peakHeatingWatt,
+            };
+            writer.write(ids[i], values);
+        }
+    }
+    if (!closeOutput(output, options.outputPath, !writer.flush()))
+        return 1;
+
+    std::fprintf(stderr,
+                 "%zu zones, %zu partitions, %zu unheated, %zu rejected; built in %.3f s\n"
+                 "%s in %.3f s, %d conjugate gradient iterations%s\n",
+                 rooms.size(), layout.partitions.size(), stats.unknowns, rejected, buildSeconds,
+                 transient ? "simulated" : "solved", solveSeconds, stats.iterations,
+                 stats.converged ? "" : " (did not converge)");
+    if (!stats.converged)
+        return 1;
+    return rejected == 0 ? 0 : 2;
+}
+
+// Lists the catalog entries matching --find (all of them without it), by category
+int runCatalogMode(const HeadlessOptions &options)
+{
+    const auto started = std::chrono::steady_clock::now();
+    Catalog catalog;
+    std::string error;
+    if (!catalog.load(options.inputPath, error, options.catalogIndex)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    const auto loaded = std::chrono::steady_clock::now();
+
+    std::vector<CatalogId> matches;
+    std::string text = "category,name,value\n";
+    size_t matched = 0;
+    std::chrono::steady_clock::duration searching{};
+    for (int c = 0; c < int(CatalogCategory::Count); ++c) {
+        const CatalogCategory category = CatalogCategory(c);
+        const auto searchStarted = std::chrono::steady_clock::now();
+        catalog.search(category, options.find, 0, matches);
+        searching += std::chrono::steady_clock::now() - searchStarted;
+        matched += matches.size();
+        for (CatalogId id : matches) {
+            const std::string_view name = catalog.name(id);
+            text += catalogCategoryName(category);
+            text += ',';
+            if (name.find_first_of(",\"") == std::string_view::npos) {
+                text += name;
+            } else {
+                text += '"';
+                for (char ch : name)
+                    text += ch == '"' ? std::string("\"\"") : std::string(1, ch);
+                text += '"';
+            }
+            char number[32];
+            std::snprintf(number, sizeof(number), ",%g\n", catalog.value(id));
+            text += number;
+        }
+    }
+
+    std::FILE *output = openOutput(options.outputPath);
+    if (!output)
+        return 1;
+    const bool writeFailed = std::fwrite(text.data(), 1, text.size(), output) != text.size();
+    if (!closeOutput(output, options.outputPath, writeFailed))
+        return 1;
+
+    const auto milliseconds = [](std::chrono::steady_clock::duration duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    };
+    std::fprintf(stderr, "%zu entries from the %s in %.3f ms, %zu matched in %.3f ms\n", catalog.size(),
+                 catalog.fromIndex() ? "index" : "source", milliseconds(loaded - started), matched,
+                 milliseconds(searching));
+    return 0;
+}
+
+// Creates or opens a project, optionally adds calculated rooms and exports it
+int runProjectMode(const HeadlessOptions &options)
+{
+    const auto started = std::chrono::steady_clock::now();
+    ProjectFile project;
+    std::string error;
+    std::error_code ec;
+    const bool exists = std::filesystem::exists(options.inputPath, ec);
+    if (!exists && options.addPath.empty()) {
+        std::fprintf(stderr, "Cannot open %s\n", options.inputPath.c_str());
+        return 1;
+    }
+    if (exists && !project.open(options.inputPath, error)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    const auto opened = std::chrono::steady_clock::now();
+
+    std::vector<std::string> ids;
+    std::vector<RoomInput> rooms;
+    size_t rejected = 0;
+    if (!options.addPath.empty() && !readRooms(options.addPath, options.inputFormat, ids, rooms, rejected))
+        return 1;
+    ProjectRoom room;
+    for (size_t i = 0; i < rooms.size(); ++i) {
+        room.name = ids[i];
+        room.input = rooms[i];
+        room.loads = calculateRoomLoads(rooms[i]);
+        project.add(room);
+    }
+
+    const auto saveStarted = std::chrono::steady_clock::now();
+    const bool saved = !exists || options.compact ? project.saveAs(options.inputPath, error) : project.save(error);
+    if (!saved) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    const auto saveFinished = std::chrono::steady_clock::now();
+
+    if (!options.exportPath.empty()) {
+        std::FILE *output = openOutput(options.exportPath);
+        if (!output)
+            return 1;
+        const bool ok = project.exportRooms(output, options.outputFormat, error);
+        if (!closeOutput(output, options.exportPath, !ok))
+            return 1;
+    }
+
+    const auto milliseconds = [](std::chrono::steady_clock::duration duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    };
+    std::fprintf(stderr,
+                 "%zu rooms; opened in %.3f ms (%zu replayed after the index), %zu added, saved in %.3f ms, "
+                 "%.1f kB stale\n",
+                 project.size(), milliseconds(opened - started), project.appendedOnOpen(), rooms.size(),
+                 milliseconds(saveFinished - saveStarted), project.staleBytes() / 1e3);
+    return rejected == 0 ? 0 : 2;
+}
+
+// Prints a latency summary; false when a p99 target was given and missed
+bool reportLatency(const ProbeSummary &latency, double p99TargetMs)
+{
+    std::fprintf(stderr, "latency p50 %.1f us, p90 %.1f us, p99 %.1f us, max %.1f us", latency.p50Ns / 1e3,
+                 latency.p90Ns / 1e3, latency.p99Ns / 1e3, latency.maxNs / 1e3);
+    if (p99TargetMs <= 0) {
+        std::fprintf(stderr, "\n");
+        return true;
+    }
+    const bool met = latency.p99Ns <= p99TargetMs * 1e6;
+    std::fprintf(stderr, "; p99 target %g ms %s\n", p99TargetMs, met ? "met" : "missed");
+    return met;
+}
+
+// Answers calculation requests on a Unix socket until interrupted
+int runServeMode(const HeadlessOptions &options)
+{
+    ServeOptions serveOptions;
+    serveOptions.threads = options.threads;
+    serveOptions.maxBatch = options.maxBatch;
+    std::string cachePath;
+    const std::unique_ptr<ResultCache> cache = openResultCache(options, cachePath);
+    serveOptions.cache = cache.get();
+
+    std::fprintf(stderr, "Starting the calculation service on %s, %s kernel; Ctrl+C stops it\n",
+                 options.inputPath.c_str(), kernelIsaName(activeKernelIsa()));
+    std::string error;
+    const ServeStats stats = runCalcServer(options.inputPath, serveOptions, error);
+    if (!stats.ok) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    std::fprintf(stderr,
+                 "%llu requests, %llu rejected, from %zu connections in %.1f s on %u threads\n"
+                 "%llu batches, %.1f requests per batch, largest %zu\n",
+                 (unsigned long long)stats.requests, (unsigned long long)stats.rejected, stats.connections,
+                 stats.seconds, stats.threads, (unsigned long long)stats.batches,
+                 stats.batches ? double(stats.requests) / stats.batches : 0.0, stats.largestBatch);
+    reportLatency(stats.latency, options.p99TargetMs);
+    return closeResultCache(cache.get(), cachePath) ? 0 : 1;
+}
+
+// Drives a running server with the rooms and checks its answers. Exits with
+// status 3 when a --p99-target was missed, as the benchmarks do for a regression.
+int runLoadGeneratorMode(const HeadlessOptions &options)
+{
+    std::vector<std::string> ids;
+    std::vector<RoomInput> rooms;
+    size_t rejected = 0;
+    if (!readRooms(options.inputPath, options.inputFormat, ids, rooms, rejected))
+        return 1;
+
+    LoadOptions loadOptions;
+    loadOptions.connections = options.connections;
+    loadOptions.pipeline = options.pipeline;
+    loadOptions.requests = options.requests;
+    loadOptions.binary = options.binary;
+
+    std::string error;
+    const LoadStats stats = runLoadGenerator(options.socketPath, rooms, loadOptions, error);
+    if (!stats.ok)
+        std::fprintf(stderr, "%s\n", error.c_str());
+
+    const double seconds = std::max(stats.seconds, 1e-9);
+    std::fprintf(stderr,
+                 "%llu %s requests over %u connections, %u in flight each, in %.3f s (%.0f requests/s)\n"
+                 "%llu rejected, %llu answers differ from the local calculation\n",
+                 (unsigned long long)stats.requests, options.binary ? "binary" : "JSON", options.connections,
+                 options.pipeline, stats.seconds, stats.requests / seconds, (unsigned long long)stats.rejected,
+                 (unsigned long long)stats.mismatches);
+    const bool met = reportLatency(stats.latency, options.p99TargetMs);
+    if (!stats.ok || stats.rejected || stats.mismatches)
+        return 1;
+    return met ? 0 : 3;
+}
+
+// Reads a line into buffer without its line ending; false at the end of the file. A
+// line that does not fit is skipped to its end and comes back empty with tooLong set.
+bool readLine(std::FILE *file, char *buffer, int size, std::string_view &line, bool &tooLong)
+{
+    if (!std::fgets(buffer, size, file))
+        return false;
+    size_t length = std::strlen(buffer);
+    tooLong = length == size_t(size - 1) && buffer[length - 1] != '\n' && !std::feof(file);
+    if (tooLong) {
+        for (int c = std::getc(file); c != EOF && c != '\n'; c = std::getc(file)) {
+        }
+        length = 0;
+    }
+    while (length && (buffer[length - 1] == '\n' || buffer[length - 1] == '\r'))
+        --length;
+    line = std::string_view(buffer, length);
+    return true;
+}
+
+// Checks the rooms' installed capacity against readings as they arrive, writing a
+// line whenever a room goes over capacity or comes back under
+int runMonitorMode(const HeadlessOptions &options)
+{
+    std::vector<std::string> ids;
+    std::vector<RoomInput> rooms;
+    size_t rejected = 0;
+    if (!readRooms(options.inputPath, options.inputFormat, ids, rooms, rejected))
+        return 1;
+
+    MonitorOptions monitorOptions;
+    monitorOptions.historyMinutes = options.historyMinutes;
+    monitorOptions.sustainMinutes = options.sustainMinutes;
+    monitorOptions.coolingUnits = options.coolingUnits;
+    monitorOptions.heatingUnits = options.heatingUnits;
+    LoadMonitor monitor(ids, rooms, monitorOptions);
+
+    std::FILE *readings = options.readingsPath == "-" ? stdin : std::fopen(options.readingsPath.c_str(), "rb");
+    if (!readings) {
+        std::fprintf(stderr, "Cannot open %s\n", options.readingsPath.c_str());
+        return 1;
+    }
+    std::FILE *output = openOutput(options.outputPath);
+    if (!output) {
+        if (readings != stdin)
+            std::fclose(readings);
+        return 1;
+    }
+    ColumnWriter writer(output, options.outputFormat, {
+        {"Time", 0}, {"Over", 0},
+        {"IndoorC", 2}, {"OutdoorC", 2},
+        {"HeatingW", 2}, {"CoolingW", 2},
+        {"HeatingCapacityW", 2}, {"CoolingCapacityW", 2},
+    });
+    std::vector<MonitorEvent> events;
+    bool writeFailed = false;
+    // Flushed as they come, for whatever is watching the other end of a pipe
+    auto writeEvents = [&]() {
+        for (const MonitorEvent &event : events) {
+            const double values[] = {
+                event.time, event.over ? 1.0 : 0.0,
+                event.indoor, event.outdoor,
+                event.heatingWatt, event.coolingWatt,
+                monitor.heatingCapacityWatt(event.room), monitor.coolingCapacityWatt(event.room),
+            };
+            writer.write(monitor.id(event.room), values);
+        }
+        events.clear();
+        writeFailed |= !writer.flush();
+    };
+    writeEvents();
+
+    const auto started = std::chrono::steady_clock::now();
+    char buffer[4096];
+    std::string_view line;
+    bool tooLong = false;
+    size_t invalid = 0;
+    Reading reading;
+    for (bool first = true; readLine(readings, buffer, sizeof(buffer), line, tooLong); first = false) {
+        if (line.empty() && !tooLong)
+            continue;
+        // The first line may be a header
+        if (tooLong || !parseReading(line, reading)) {
+            invalid += !first;
+            continue;
+        }
+        monitor.add(reading, events);
+        if (!events.empty())
+            writeEvents();
+    }
+    const bool readFailed = std::ferror(readings) != 0;
+    if (readings != stdin)
+        std::fclose(readings);
+    monitor.finish(events);
+    writeEvents();
+    const double seconds
+        = std::max(std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count(), 1e-9);
+    writeFailed = !closeOutput(output, options.outputPath, writeFailed);
+    if (readFailed)
+        std::fprintf(stderr, "Failed reading %s\n", options.readingsPath.c_str());
+
+    if (!options.summaryPath.empty()) {
+        std::FILE *summaryFile = openOutput(options.summaryPath);
+        if (!summaryFile)
+            return 1;
+        ColumnWriter summaryWriter(summaryFile, formatForPath(options.summaryPath), {
+            {"Minutes", 0}, {"OverMinutes", 0}, {"Over", 0},
+            {"PeakHeatingW", 2}, {"PeakCoolingW", 2},
+            {"RecentHeatingW", 2}, {"RecentCoolingW", 2},
+            {"HeatingCapacityW", 2}, {"CoolingCapacityW", 2},
+        });
+        for (size_t i = 0; i < monitor.roomCount(); ++i) {
+            const MonitorRoomSummary summary = monitor.summary(i);
+            const double values[] = {
+                double(summary.minutes), double(summary.overMinutes), summary.over ? 1.0 : 0.0,
+                summary.peakHeatingWatt, summary.peakCoolingWatt,
+                summary.recentHeatingWatt, summary.recentCoolingWatt,
+                monitor.heatingCapacityWatt(i), monitor.coolingCapacityWatt(i),
+            };
+            summaryWriter.write(monitor.id(i), values);
+        }
+        if (!closeOutput(summaryFile, options.summaryPath, !summaryWriter.flush()))
+            return 1;
+    }
+
+    const MonitorStats &stats = monitor.stats();
+    std::fprintf(stderr,
+                 "%llu readings in %.3f s (%.0f readings/s), %llu for unknown rooms, %llu late, %zu invalid\n"
+                 "%llu room-minutes, %zu of %zu rooms over capacity at the end, %.1f MB held\n",
+                 (unsigned long long)stats.readings, seconds, stats.readings / seconds,
+                 (unsigned long long)stats.unknownRoom, (unsigned long long)stats.late, invalid,
+                 (unsigned long long)stats.minutes, stats.roomsOver, monitor.roomCount(),
+                 monitor.memoryBytes() / 1048576.0);
+    if (readFailed || writeFailed)
+        return 1;
+    return rejected == 0 && invalid == 0 ? 0 : 2;
+}
+
+// Plays readings back as a sensor feed would send them, for trying --monitor
+// offline: each line is written when as much time has passed as its reading's
+// time is after the first one's, divided by the speed
+int runReplayMode(const HeadlessOptions &options)
+{
+    std::FILE *input = options.inputPath == "-" ? stdin : std::fopen(options.inputPath.c_str(), "rb");
+    if (!input) {
+        std::fprintf(stderr, "Cannot open %s\n", options.inputPath.c_str());
+        return 1;
+    }
+    std::FILE *output = openOutput(options.outputPath);
+    if (!output) {
+        if (input != stdin)
+            std::fclose(input);
+        return 1;
+    }
+
+    const auto started = std::chrono::steady_clock::now();
+    char buffer[4096];
+    std::string_view line;
+    bool tooLong = false;
+    uint64_t written = 0;
+    size_t skipped = 0;
+    bool timed = false;
+    double firstTime = 0;
+    bool writeFailed = false;
+    Reading reading;
+    while (readLine(input, buffer, sizeof(buffer), line, tooLong)) {
+        if (tooLong) {
+            ++skipped;
+            continue;
+        }
+        if (options.speed > 0 && parseReading(line, reading)) {
+            if (!timed) {
+                firstTime = reading.time;
+                timed = true;
+            }
+            const auto due = started + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                           std::chrono::duration<double>((reading.time - firstTime) / options.speed));
+            if (due > std::chrono::steady_clock::now()) {
+                writeFailed |= std::fflush(output) != 0;
+                std::this_thread::sleep_until(due);
+            }
+        }
+        writeFailed |= std::fwrite(line.data(), 1, line.size(), output) != line.size();
+        writeFailed |= std::fputc('\n', output) == EOF;
+        ++written;
+    }
+    const bool readFailed = std::ferror(input) != 0;
+    if (input != stdin)
+        std::fclose(input);
+    writeFailed = !closeOutput(output, options.outputPath, writeFailed);
+    if (readFailed)
+        std::fprintf(stderr, "Failed reading %s\n", options.inputPath.c_str());
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    std::fprintf(stderr, "%llu lines replayed in %.3f s, %zu too long skipped\n", (unsigned long long)written, seconds,
+                 skipped);
+    return readFailed || writeFailed ? 1 : 0;
+}
+
+} // namespace
+
+
+// The executable is built for the GUI subsystem on Windows, so borrow the
+// console of the shell that started it for any stream not redirected to a file
+void attachParentConsole()
+{
+#ifdef _WIN32
+    if (!AttachConsole(ATTACH_PARENT_PROCESS))
+        return;
+    if (GetFileType(GetStdHandle(STD_OUTPUT_HANDLE)) == FILE_TYPE_UNKNOWN)
+        std::freopen("CONOUT$", "w", stdout);
+    if (GetFileType(GetStdHandle(STD_ERROR_HANDLE)) == FILE_TYPE_UNKNOWN)
+        std::freopen("CONOUT$", "w", stderr);
+#endif
+}
+
+bool isHeadlessCommand(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        HeadlessMode mode;
+        if (findMode(argv[i], mode))
+            return true;
+    }
+    return false;
+}
+
+int runHeadless(int argc, char *argv[])
+{
+    attachParentConsole();
+
+    HeadlessOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+    switch (options.mode) {
+    case HeadlessMode::Simulate:
+        return runSimulation(options);
+    case HeadlessMode::Sweep:
+        return runSweepMode(options);
+    case HeadlessMode::MonteCarlo:
+        return runMonteCarloMode(options);
+    case HeadlessMode::Building:
+        return runBuildingMode(options);
+    case HeadlessMode::Catalog:
+        return runCatalogMode(options);
+    case HeadlessMode::Project:
+        return runProjectMode(options);
+    case HeadlessMode::Serve:
+        return runServeMode(options);
+    case HeadlessMode::LoadGenerator:
+        return runLoadGeneratorMode(options);
+    case HeadlessMode::Monitor:
+        return runMonitorMode(options);
+    case HeadlessMode::Replay:
+        return runReplayMode(options);
+    case HeadlessMode::Batch:
+        break;
+    }
+    return runBatch(options);
+}
@@ -0,0 +1,15 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+// Command-line modes that run without a QApplication (and so without a display)
+
+// True when the arguments select one of the headless modes
+bool isHeadlessCommand(int argc, char *argv[]);
+
+// Runs the selected headless mode and returns the process exit code
+int runHeadless(int argc, char *argv[]);
+
+// Lets the GUI-subsystem build on Windows write to the console it was started from
+void attachParentConsole();
+
+#endif // HEADLESS_H
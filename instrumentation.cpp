@@ -0,0 +1,344 @@
+#include "instrumentation.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+
+// Four buckets per power of two of nanoseconds, up to 2^48 ns
+const int BucketCount = 192;
+const int TraceCapacity = 4096;
+const int MaxProbes = Instrumentation::MaxProbes;
+
+struct TraceEvent
+{
+    std::atomic<uint64_t> start{0};
+    std::atomic<uint64_t> duration{0};
+    std::atomic<uint64_t> tag{0}; // probe in the low byte, thread number above it
+};
+
+// One thread's recordings. Only the owning thread writes, so plain relaxed
+// loads and stores are enough and nothing bounces between cores.
+struct ThreadStats
+{
+    std::atomic<uint64_t> count[MaxProbes] = {};
+    std::atomic<uint64_t> total[MaxProbes] = {};
+    std::atomic<uint64_t> minimum[MaxProbes] = {};
+    std::atomic<uint64_t> maximum[MaxProbes] = {};
+    std::atomic<uint64_t> buckets[MaxProbes][BucketCount] = {};
+    TraceEvent events[TraceCapacity];
+    std::atomic<uint64_t> eventsWritten{0};
+    uint64_t thread = 0;
+};
+
+struct Registry
+{
+    std::mutex mutex;
+    const char *names[MaxProbes] = {};
+    bool timers[MaxProbes] = {};
+    std::atomic<int> probes{0};
+    std::vector<std::unique_ptr<ThreadStats>> threads;
+    std::vector<ThreadStats *> unused; // from threads that have exited, kept for their data
+    uint64_t nextThread = 1;
+};
+
+Registry &registry()
+{
+    static Registry instance;
+    return instance;
+}
+
+// Hands a thread its stats on first use and returns them for reuse when it exits
+struct ThreadSlot
+{
+    ThreadStats *stats = nullptr;
+
+    ~ThreadSlot()
+    {
+        if (!stats)
+            return;
+        Registry &shared = registry();
+        std::lock_guard<std::mutex> lock(shared.mutex);
+        shared.unused.push_back(stats);
+    }
+
+    ThreadStats &get()
+    {
+        if (!stats) {
+            Registry &shared = registry();
+            std::lock_guard<std::mutex> lock(shared.mutex);
+            if (shared.unused.empty()) {
+                shared.threads.push_back(std::make_unique<ThreadStats>());
+                stats = shared.threads.back().get();
+            } else {
+                stats = shared.unused.back();
+                shared.unused.pop_back();
+            }
+            stats->thread = shared.nextThread++;
+        }
+        return *stats;
+    }
+};
+
+thread_local ThreadSlot threadSlot;
+
+int highestBit(uint64_t value)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return static_cast<int>(index);
+#else
+    return 63 - __builtin_clzll(value);
+#endif
+}
+
+int bucketIndex(uint64_t value)
+{
+    if (value < 4)
+        return static_cast<int>(value);
+    const int octave = std::min(highestBit(value), 47);
+    const int sub = static_cast<int>((value >> (octave - 2)) & 3);
+    return (octave - 1) * 4 + sub;
+}
+
+// Middle of the range of values a bucket holds
+double bucketMiddle(int index)
+{
+    if (index < 4)
+        return index;
+    const int octave = index / 4 + 1;
+    const double width = double(uint64_t(1) << (octave - 2));
+    return (4 + index % 4) * width + width / 2;
+}
+
+void add(std::atomic<uint64_t> &value, uint64_t amount)
+{
+    value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+void addTrace(ThreadStats &stats, int probe, uint64_t start, uint64_t duration)
+{
+    const uint64_t written = stats.eventsWritten.load(std::memory_order_relaxed);
+    TraceEvent &event = stats.events[written % TraceCapacity];
+    event.start.store(start, std::memory_order_relaxed);
+    event.duration.store(duration, std::memory_order_relaxed);
+    event.tag.store(stats.thread << 8 | uint64_t(probe), std::memory_order_relaxed);
+    stats.eventsWritten.store(written + 1, std::memory_order_release);
+}
+
+void appendEscaped(std::string &out, const char *text)
+{
+    for (; *text; ++text) {
+        if (*text == '"' || *text == '\\')
+            out += '\\';
+        out += *text;
+    }
+}
+
+bool writeFile(const std::string &path, const std::string &text)
+{
+    std::FILE *file = std::fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+    bool ok = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+    ok = std::fclose(file) == 0 && ok;
+    return ok;
+}
+
+const auto processStart = std::chrono::steady_clock::now();
+
+} // namespace
+
+
+std::atomic<bool> Instrumentation::active{std::getenv("BTUCALC_INSTRUMENT") != nullptr};
+
+void Instrumentation::setEnabled(bool enable)
+{
+    active.store(enable, std::memory_order_relaxed);
+}
+
+int Instrumentation::probe(const char *name, bool timer)
+{
+    Registry &shared = registry();
+    std::lock_guard<std::mutex> lock(shared.mutex);
+    const int probes = shared.probes.load(std::memory_order_relaxed);
+    for (int i = 0; i < probes; ++i) {
+        if (std::string(shared.names[i]) == name)
+            return i;
+    }
+    // Past the limit everything shares the last probe rather than failing
+    if (probes == MaxProbes)
+        return MaxProbes - 1;
+    shared.names[probes] = name;
+    shared.timers[probes] = timer;
+    shared.probes.store(probes + 1, std::memory_order_release);
+    return probes;
+}
+
+uint64_t Instrumentation::now()
+{
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - processStart).count());
+}
+
+void Instrumentation::record(int probe, uint64_t start, uint64_t duration)
+{
+    ThreadStats &stats = threadSlot.get();
+    const uint64_t count = stats.count[probe].load(std::memory_order_relaxed);
+    if (count == 0 || duration < stats.minimum[probe].load(std::memory_order_relaxed))
+        stats.minimum[probe].store(duration, std::memory_order_relaxed);
+    if (duration > stats.maximum[probe].load(std::memory_order_relaxed))
+        stats.maximum[probe].store(duration, std::memory_order_relaxed);
+    add(stats.total[probe], duration);
+    add(stats.buckets[probe][bucketIndex(duration)], 1);
+    stats.count[probe].store(count + 1, std::memory_order_relaxed);
+    addTrace(stats, probe, start, duration);
+}
+
+void Instrumentation::addCount(int probe, uint64_t amount)
+{
+    ThreadStats &stats = threadSlot.get();
+    add(stats.count[probe], amount);
+}
+
+std::vector<ProbeSummary> Instrumentation::summary()
+{
+    Registry &shared = registry();
+    std::lock_guard<std::mutex> lock(shared.mutex);
+    const int probes = shared.probes.load(std::memory_order_acquire);
+    std::vector<ProbeSummary> summaries(probes);
+    std::vector<uint64_t> buckets(BucketCount);
+    for (int probe = 0; probe < probes; ++probe) {
+        ProbeSummary &summary = summaries[probe];
+        summary.name = shared.names[probe];
+        summary.timer = shared.timers[probe];
+        std::fill(buckets.begin(), buckets.end(), 0);
+        uint64_t minimum = UINT64_MAX;
+        uint64_t maximum = 0;
+        for (const auto &stats : shared.threads) {
+            const uint64_t count = stats->count[probe].load(std::memory_order_relaxed);
+            if (count == 0)
+                continue;
+            summary.count += count;
+            summary.totalNs += stats->total[probe].load(std::memory_order_relaxed);
+            minimum = std::min(minimum, stats->minimum[probe].load(std::memory_order_relaxed));
+            maximum = std::max(maximum, stats->maximum[probe].load(std::memory_order_relaxed));
+            for (int b = 0; b < BucketCount; ++b)
+                buckets[b] += stats->buckets[probe][b].load(std::memory_order_relaxed);
+        }
+        if (!summary.timer || summary.count == 0)
+            continue;
+        summary.minNs = double(minimum);
+        summary.maxNs = double(maximum);
+
+        uint64_t recorded = 0;
+        for (uint64_t value : buckets)
+            recorded += value;
+        const double fractions[] = {0.5, 0.9, 0.99};
+        double *targets[] = {&summary.p50Ns, &summary.p90Ns, &summary.p99Ns};
+        for (int p = 0; p < 3; ++p) {
+            const uint64_t rank = static_cast<uint64_t>(fractions[p] * recorded);
+            uint64_t seen = 0;
+            int b = 0;
+            while (b < BucketCount - 1 && seen + buckets[b] <= rank)
+                seen += buckets[b++];
+            *targets[p] = std::clamp(bucketMiddle(b), summary.minNs, summary.maxNs);
+        }
+    }
+    return summaries;
+}
+
+void Instrumentation::reset()
+{
+    Registry &shared = registry();
+    std::lock_guard<std::mutex> lock(shared.mutex);
+    for (const auto &stats : shared.threads) {
+        for (int probe = 0; probe < MaxProbes; ++probe) {
+            stats->count[probe].store(0, std::memory_order_relaxed);
+            stats->total[probe].store(0, std::memory_order_relaxed);
+            stats->minimum[probe].store(0, std::memory_order_relaxed);
+            stats->maximum[probe].store(0, std::memory_order_relaxed);
+            for (auto &bucket : stats->buckets[probe])
+                bucket.store(0, std::memory_order_relaxed);
+        }
+        stats->eventsWritten.store(0, std::memory_order_relaxed);
+    }
+}
+
+bool Instrumentation::writeJson(const std::string &path)
+{
+    std::string out = "{\n  \"probes\": [";
+    char number[64];
+    bool first = true;
+    for (const ProbeSummary &summary : summary()) {
+        out += first ? "\n    {\"name\": \"" : ",\n    {\"name\": \"";
+        first = false;
+        appendEscaped(out, summary.name.c_str());
+        if (!summary.timer) {
+            std::snprintf(number, sizeof(number), "\", \"kind\": \"counter\", \"count\": %llu}",
+                          (unsigned long long)summary.count);
+            out += number;
+            continue;
+        }
+        std::snprintf(number, sizeof(number), "\", \"kind\": \"timer\", \"count\": %llu",
+                      (unsigned long long)summary.count);
+        out += number;
+        const struct
+        {
+            const char *key;
+            double value;
+        } fields[] = {
+            {"totalNs", summary.totalNs}, {"minNs", summary.minNs}, {"maxNs", summary.maxNs},
+            {"p50Ns", summary.p50Ns}, {"p90Ns", summary.p90Ns}, {"p99Ns", summary.p99Ns},
+        };
+        for (const auto &field : fields) {
+            std::snprintf(number, sizeof(number), ", \"%s\": %.0f", field.key, field.value);
+            out += number;
+        }
+        out += '}';
+    }
+    out += "\n  ]\n}\n";
+    return writeFile(path, out);
+}
+
+bool Instrumentation::writeChromeTrace(const std::string &path)
+{
+    std::vector<const char *> names;
+    std::string out = "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+    bool first = true;
+    {
+        Registry &shared = registry();
+        std::lock_guard<std::mutex> lock(shared.mutex);
+        names.assign(shared.names, shared.names + shared.probes.load(std::memory_order_acquire));
+        char event[160];
+        for (const auto &stats : shared.threads) {
+            const uint64_t written = stats->eventsWritten.load(std::memory_order_acquire);
+            const uint64_t begin = written > uint64_t(TraceCapacity) ? written - TraceCapacity : 0;
+            for (uint64_t i = begin; i < written; ++i) {
+                const TraceEvent &trace = stats->events[i % TraceCapacity];
+                const uint64_t tag = trace.tag.load(std::memory_order_relaxed);
+                const size_t probe = tag & 0xff;
+                if (probe >= names.size())
+                    continue;
+                out += first ? "\n  {\"name\": \"" : ",\n  {\"name\": \"";
+                first = false;
+                appendEscaped(out, names[probe]);
+                std::snprintf(event, sizeof(event), "\", \"ph\": \"X\", \"pid\": 1, \"tid\": %llu, \"ts\": %.3f, \"dur\": %.3f}",
+                              (unsigned long long)(tag >> 8), trace.start.load(std::memory_order_relaxed) / 1e3,
+                              trace.duration.load(std::memory_order_relaxed) / 1e3);
+                out += event;
+            }
+        }
+    }
+    out += "\n]}\n";
+    return writeFile(path, out);
+}
@@ -0,0 +1,98 @@
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Always compiled hot path instrumentation. Scoped timers and counters record
+// into histograms owned by the recording thread, so recording never locks or
+// contends; readers merge every thread's histograms when asked. While disabled
+// (the default unless BTUCALC_INSTRUMENT is set) a probe costs one relaxed load.
+//
+// A probe is registered once per call site:
+//
+//     static const int probe = Instrumentation::probe("form.update");
+//     ScopedTimer timer(probe);
+
+struct ProbeSummary
+{
+    std::string name;
+    bool timer = true; // false for counters, whose count is the sum of the amounts
+    uint64_t count = 0;
+    double totalNs = 0;
+    double minNs = 0;
+    double maxNs = 0;
+    double p50Ns = 0; // percentiles are bucket midpoints, within 12.5%
+    double p90Ns = 0;
+    double p99Ns = 0;
+};
+
+class Instrumentation
+{
+public:
+    static const int MaxProbes = 64;
+
+    static bool enabled() { return active.load(std::memory_order_relaxed); }
+    static void setEnabled(bool enable);
+
+    // Id of a named probe, registering it on first use; name must be a literal
+    static int probe(const char *name, bool timer = true);
+
+    // Steady clock in nanoseconds
+    static uint64_t now();
+
+    // Adds one timing (start and duration from now()) to the calling thread's histogram
+    static void record(int probe, uint64_t start, uint64_t duration);
+
+    static void count(int probe, uint64_t amount = 1)
+    {
+        if (enabled())
+            addCount(probe, amount);
+    }
+
+    // Every registered probe, merged over all threads that have recorded
+    static std::vector<ProbeSummary> summary();
+
+    // Clears the histograms and trace; timings being recorded right now may survive it
+    static void reset();
+
+    static bool writeJson(const std::string &path);
+
+    // Recent timings (the last few thousand per thread) in the Chrome trace event
+    // format, for chrome://tracing or Perfetto
+    static bool writeChromeTrace(const std::string &path);
+
+private:
+    static void addCount(int probe, uint64_t amount);
+
+    static std::atomic<bool> active;
+};
+
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(int probe)
+        : probe(probe)
+        , running(Instrumentation::enabled())
+        , start(running ? Instrumentation::now() : 0)
+    {
+    }
+
+    ~ScopedTimer()
+    {
+        if (running)
+            Instrumentation::record(probe, start, Instrumentation::now() - start);
+    }
+
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+    int probe;
+    bool running;
+    uint64_t start;
+};
+
+#endif // INSTRUMENTATION_H
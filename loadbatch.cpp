@@ -0,0 +1,230 @@
+#include "loadbatch.h"
+#include "loadkernel.h"
+#include "solargain.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_MSC_VER) && (defined(BTUCALC_HAVE_AVX2) || defined(BTUCALC_HAVE_AVX512))
+#include <intrin.h>
+#endif
+
+namespace {
+
+const int UnsetIsa = -1;
+std::atomic<int> selectedIsa{UnsetIsa};
+
+bool cpuSupports(KernelIsa isa)
+{
+    if (isa == KernelIsa::Scalar)
+        return true;
+#if !defined(BTUCALC_HAVE_AVX512)
+    if (isa == KernelIsa::Avx512)
+        return false;
+#endif
+#if !defined(BTUCALC_HAVE_AVX2)
+    if (isa == KernelIsa::Avx2)
+        return false;
+#endif
+
+#if defined(BTUCALC_HAVE_AVX2) || defined(BTUCALC_HAVE_AVX512)
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    const bool osSavesAvx = (info[2] & (1 << 27)) && (info[2] & (1 << 28));
+    if (!osSavesAvx)
+        return false;
+    const unsigned long long xcr0 = _xgetbv(0);
+    __cpuidex(info, 7, 0);
+    if (isa == KernelIsa::Avx2)
+        return (xcr0 & 0x6) == 0x6 && (info[1] & (1 << 5));
+    return (xcr0 & 0xe6) == 0xe6 && (info[1] & (1 << 16));
+#else
+    __builtin_cpu_init();
+    if (isa == KernelIsa::Avx2)
+        return __builtin_cpu_supports("avx2");
+    return __builtin_cpu_supports("avx512f");
+#endif
+#else
+    return false;
+#endif
+}
+
+KernelIsa bestSupportedIsa(KernelIsa wanted)
+{
+    if (wanted == KernelIsa::Avx512 && !cpuSupports(KernelIsa::Avx512))
+        wanted = KernelIsa::Avx2;
+    if (wanted == KernelIsa::Avx2 && !cpuSupports(KernelIsa::Avx2))
+        wanted = KernelIsa::Scalar;
+    return wanted;
+}
+
+KernelIsa detectIsa()
+{
+    KernelIsa wanted = KernelIsa::Avx512;
+    if (const char *name = std::getenv("BTUCALC_KERNEL")) {
+        if (std::strcmp(name, "scalar") == 0)
+            wanted = KernelIsa::Scalar;
+        else if (std::strcmp(name, "avx2") == 0)
+            wanted = KernelIsa::Avx2;
+    }
+    return bestSupportedIsa(wanted);
+}
+
+} // namespace
+
+
+void RoomBatch::clear()
+{
+    for (auto &column : columns)
+        column.clear();
+}
+
+void RoomBatch::reserve(size_t count)
+{
+    for (auto &column : columns)
+        column.reserve(count);
+}
+
+void RoomBatch::append(const RoomInput &input)
+{
+    const SurfaceAreas areas = resolveSurfaceAreas(input);
+    const WindowGainFactors gains = windowGainFactors(input);
+    auto shade = [](bool shaded) { return shaded ? 1.0 : 1.4; };
+    auto btu = [](OutputUnit unit) { return unit == OutputUnit::BTU ? 1.0 : 0.0; };
+
+    columns[Length].push_back(input.length);
+    columns[Width].push_back(input.width);
+    columns[Height].push_back(input.height);
+    columns[NorthWindowArea].push_back(input.northWindowArea);
+    columns[EastWindowArea].push_back(input.eastWindowArea);
+    columns[SouthWindowArea].push_back(input.southWindowArea);
+    columns[WestWindowArea].push_back(input.westWindowArea);
+    columns[NorthShade].push_back(shade(input.northShaded));
+    columns[EastShade].push_back(shade(input.eastShaded));
+    columns[SouthShade].push_back(shade(input.southShaded));
+    columns[WestShade].push_back(shade(input.westShaded));
+    columns[NorthGain].push_back(gains.north);
+    columns[EastGain].push_back(gains.east);
+    columns[SouthGain].push_back(gains.south);
+    columns[WestGain].push_back(gains.west);
+    columns[Occupants].push_back(input.occupants);
+    columns[EquipmentWatt].push_back(input.equipmentWatt);
+    columns[LightingWatt].push_back(input.lightingWatt);
+    columns[LightingMult].push_back(input.lightingMult);
+    columns[CoolAdjust].push_back(input.coolAdjust);
+    columns[CoolCapacity].push_back(input.coolCapacity);
+    columns[CoolUnitsBTU].push_back(btu(input.coolUnits));
+    columns[WallArea].push_back(areas.wall);
+    columns[WindowArea].push_back(areas.window);
+    columns[CeilingArea].push_back(areas.ceiling);
+    columns[FloorArea].push_back(areas.floor);
+    columns[WallU].push_back(input.wallU);
+    columns[WindowU].push_back(input.windowU);
+    columns[CeilingU].push_back(input.ceilingU);
+    columns[FloorU].push_back(input.floorU);
+    columns[TargetTemp].push_back(input.targetTemp);
+    columns[ExternalTemp].push_back(input.externalTemp);
+    columns[VentilationAch].push_back(input.ventilationAch);
+    columns[LeakageAch].push_back(input.leakageAch);
+    columns[HeatAdjust].push_back(input.heatAdjust);
+    columns[HeatCapacity].push_back(input.heatCapacity);
+    columns[HeatUnitsBTU].push_back(btu(input.heatUnits));
+}
+
+
+void LoadBatch::resize(size_t count)
+{
+    for (auto &column : columns)
+        column.resize(count);
+    coolingUnits.resize(count);
+    heatingUnits.resize(count);
+}
+
+RoomLoads LoadBatch::at(size_t index) const
+{
+    RoomLoads loads;
+    loads.roomWatt = columns[RoomWatt][index];
+    loads.windowCoolWatt = columns[WindowCoolWatt][index];
+    loads.occupantWatt = columns[OccupantWatt][index];
+    loads.equipmentWatt = columns[EquipmentWatt][index];
+    loads.lightingWatt = columns[LightingWatt][index];
+    loads.totalCoolingWatt = columns[TotalCoolingWatt][index];
+    loads.peakCoolingWatt = columns[PeakCoolingWatt][index];
+    loads.coolingUnits = coolingUnits[index];
+    loads.wallWatt = columns[WallWatt][index];
+    loads.windowHeatWatt = columns[WindowHeatWatt][index];
+    loads.ceilingWatt = columns[CeilingWatt][index];
+    loads.floorWatt = columns[FloorWatt][index];
+    loads.transmissionWatt = columns[TransmissionWatt][index];
+    loads.ventWatt = columns[VentWatt][index];
+    loads.leakWatt = columns[LeakWatt][index];
+    loads.totalHeatingWatt = columns[TotalHeatingWatt][index];
+    loads.peakHeatingWatt = columns[PeakHeatingWatt][index];
+    loads.heatingUnits = heatingUnits[index];
+    return loads;
+}
+
+
+KernelIsa activeKernelIsa()
+{
+    int isa = selectedIsa.load(std::memory_order_relaxed);
+    if (isa == UnsetIsa) {
+        isa = static_cast<int>(detectIsa());
+        selectedIsa.store(isa, std::memory_order_relaxed);
+    }
+    return static_cast<KernelIsa>(isa);
+}
+
+void setKernelIsa(KernelIsa isa)
+{
+    selectedIsa.store(static_cast<int>(bestSupportedIsa(isa)), std::memory_order_relaxed);
+}
+
+const char *kernelIsaName(KernelIsa isa)
+{
+    switch (isa) {
+    case KernelIsa::Avx512: return "avx512";
+    case KernelIsa::Avx2: return "avx2";
+    case KernelIsa::Scalar: break;
+    }
+    return "scalar";
+}
+
+void calculateLoadsScalar(const KernelArgs &args, size_t begin, size_t end)
+{
+    calculateLoadRange<ScalarLanes>(args, begin, end);
+}
+
+void calculateLoadBatch(const RoomBatch &rooms, LoadBatch &loads)
+{
+    loads.resize(rooms.size());
+    calculateLoadBatch(rooms, loads, 0, rooms.size());
+}
+
+void calculateLoadBatch(const RoomBatch &rooms, LoadBatch &loads, size_t begin, size_t end)
+{
+    KernelArgs args;
+    for (int i = 0; i < RoomBatch::ColumnCount; ++i)
+        args.in[i] = rooms.columns[i].data();
+    for (int i = 0; i < LoadBatch::ColumnCount; ++i)
+        args.out[i] = loads.columns[i].data();
+    args.coolingUnits = loads.coolingUnits.data();
+    args.heatingUnits = loads.heatingUnits.data();
+
+    switch (activeKernelIsa()) {
+    case KernelIsa::Avx512:
+        calculateLoadsAvx512(args, begin, end);
+        break;
+    case KernelIsa::Avx2:
+        calculateLoadsAvx2(args, begin, end);
+        break;
+    case KernelIsa::Scalar:
+        calculateLoadsScalar(args, begin, end);
+        break;
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef LOADBATCH_H
+#define LOADBATCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "loadcalc.h"
+
+// Structure-of-arrays form of RoomInput / RoomLoads for calculating many rooms at once.
+// Results match calculateRoomLoads() bit for bit whichever instruction set is used.
+
+struct RoomBatch
+{
+    enum Column {
+        Length, Width, Height,
+        NorthWindowArea, EastWindowArea, SouthWindowArea, WestWindowArea,
+        NorthShade, EastShade, SouthShade, WestShade, // 1.0 shaded, 1.4 unshaded
+        NorthGain, EastGain, SouthGain, WestGain, // windowGainFactors()
+        Occupants, EquipmentWatt, LightingWatt, LightingMult,
+        CoolAdjust, CoolCapacity, CoolUnitsBTU, // 1.0 when capacity is in BTU
+        WallArea, WindowArea, CeilingArea, FloorArea, // resolved areas
+        WallU, WindowU, CeilingU, FloorU,
+        TargetTemp, ExternalTemp, VentilationAch, LeakageAch,
+        HeatAdjust, HeatCapacity, HeatUnitsBTU,
+        ColumnCount
+    };
+
+    std::vector<double> columns[ColumnCount];
+
+    size_t size() const { return columns[Length].size(); }
+    void clear();
+    void reserve(size_t count);
+    void append(const RoomInput &input);
+};
+
+struct LoadBatch
+{
+    enum Column {
+        RoomWatt, WindowCoolWatt, OccupantWatt, EquipmentWatt, LightingWatt,
+        TotalCoolingWatt, PeakCoolingWatt,
+        WallWatt, WindowHeatWatt, CeilingWatt, FloorWatt, TransmissionWatt,
+        VentWatt, LeakWatt, TotalHeatingWatt, PeakHeatingWatt,
+        ColumnCount
+    };
+
+    std::vector<double> columns[ColumnCount];
+    std::vector<int32_t> coolingUnits;
+    std::vector<int32_t> heatingUnits;
+
+    size_t size() const { return coolingUnits.size(); }
+    void resize(size_t count);
+    RoomLoads at(size_t index) const;
+};
+
+enum class KernelIsa { Scalar, Avx2, Avx512 };
+
+// Best instruction set supported by this CPU and build, unless overridden by
+// setKernelIsa() or the BTUCALC_KERNEL environment variable (scalar, avx2, avx512)
+KernelIsa activeKernelIsa();
+
+// Forces a kernel (clamped to what the CPU supports), e.g. for differential checks
+void setKernelIsa(KernelIsa isa);
+
+const char *kernelIsaName(KernelIsa isa);
+
+// Calculates every room, resizing loads to match
+void calculateLoadBatch(const RoomBatch &rooms, LoadBatch &loads);
+
+// Calculates rooms [begin, end) into an already sized loads batch
+void calculateLoadBatch(const RoomBatch &rooms, LoadBatch &loads, size_t begin, size_t end);
+
+#endif // LOADBATCH_H
@@ -0,0 +1,158 @@
+// Differential test of the batch kernels: every instruction set this CPU supports
+// has to give calculateRoomLoads() results bit for bit, on rooms chosen to reach
+// the kernels' edge cases and on counts that leave a partial vector at the end.
+//
+//   btucalc_kernel_test [rooms]
+//
+// Prints each mismatch and exits with status 1 if there was any.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "batchio.h"
+#include "loadbatch.h"
+#include "loadcalc.h"
+
+namespace {
+
+// Same rooms on every run, with every few rooms an unusual one
+std::vector<RoomInput> testRooms(size_t count)
+{
+    std::vector<RoomInput> rooms(count);
+    uint32_t state = 271828;
+    auto next = [&state](double low, double high) {
+        state = state * 1664525u + 1013904223u;
+        return low + (high - low) * (state >> 8) / double(1 << 24);
+    };
+    for (size_t i = 0; i < count; ++i) {
+        RoomInput &room = rooms[i];
+        room.length = next(1, 15);
+        room.width = next(1, 12);
+        room.height = next(2, 4);
+        room.northWindowArea = next(0, 4);
+        room.eastWindowArea = next(0, 4);
+        room.southWindowArea = next(0, 6);
+        room.westWindowArea = next(0, 4);
+        room.northShaded = next(0, 1) < 0.3;
+        room.eastShaded = next(0, 1) < 0.3;
+        room.southShaded = next(0, 1) < 0.5;
+        room.westShaded = next(0, 1) < 0.3;
+        room.occupants = std::floor(next(0, 10));
+        room.equipmentWatt = next(0, 1500);
+        room.lightingWatt = next(0, 400);
+        room.lightingMult = next(0, 1) < 0.5 ? 4.25 : 2.8;
+        room.coolAdjust = next(0, 25);
+        room.coolCapacity = next(500, 5000);
+        room.wallU = next(0.1, 2.5);
+        room.windowU = next(0.8, 5.8);
+        room.ceilingU = next(0.1, 3);
+        room.floorU = next(0.1, 1.2);
+        room.targetTemp = next(16, 24);
+        room.externalTemp = next(-20, 10);
+        room.ventilationAch = next(0, 6);
+        room.leakageAch = next(0, 1.5);
+        room.heatAdjust = next(0, 25);
+        room.heatCapacity = next(500, 3000);
+
+        switch (i % 8) {
+        case 1: // capacities in BTU per hour
+            room.coolUnits = OutputUnit::BTU;
+            room.heatUnits = OutputUnit::BTU;
+            room.coolCapacity *= 3.412;
+            room.heatCapacity *= 3.412;
+            break;
+        case 2: // solar gains for a latitude, south of the equator every other time
+            room.latitude = (i % 16 == 2 ? 1 : -1) * next(0, 70);
+            room.windowG = next(0.2, 0.9);
+            break;
+        case 3: // capacities the parsers refuse but the engine still has to agree on
+            room.coolCapacity = i % 16 == 3 ? 0 : -next(1, 1000);
+            room.heatCapacity = i % 16 == 3 ? -next(1, 1000) : 0;
+            break;
+        case 4: // areas given rather than derived
+            room.wallArea = next(0, 60);
+            room.windowArea = next(0, 10);
+            room.ceilingArea = next(0, 40);
+            room.floorArea = next(0, 40);
+            break;
+        case 5: // no load at all
+            room.northWindowArea = room.eastWindowArea = room.southWindowArea = room.westWindowArea = 0;
+            room.occupants = room.equipmentWatt = room.lightingWatt = 0;
+            room.externalTemp = room.targetTemp;
+            break;
+        case 6: // warmer outside than in
+            room.externalTemp = room.targetTemp + next(0.5, 15);
+            break;
+        }
+    }
+    return rooms;
+}
+
+bool sameBits(double a, double b)
+{
+    return std::memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+// Compares every field of loads with the scalar engine's; returns the mismatches
+int compare(const std::vector<RoomInput> &rooms, const LoadBatch &loads, KernelIsa isa)
+{
+    int mismatches = 0;
+    for (size_t i = 0; i < rooms.size(); ++i) {
+        const RoomLoads expected = calculateRoomLoads(rooms[i]);
+        const RoomLoads actual = loads.at(i);
+        for (int field = 0; resultFieldName(field); ++field) {
+            const double want = resultFieldValue(expected, field);
+            const double got = resultFieldValue(actual, field);
+            if (sameBits(want, got))
+                continue;
+            if (++mismatches <= 20)
+                std::printf("%s: room %zu %s is %.17g, not %.17g\n", kernelIsaName(isa), i, resultFieldName(field),
+                            got, want);
+        }
+    }
+    return mismatches;
+}
+
+} // namespace
+
+
+int main(int argc, char *argv[])
+{
+    const size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 4099;
+    const std::vector<RoomInput> rooms = testRooms(count);
+    RoomBatch batch;
+    batch.reserve(rooms.size());
+    for (const RoomInput &room : rooms)
+        batch.append(room);
+
+    int mismatches = 0;
+    for (KernelIsa isa : {KernelIsa::Scalar, KernelIsa::Avx2, KernelIsa::Avx512}) {
+        setKernelIsa(isa);
+        if (activeKernelIsa() != isa) {
+            std::printf("%s: not supported here, skipped\n", kernelIsaName(isa));
+            continue;
+        }
+
+        LoadBatch loads;
+        calculateLoadBatch(batch, loads);
+        int found = compare(rooms, loads, isa);
+
+        // Ranges that start and end part way through a vector, as the parallel batch hands out
+        LoadBatch ranges;
+        ranges.resize(rooms.size());
+        for (size_t begin = 0, step = 1; begin < rooms.size(); begin += step, step = step % 13 + 1) {
+            const size_t end = std::min(rooms.size(), begin + step);
+            calculateLoadBatch(batch, ranges, begin, end);
+        }
+        found += compare(rooms, ranges, isa);
+
+        std::printf("%s: %zu rooms, %d mismatches\n", kernelIsaName(isa), rooms.size(), found);
+        mismatches += found;
+    }
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,134 @@
+#include "loadcalc.h"
+
+#include <cmath>
+
+#include "solargain.h"
+
+namespace {
+
+constexpr bool near(double value, double expected, double tolerance)
+{
+    return value - expected <= tolerance && expected - value <= tolerance;
+}
+
+// Reference cases for the unit layer, checked by the compiler
+static_assert(toBtuPerHour(Watts(1)).value() == WattBTU, "1 W is 3.412 BTU/h");
+static_assert(near(toWatts(toBtuPerHour(Watts(2500))).value(), 2500, 1e-9), "power round trip");
+static_assert(near(toSquareFeet(SquareMetres(1)), 10.7639, 1e-4), "1 m2 is 10.7639 ft2");
+static_assert(near(toSquareFeet(SquareMetres(20)) * 31.25, 6727.44, 1e-2), "20 m2 room cooling");
+static_assert(near(airExchangeCoefficient(AirChangesPerHour(1), CubicMetres(3600)), AirDensity * AirSpecificHeat, 1e-12),
+              "one air change of 3600 m3 per hour is 1 m3/s");
+static_assert(near(airExchangeLoss(AirChangesPerHour(4), CubicMetres(48), Kelvin(14)).value(), 920.155, 1e-3),
+              "4 ACH through a 4 x 5 x 2.4 m room at 14 K");
+static_assert(capacityRatio<OutputUnit::Watts>(Watts(3000), 1500) == 2, "2 units of 1500 W");
+static_assert(near(capacityRatio<OutputUnit::BTU>(Watts(2000), 2500), 2.7296, 1e-9), "2 kW against 2500 BTU/h units");
+static_assert(near(capacityRatio<OutputUnit::Watts>(BtuPerHour(6824), 1000), 2, 1e-9), "6824 BTU/h against 1 kW units");
+
+} // namespace
+
+
+SurfaceAreas estimateSurfaceAreas(const RoomInput &input)
+{
+    SurfaceAreas areas;
+    areas.ceiling = input.length * input.width;
+    areas.floor = areas.ceiling;
+    areas.window = input.northWindowArea + input.eastWindowArea + input.southWindowArea + input.westWindowArea;
+    areas.wall = (2 * input.length * input.height) + (2 * input.width * input.height) - areas.window;
+    return areas;
+}
+
+SurfaceAreas resolveSurfaceAreas(const RoomInput &input)
+{
+    SurfaceAreas areas = estimateSurfaceAreas(input);
+    areas.wall = input.wallArea.value_or(areas.wall);
+    areas.window = input.windowArea.value_or(areas.window);
+    areas.ceiling = input.ceilingArea.value_or(areas.ceiling);
+    areas.floor = input.floorArea.value_or(areas.floor);
+    return areas;
+}
+
+void calculateCoolingLoads(const RoomInput &input, RoomLoads &loads)
+{
+    double northShade = input.northShaded ? 1.0 : 1.4;
+    double eastShade = input.eastShaded ? 1.0 : 1.4;
+    double southShade = input.southShaded ? 1.0 : 1.4;
+    double westShade = input.westShaded ? 1.0 : 1.4;
+
+
+    // Calculate Cooling BTU
+    const SquareMetres roomArea(input.length * input.width);
+    const BtuPerHour roomBTU(toSquareFeet(roomArea) * 31.25);
+    loads.roomWatt = toWatts(roomBTU).value();
+
+    const WindowGainFactors gains = windowGainFactors(input);
+    const BtuPerHour northWindowBTU(input.northWindowArea * gains.north * northShade);
+    const BtuPerHour eastWindowBTU(input.eastWindowArea * gains.east * eastShade);
+    const BtuPerHour southWindowBTU(input.southWindowArea * gains.south * southShade);
+    const BtuPerHour westWindowBTU(input.westWindowArea * gains.west * westShade);
+    const BtuPerHour windowCoolBTU = northWindowBTU + eastWindowBTU + southWindowBTU + westWindowBTU;
+    loads.windowCoolWatt = (toWatts(northWindowBTU) + toWatts(eastWindowBTU)
+                            + toWatts(southWindowBTU) + toWatts(westWindowBTU)).value();
+
+    const BtuPerHour occupantBTU(input.occupants * 600);
+    loads.occupantWatt = toWatts(occupantBTU).value();
+
+    const BtuPerHour equipmentBTU = toBtuPerHour(Watts(input.equipmentWatt));
+    loads.equipmentWatt = input.equipmentWatt;
+
+    const BtuPerHour lightingBTU(input.lightingWatt * input.lightingMult);
+    loads.lightingWatt = toWatts(lightingBTU).value();
+
+    const BtuPerHour totalCoolingBTU = roomBTU + windowCoolBTU + occupantBTU + equipmentBTU + lightingBTU;
+    loads.totalCoolingWatt = toWatts(totalCoolingBTU).value();
+    const BtuPerHour peakCoolingBTU = totalCoolingBTU * (1 + input.coolAdjust / 100);
+    loads.peakCoolingWatt = toWatts(peakCoolingBTU).value();
+
+    loads.coolingUnits = unitsRequired(peakCoolingBTU, input.coolCapacity, input.coolUnits);
+}
+
+void calculateHeatingLoads(const RoomInput &input, RoomLoads &loads)
+{
+    const SurfaceAreas areas = resolveSurfaceAreas(input);
+
+    // Calculate Heating BTU
+    const CubicMetres roomVolume(input.length * input.width * input.height);
+
+    const Kelvin diffTemp(std::fabs(input.targetTemp - input.externalTemp));
+
+    loads.wallWatt = areas.wall * diffTemp.value() * input.wallU;
+    loads.windowHeatWatt = areas.window * diffTemp.value() * input.windowU;
+    loads.ceilingWatt = areas.ceiling * diffTemp.value() * input.ceilingU;
+    loads.floorWatt = areas.floor * diffTemp.value() * input.floorU;
+    loads.transmissionWatt = loads.wallWatt + loads.windowHeatWatt + loads.ceilingWatt + loads.floorWatt;
+
+    loads.ventWatt = airExchangeLoss(AirChangesPerHour(input.ventilationAch), roomVolume, diffTemp).value();
+    loads.leakWatt = airExchangeLoss(AirChangesPerHour(input.leakageAch), roomVolume, diffTemp).value();
+
+    loads.totalHeatingWatt = loads.transmissionWatt + loads.ventWatt + loads.leakWatt;
+    loads.peakHeatingWatt = loads.totalHeatingWatt * (1 + input.heatAdjust / 100);
+
+    loads.heatingUnits = unitsRequired(Watts(loads.peakHeatingWatt), input.heatCapacity, input.heatUnits);
+}
+
+RoomLoads calculateRoomLoads(const RoomInput &input)
+{
+    RoomLoads loads;
+    calculateCoolingLoads(input, loads);
+    calculateHeatingLoads(input, loads);
+    return loads;
+}
+
+HeatLossCoefficients heatLossCoefficients(const RoomInput &input)
+{
+    const SurfaceAreas areas = resolveSurfaceAreas(input);
+    const CubicMetres roomVolume(input.length * input.width * input.height);
+
+    HeatLossCoefficients coefficients;
+    coefficients.wall = areas.wall * input.wallU;
+    coefficients.window = areas.window * input.windowU;
+    coefficients.ceiling = areas.ceiling * input.ceilingU;
+    coefficients.floor = areas.floor * input.floorU;
+    coefficients.vent = airExchangeCoefficient(AirChangesPerHour(input.ventilationAch), roomVolume);
+    coefficients.leak = airExchangeCoefficient(AirChangesPerHour(input.leakageAch), roomVolume);
+    return coefficients;
+}
@@ -0,0 +1,141 @@
+#ifndef LOADCALC_H
+#define LOADCALC_H
+
+#include <cmath>
+#include <optional>
+
+#include "units.h"
+
+// Qt-free heating/cooling load engine shared by the GUI and batch tooling
+
+// Defaults match the GUI placeholders and the first entry of each dropdown
+struct RoomInput
+{
+    double length = 0;
+    double width = 0;
+    double height = 0;
+
+    double northWindowArea = 0;
+    double eastWindowArea = 0;
+    double southWindowArea = 0;
+    double westWindowArea = 0;
+
+    bool northShaded = false;
+    bool eastShaded = false;
+    bool southShaded = false;
+    bool westShaded = false;
+
+    double occupants = 0;
+    double equipmentWatt = 0;
+    double lightingWatt = 0;
+    double lightingMult = 4.25; // Incandescent
+    double coolAdjust = 10;
+    double coolCapacity = 2500;
+    OutputUnit coolUnits = OutputUnit::Watts;
+
+    // Site latitude (degrees north) for solar window gains; unset uses the
+    // rule-of-thumb factors per orientation
+    std::optional<double> latitude;
+    double windowG = 0.85; // glazing solar energy transmittance, Single Glazed
+
+    // Surface areas are derived from the room dimensions unless given
+    std::optional<double> wallArea;
+    std::optional<double> windowArea;
+    std::optional<double> ceilingArea;
+    std::optional<double> floorArea;
+
+    double wallU = 2; // Solid Brick Wall
+    double windowU = 5.8; // Single Glazed
+    double ceilingU = 3; // Uninsulated Loft
+    double floorU = 1; // Uninsulated Solid Floor
+
+    double targetTemp = 19;
+    double externalTemp = 5;
+    double ventilationAch = 4;
+    double leakageAch = 0.5;
+    double heatAdjust = 10;
+    double heatCapacity = 1500;
+    OutputUnit heatUnits = OutputUnit::Watts;
+};
+
+struct SurfaceAreas
+{
+    double wall = 0;
+    double window = 0;
+    double ceiling = 0;
+    double floor = 0;
+};
+
+struct RoomLoads
+{
+    // Cooling
+    double roomWatt = 0;
+    double windowCoolWatt = 0;
+    double occupantWatt = 0;
+    double equipmentWatt = 0;
+    double lightingWatt = 0;
+    double totalCoolingWatt = 0;
+    double peakCoolingWatt = 0;
+    int coolingUnits = 0;
+
+    // Heating
+    double wallWatt = 0;
+    double windowHeatWatt = 0;
+    double ceilingWatt = 0;
+    double floorWatt = 0;
+    double transmissionWatt = 0;
+    double ventWatt = 0;
+    double leakWatt = 0;
+    double totalHeatingWatt = 0;
+    double peakHeatingWatt = 0;
+    int heatingUnits = 0;
+};
+
+// Heat flow per kelvin of indoor/outdoor difference (W/K), i.e. the heating terms
+// without the temperature difference
+struct HeatLossCoefficients
+{
+    double wall = 0;
+    double window = 0;
+    double ceiling = 0;
+    double floor = 0;
+    double vent = 0;
+    double leak = 0;
+
+    double total() const { return wall + window + ceiling + floor + vent + leak; }
+};
+
+// Areas estimated from the room dimensions (shown as placeholders in the GUI)
+SurfaceAreas estimateSurfaceAreas(const RoomInput &input);
+
+// Estimated areas with any explicitly given areas applied on top
+SurfaceAreas resolveSurfaceAreas(const RoomInput &input);
+
+// Peak load as a multiple of one unit's capacity, with capacity given in Unit. The peak
+// can be in either power type; it is converted to Unit at compile time.
+template <OutputUnit Unit, class Power>
+constexpr double capacityRatio(Power peak, double capacity)
+{
+    return convertPower<typename OutputQuantity<Unit>::Type>(peak).value() / capacity;
+}
+
+// Number of units needed to cover a peak load, for a unit chosen at run time;
+// none for a unit without a capacity, which would leave nothing to divide by
+template <class Power>
+inline int unitsRequired(Power peak, double capacity, OutputUnit unit)
+{
+    if (!(capacity > 0))
+        return 0;
+    return std::ceil(unit == OutputUnit::BTU ? capacityRatio<OutputUnit::BTU>(peak, capacity)
+                                             : capacityRatio<OutputUnit::Watts>(peak, capacity));
+}
+
+// The cooling and heating halves are independent, so either can be refreshed alone
+void calculateCoolingLoads(const RoomInput &input, RoomLoads &loads);
+void calculateHeatingLoads(const RoomInput &input, RoomLoads &loads);
+
+RoomLoads calculateRoomLoads(const RoomInput &input);
+
+HeatLossCoefficients heatLossCoefficients(const RoomInput &input);
+
+#endif // LOADCALC_H
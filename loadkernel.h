@@ -0,0 +1,140 @@
+#ifndef LOADKERNEL_H
+#define LOADKERNEL_H
+
+// Internal to the batch calculation: the per-room formulas written once over a
+// vector type V, so every instruction set performs the same operations in the
+// same order as calculateRoomLoads(). The templates live in an anonymous namespace
+// because each kernel translation unit is built with different instruction set
+// flags (and without floating point contraction).
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include "loadbatch.h"
+
+struct KernelArgs
+{
+    const double *in[RoomBatch::ColumnCount];
+    double *out[LoadBatch::ColumnCount];
+    int32_t *coolingUnits;
+    int32_t *heatingUnits;
+};
+
+void calculateLoadsScalar(const KernelArgs &args, size_t begin, size_t end);
+void calculateLoadsAvx2(const KernelArgs &args, size_t begin, size_t end);
+void calculateLoadsAvx512(const KernelArgs &args, size_t begin, size_t end);
+
+namespace {
+
+// One room at a time, used for the scalar kernel and the tail of the vector kernels
+struct ScalarLanes
+{
+    static const size_t Width = 1;
+    double v;
+
+    static ScalarLanes load(const double *p) { return {*p}; }
+    static ScalarLanes set(double x) { return {x}; }
+    void store(double *p) const { *p = v; }
+    friend ScalarLanes operator+(ScalarLanes a, ScalarLanes b) { return {a.v + b.v}; }
+    friend ScalarLanes operator-(ScalarLanes a, ScalarLanes b) { return {a.v - b.v}; }
+    friend ScalarLanes operator*(ScalarLanes a, ScalarLanes b) { return {a.v * b.v}; }
+    friend ScalarLanes operator/(ScalarLanes a, ScalarLanes b) { return {a.v / b.v}; }
+    static ScalarLanes abs(ScalarLanes a) { return {std::fabs(a.v)}; }
+    static ScalarLanes select(ScalarLanes flag, ScalarLanes a, ScalarLanes b) { return {flag.v != 0 ? a.v : b.v}; }
+    static ScalarLanes positive(ScalarLanes a) { return {a.v > 0 ? 1.0 : 0.0}; }
+    static void storeCeil(int32_t *p, ScalarLanes a) { *p = static_cast<int32_t>(std::ceil(a.v)); }
+};
+
+template <class V>
+inline void calculateLoadLanes(const KernelArgs &args, size_t i)
+{
+    typedef RoomBatch R;
+    typedef LoadBatch L;
+    auto in = [&](R::Column column) { return V::load(args.in[column] + i); };
+    auto out = [&](L::Column column, V value) { value.store(args.out[column] + i); };
+
+    const V wattBTU = V::set(WattBTU);
+    const V length = in(R::Length);
+    const V width = in(R::Width);
+
+    // Cooling
+    V roomArea = length * width * V::set(FeetPerMetre) * V::set(FeetPerMetre);
+    V roomBTU = roomArea * V::set(31.25);
+    out(L::RoomWatt, roomBTU / wattBTU);
+
+    V northWindowBTU = in(R::NorthWindowArea) * in(R::NorthGain) * in(R::NorthShade);
+    V eastWindowBTU = in(R::EastWindowArea) * in(R::EastGain) * in(R::EastShade);
+    V southWindowBTU = in(R::SouthWindowArea) * in(R::SouthGain) * in(R::SouthShade);
+    V westWindowBTU = in(R::WestWindowArea) * in(R::WestGain) * in(R::WestShade);
+    V windowCoolBTU = northWindowBTU + eastWindowBTU + southWindowBTU + westWindowBTU;
+    out(L::WindowCoolWatt, northWindowBTU / wattBTU + eastWindowBTU / wattBTU
+                           + southWindowBTU / wattBTU + westWindowBTU / wattBTU);
+
+    V occupantBTU = in(R::Occupants) * V::set(600);
+    out(L::OccupantWatt, occupantBTU / wattBTU);
+
+    V equipmentWatt = in(R::EquipmentWatt);
+    V equipmentBTU = equipmentWatt * wattBTU;
+    out(L::EquipmentWatt, equipmentWatt);
+
+    V lightingBTU = in(R::LightingWatt) * in(R::LightingMult);
+    out(L::LightingWatt, lightingBTU / wattBTU);
+
+    V totalCoolingBTU = roomBTU + windowCoolBTU + occupantBTU + equipmentBTU + lightingBTU;
+    out(L::TotalCoolingWatt, totalCoolingBTU / wattBTU);
+    V peakCoolingBTU = totalCoolingBTU * (V::set(1) + in(R::CoolAdjust) / V::set(100));
+    V peakCoolingWatt = peakCoolingBTU / wattBTU;
+    out(L::PeakCoolingWatt, peakCoolingWatt);
+    // No units for a unit without a capacity, as in unitsRequired()
+    const V coolCapacity = in(R::CoolCapacity);
+    V::storeCeil(args.coolingUnits + i,
+                 V::select(V::positive(coolCapacity),
+                           V::select(in(R::CoolUnitsBTU), peakCoolingBTU, peakCoolingWatt) / coolCapacity, V::set(0)));
+
+    // Heating
+    V roomVolume = length * width * in(R::Height);
+    V diffTemp = V::abs(in(R::TargetTemp) - in(R::ExternalTemp));
+
+    V wallWatt = in(R::WallArea) * diffTemp * in(R::WallU);
+    V windowHeatWatt = in(R::WindowArea) * diffTemp * in(R::WindowU);
+    V ceilingWatt = in(R::CeilingArea) * diffTemp * in(R::CeilingU);
+    V floorWatt = in(R::FloorArea) * diffTemp * in(R::FloorU);
+    V transmissionWatt = wallWatt + windowHeatWatt + ceilingWatt + floorWatt;
+    out(L::WallWatt, wallWatt);
+    out(L::WindowHeatWatt, windowHeatWatt);
+    out(L::CeilingWatt, ceilingWatt);
+    out(L::FloorWatt, floorWatt);
+    out(L::TransmissionWatt, transmissionWatt);
+
+    const V airHeat = V::set(AirDensity * AirSpecificHeat);
+    const V secondsPerHour = V::set(SecondsPerHour);
+    V ventWatt = airHeat * (in(R::VentilationAch) / secondsPerHour) * roomVolume * diffTemp;
+    V leakWatt = airHeat * (in(R::LeakageAch) / secondsPerHour) * roomVolume * diffTemp;
+    out(L::VentWatt, ventWatt);
+    out(L::LeakWatt, leakWatt);
+
+    V totalHeatingWatt = transmissionWatt + ventWatt + leakWatt;
+    out(L::TotalHeatingWatt, totalHeatingWatt);
+    V peakHeatingWatt = totalHeatingWatt * (V::set(1) + in(R::HeatAdjust) / V::set(100));
+    out(L::PeakHeatingWatt, peakHeatingWatt);
+    V peakHeatingBTU = peakHeatingWatt * wattBTU;
+    const V heatCapacity = in(R::HeatCapacity);
+    V::storeCeil(args.heatingUnits + i,
+                 V::select(V::positive(heatCapacity),
+                           V::select(in(R::HeatUnitsBTU), peakHeatingBTU, peakHeatingWatt) / heatCapacity, V::set(0)));
+}
+
+template <class V>
+inline void calculateLoadRange(const KernelArgs &args, size_t begin, size_t end)
+{
+    size_t i = begin;
+    for (; i + V::Width <= end; i += V::Width)
+        calculateLoadLanes<V>(args, i);
+    for (; i < end; ++i)
+        calculateLoadLanes<ScalarLanes>(args, i);
+}
+
+} // namespace
+
+#endif // LOADKERNEL_H
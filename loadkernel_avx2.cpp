@@ -0,0 +1,57 @@
+// AVX2 batch kernel, built with AVX2 enabled and floating point contraction off
+#include "loadkernel.h"
+
+#ifdef BTUCALC_HAVE_AVX2
+
+#include <immintrin.h>
+
+namespace {
+
+struct Avx2Lanes
+{
+    static const size_t Width = 4;
+    __m256d v;
+
+    static Avx2Lanes load(const double *p) { return {_mm256_loadu_pd(p)}; }
+    static Avx2Lanes set(double x) { return {_mm256_set1_pd(x)}; }
+    void store(double *p) const { _mm256_storeu_pd(p, v); }
+    friend Avx2Lanes operator+(Avx2Lanes a, Avx2Lanes b) { return {_mm256_add_pd(a.v, b.v)}; }
+    friend Avx2Lanes operator-(Avx2Lanes a, Avx2Lanes b) { return {_mm256_sub_pd(a.v, b.v)}; }
+    friend Avx2Lanes operator*(Avx2Lanes a, Avx2Lanes b) { return {_mm256_mul_pd(a.v, b.v)}; }
+    friend Avx2Lanes operator/(Avx2Lanes a, Avx2Lanes b) { return {_mm256_div_pd(a.v, b.v)}; }
+    static Avx2Lanes abs(Avx2Lanes a) { return {_mm256_andnot_pd(_mm256_set1_pd(-0.0), a.v)}; }
+
+    static Avx2Lanes select(Avx2Lanes flag, Avx2Lanes a, Avx2Lanes b)
+    {
+        __m256d mask = _mm256_cmp_pd(flag.v, _mm256_setzero_pd(), _CMP_NEQ_UQ);
+        return {_mm256_blendv_pd(b.v, a.v, mask)};
+    }
+
+    static Avx2Lanes positive(Avx2Lanes a)
+    {
+        __m256d mask = _mm256_cmp_pd(a.v, _mm256_setzero_pd(), _CMP_GT_OQ);
+        return {_mm256_and_pd(mask, _mm256_set1_pd(1.0))};
+    }
+
+    static void storeCeil(int32_t *p, Avx2Lanes a)
+    {
+        __m128i units = _mm256_cvttpd_epi32(_mm256_ceil_pd(a.v));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(p), units);
+    }
+};
+
+} // namespace
+
+void calculateLoadsAvx2(const KernelArgs &args, size_t begin, size_t end)
+{
+    calculateLoadRange<Avx2Lanes>(args, begin, end);
+}
+
+#else
+
+void calculateLoadsAvx2(const KernelArgs &args, size_t begin, size_t end)
+{
+    calculateLoadRange<ScalarLanes>(args, begin, end);
+}
+
+#endif
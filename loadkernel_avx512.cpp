@@ -0,0 +1,57 @@
+// AVX-512 batch kernel, built with AVX-512F enabled and floating point contraction off
+#include "loadkernel.h"
+
+#ifdef BTUCALC_HAVE_AVX512
+
+#include <immintrin.h>
+
+namespace {
+
+struct Avx512Lanes
+{
+    static const size_t Width = 8;
+    __m512d v;
+
+    static Avx512Lanes load(const double *p) { return {_mm512_loadu_pd(p)}; }
+    static Avx512Lanes set(double x) { return {_mm512_set1_pd(x)}; }
+    void store(double *p) const { _mm512_storeu_pd(p, v); }
+    friend Avx512Lanes operator+(Avx512Lanes a, Avx512Lanes b) { return {_mm512_add_pd(a.v, b.v)}; }
+    friend Avx512Lanes operator-(Avx512Lanes a, Avx512Lanes b) { return {_mm512_sub_pd(a.v, b.v)}; }
+    friend Avx512Lanes operator*(Avx512Lanes a, Avx512Lanes b) { return {_mm512_mul_pd(a.v, b.v)}; }
+    friend Avx512Lanes operator/(Avx512Lanes a, Avx512Lanes b) { return {_mm512_div_pd(a.v, b.v)}; }
+    static Avx512Lanes abs(Avx512Lanes a) { return {_mm512_abs_pd(a.v)}; }
+
+    static Avx512Lanes select(Avx512Lanes flag, Avx512Lanes a, Avx512Lanes b)
+    {
+        __mmask8 mask = _mm512_cmp_pd_mask(flag.v, _mm512_setzero_pd(), _CMP_NEQ_UQ);
+        return {_mm512_mask_blend_pd(mask, b.v, a.v)};
+    }
+
+    static Avx512Lanes positive(Avx512Lanes a)
+    {
+        __mmask8 mask = _mm512_cmp_pd_mask(a.v, _mm512_setzero_pd(), _CMP_GT_OQ);
+        return {_mm512_maskz_mov_pd(mask, _mm512_set1_pd(1.0))};
+    }
+
+    static void storeCeil(int32_t *p, Avx512Lanes a)
+    {
+        __m512d rounded = _mm512_roundscale_pd(a.v, _MM_FROUND_TO_POS_INF | _MM_FROUND_NO_EXC);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), _mm512_cvttpd_epi32(rounded));
+    }
+};
+
+} // namespace
+
+void calculateLoadsAvx512(const KernelArgs &args, size_t begin, size_t end)
+{
+    calculateLoadRange<Avx512Lanes>(args, begin, end);
+}
+
+#else
+
+void calculateLoadsAvx512(const KernelArgs &args, size_t begin, size_t end)
+{
+    calculateLoadRange<ScalarLanes>(args, begin, end);
+}
+
+#endif
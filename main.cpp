@@ -1,11 +1,79 @@
 #include "mainwindow.h"
+#include "headless.h"
+#include "instrumentation.h"
 
 #include <QApplication>
 
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+bool hasOption(int argc, char *argv[], const char *option)
+{
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], option) == 0)
+            return true;
+    }
+    return false;
+}
+
+// Each startup step in the order they run (setupUi is part of window), ending with the time to interactive
+void printStartupTrace()
+{
+    const char *const steps[] = {"startup.application", "startup.window", "startup.setupUi", "startup.show",
+                                 "startup.firstPaint", "startup.catalog", "startup.total"};
+    const std::vector<ProbeSummary> probes = Instrumentation::summary();
+    for (const char *step : steps) {
+        for (const ProbeSummary &probe : probes) {
+            if (probe.name == step && probe.count)
+                std::fprintf(stderr, "%-20s %8.1f ms\n", step, probe.totalNs / 1e6);
+        }
+    }
+}
+
+void record(int probe, uint64_t start)
+{
+    if (Instrumentation::enabled())
+        Instrumentation::record(probe, start, Instrumentation::now() - start);
+}
+
+} // namespace
+
+
 int main(int argc, char *argv[])
 {
+    const uint64_t started = Instrumentation::now();
+
+    // Batch and other headless modes must not create a QApplication (no display needed)
+    if (isHeadlessCommand(argc, argv))
+        return runHeadless(argc, argv);
+
+    const bool trace = hasOption(argc, argv, "--startup-trace");
+    if (trace) {
+        attachParentConsole();
+        Instrumentation::setEnabled(true);
+    }
+
+    static const int applicationProbe = Instrumentation::probe("startup.application");
+    static const int showProbe = Instrumentation::probe("startup.show");
+    static const int startupProbe = Instrumentation::probe("startup.total");
+
+    uint64_t step = Instrumentation::now();
     QApplication a(argc, argv);
+    record(applicationProbe, step);
+
     MainWindow w;
+    step = Instrumentation::now();
     w.show();
+    record(showProbe, step);
+
+    // Startup is over once the form has been painted and its catalog loaded
+    QObject::connect(&w, &MainWindow::interactive, [started, trace]() {
+        record(startupProbe, started);
+        if (trace)
+            printStartupTrace();
+    });
     return a.exec();
 }
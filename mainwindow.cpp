@@ -1,20 +1,73 @@
 #include "mainwindow.h"
 #include "./ui_mainwindow.h"
+#include "reportassets.h"
+#include "sweepdialog.h"
+#include "batchio.h"
+#include "catalogmodel.h"
+#include "diagnosticsdialog.h"
+#include "scenariodialog.h"
+#include "instrumentation.h"
 #include <QFile>
 #include <QTextStream>
 #include <QDoubleValidator>
 #include <QFileDialog>
 #include <QStandardPaths>
-#include <QPrinter>
-#include <QPainter>
-#include <QImage>
-#include <QPdfWriter>
+#include <QTimer>
+#include <QThread>
+#include <QProgressDialog>
+#include <QInputDialog>
+#include <QDir>
+#include <QShortcut>
+#include <QLocale>
+#include <QEvent>
+
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+
+ProjectRoom toProjectRoom(const RoomReport &report)
+{
+    ProjectRoom room;
+    room.name = report.name.toStdString();
+    room.input = report.input;
+    room.loads = report.loads;
+    room.lightType = report.lightType.toStdString();
+    room.wallMaterial = report.wallMaterial.toStdString();
+    room.windowMaterial = report.windowMaterial.toStdString();
+    room.ceilingMaterial = report.ceilingMaterial.toStdString();
+    room.floorMaterial = report.floorMaterial.toStdString();
+    return room;
+}
+
+RoomReport toRoomReport(const ProjectRoom &room)
+{
+    RoomReport report;
+    report.name = QString::fromStdString(room.name);
+    report.input = room.input;
+    report.loads = room.loads;
+    report.lightType = QString::fromStdString(room.lightType);
+    report.wallMaterial = QString::fromStdString(room.wallMaterial);
+    report.windowMaterial = QString::fromStdString(room.windowMaterial);
+    report.ceilingMaterial = QString::fromStdString(room.ceilingMaterial);
+    report.floorMaterial = QString::fromStdString(room.floorMaterial);
+    return report;
+}
+
+} // namespace
+
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
 {
-    ui->setupUi(this);
+    static const int constructProbe = Instrumentation::probe("startup.window");
+    static const int setupProbe = Instrumentation::probe("startup.setupUi");
+    ScopedTimer timer(constructProbe);
+    {
+        ScopedTimer setupTimer(setupProbe);
+        ui->setupUi(this);
+    }
 
 
     // Setup float (numeric) only QLineEdit and default 0 values
@@ -26,6 +79,7 @@ MainWindow::MainWindow(QWidget *parent)
         ui->LENWindowHC, ui->LEEWindowHC, ui->LESWindowHC, ui->LEWWindowHC,
         ui->LEOccupantsHC, ui->LEEquipmentHC, ui->LELightHC,
         ui->LECoolAdjustHC, ui->LECoolCapacityHC,
+        ui->LELatitudeHC, ui->LEWindowGHC,
         ui->LEWallAreaHC, ui->LEWindowAreaHC, ui->LECeilingAreaHC, ui->LEFloorAreaHC,
         ui->LETargetTempHC, ui->LEExternalTempHC,
         ui->LEVentilationHC, ui->LELeakageHC,
@@ -49,69 +103,143 @@ MainWindow::MainWindow(QWidget *parent)
     ui->LEHeatAdjustHC->setPlaceholderText(QString::number(10, 'f', 2));
     ui->LECoolCapacityHC->setPlaceholderText(QString::number(2500, 'f', 2));
     ui->LEHeatCapacityHC->setPlaceholderText(QString::number(1500, 'f', 2));
+    ui->LEWindowGHC->setPlaceholderText(QString::number(0.85, 'f', 2));
+    ui->LELatitudeHC->setPlaceholderText(tr("Rule of thumb"));
 
 
     // Setup Dropdown Boxes
-    ui->LightTypeHC->addItem("Incandescent", 4.25);
-    ui->LightTypeHC->addItem("Florescent", 2.8);
-    ui->LightTypeHC->addItem("LED", 2);
-
-    ui->WallMaterialHC->addItem("Solid Brick Wall", 2);
-    ui->WallMaterialHC->addItem("Cavity Wall (No Insulation)", 1.5);
-    ui->WallMaterialHC->addItem("Cavity Wall (Insulated)", 0.55);
-    ui->WallMaterialHC->addItem("Modern Insulated Wall", 0.3);
-    ui->WallMaterialHC->addItem("Timber Frame Wall (with Insulation)", 0.3);
-
-    ui->WindowMaterialHC->addItem("Single Glazed", 5.8);
-    ui->WindowMaterialHC->addItem("Double Glazed (old, air filled)", 3);
-    ui->WindowMaterialHC->addItem("Double Glazed (modern, low-e)", 1.6);
-    ui->WindowMaterialHC->addItem("Triple Glazed", 1);
-
-    ui->CeilingMaterialHC->addItem("Uninsulated Loft", 3);
-    ui->CeilingMaterialHC->addItem("Insulated Ceiling", 0.4);
-    ui->CeilingMaterialHC->addItem("Modern Insulated Roof", 0.2);
-    ui->CeilingMaterialHC->addItem("Warm Flata Roof (Insulated)", 0.25);
-
-    ui->FloorMaterialHC->addItem("Uninsulated Solid Floor", 1);
-    ui->FloorMaterialHC->addItem("Suspended Timber Floor", 1);
-    ui->FloorMaterialHC->addItem("Insulated Ground-Bearing Slab", 0.25);
-    ui->FloorMaterialHC->addItem("Retrofit Insulated Timber Floor", 0.3);
-
-    ui->CoolUnitsHC->addItems({"Watts", "BTU"});
-    ui->HeatUnitsHC->addItems({"Watts", "BTU"});
+    // Materials and lamps come from the catalog, which is loaded by ensureCatalog() once the form is on screen
+    for (QComboBox *combo : {ui->CoolUnitsHC, ui->HeatUnitsHC}) {
+        combo->addItem("Watts", int(OutputUnit::Watts));
+        combo->addItem("BTU", int(OutputUnit::BTU));
+    }
 
 
     // Setup Auto Calculations
-    auto connectChanged = [this](QObject *obj) {
-        connect(obj, SIGNAL(textChanged(QString)), this, SLOT(updatePlaceholders()));
+    // Each input updates only its own field of the cached room and marks the results that depend on it.
+    // Bursts of changes (pasting, key repeat) are coalesced into one recalculation per event loop pass.
+    recalcTimer = new QTimer(this);
+    recalcTimer->setSingleShot(true);
+    recalcTimer->setInterval(0);
+    connect(recalcTimer, &QTimer::timeout, this, &MainWindow::updatePlaceholders);
+
+    // Once the project has a file, the form is saved with it a moment after typing stops.
+    // Saves append only what changed, so they take about as long as the edit is big.
+    autosaveTimer = new QTimer(this);
+    autosaveTimer->setSingleShot(true);
+    autosaveTimer->setInterval(2000);
+    connect(autosaveTimer, &QTimer::timeout, this, &MainWindow::autosave);
+
+    auto bindValue = [this](QLineEdit *edit, double RoomInput::*field, int affects) {
+        connect(edit, &QLineEdit::textChanged, this, [this, edit, field, affects]() {
+            roomInput.*field = getLineEditValue(edit);
+            markDirty(affects);
+        });
     };
-
-    for (auto *edit : numericEdits)
-        connectChanged(edit);
-
-    QList<QComboBox *> comboBoxes = {
-        ui->LightTypeHC, ui->WallMaterialHC, ui->WindowMaterialHC,
-        ui->CeilingMaterialHC, ui->FloorMaterialHC,
-        ui->CoolUnitsHC, ui->HeatUnitsHC
+    const int dimensionsAffect = CoolingDirty | HeatingDirty | AreaGuessDirty;
+    bindValue(ui->LELengthHC, &RoomInput::length, dimensionsAffect);
+    bindValue(ui->LEWidthHC, &RoomInput::width, dimensionsAffect);
+    bindValue(ui->LEHeightHC, &RoomInput::height, HeatingDirty | AreaGuessDirty);
+    bindValue(ui->LENWindowHC, &RoomInput::northWindowArea, dimensionsAffect);
+    bindValue(ui->LEEWindowHC, &RoomInput::eastWindowArea, dimensionsAffect);
+    bindValue(ui->LESWindowHC, &RoomInput::southWindowArea, dimensionsAffect);
+    bindValue(ui->LEWWindowHC, &RoomInput::westWindowArea, dimensionsAffect);
+    bindValue(ui->LEOccupantsHC, &RoomInput::occupants, CoolingDirty);
+    bindValue(ui->LEEquipmentHC, &RoomInput::equipmentWatt, CoolingDirty);
+    bindValue(ui->LELightHC, &RoomInput::lightingWatt, CoolingDirty);
+    bindValue(ui->LECoolAdjustHC, &RoomInput::coolAdjust, CoolingDirty);
+    bindValue(ui->LECoolCapacityHC, &RoomInput::coolCapacity, CoolingDirty);
+    bindValue(ui->LEWindowGHC, &RoomInput::windowG, CoolingDirty);
+    bindValue(ui->LETargetTempHC, &RoomInput::targetTemp, HeatingDirty);
+    bindValue(ui->LEExternalTempHC, &RoomInput::externalTemp, HeatingDirty);
+    bindValue(ui->LEVentilationHC, &RoomInput::ventilationAch, HeatingDirty);
+    bindValue(ui->LELeakageHC, &RoomInput::leakageAch, HeatingDirty);
+    bindValue(ui->LEHeatAdjustHC, &RoomInput::heatAdjust, HeatingDirty);
+    bindValue(ui->LEHeatCapacityHC, &RoomInput::heatCapacity, HeatingDirty);
+
+    auto bindArea = [this](QLineEdit *edit, std::optional<double> RoomInput::*field) {
+        connect(edit, &QLineEdit::textChanged, this, [this, edit, field]() {
+            roomInput.*field = optionalValue(edit);
+            markDirty(HeatingDirty);
+        });
     };
-
-    for (auto *combo : comboBoxes)
-        connect(combo, SIGNAL(currentTextChanged(QString)), this, SLOT(updatePlaceholders()));
-
-    QList<QCheckBox *> checkboxes = {
-        ui->NorthShadeHC, ui->EastShadeHC,
-        ui->SouthShadeHC, ui->WestShadeHC
+    bindArea(ui->LEWallAreaHC, &RoomInput::wallArea);
+    bindArea(ui->LEWindowAreaHC, &RoomInput::windowArea);
+    bindArea(ui->LECeilingAreaHC, &RoomInput::ceilingArea);
+    bindArea(ui->LEFloorAreaHC, &RoomInput::floorArea);
+
+    // An empty latitude keeps the rule-of-thumb window gains
+    connect(ui->LELatitudeHC, &QLineEdit::textChanged, this, [this]() {
+        roomInput.latitude = optionalValue(ui->LELatitudeHC);
+        markDirty(CoolingDirty);
+    });
+
+    auto bindMaterial = [this](QComboBox *combo, QLineEdit *edit, double RoomInput::*field) {
+        connect(edit, &QLineEdit::textChanged, this, [this, combo, edit, field]() {
+            roomInput.*field = materialValue(combo, edit);
+            markDirty(HeatingDirty);
+        });
+        connect(combo, &QComboBox::currentIndexChanged, this, [this, combo, edit, field]() {
+            roomInput.*field = materialValue(combo, edit);
+            markDirty(HeatingDirty | MaterialGuessDirty);
+        });
     };
-
-    for (auto *box : checkboxes)
-        connect(box, SIGNAL(stateChanged(int)), this, SLOT(updatePlaceholders()));
+    bindMaterial(ui->WallMaterialHC, ui->LEWallMaterialHC, &RoomInput::wallU);
+    bindMaterial(ui->WindowMaterialHC, ui->LEWindowMaterialHC, &RoomInput::windowU);
+    bindMaterial(ui->CeilingMaterialHC, ui->LECeilingMaterialHC, &RoomInput::ceilingU);
+    bindMaterial(ui->FloorMaterialHC, ui->LEFloorMaterialHC, &RoomInput::floorU);
+
+    connect(ui->LightTypeHC, &QComboBox::currentIndexChanged, this, [this]() {
+        roomInput.lightingMult = catalog.value(catalogId(ui->LightTypeHC));
+        markDirty(CoolingDirty);
+    });
+
+    auto bindUnits = [this](QComboBox *combo, OutputUnit RoomInput::*field, int affects) {
+        connect(combo, &QComboBox::currentIndexChanged, this, [this, combo, field, affects]() {
+            roomInput.*field = outputUnit(combo);
+            markDirty(affects);
+        });
+    };
+    bindUnits(ui->CoolUnitsHC, &RoomInput::coolUnits, CoolingDirty);
+    bindUnits(ui->HeatUnitsHC, &RoomInput::heatUnits, HeatingDirty);
+
+    auto bindShade = [this](QCheckBox *box, bool RoomInput::*field) {
+        connect(box, &QCheckBox::toggled, this, [this, field](bool checked) {
+            roomInput.*field = checked;
+            markDirty(CoolingDirty);
+        });
+    };
+    bindShade(ui->NorthShadeHC, &RoomInput::northShaded);
+    bindShade(ui->EastShadeHC, &RoomInput::eastShaded);
+    bindShade(ui->SouthShadeHC, &RoomInput::southShaded);
+    bindShade(ui->WestShadeHC, &RoomInput::westShaded);
 
     connect(ui->pushButton, &QPushButton::pressed, this, &MainWindow::savePDF);
+    connect(ui->addRoomButton, &QPushButton::pressed, this, &MainWindow::addRoomToReport);
+    connect(ui->saveReportButton, &QPushButton::pressed, this, &MainWindow::saveProjectReport);
+    connect(ui->sweepButton, &QPushButton::pressed, this, &MainWindow::openSweep);
+    connect(ui->scenariosButton, &QPushButton::pressed, this, &MainWindow::openScenarios);
+    connect(ui->openProjectButton, &QPushButton::pressed, this, &MainWindow::openProject);
+    connect(ui->saveProjectButton, &QPushButton::pressed, this, &MainWindow::saveProjectAs);
+    connect(ui->exportProjectButton, &QPushButton::pressed, this, &MainWindow::exportProject);
+
+    // Not on any menu; for looking into reports of lag on site
+    QShortcut *diagnostics = new QShortcut(QKeySequence(Qt::CTRL | Qt::SHIFT | Qt::Key_D), this);
+    connect(diagnostics, &QShortcut::activated, this, &MainWindow::openDiagnostics);
+
+    // Steps through the edits of every scenario; Ctrl+Z stays with the line edits' own undo
+    QShortcut *undo = new QShortcut(QKeySequence(Qt::CTRL | Qt::ALT | Qt::Key_Z), this);
+    connect(undo, &QShortcut::activated, this, &MainWindow::undoScenarioEdit);
+    QShortcut *redo = new QShortcut(QKeySequence(Qt::CTRL | Qt::ALT | Qt::Key_Y), this);
+    connect(redo, &QShortcut::activated, this, &MainWindow::redoScenarioEdit);
 }
 
 
 MainWindow::~MainWindow()
 {
+    stopReport();
+    if (!project.path().empty())
+        saveProject();
     delete ui;
 }
 
@@ -123,414 +251,654 @@ double MainWindow::getLineEditValue(QLineEdit* lineEdit) {
                lineEdit->text().toDouble();
 }
 
-QString MainWindow::getLineEditPrint(QLineEdit* lineEdit) {
+// The number typed in a field that may be left empty, such as an area override or the latitude
+std::optional<double> MainWindow::optionalValue(QLineEdit *lineEdit)
+{
+    if (lineEdit->text().isEmpty())
+        return std::nullopt;
+    return lineEdit->text().toDouble();
+}
+
+// U-value typed by the user, or the one for the selected material
+double MainWindow::materialValue(QComboBox *combo, QLineEdit *lineEdit)
+{
     return lineEdit->text().isEmpty() ?
-               lineEdit->placeholderText() :
-               lineEdit->text();
+               catalog.value(catalogId(combo)) :
+               lineEdit->text().toDouble();
 }
 
-// Updates placeholders as text is input (use theory to make auto update (no need for calculate button))
-void MainWindow::updatePlaceholders()
+// Units combos carry the OutputUnit as item data rather than being matched on their text
+OutputUnit MainWindow::outputUnit(QComboBox *combo)
 {
-    double length = getLineEditValue(ui->LELengthHC);
-    double width  = getLineEditValue(ui->LEWidthHC);
-    double height = getLineEditValue(ui->LEHeightHC);
-
-    double northArea = getLineEditValue(ui->LENWindowHC);
-    double eastArea = getLineEditValue(ui->LEEWindowHC);
-    double southArea = getLineEditValue(ui->LESWindowHC);
-    double westArea = getLineEditValue(ui->LEWWindowHC);
-
-    double northShade = ui->NorthShadeHC->isChecked() ? 1.0 : 1.4;
-    double eastShade = ui->EastShadeHC->isChecked() ? 1.0 : 1.4;
-    double southShade = ui->SouthShadeHC->isChecked() ? 1.0 : 1.4;
-    double westShade = ui->WestShadeHC->isChecked() ? 1.0 : 1.4;
-
-    double occupants = getLineEditValue(ui->LEOccupantsHC);
-    double equipmentWatt = getLineEditValue(ui->LEEquipmentHC);
-    double lightingWatts = getLineEditValue(ui->LELightHC);
-    double coolAdjust = getLineEditValue(ui->LECoolAdjustHC);
-    double coolCapacity = getLineEditValue(ui->LECoolCapacityHC);
-    double lightingMult = ui->LightTypeHC->currentData().toDouble();
-
-    double wallMultGuess = ui->WallMaterialHC->currentData().toDouble();
-    ui->LEWallMaterialHC->setPlaceholderText(QString::number(wallMultGuess, 'f', 2));
-    double windowMultGuess = ui->WindowMaterialHC->currentData().toDouble();
-    ui->LEWindowMaterialHC->setPlaceholderText(QString::number(windowMultGuess, 'f', 2));
-    double ceilingMultGuess = ui->CeilingMaterialHC->currentData().toDouble();
-    ui->LECeilingMaterialHC->setPlaceholderText(QString::number(ceilingMultGuess, 'f', 2));
-    double floorMultGuess = ui->FloorMaterialHC->currentData().toDouble();
-    ui->LEFloorMaterialHC->setPlaceholderText(QString::number(floorMultGuess, 'f', 2));
-
-    double wallMult = getLineEditValue(ui->LEWallMaterialHC);
-    double windowMult = getLineEditValue(ui->LEWindowMaterialHC);
-    double ceilingMult = getLineEditValue(ui->LECeilingMaterialHC);
-    double floorMult = getLineEditValue(ui->LEFloorMaterialHC);
-
-    double targetTemp = getLineEditValue(ui->LETargetTempHC);
-    double externalTemp = getLineEditValue(ui->LEExternalTempHC);
-    double ventRate = getLineEditValue(ui->LEVentilationHC);
-    double leakRate = getLineEditValue(ui->LELeakageHC);
-    double heatAdjust = getLineEditValue(ui->LEHeatAdjustHC);
-    double heatCapacity = getLineEditValue(ui->LEHeatCapacityHC);
-
-    double ceilingAreaGuess = length * width;
-    double floorAreaGuess = ceilingAreaGuess;
-    ui->LECeilingAreaHC->setPlaceholderText(QString::number(ceilingAreaGuess, 'f', 2));
-    ui->LEFloorAreaHC->setPlaceholderText(QString::number(floorAreaGuess, 'f', 2));
-
-    double windowAreaGuess = northArea + eastArea + southArea + westArea;
-    ui->LEWindowAreaHC->setPlaceholderText(QString::number(windowAreaGuess, 'f', 2));
-
-    double wallAreaGuess = (2 * length * height) + (2 * width * height) - windowAreaGuess;
-    ui->LEWallAreaHC->setPlaceholderText(QString::number(wallAreaGuess, 'f', 2));
-
-    double wallArea = getLineEditValue(ui->LEWallAreaHC);
-    double windowArea = getLineEditValue(ui->LEWindowAreaHC);
-    double ceilingArea = getLineEditValue(ui->LECeilingAreaHC);
-    double floorArea = getLineEditValue(ui->LEFloorAreaHC);
-
-
-    // Calculate Cooling BTU
-    double roomArea = length * width * 3.2808399 * 3.2808399; // metres to feet
-    double roomBTU = roomArea * 31.25;
-    double roomWatt = roomBTU / WattBTU;
-
-    double northWindowBTU = northArea * 164 * northShade;
-    double northWindowWatt = northWindowBTU / WattBTU;
-    double eastWindowBTU = eastArea * 625 * eastShade;
-    double eastWindowWatt = eastWindowBTU / WattBTU;
-    double southWindowBTU = southArea * 868 * southShade;
-    double southWindowWatt = southWindowBTU / WattBTU;
-    double westWindowBTU = westArea * 625 * westShade;
-    double westWindowWatt = westWindowBTU / WattBTU;
-    double windowCoolBTU = northWindowBTU + eastWindowBTU + southWindowBTU + westWindowBTU;
-    double windowCoolWatt = northWindowWatt + eastWindowWatt + southWindowWatt + westWindowWatt;
-
-    double occupantBTU = occupants * 600;
-    double occupantWatt = occupantBTU / WattBTU;
-
-    double equipmentBTU = equipmentWatt * WattBTU;
-
-    double lightingBTU = lightingWatts * lightingMult;
-    double lightingWatt = lightingBTU / WattBTU;
-
-    double totalCoolingBTU = roomBTU + windowCoolBTU + occupantBTU + equipmentBTU + lightingBTU;
-    double totalCoolingWatt = totalCoolingBTU / WattBTU;
-    double peakCoolingBTU = totalCoolingBTU * (1 + coolAdjust / 100);
-    double peakCoolingWatt = peakCoolingBTU / WattBTU;
-
-    int numberCoolingUnits = 0;
-    if (ui->CoolUnitsHC->currentText() == "BTU")
-    {
-        numberCoolingUnits = ceil(peakCoolingBTU / coolCapacity);
-    }
-    if (ui->CoolUnitsHC->currentText() == "Watts")
-    {
-        numberCoolingUnits = ceil(peakCoolingWatt / coolCapacity);
+    return static_cast<OutputUnit>(combo->currentData().toInt());
+}
+
+// catalog.csv in the application data folder replaces the built-in entries when present.
+// Its compiled index is kept beside it and mapped on later starts.
+void MainWindow::loadCatalog()
+{
+    const QString path = QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation))
+                             .filePath("catalog.csv");
+    std::string error;
+    if (QFile::exists(path) && catalog.load(QFile::encodeName(path).toStdString(), error))
+        return;
+    if (!error.empty())
+        qWarning("Using the built-in catalog: %s", error.c_str());
+    catalog.loadBuiltIn();
+}
+
+// Materials and lamps come from the catalog; the combos show its index directly with type-ahead search.
+// Anything reading the combos calls this first, in case it runs before the deferred startup step.
+void MainWindow::ensureCatalog()
+{
+    if (catalogReady)
+        return;
+
+    static const int catalogProbe = Instrumentation::probe("startup.catalog");
+    ScopedTimer timer(catalogProbe);
+    loadCatalog();
+    setupCatalogCombo(ui->LightTypeHC, &catalog, CatalogCategory::Light);
+    setupCatalogCombo(ui->WallMaterialHC, &catalog, CatalogCategory::Wall);
+    setupCatalogCombo(ui->WindowMaterialHC, &catalog, CatalogCategory::Window);
+    setupCatalogCombo(ui->CeilingMaterialHC, &catalog, CatalogCategory::Ceiling);
+    setupCatalogCombo(ui->FloorMaterialHC, &catalog, CatalogCategory::Floor);
+    catalogReady = true;
+
+    roomInput = readRoomInput();
+    scenarios = ScenarioSet(tr("Scenario 1").toStdString(), currentScenarioState());
+    dirty = AllDirty;
+    updatePlaceholders();
+}
+
+// The form is painted once without the catalog and results, which are filled in on the next pass
+bool MainWindow::event(QEvent *event)
+{
+    if (event->type() == QEvent::Show && !shownAt)
+        shownAt = Instrumentation::now();
+    const bool handled = QMainWindow::event(event);
+    if (event->type() == QEvent::Paint && !painted) {
+        painted = true;
+        static const int paintProbe = Instrumentation::probe("startup.firstPaint");
+        if (Instrumentation::enabled())
+            Instrumentation::record(paintProbe, shownAt, Instrumentation::now() - shownAt);
+        QTimer::singleShot(0, this, &MainWindow::finishStartup);
     }
+    return handled;
+}
 
+void MainWindow::finishStartup()
+{
+    ensureCatalog();
+    emit interactive();
+}
 
-    // Calculate Heating BTU
-    double roomVolume = length * width * height;
+void MainWindow::markDirty(int flags)
+{
+    dirty |= flags;
+    if (!recalcTimer->isActive())
+        recalcTimer->start();
+    if (!project.path().empty())
+        autosaveTimer->start();
+}
 
-    double diffTemp = abs(targetTemp - externalTemp);
+// Only touches the widget when the displayed text actually changes
+void MainWindow::showOutput(QTextBrowser *box, double value)
+{
+    static const int writeProbe = Instrumentation::probe("form.write");
+    static const int skipProbe = Instrumentation::probe("form.writeSkipped", false);
+    QString text = QString::number(value, 'f', 2);
+    QString &shown = shownOutputs[box];
+    if (shown == text) {
+        Instrumentation::count(skipProbe);
+        return;
+    }
+    ScopedTimer timer(writeProbe);
+    shown = text;
+    box->setText(text);
+}
 
-    double wallWatt = wallArea * diffTemp * wallMult;
-    double wallBTU = wallWatt * WattBTU;
-    double windowHeatWatt = windowArea * diffTemp * windowMult;
-    double windowHeatBTU = windowHeatWatt * WattBTU;
-    double ceilingWatt = ceilingArea * diffTemp * ceilingMult;
-    double ceilingBTU = ceilingWatt * WattBTU;
-    double floorWatt = floorArea * diffTemp * floorMult;
-    double floorBTU = floorWatt * WattBTU;
-    double transmissionWatt = wallWatt + windowHeatWatt + ceilingWatt + floorWatt;
-    double transmissionBTU = transmissionWatt * WattBTU;
+// Gathers the room description from the form, resolving empty fields to their placeholders
+RoomInput MainWindow::readRoomInput()
+{
+    RoomInput input;
+    input.length = getLineEditValue(ui->LELengthHC);
+    input.width  = getLineEditValue(ui->LEWidthHC);
+    input.height = getLineEditValue(ui->LEHeightHC);
+
+    input.northWindowArea = getLineEditValue(ui->LENWindowHC);
+    input.eastWindowArea = getLineEditValue(ui->LEEWindowHC);
+    input.southWindowArea = getLineEditValue(ui->LESWindowHC);
+    input.westWindowArea = getLineEditValue(ui->LEWWindowHC);
+
+    input.northShaded = ui->NorthShadeHC->isChecked();
+    input.eastShaded = ui->EastShadeHC->isChecked();
+    input.southShaded = ui->SouthShadeHC->isChecked();
+    input.westShaded = ui->WestShadeHC->isChecked();
+
+    input.occupants = getLineEditValue(ui->LEOccupantsHC);
+    input.equipmentWatt = getLineEditValue(ui->LEEquipmentHC);
+    input.lightingWatt = getLineEditValue(ui->LELightHC);
+    input.coolAdjust = getLineEditValue(ui->LECoolAdjustHC);
+    input.coolCapacity = getLineEditValue(ui->LECoolCapacityHC);
+    input.lightingMult = catalog.value(catalogId(ui->LightTypeHC));
+    input.coolUnits = outputUnit(ui->CoolUnitsHC);
+    input.latitude = optionalValue(ui->LELatitudeHC);
+    input.windowG = getLineEditValue(ui->LEWindowGHC);
+
+    input.wallArea = optionalValue(ui->LEWallAreaHC);
+    input.windowArea = optionalValue(ui->LEWindowAreaHC);
+    input.ceilingArea = optionalValue(ui->LECeilingAreaHC);
+    input.floorArea = optionalValue(ui->LEFloorAreaHC);
+
+    input.wallU = materialValue(ui->WallMaterialHC, ui->LEWallMaterialHC);
+    input.windowU = materialValue(ui->WindowMaterialHC, ui->LEWindowMaterialHC);
+    input.ceilingU = materialValue(ui->CeilingMaterialHC, ui->LECeilingMaterialHC);
+    input.floorU = materialValue(ui->FloorMaterialHC, ui->LEFloorMaterialHC);
+
+    input.targetTemp = getLineEditValue(ui->LETargetTempHC);
+    input.externalTemp = getLineEditValue(ui->LEExternalTempHC);
+    input.ventilationAch = getLineEditValue(ui->LEVentilationHC);
+    input.leakageAch = getLineEditValue(ui->LELeakageHC);
+    input.heatAdjust = getLineEditValue(ui->LEHeatAdjustHC);
+    input.heatCapacity = getLineEditValue(ui->LEHeatCapacityHC);
+    input.heatUnits = outputUnit(ui->HeatUnitsHC);
+
+    return input;
+}
 
-    double ventWatt = AirDensity * AirSpecificHeat * (ventRate / (60*60)) * roomVolume * diffTemp;
-    double ventBTU = ventWatt * WattBTU;
-    double leakWatt = AirDensity * AirSpecificHeat * (leakRate / (60*60)) * roomVolume * diffTemp;
-    double leakBTU = leakWatt * WattBTU;
+// Updates placeholders and results for whatever changed since the last pass (no need for calculate button)
+void MainWindow::updatePlaceholders()
+{
+    // Edits made before the catalog arrives stay dirty; ensureCatalog() recalculates everything
+    if (!catalogReady)
+        return;
 
-    double totalHeatingWatt = transmissionWatt + ventWatt + leakWatt;
-    double totalHeatingBTU = totalHeatingWatt * WattBTU;
-    double peakHeatingWatt = totalHeatingWatt * (1 + heatAdjust / 100);
-    double peakHeatingBTU = peakHeatingWatt * WattBTU;
+    static const int updateProbe = Instrumentation::probe("form.update");
+    ScopedTimer timer(updateProbe);
+    const int changed = dirty;
+    dirty = 0;
 
-    int numberHeatingUnits = 0;
-    if (ui->CoolUnitsHC->currentText() == "BTU")
-    {
-        numberHeatingUnits = ceil(peakHeatingBTU / heatCapacity);
+    if (changed & MaterialGuessDirty) {
+        ui->LEWallMaterialHC->setPlaceholderText(QString::number(catalog.value(catalogId(ui->WallMaterialHC)), 'f', 2));
+        ui->LEWindowMaterialHC->setPlaceholderText(QString::number(catalog.value(catalogId(ui->WindowMaterialHC)), 'f', 2));
+        ui->LECeilingMaterialHC->setPlaceholderText(QString::number(catalog.value(catalogId(ui->CeilingMaterialHC)), 'f', 2));
+        ui->LEFloorMaterialHC->setPlaceholderText(QString::number(catalog.value(catalogId(ui->FloorMaterialHC)), 'f', 2));
     }
-    if (ui->CoolUnitsHC->currentText() == "Watts")
-    {
-        numberHeatingUnits = ceil(peakHeatingWatt / coolCapacity);
+
+    if (changed & AreaGuessDirty) {
+        const SurfaceAreas areaGuess = estimateSurfaceAreas(roomInput);
+        ui->LECeilingAreaHC->setPlaceholderText(QString::number(areaGuess.ceiling, 'f', 2));
+        ui->LEFloorAreaHC->setPlaceholderText(QString::number(areaGuess.floor, 'f', 2));
+        ui->LEWindowAreaHC->setPlaceholderText(QString::number(areaGuess.window, 'f', 2));
+        ui->LEWallAreaHC->setPlaceholderText(QString::number(areaGuess.wall, 'f', 2));
     }
 
 
     // Output results to text boxes
-    ui->OutRoomHeatHC->setText(QString::number(roomWatt, 'f', 2));
-    ui->OutWindowHeatHC->setText(QString::number(windowCoolWatt, 'f', 2));
-    ui->OutOccupantHeatHC->setText(QString::number(occupantWatt, 'f', 2));
-    ui->OutEquipmentHeatHC->setText(QString::number(equipmentWatt, 'f', 2));
-    ui->OutLightHeatHC->setText(QString::number(lightingWatt, 'f', 2));
-    ui->OutTotalCoolHC->setText(QString::number(totalCoolingWatt, 'f', 2));
-    ui->OutPeakCoolHC->setText(QString::number(peakCoolingWatt, 'f', 2));
-    ui->OutCoolUnitsHC->setText(QString::number(numberCoolingUnits, 'f', 2));
-
-    ui->OutWallLossHC->setText(QString::number(wallWatt, 'f', 2));
-    ui->OutWindowLossHC->setText(QString::number(windowHeatWatt, 'f', 2));
-    ui->OutCeilingLossHC->setText(QString::number(ceilingWatt, 'f', 2));
-    ui->OutFloorLossHC->setText(QString::number(floorWatt, 'f', 2));
-    ui->OutTransmissionLossHC->setText(QString::number(transmissionWatt, 'f', 2));
-    ui->OutVentilationLossHC->setText(QString::number(ventWatt, 'f', 2));
-    ui->OutLeakageLossHC->setText(QString::number(leakWatt, 'f', 2));
-    ui->OutTotalHeatHC->setText(QString::number(totalHeatingWatt, 'f', 2));
-    ui->OutPeakHeatHC->setText(QString::number(peakHeatingWatt, 'f', 2));
-    ui->OutHeatUnitsHC->setText(QString::number(numberHeatingUnits, 'f', 2));
+    if (changed & CoolingDirty) {
+        calculateCoolingLoads(roomInput, roomLoads);
+        showOutput(ui->OutRoomHeatHC, roomLoads.roomWatt);
+        showOutput(ui->OutWindowHeatHC, roomLoads.windowCoolWatt);
+        showOutput(ui->OutOccupantHeatHC, roomLoads.occupantWatt);
+        showOutput(ui->OutEquipmentHeatHC, roomLoads.equipmentWatt);
+        showOutput(ui->OutLightHeatHC, roomLoads.lightingWatt);
+        showOutput(ui->OutTotalCoolHC, roomLoads.totalCoolingWatt);
+        showOutput(ui->OutPeakCoolHC, roomLoads.peakCoolingWatt);
+        showOutput(ui->OutCoolUnitsHC, roomLoads.coolingUnits);
+    }
+
+    if (changed & HeatingDirty) {
+        calculateHeatingLoads(roomInput, roomLoads);
+        showOutput(ui->OutWallLossHC, roomLoads.wallWatt);
+        showOutput(ui->OutWindowLossHC, roomLoads.windowHeatWatt);
+        showOutput(ui->OutCeilingLossHC, roomLoads.ceilingWatt);
+        showOutput(ui->OutFloorLossHC, roomLoads.floorWatt);
+        showOutput(ui->OutTransmissionLossHC, roomLoads.transmissionWatt);
+        showOutput(ui->OutVentilationLossHC, roomLoads.ventWatt);
+        showOutput(ui->OutLeakageLossHC, roomLoads.leakWatt);
+        showOutput(ui->OutTotalHeatHC, roomLoads.totalHeatingWatt);
+        showOutput(ui->OutPeakHeatHC, roomLoads.peakHeatingWatt);
+        showOutput(ui->OutHeatUnitsHC, roomLoads.heatingUnits);
+    }
+
+    recordScenarioEdit();
 }
 
+// The form's inputs as a change to the active scenario, sharing whatever it leaves alone
+ScenarioState MainWindow::currentScenarioState()
+{
+    ScenarioState state;
+    state.input = scenarios.state(scenarios.active()).input.with(roomInput);
+    state.selections.light = catalogId(ui->LightTypeHC);
+    state.selections.wall = catalogId(ui->WallMaterialHC);
+    state.selections.window = catalogId(ui->WindowMaterialHC);
+    state.selections.ceiling = catalogId(ui->CeilingMaterialHC);
+    state.selections.floor = catalogId(ui->FloorMaterialHC);
+    return state;
+}
 
-void MainWindow::savePDF()
+// Each recalculation pass is one undo step, merged with the last when both changed the same field
+void MainWindow::recordScenarioEdit()
+{
+    // A scenario just put in the form is already what the form holds
+    if (!showingScenario)
+        scenarios.edit(scenarios.active(), currentScenarioState());
+    showingScenario = false;
+    if (scenarioDialog)
+        scenarioDialog->refresh();
+}
+
+
+// Snapshot of the current form for the report, using the calculated results
+RoomReport MainWindow::currentRoomReport(const QString &name)
+{
+    ensureCatalog();
+    if (dirty)
+        updatePlaceholders();
+
+    RoomReport room;
+    room.name = name;
+    room.input = roomInput;
+    room.loads = roomLoads;
+    // The selected entries, not whatever is half typed into the editable combos
+    auto selected = [](QComboBox *combo) { return combo->itemText(combo->currentIndex()); };
+    room.lightType = selected(ui->LightTypeHC);
+    room.wallMaterial = selected(ui->WallMaterialHC);
+    room.windowMaterial = selected(ui->WindowMaterialHC);
+    room.ceilingMaterial = selected(ui->CeilingMaterialHC);
+    room.floorMaterial = selected(ui->FloorMaterialHC);
+    return room;
+}
+
+// Puts a saved room back into the form. Values equal to a placeholder are left empty, and
+// U-values matching the saved material select it rather than being typed in.
+void MainWindow::showRoom(const RoomReport &room)
+{
+    ensureCatalog();
+    const RoomInput &input = room.input;
+    auto setValue = [](QLineEdit *edit, double value) {
+        edit->setText(value == edit->placeholderText().toDouble()
+                          ? QString()
+                          : QString::number(value, 'g', QLocale::FloatingPointShortest));
+    };
+    setValue(ui->LELengthHC, input.length);
+    setValue(ui->LEWidthHC, input.width);
+    setValue(ui->LEHeightHC, input.height);
+    setValue(ui->LENWindowHC, input.northWindowArea);
+    setValue(ui->LEEWindowHC, input.eastWindowArea);
+    setValue(ui->LESWindowHC, input.southWindowArea);
+    setValue(ui->LEWWindowHC, input.westWindowArea);
+    setValue(ui->LEOccupantsHC, input.occupants);
+    setValue(ui->LEEquipmentHC, input.equipmentWatt);
+    setValue(ui->LELightHC, input.lightingWatt);
+    setValue(ui->LECoolAdjustHC, input.coolAdjust);
+    setValue(ui->LECoolCapacityHC, input.coolCapacity);
+    setValue(ui->LEWindowGHC, input.windowG);
+    setValue(ui->LETargetTempHC, input.targetTemp);
+    setValue(ui->LEExternalTempHC, input.externalTemp);
+    setValue(ui->LEVentilationHC, input.ventilationAch);
+    setValue(ui->LELeakageHC, input.leakageAch);
+    setValue(ui->LEHeatAdjustHC, input.heatAdjust);
+    setValue(ui->LEHeatCapacityHC, input.heatCapacity);
+
+    ui->NorthShadeHC->setChecked(input.northShaded);
+    ui->EastShadeHC->setChecked(input.eastShaded);
+    ui->SouthShadeHC->setChecked(input.southShaded);
+    ui->WestShadeHC->setChecked(input.westShaded);
+
+    auto setArea = [](QLineEdit *edit, const std::optional<double> &area) {
+        edit->setText(area ? QString::number(*area, 'g', QLocale::FloatingPointShortest) : QString());
+    };
+    setArea(ui->LEWallAreaHC, input.wallArea);
+    setArea(ui->LEWindowAreaHC, input.windowArea);
+    setArea(ui->LECeilingAreaHC, input.ceilingArea);
+    setArea(ui->LEFloorAreaHC, input.floorArea);
+    setArea(ui->LELatitudeHC, input.latitude);
+
+    auto setMaterial = [this](QComboBox *combo, QLineEdit *edit, const QString &name, double value) {
+        const bool listed = selectCatalogName(combo, name.toStdString());
+        edit->setText(listed && catalog.value(catalogId(combo)) == value
+                          ? QString()
+                          : QString::number(value, 'g', QLocale::FloatingPointShortest));
+    };
+    setMaterial(ui->WallMaterialHC, ui->LEWallMaterialHC, room.wallMaterial, input.wallU);
+    setMaterial(ui->WindowMaterialHC, ui->LEWindowMaterialHC, room.windowMaterial, input.windowU);
+    setMaterial(ui->CeilingMaterialHC, ui->LECeilingMaterialHC, room.ceilingMaterial, input.ceilingU);
+    setMaterial(ui->FloorMaterialHC, ui->LEFloorMaterialHC, room.floorMaterial, input.floorU);
+    selectCatalogName(ui->LightTypeHC, room.lightType.toStdString());
+
+    ui->CoolUnitsHC->setCurrentIndex(ui->CoolUnitsHC->findData(int(input.coolUnits)));
+    ui->HeatUnitsHC->setCurrentIndex(ui->HeatUnitsHC->findData(int(input.heatUnits)));
+}
+
+QString MainWindow::askPdfFileName(const QString &title, const QString &defaultName)
 {
     QString fileName = QFileDialog::getSaveFileName(
         this,
-        tr("Save PDF"),
-        QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation) + "/output.pdf",
+        title,
+        QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation) + "/" + defaultName,
         tr("PDF Files (*.pdf)")
         );
 
+    if (!fileName.isEmpty() && !fileName.endsWith(".pdf", Qt::CaseInsensitive))
+        fileName += ".pdf";
+    return fileName;
+}
+
+void MainWindow::savePDF()
+{
+    if (reportThread)
+        return;
+
+    const QString fileName = askPdfFileName(tr("Save PDF"), "output.pdf");
     if (fileName.isEmpty())
         return;
 
-    if (!fileName.endsWith(".pdf", Qt::CaseInsensitive))
-        fileName += ".pdf";
+    static const int prepareProbe = Instrumentation::probe("pdf.prepare");
+    RoomReport room;
+    {
+        ScopedTimer timer(prepareProbe);
+        room = currentRoomReport(QString());
+    }
+    startReport(fileName, {room}, false);
+}
+
+void MainWindow::addRoomToReport()
+{
+    bool ok = false;
+    const QString name = QInputDialog::getText(this, tr("Add room to report"), tr("Room name:"), QLineEdit::Normal,
+                                               tr("Room %1").arg(project.size() + 1), &ok);
+    if (!ok)
+        return;
+
+    project.add(toProjectRoom(currentRoomReport(name)));
+    updateProjectLabel();
+    if (!project.path().empty())
+        autosaveTimer->start();
+}
+
+void MainWindow::updateProjectLabel()
+{
+    const int rooms = static_cast<int>(project.size());
+    ui->reportRoomsLabel->setText(rooms ? tr("%n room(s) in report", nullptr, rooms) : tr("No rooms in report"));
+    ui->saveReportButton->setEnabled(rooms > 0);
+    ui->exportProjectButton->setEnabled(rooms > 0);
+}
+
+void MainWindow::saveProjectReport()
+{
+    if (reportThread || project.size() == 0)
+        return;
 
-    QPdfWriter writer(fileName);
-    writer.setPageSize(QPageSize::A4);
-    writer.setResolution(300);
-    writer.setCreator("KAM Engineering Ltd.");
-    QPainter painter(&writer);
-
-    // Page dimensions and margins
-    const int pageWidth = writer.width();
-    const int pageHeight = writer.height();
-    const int margin = 200;
-    const int columnGap = 60;
-    const int columnWidth = (pageWidth - 2 * margin - columnGap) / 2;
-    const int lineSpacing = 60;
-    const int sectionSpacing = 160;
-
-    // Fonts
-    QFont titleFont("Arial", 14, QFont::Bold);
-    QFont headerFont("Arial", 11, QFont::Bold);
-    QFont contentFont("Arial", 10);
-    QFont footerFont("Arial", 8);
-
-    QPen pen(QColor(102, 46, 145));
-    painter.setPen(pen);
-
-    // Draw background logo and corner logo
-    QImage backgroundImage(":/Kam logo.jpg");
-    if (!backgroundImage.isNull()) {
-        QTransform rotation;
-        rotation.rotate(60);
-        QImage rotatedImage = backgroundImage.transformed(rotation);
-        QImage scaledImage = rotatedImage.scaled(pageWidth, pageHeight, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
-        painter.setOpacity(0.2);
-        painter.drawImage(QPoint(0, 0), scaledImage);
-        painter.setOpacity(1.0);
-
-
-        QImage scaledLogo = backgroundImage.scaledToHeight(pageHeight/20, Qt::SmoothTransformation);
-        painter.drawImage(QPoint(pageWidth-scaledLogo.width(), 0), scaledLogo);
+    const QString fileName = askPdfFileName(tr("Save project report"), "project.pdf");
+    if (fileName.isEmpty())
+        return;
+
+    // The report needs every room, so this is where a large project gets decoded
+    QList<RoomReport> rooms;
+    rooms.reserve(static_cast<int>(project.size()));
+    ProjectRoom room;
+    for (size_t i = 0; i < project.size(); ++i) {
+        if (project.room(i, room))
+            rooms.append(toRoomReport(room));
     }
+    startReport(fileName, rooms, true);
+}
 
-    // Draw F-Gas logo
-    QImage FGasImage(":/REFCOM Certified logo.png");
-    if (!FGasImage.isNull()) {
-        QImage scaledFGas = FGasImage.scaledToHeight(pageHeight/20, Qt::SmoothTransformation);
-        painter.drawImage(QPoint(0, 0), scaledFGas);
+// Keeps the current project's unsaved changes, then maps the chosen one and restores its form
+void MainWindow::openProject()
+{
+    const QString fileName = QFileDialog::getOpenFileName(
+        this, tr("Open project"), QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation),
+        tr("BTU Calculator Projects (*.btup)"));
+    if (fileName.isEmpty())
+        return;
+
+    // Tried on its own first, so a file that cannot be read leaves the current project alone
+    const std::string path = QFile::encodeName(fileName).toStdString();
+    std::string error;
+    if (!ProjectFile().open(path, error)) {
+        statusBar()->showMessage(tr("Could not open %1").arg(QString::fromStdString(error)));
+        return;
+    }
+    if (!project.path().empty())
+        saveProject();
+    if (!project.open(path, error)) {
+        statusBar()->showMessage(tr("Could not open %1").arg(QString::fromStdString(error)));
+        updateProjectLabel();
+        return;
+    }
+
+    ProjectRoom room;
+    if (project.draft(room))
+        showRoom(toRoomReport(room));
+    autosaveTimer->stop();
+    updateProjectLabel();
+    statusBar()->showMessage(tr("Opened %1").arg(fileName), 5000);
+}
+
+// Writes the whole project to a new file, dropping superseded records, and autosaves there from then on
+void MainWindow::saveProjectAs()
+{
+    QString fileName = QFileDialog::getSaveFileName(
+        this, tr("Save project"),
+        QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation) + "/project.btup",
+        tr("BTU Calculator Projects (*.btup)"));
+    if (fileName.isEmpty())
+        return;
+    if (!fileName.endsWith(".btup", Qt::CaseInsensitive))
+        fileName += ".btup";
+
+    project.setDraft(toProjectRoom(currentRoomReport(QString())));
+    std::string error;
+    if (!project.saveAs(QFile::encodeName(fileName).toStdString(), error)) {
+        statusBar()->showMessage(tr("Could not save %1: %2").arg(fileName, QString::fromStdString(error)));
+        return;
     }
+    autosaveTimer->stop();
+    statusBar()->showMessage(tr("Saved %1").arg(fileName), 5000);
+}
+
+void MainWindow::exportProject()
+{
+    const QString fileName = QFileDialog::getSaveFileName(
+        this, tr("Export rooms"),
+        QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation) + "/rooms.csv",
+        tr("CSV Files (*.csv);;JSON Lines Files (*.jsonl)"));
+    if (fileName.isEmpty())
+        return;
 
+    const std::string path = QFile::encodeName(fileName).toStdString();
+    std::FILE *file = std::fopen(path.c_str(), "wb");
+    std::string error;
+    bool ok = file && project.exportRooms(file, formatForPath(path), error);
+    ok = file && std::fclose(file) == 0 && ok;
+    statusBar()->showMessage(ok ? tr("Exported %1").arg(fileName) : tr("Could not write %1").arg(fileName), 5000);
+}
 
-    // --- Title ---
-    painter.setFont(titleFont);
-    painter.drawText(QRect(margin, margin / 2, pageWidth - 2 * margin, margin),
-                     Qt::AlignHCenter,
-                     "HVAC Load Calculation Report");
-
-    // --- Branding ---
-    int yTop = margin;
-    painter.setFont(headerFont);
-    painter.drawText(QRect(0, yTop, pageWidth, margin),
-                     Qt::AlignHCenter | Qt::AlignTop,
-                     "www.kam-surveys.co.uk | hello@kam-surveys.co.uk");
-
-    // --- Initialize Column Coordinates ---
-    int yLeft = yTop + sectionSpacing;
-    int yRight = yTop + sectionSpacing;
-    int yMain = yTop + 1.5 * sectionSpacing;
-    int xLeft = margin;
-    int xRight = margin + columnWidth + columnGap;
-
-    // Lambda for drawing label-value pair
-    auto writeLine = [&](int x, int &y, const QString &label, const QString &value, const QString &string3="", const QString &string4="", bool newLine=true) {
-        painter.setFont(contentFont);
-        painter.drawText(x, y, QString("%1: %2%3%4").arg(label, value, string3, string4));
-        if (newLine) {
-            y += lineSpacing;
+void MainWindow::autosave()
+{
+    if (!project.path().empty())
+        saveProject();
+}
+
+// Appends the form and any changed rooms to the project file
+bool MainWindow::saveProject()
+{
+    project.setDraft(toProjectRoom(currentRoomReport(QString())));
+    std::string error;
+    if (project.save(error))
+        return true;
+    statusBar()->showMessage(tr("Autosave failed: %1").arg(QString::fromStdString(error)));
+    return false;
+}
+
+// Offers the material lists and shading as sweep options, starting from the current room
+void MainWindow::openSweep()
+{
+    ensureCatalog();
+    if (dirty)
+        updatePlaceholders();
+
+    // Only distinct U-values change the loads, so each offers one product per value.
+    // Large catalogs are thinned to an even spread of values that keeps the current one.
+    const int maxOptions = 48;
+    QList<SweepCatalog> catalogs;
+    auto addCombo = [&](const QString &title, const char *field, QComboBox *combo, CatalogCategory category) {
+        std::vector<CatalogId> ids(catalog.count(category));
+        for (size_t i = 0; i < ids.size(); ++i)
+            ids[i] = catalog.first(category) + static_cast<CatalogId>(i);
+        auto byValue = [this](CatalogId a, CatalogId b) { return catalog.value(a) < catalog.value(b); };
+        std::stable_sort(ids.begin(), ids.end(), byValue);
+        ids.erase(std::unique(ids.begin(), ids.end(),
+                              [this](CatalogId a, CatalogId b) { return catalog.value(a) == catalog.value(b); }),
+                  ids.end());
+        if (ids.size() > size_t(maxOptions)) {
+            std::vector<CatalogId> spread;
+            for (int k = 0; k < maxOptions; ++k)
+                spread.push_back(ids[k * (ids.size() - 1) / (maxOptions - 1)]);
+            const CatalogId current = catalogId(combo);
+            if (current != NoCatalogId && !std::binary_search(spread.begin(), spread.end(), current, byValue))
+                spread.insert(std::upper_bound(spread.begin(), spread.end(), current, byValue), current);
+            ids.swap(spread);
         }
+
+        SweepCatalog options{title, roomFieldIndex(field), {}};
+        for (CatalogId id : ids) {
+            const std::string_view name = catalog.name(id);
+            options.entries.append({QString::fromUtf8(name.data(), static_cast<qsizetype>(name.size())),
+                                    catalog.value(id)});
+        }
+        catalogs.append(options);
+    };
+    addCombo(tr("Wall"), "wallU", ui->WallMaterialHC, CatalogCategory::Wall);
+    addCombo(tr("Window"), "windowU", ui->WindowMaterialHC, CatalogCategory::Window);
+    addCombo(tr("Ceiling"), "ceilingU", ui->CeilingMaterialHC, CatalogCategory::Ceiling);
+    addCombo(tr("Floor"), "floorU", ui->FloorMaterialHC, CatalogCategory::Floor);
+
+    auto addShading = [&](const QString &title, const char *field) {
+        catalogs.append({title, roomFieldIndex(field), {{tr("Unshaded"), 0}, {tr("Shaded"), 1}}});
+    };
+    addShading(tr("North windows"), "northShaded");
+    addShading(tr("East windows"), "eastShaded");
+    addShading(tr("South windows"), "southShaded");
+    addShading(tr("West windows"), "westShaded");
+
+    SweepDialog *dialog = new SweepDialog(roomInput, catalogs, this);
+    dialog->setAttribute(Qt::WA_DeleteOnClose);
+    dialog->show();
+}
+
+void MainWindow::openScenarios()
+{
+    ensureCatalog();
+    if (dirty)
+        updatePlaceholders();
+
+    if (!scenarioDialog) {
+        scenarioDialog = new ScenarioDialog(&scenarios, this);
+        scenarioDialog->setAttribute(Qt::WA_DeleteOnClose);
+        connect(scenarioDialog, &ScenarioDialog::activeChanged, this, &MainWindow::showActiveScenario);
+        connect(scenarioDialog, &ScenarioDialog::undoRequested, this, &MainWindow::undoScenarioEdit);
+        connect(scenarioDialog, &ScenarioDialog::redoRequested, this, &MainWindow::redoScenarioEdit);
+    }
+    scenarioDialog->show();
+    scenarioDialog->raise();
+}
+
+void MainWindow::showActiveScenario()
+{
+    const ScenarioState &state = scenarios.state(scenarios.active());
+    auto selected = [this](CatalogId id) {
+        const std::string_view name = id == NoCatalogId ? std::string_view() : catalog.name(id);
+        return QString::fromUtf8(name.data(), static_cast<qsizetype>(name.size()));
     };
+    RoomReport room;
+    room.input = state.input.input();
+    room.lightType = selected(state.selections.light);
+    room.wallMaterial = selected(state.selections.wall);
+    room.windowMaterial = selected(state.selections.window);
+    room.ceilingMaterial = selected(state.selections.ceiling);
+    room.floorMaterial = selected(state.selections.floor);
+    showRoom(room);
+    showingScenario = true;
+    markDirty(AllDirty);
+}
 
-    painter.setFont(headerFont);
-    painter.drawText(xLeft, yMain, "Room Dimensions");
-    painter.drawText(xRight, yMain, "Surface Information");
-    yMain += lineSpacing;
+void MainWindow::undoScenarioEdit()
+{
+    ensureCatalog();
+    if (dirty)
+        updatePlaceholders();
+    showScenarioStep(scenarios.undo());
+}
 
-    painter.setFont(contentFont);
-    painter.drawText(xLeft, yMain, QString("%1: %2 m").arg("Length", getLineEditPrint(ui->LELengthHC)));
-    painter.drawText(xRight, yMain, QString("%1: %2 m\u00B2").arg("Wall Surface Area", getLineEditPrint(ui->LEWallAreaHC)));
-    yMain += lineSpacing;
-
-    painter.setFont(footerFont);
-    painter.drawText(xRight, yMain, QString("   %1 - %2: %3 W/m\u00B2K").arg(ui->WallMaterialHC->currentText(), "U-Value", getLineEditPrint(ui->LEWallMaterialHC)));
-    painter.setFont(contentFont);
-    painter.drawText(xLeft, yMain, QString("%1: %2 m").arg("Width", getLineEditPrint(ui->LEWidthHC)));
-    yMain += lineSpacing;
-
-    painter.drawText(xLeft, yMain, QString("%1: %2 m").arg("Height", getLineEditPrint(ui->LEHeightHC)));
-    painter.drawText(xRight, yMain, QString("%1: %2 m\u00B2").arg("Window Surface Area", getLineEditPrint(ui->LEWindowAreaHC)));
-    yMain += lineSpacing;
-
-    painter.setFont(footerFont);
-    painter.drawText(xRight, yMain, QString("   %1 - %2: %3 W/m\u00B2K").arg(ui->WindowMaterialHC->currentText(), "U-Value", getLineEditPrint(ui->LEWindowMaterialHC)));
-    yMain += lineSpacing;
-
-    painter.setFont(headerFont);
-    painter.drawText(xLeft, yMain, "Window Areas & Shading");
-    painter.setFont(contentFont);
-    painter.drawText(xRight, yMain, QString("%1: %2 m\u00B2").arg("Ceiling Surface Area", getLineEditPrint(ui->LECeilingAreaHC)));
-    yMain += lineSpacing;
-
-    painter.drawText(xLeft, yMain, QString("%1: %2 m\u00B2 - %3").arg("North Window Area", getLineEditPrint(ui->LENWindowHC), ui->NorthShadeHC->isChecked() ? "Shaded" : "Unshaded"));
-    painter.setFont(footerFont);
-    painter.drawText(xRight, yMain, QString("   %1 - %2: %3 W/m\u00B2K").arg(ui->CeilingMaterialHC->currentText(), "U-Value", getLineEditPrint(ui->LECeilingMaterialHC)));
-    yMain += lineSpacing;
-
-    painter.setFont(contentFont);
-    painter.drawText(xLeft, yMain, QString("%1: %2 m\u00B2 - %3").arg("East Window Area", getLineEditPrint(ui->LEEWindowHC), ui->EastShadeHC->isChecked() ? "Shaded" : "Unshaded"));
-    painter.drawText(xRight, yMain, QString("%1: %2 m\u00B2").arg("Floor Surface Area", getLineEditPrint(ui->LEFloorAreaHC)));
-    yMain += lineSpacing;
-
-    painter.drawText(xLeft, yMain, QString("%1: %2 m\u00B2 - %3").arg("South Window Area", getLineEditPrint(ui->LESWindowHC), ui->SouthShadeHC->isChecked() ? "Shaded" : "Unshaded"));
-    painter.setFont(footerFont);
-    painter.drawText(xRight, yMain, QString("   %1 - %2: %3 W/m\u00B2K").arg(ui->FloorMaterialHC->currentText(), "U-Value", getLineEditPrint(ui->LEFloorMaterialHC)));
-    yMain += lineSpacing;
-
-    painter.setFont(contentFont);
-    painter.drawText(xLeft, yMain, QString("%1: %2 m\u00B2 - %3").arg("West Window Area", getLineEditPrint(ui->LEWWindowHC), ui->WestShadeHC->isChecked() ? "Shaded" : "Unshaded"));
-    yMain += lineSpacing;
-
-    painter.setFont(headerFont);
-    painter.drawText(xRight, yMain, QString("Temperature Conditions"));
-    yMain += lineSpacing;
-
-    painter.drawText(xLeft, yMain, QString("Internal Heat Loads"));
-    painter.setFont(contentFont);
-    painter.drawText(xRight, yMain, QString("%1: %2 \u00B0C").arg("Target Room Temperature", getLineEditPrint(ui->LETargetTempHC)));
-    yMain += lineSpacing;
-
-    painter.drawText(xLeft, yMain, QString("%1: %2").arg("No. of Occupants", getLineEditPrint(ui->LEOccupantsHC)));
-    painter.drawText(xRight, yMain, QString("%1: %2 \u00B0C").arg("External Temperature", getLineEditPrint(ui->LEExternalTempHC)));
-    yMain += lineSpacing;
-
-    painter.drawText(xLeft, yMain, QString("%1: %2 W").arg("Equipment Load", getLineEditPrint(ui->LEEquipmentHC)));
-    yMain += lineSpacing;
-
-    painter.drawText(xLeft, yMain, QString("%1: %2 W - %3").arg("Lighting Load", getLineEditPrint(ui->LELightHC), ui->LightTypeHC->currentText()));
-    painter.setFont(headerFont);
-    painter.drawText(xRight, yMain, QString("Air Flow Information"));
-    yMain += lineSpacing;
-
-    painter.setFont(contentFont);
-    painter.drawText(xRight, yMain, QString("%1: %2").arg("Ventilation (Desired) Air Replacements per Hour", getLineEditPrint(ui->LEVentilationHC)));
-    yMain += lineSpacing;
-
-    painter.drawText(xRight, yMain, QString("%1: %2").arg("Leakage (Undesired) Air Replacements per Hour", getLineEditPrint(ui->LELeakageHC)));
-    yMain += lineSpacing;
-
-    yMain += lineSpacing;
-
-    painter.setFont(headerFont);
-    painter.drawText(xLeft, yMain, QString("Cooling Unit Settings"));
-    painter.drawText(xRight, yMain, QString("Heating Unit Settings"));
-    yMain += lineSpacing;
-
-    painter.setFont(contentFont);
-    painter.drawText(xLeft, yMain, QString("%1: %2 %").arg("Peak Cooling Adjustment", getLineEditPrint(ui->LECoolAdjustHC)));
-    painter.drawText(xRight, yMain, QString("%1: %2 %").arg("Peak Heating Adjustment", getLineEditPrint(ui->LEHeatAdjustHC)));
-    yMain += lineSpacing;
-
-    painter.drawText(xLeft, yMain, QString("%1: %2 W").arg("Cooling Capacity per Unit", getLineEditPrint(ui->LECoolCapacityHC)));
-    painter.drawText(xRight, yMain, QString("%1: %2 W").arg("Heating Capacity per Unit", getLineEditPrint(ui->LEHeatCapacityHC)));
-
-
-    yLeft = yMain;
-    yRight = yMain;
-
-    yLeft += sectionSpacing;
-
-    // --- Cooling Summary (Left Column) ---
-    painter.setFont(headerFont);
-    painter.drawText(xLeft, yLeft, "Cooling Summary");
-    yLeft += lineSpacing;
-
-    writeLine(xLeft, yLeft, "Room Heat Load (W)", ui->OutRoomHeatHC->toPlainText());
-    writeLine(xLeft, yLeft, "Window Heat Gain (W)", ui->OutWindowHeatHC->toPlainText());
-    writeLine(xLeft, yLeft, "Occupant Heat Gain (W)", ui->OutOccupantHeatHC->toPlainText());
-    writeLine(xLeft, yLeft, "Equipment Load (W)", ui->OutEquipmentHeatHC->toPlainText());
-    writeLine(xLeft, yLeft, "Lighting Load (W)", ui->OutLightHeatHC->toPlainText());
-    writeLine(xLeft, yLeft, "Total Cooling Load (W)", ui->OutTotalCoolHC->toPlainText());
-    writeLine(xLeft, yLeft, "Peak Cooling Load (W)", ui->OutPeakCoolHC->toPlainText());
-    writeLine(xLeft, yLeft, "Cooling Units Required", ui->OutCoolUnitsHC->toPlainText());
-
-    yRight += sectionSpacing;
-
-    // --- Heating Summary (Right Column) ---
-    painter.setFont(headerFont);
-    painter.drawText(xRight, yRight, "Heating Summary");
-    yRight += lineSpacing;
-
-    writeLine(xRight, yRight, "Wall Heat Loss (W)", ui->OutWallLossHC->toPlainText());
-    writeLine(xRight, yRight, "Window Heat Loss (W)", ui->OutWindowLossHC->toPlainText());
-    writeLine(xRight, yRight, "Ceiling Heat Loss (W)", ui->OutCeilingLossHC->toPlainText());
-    writeLine(xRight, yRight, "Floor Heat Loss (W)", ui->OutFloorLossHC->toPlainText());
-    writeLine(xRight, yRight, "Transmission Loss (W)", ui->OutTransmissionLossHC->toPlainText());
-    writeLine(xRight, yRight, "Ventilation Loss (W)", ui->OutVentilationLossHC->toPlainText());
-    writeLine(xRight, yRight, "Leakage Loss (W)", ui->OutLeakageLossHC->toPlainText());
-    writeLine(xRight, yRight, "Total Heating Load (W)", ui->OutTotalHeatHC->toPlainText());
-    writeLine(xRight, yRight, "Peak Heating Load (W)", ui->OutPeakHeatHC->toPlainText());
-    writeLine(xRight, yRight, "Heating Units Required", ui->OutHeatUnitsHC->toPlainText());
-
-    // --- Footer ---
-    painter.setFont(footerFont);
-    QString footer1 = "This BTU calculated based on the information gathered during the onsite survey of your property and is intended as a guide to help determine the";
-    QString footer2 = "appropriate air conditioning capacity for the space in question. Accurate sizing ensures optimal comfort, energy efficiency, and performance.";
-    QString footer3 = "For more tailored recommendations or to discuss your requirements further, please contact our team.";
-    QString footer5 = "KAM Engineering Ltd | Generated on: " + QDate::currentDate().toString("dd MMMM yyyy");
-
-    QRect footer1Rect(0, pageHeight - margin / 2 - 4*lineSpacing, pageWidth, lineSpacing);
-    painter.drawText(footer1Rect, Qt::AlignHCenter | Qt::AlignVCenter, footer1);
+void MainWindow::redoScenarioEdit()
+{
+    ensureCatalog();
+    if (dirty)
+        updatePlaceholders();
+    showScenarioStep(scenarios.redo());
+}
 
-    QRect footer2Rect(0, pageHeight - margin / 2 - 3*lineSpacing, pageWidth, lineSpacing);
-    painter.drawText(footer2Rect, Qt::AlignHCenter | Qt::AlignVCenter, footer2);
-
-    QRect footer3Rect(0, pageHeight - margin / 2 - 2*lineSpacing, pageWidth, lineSpacing);
-    painter.drawText(footer3Rect, Qt::AlignHCenter | Qt::AlignVCenter, footer3);
-
-    QRect footer5Rect(0, pageHeight - margin / 2 - 20, pageWidth, lineSpacing);
-    painter.drawText(footer5Rect, Qt::AlignHCenter | Qt::AlignVCenter, footer5);
+// Undo and redo can change any scenario; the one changed is put in the form
+void MainWindow::showScenarioStep(int changed)
+{
+    if (changed < 0)
+        return;
+    scenarios.setActive(size_t(changed));
+    showActiveScenario();
+}
+
+void MainWindow::openDiagnostics()
+{
+    DiagnosticsDialog *dialog = new DiagnosticsDialog(this);
+    dialog->setAttribute(Qt::WA_DeleteOnClose);
+    dialog->show();
+}
+
+// Renders on a worker thread so the window stays responsive; the progress dialog cancels it
+void MainWindow::startReport(const QString &fileName, const QList<RoomReport> &rooms, bool withSummary)
+{
+    reportCancelled = std::make_shared<std::atomic<bool>>(false);
+    reportThread = new QThread(this);
+    ReportWriter *writer = new ReportWriter(fileName, rooms, withSummary, reportCancelled);
+    writer->moveToThread(reportThread);
+
+    const int pages = ReportWriter::pageCount(rooms.size(), withSummary);
+    reportProgress = new QProgressDialog(tr("Rendering report..."), tr("Cancel"), 0, pages, this);
+    reportProgress->setWindowModality(Qt::WindowModal);
+    reportProgress->setMinimumDuration(500);
+    reportProgress->setValue(0);
+
+    std::shared_ptr<std::atomic<bool>> cancelled = reportCancelled;
+    connect(reportProgress, &QProgressDialog::canceled, this, [cancelled]() {
+        cancelled->store(true);
+    });
+    connect(reportThread, &QThread::started, writer, &ReportWriter::render);
+    connect(writer, &ReportWriter::progress, reportProgress, &QProgressDialog::setValue);
+    connect(writer, &ReportWriter::finished, this, [this](bool completed, const QString &fileName) {
+        reportThread->quit();
+        reportThread->wait();
+        reportThread->deleteLater();
+        reportThread = nullptr;
+        reportProgress->deleteLater();
+        reportProgress = nullptr;
+        if (completed)
+            statusBar()->showMessage(tr("Saved %1").arg(fileName), 5000);
+    });
+    connect(reportThread, &QThread::finished, writer, &QObject::deleteLater);
+
+    reportThread->start();
+}
+
+// Cancels a running report and waits for the worker to stop
+void MainWindow::stopReport()
+{
+    if (!reportThread)
+        return;
 
-    painter.end();
+    reportCancelled->store(true);
+    reportThread->quit();
+    reportThread->wait();
 }
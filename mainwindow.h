@@ -2,14 +2,34 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
+#include <QHash>
+#include <QList>
+#include <QPointer>
 #include <qlineedit.h>
 
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "catalog.h"
+#include "loadcalc.h"
+#include "projectfile.h"
+#include "reportwriter.h"
+#include "scenario.h"
+
 QT_BEGIN_NAMESPACE
 namespace Ui {
 class MainWindow;
 }
 QT_END_NAMESPACE
 
+class QComboBox;
+class QProgressDialog;
+class ScenarioDialog;
+class QTextBrowser;
+class QThread;
+class QTimer;
+
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
@@ -18,16 +38,83 @@ public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
 
+signals:
+    // Once after the form has first been painted and its catalog has been loaded
+    void interactive();
+
+protected:
+    bool event(QEvent *event) override;
+
 private slots:
     double getLineEditValue(QLineEdit* lineEdit);
-    QString getLineEditPrint(QLineEdit* lineEdit);
     void updatePlaceholders();
     void savePDF();
+    void addRoomToReport();
+    void saveProjectReport();
+    void openSweep();
+    void openDiagnostics();
+    void openProject();
+    void saveProjectAs();
+    void exportProject();
+    void autosave();
+    void finishStartup();
+    void openScenarios();
+    void showActiveScenario();
+    void undoScenarioEdit();
+    void redoScenarioEdit();
 
 private:
+    // Results that need refreshing after an input change
+    enum DirtyFlag {
+        CoolingDirty = 0x1,
+        HeatingDirty = 0x2,
+        AreaGuessDirty = 0x4,
+        MaterialGuessDirty = 0x8,
+        AllDirty = 0xf
+    };
+
+    RoomInput readRoomInput();
+    std::optional<double> optionalValue(QLineEdit *lineEdit);
+    double materialValue(QComboBox *combo, QLineEdit *lineEdit);
+    OutputUnit outputUnit(QComboBox *combo);
+    void markDirty(int flags);
+    void showOutput(QTextBrowser *box, double value);
+    void loadCatalog();
+    void ensureCatalog();
+    RoomReport currentRoomReport(const QString &name);
+    void showRoom(const RoomReport &room);
+    ScenarioState currentScenarioState();
+    void recordScenarioEdit();
+    void showScenarioStep(int changed);
+    void updateProjectLabel();
+    bool saveProject();
+    QString askPdfFileName(const QString &title, const QString &defaultName);
+    void startReport(const QString &fileName, const QList<RoomReport> &rooms, bool withSummary);
+    void stopReport();
+
     Ui::MainWindow *ui;
-    const double WattBTU = 3.412; // 1 watt = 3.412 BTU/hr
-    const double AirDensity = 1.225; // kg/m^3
-    const double AirSpecificHeat = 1.006; // J/kg.K
+    Catalog catalog;
+    // The window is shown before the catalog is loaded into the combos
+    bool catalogReady = false;
+    bool painted = false;
+    uint64_t shownAt = 0;
+    QTimer *recalcTimer;
+    RoomInput roomInput;
+    RoomLoads roomLoads;
+    int dirty = 0;
+    QHash<QTextBrowser *, QString> shownOutputs;
+
+    // Rooms of the project, appended to its file (once it has one) shortly after each change,
+    // and the report being rendered (if any)
+    ProjectFile project;
+    QTimer *autosaveTimer;
+    QThread *reportThread = nullptr;
+    QProgressDialog *reportProgress = nullptr;
+    std::shared_ptr<std::atomic<bool>> reportCancelled;
+
+    // The form edits the active scenario; the others are kept for comparison
+    ScenarioSet scenarios;
+    QPointer<ScenarioDialog> scenarioDialog;
+    bool showingScenario = false;
 };
 #endif // MAINWINDOW_H
@@ -0,0 +1,37 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file. An empty file maps to size() == 0.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    // How the mapping will be read, passed on to the system's read-ahead
+    enum class Access { Sequential, Random };
+
+    bool open(const std::string &path, Access access = Access::Sequential);
+    void close();
+
+    bool isOpen() const { return opened; }
+    const char *data() const { return view; }
+    size_t size() const { return length; }
+
+private:
+    const char *view = nullptr;
+    size_t length = 0;
+    bool opened = false;
+#ifdef _WIN32
+    void *file = nullptr;
+    void *mapping = nullptr;
+#endif
+};
+
+#endif // MAPPEDFILE_H
@@ -0,0 +1,216 @@
+#include "monitor.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "batchio.h"
+
+namespace {
+
+const std::string_view SiteRoom = "*";
+
+std::string_view trimmedField(std::string_view text)
+{
+    while (!text.empty() && (text.front() == ' ' || text.front() == '\t'))
+        text.remove_prefix(1);
+    while (!text.empty() && (text.back() == ' ' || text.back() == '\t' || text.back() == '\r'))
+        text.remove_suffix(1);
+    return text;
+}
+
+// An empty temperature is NaN, anything else has to be a number
+bool parseTemperature(std::string_view text, double &value)
+{
+    if (trimmedField(text).empty()) {
+        value = std::nan("");
+        return true;
+    }
+    return parseNumber(text, value);
+}
+
+double capacityWatt(double capacity, OutputUnit unit)
+{
+    return unit == OutputUnit::BTU ? toWatts(BtuPerHour(capacity)).value() : capacity;
+}
+
+} // namespace
+
+
+bool parseReading(std::string_view line, Reading &reading)
+{
+    std::string_view fields[4];
+    for (int i = 0; i < 4; ++i) {
+        const size_t comma = i < 3 ? line.find(',') : std::string_view::npos;
+        if (i < 3 && comma == std::string_view::npos)
+            return false;
+        fields[i] = line.substr(0, comma);
+        line.remove_prefix(i < 3 ? comma + 1 : line.size());
+    }
+    reading.room = trimmedField(fields[1]);
+    return !reading.room.empty() && parseNumber(fields[0], reading.time) && std::isfinite(reading.time)
+           && parseTemperature(fields[2], reading.indoor) && parseTemperature(fields[3], reading.outdoor);
+}
+
+LoadMonitor::LoadMonitor(const std::vector<std::string> &ids, const std::vector<RoomInput> &inputs,
+                         const MonitorOptions &options)
+    : ids(ids)
+    , options(options)
+    , siteOutdoor(std::nan(""))
+{
+    this->options.historyMinutes = std::max<size_t>(1, options.historyMinutes);
+    this->options.sustainMinutes = std::max(1, options.sustainMinutes);
+    index.reserve(this->ids.size());
+    for (size_t i = 0; i < this->ids.size(); ++i)
+        index.emplace(this->ids[i], i);
+
+    rooms.resize(inputs.size());
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        const RoomInput &input = inputs[i];
+        const RoomLoads design = calculateRoomLoads(input);
+        const int coolingUnits = options.coolingUnits >= 0 ? options.coolingUnits : design.coolingUnits;
+        const int heatingUnits = options.heatingUnits >= 0 ? options.heatingUnits : design.heatingUnits;
+        Room &room = rooms[i];
+        room.lossPerKelvin = heatLossCoefficients(input).total();
+        room.gainsWatt = design.windowCoolWatt + design.occupantWatt + design.equipmentWatt + design.lightingWatt;
+        room.heatingCapacity = heatingUnits * capacityWatt(input.heatCapacity, input.heatUnits);
+        room.coolingCapacity = coolingUnits * capacityWatt(input.coolCapacity, input.coolUnits);
+        room.indoor = room.outdoor = std::nan("");
+    }
+    ring.resize(rooms.size() * this->options.historyMinutes);
+}
+
+ReadingStatus LoadMonitor::add(const Reading &reading, std::vector<MonitorEvent> &events)
+{
+    const int64_t minute = static_cast<int64_t>(std::floor(reading.time / 60));
+    if (reading.room == SiteRoom) {
+        if (!std::isnan(reading.outdoor))
+            siteOutdoor = reading.outdoor;
+    } else {
+        auto found = index.find(reading.room);
+        if (found == index.end()) {
+            ++counters.unknownRoom;
+            return ReadingStatus::UnknownRoom;
+        }
+        Room &room = rooms[found->second];
+        if (minute < room.minute) {
+            ++counters.late;
+            return ReadingStatus::Late;
+        }
+        if (minute != room.minute) {
+            if (room.samples)
+                completeMinute(found->second, events);
+            room.minute = minute;
+        }
+
+        if (!std::isnan(reading.indoor))
+            room.indoor = reading.indoor;
+        if (!std::isnan(reading.outdoor))
+            room.outdoor = reading.outdoor;
+        const double outdoor = std::isnan(room.outdoor) ? siteOutdoor : room.outdoor;
+        if (!std::isnan(room.indoor) && !std::isnan(outdoor)) {
+            room.indoorSum += room.indoor;
+            room.outdoorSum += outdoor;
+            ++room.samples;
+        }
+    }
+    ++counters.readings;
+
+    // Sensors that went quiet have their minute completed once the rest are a minute past it
+    if (minute > latestMinute) {
+        latestMinute = minute;
+        completeStale(minute - 1, events);
+    }
+    return ReadingStatus::Ok;
+}
+
+void LoadMonitor::finish(std::vector<MonitorEvent> &events)
+{
+    completeStale(INT64_MAX, events);
+}
+
+void LoadMonitor::completeStale(int64_t minute, std::vector<MonitorEvent> &events)
+{
+    for (size_t i = 0; i < rooms.size(); ++i) {
+        if (rooms[i].samples && rooms[i].minute < minute)
+            completeMinute(i, events);
+    }
+}
+
+void LoadMonitor::completeMinute(size_t index, std::vector<MonitorEvent> &events)
+{
+    Room &room = rooms[index];
+    const double indoor = room.indoorSum / room.samples;
+    const double outdoor = room.outdoorSum / room.samples;
+    const double envelope = room.lossPerKelvin * (indoor - outdoor);
+    const Minute completed = {
+        float(indoor), float(outdoor), float(std::max(0.0, envelope)), float(std::max(0.0, room.gainsWatt - envelope)),
+    };
+
+    // The ring's sums are kept as minutes come and go, and summed afresh each time round
+    const size_t history = options.historyMinutes;
+    Minute *slots = &ring[index * history];
+    if (room.ringSize == history) {
+        room.heatingSum -= slots[room.ringHead].heatingWatt;
+        room.coolingSum -= slots[room.ringHead].coolingWatt;
+    } else {
+        ++room.ringSize;
+    }
+    slots[room.ringHead] = completed;
+    room.heatingSum += completed.heatingWatt;
+    room.coolingSum += completed.coolingWatt;
+    room.ringHead = (room.ringHead + 1) % history;
+    if (room.ringHead == 0) {
+        room.heatingSum = room.coolingSum = 0;
+        for (size_t i = 0; i < room.ringSize; ++i) {
+            room.heatingSum += slots[i].heatingWatt;
+            room.coolingSum += slots[i].coolingWatt;
+        }
+    }
+
+    const bool over = completed.heatingWatt > room.heatingCapacity || completed.coolingWatt > room.coolingCapacity;
+    ++room.minutes;
+    room.overMinutes += over;
+    room.peakHeating = std::max(room.peakHeating, double(completed.heatingWatt));
+    room.peakCooling = std::max(room.peakCooling, double(completed.coolingWatt));
+    ++counters.minutes;
+    if (over == room.over) {
+        room.run = 0;
+    } else if (++room.run >= options.sustainMinutes) {
+        room.over = over;
+        room.run = 0;
+        counters.roomsOver += over ? 1 : -1;
+        events.push_back({index, double(room.minute) * 60, over, indoor, outdoor, completed.heatingWatt,
+                          completed.coolingWatt});
+    }
+
+    // Later readings for this minute are late
+    ++room.minute;
+    room.indoorSum = room.outdoorSum = 0;
+    room.samples = 0;
+}
+
+MonitorRoomSummary LoadMonitor::summary(size_t index) const
+{
+    const Room &room = rooms[index];
+    MonitorRoomSummary summary;
+    summary.minutes = room.minutes;
+    summary.overMinutes = room.overMinutes;
+    summary.peakHeatingWatt = room.peakHeating;
+    summary.peakCoolingWatt = room.peakCooling;
+    if (room.ringSize) {
+        summary.recentHeatingWatt = room.heatingSum / room.ringSize;
+        summary.recentCoolingWatt = room.coolingSum / room.ringSize;
+    }
+    summary.over = room.over;
+    return summary;
+}
+
+size_t LoadMonitor::memoryBytes() const
+{
+    size_t bytes = rooms.capacity() * sizeof(Room) + ring.capacity() * sizeof(Minute);
+    bytes += ids.capacity() * sizeof(std::string) + index.bucket_count() * sizeof(void *);
+    bytes += index.size() * (sizeof(std::pair<std::string_view, size_t>) + 2 * sizeof(void *));
+    for (const std::string &id : ids)
+        bytes += id.capacity() > 15 ? id.capacity() + 1 : 0;
+    return bytes;
+}
@@ -0,0 +1,158 @@
+#ifndef MONITOR_H
+#define MONITOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "loadcalc.h"
+
+// Installed rooms checked against measured temperatures. Readings of indoor
+// and outdoor temperature arrive in time order from any number of sensors and
+// are averaged per room per minute. Each completed minute gets the load the
+// room's own envelope would need at those temperatures:
+//
+//   heating = (transmission + ventilation + leakage per kelvin) x (indoor - outdoor)
+//   cooling = window, occupant, equipment and lighting gains - the same envelope term
+//
+// which is calculateHeatingLoads() at the measured temperatures, and the cooling
+// gains of calculateCoolingLoads() with the rule-of-thumb room term replaced by
+// the envelope at the measured ones. Design margins are not applied, as in the
+// annual simulation. A room is flagged once either load has been above the
+// installed capacity (units x unit capacity) for a run of minutes.
+//
+// Every room keeps its last minutes in a fixed-size ring, all allocated up
+// front, so memory depends on the number of rooms and not on how long the
+// monitor runs. A reading costs a hash lookup and a few additions.
+
+struct MonitorOptions
+{
+    size_t historyMinutes = 60; // minutes kept per room
+    int sustainMinutes = 3; // minutes in a row over (or back under) capacity to change a flag
+    int coolingUnits = -1; // installed units; -1 uses what each room was sized for
+    int heatingUnits = -1;
+};
+
+// One line of sensor data: <unix time>,<room>,<indoor C>,<outdoor C>. Either
+// temperature may be empty and keeps the room's last value. The room * is the
+// site's outdoor sensor, used by rooms that have no outdoor reading of their own.
+struct Reading
+{
+    double time = 0; // seconds
+    std::string_view room;
+    double indoor = 0; // NaN when not given
+    double outdoor = 0;
+};
+
+// False for lines that are not a reading, such as a header
+bool parseReading(std::string_view line, Reading &reading);
+
+enum class ReadingStatus { Ok, UnknownRoom, Late };
+
+// A room's flag being raised or cleared at the end of a minute
+struct MonitorEvent
+{
+    size_t room;
+    double time; // start of the minute, seconds
+    bool over;
+    double indoor;
+    double outdoor;
+    double heatingWatt;
+    double coolingWatt;
+};
+
+struct MonitorRoomSummary
+{
+    uint64_t minutes = 0;
+    uint64_t overMinutes = 0;
+    double peakHeatingWatt = 0;
+    double peakCoolingWatt = 0;
+    double recentHeatingWatt = 0; // mean over the minutes still in the ring
+    double recentCoolingWatt = 0;
+    bool over = false;
+};
+
+struct MonitorStats
+{
+    uint64_t readings = 0;
+    uint64_t unknownRoom = 0;
+    uint64_t late = 0; // for a minute already completed
+    uint64_t minutes = 0;
+    size_t roomsOver = 0;
+};
+
+class LoadMonitor
+{
+public:
+    LoadMonitor(const std::vector<std::string> &ids, const std::vector<RoomInput> &rooms,
+                const MonitorOptions &options = MonitorOptions());
+
+    LoadMonitor(const LoadMonitor &) = delete;
+    LoadMonitor &operator=(const LoadMonitor &) = delete;
+
+    // Minutes the reading completes are appended to events when they change a flag
+    ReadingStatus add(const Reading &reading, std::vector<MonitorEvent> &events);
+
+    // Completes every room's current minute, at the end of the input
+    void finish(std::vector<MonitorEvent> &events);
+
+    size_t roomCount() const { return rooms.size(); }
+    const std::string &id(size_t room) const { return ids[room]; }
+    double heatingCapacityWatt(size_t room) const { return rooms[room].heatingCapacity; }
+    double coolingCapacityWatt(size_t room) const { return rooms[room].coolingCapacity; }
+    MonitorRoomSummary summary(size_t room) const;
+    const MonitorStats &stats() const { return counters; }
+
+    // Everything allocated for the rooms and their rings
+    size_t memoryBytes() const;
+
+private:
+    struct Minute
+    {
+        float indoor;
+        float outdoor;
+        float heatingWatt;
+        float coolingWatt;
+    };
+
+    struct Room
+    {
+        double lossPerKelvin; // W/K
+        double gainsWatt; // cooling gains that do not depend on temperature
+        double heatingCapacity; // W
+        double coolingCapacity;
+        int64_t minute = INT64_MIN; // the minute being averaged, INT64_MIN when none
+        double indoorSum = 0;
+        double outdoorSum = 0;
+        uint32_t samples = 0;
+        double indoor; // the last values read, NaN until the first
+        double outdoor;
+        size_t ringHead = 0; // next slot to write
+        size_t ringSize = 0;
+        double heatingSum = 0; // over the ring
+        double coolingSum = 0;
+        int run = 0; // minutes in a row on the other side of the capacity from the flag
+        bool over = false;
+        uint64_t minutes = 0;
+        uint64_t overMinutes = 0;
+        double peakHeating = 0;
+        double peakCooling = 0;
+    };
+
+    void completeMinute(size_t index, std::vector<MonitorEvent> &events);
+    void completeStale(int64_t minute, std::vector<MonitorEvent> &events);
+
+    std::vector<std::string> ids;
+    std::unordered_map<std::string_view, size_t> index;
+    std::vector<Room> rooms;
+    std::vector<Minute> ring; // historyMinutes per room, room after room
+    MonitorOptions options;
+    double siteOutdoor;
+    int64_t latestMinute = INT64_MIN;
+    MonitorStats counters;
+};
+
+#endif // MONITOR_H
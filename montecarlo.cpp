@@ -0,0 +1,325 @@
+#include "montecarlo.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "batchio.h"
+#include "loadbatch.h"
+#include "workpool.h"
+
+namespace {
+
+// Samples drawn and calculated together
+const size_t SampleBlock = 4096;
+
+const double Pi = 3.14159265358979323846;
+
+// Inputs that are a batch column as they are; anything else (sizes, windows,
+// areas, flags) changes derived columns and goes through RoomBatch::append()
+const struct
+{
+    const char *name;
+    RoomBatch::Column column;
+} directColumns[] = {
+    {"occupants", RoomBatch::Occupants},
+    {"equipmentWatt", RoomBatch::EquipmentWatt},
+    {"lightingWatt", RoomBatch::LightingWatt},
+    {"lightingMult", RoomBatch::LightingMult},
+    {"coolAdjust", RoomBatch::CoolAdjust},
+    {"coolCapacity", RoomBatch::CoolCapacity},
+    {"wallU", RoomBatch::WallU},
+    {"windowU", RoomBatch::WindowU},
+    {"ceilingU", RoomBatch::CeilingU},
+    {"floorU", RoomBatch::FloorU},
+    {"targetTemp", RoomBatch::TargetTemp},
+    {"externalTemp", RoomBatch::ExternalTemp},
+    {"ventilationAch", RoomBatch::VentilationAch},
+    {"leakageAch", RoomBatch::LeakageAch},
+    {"heatAdjust", RoomBatch::HeatAdjust},
+    {"heatCapacity", RoomBatch::HeatCapacity},
+};
+
+int directColumn(int field)
+{
+    const char *name = roomFieldName(field);
+    for (const auto &entry : directColumns) {
+        if (name && std::strcmp(name, entry.name) == 0)
+            return entry.column;
+    }
+    return -1;
+}
+
+// Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3"),
+// run on this many counters side by side so the rounds vectorise
+const size_t PhiloxLanes = 8;
+
+inline double toUniform(uint32_t high, uint32_t low)
+{
+    return double((uint64_t(high) << 21) ^ (low >> 11)) * (1.0 / 9007199254740992.0);
+}
+
+double standardNormal(double u1, double u2)
+{
+    return std::sqrt(-2 * std::log(1 - u1)) * std::cos(2 * Pi * u2);
+}
+
+void sample(const InputDistribution &distribution, const double *u1, const double *u2, size_t count, double *out)
+{
+    const double a = distribution.a;
+    const double b = distribution.b;
+    const double c = distribution.c;
+    switch (distribution.kind) {
+    case DistributionKind::Uniform:
+        for (size_t i = 0; i < count; ++i)
+            out[i] = a + (b - a) * u1[i];
+        break;
+    case DistributionKind::Normal: {
+        const double lowest = roomFieldLowest(distribution.field);
+        for (size_t i = 0; i < count; ++i)
+            out[i] = std::max(lowest, a + b * standardNormal(u1[i], u2[i]));
+        break;
+    }
+    case DistributionKind::Triangular: {
+        const double split = b > a ? (c - a) / (b - a) : 0;
+        for (size_t i = 0; i < count; ++i) {
+            const double u = u1[i];
+            out[i] = u < split ? a + std::sqrt(u * (b - a) * (c - a))
+                               : b - std::sqrt((1 - u) * (b - a) * (b - c));
+        }
+        break;
+    }
+    case DistributionKind::LogNormal: {
+        const double sigma = std::log(b);
+        for (size_t i = 0; i < count; ++i)
+            out[i] = a * std::exp(sigma * standardNormal(u1[i], u2[i]));
+        break;
+    }
+    }
+}
+
+// Nearest rank percentile; values is partially reordered
+float percentile(std::vector<float> &values, size_t from, double fraction, size_t &rank)
+{
+    rank = std::max<size_t>(from, static_cast<size_t>(std::ceil(fraction * values.size())) - 1);
+    std::nth_element(values.begin() + from, values.begin() + rank, values.end());
+    return values[rank];
+}
+
+struct SampleScratch
+{
+    RoomBatch rooms;
+    LoadBatch loads;
+    std::vector<double> u1 = std::vector<double>(SampleBlock);
+    std::vector<double> u2 = std::vector<double>(SampleBlock);
+    std::vector<std::vector<double>> values;
+};
+
+} // namespace
+
+
+bool parseDistribution(std::string_view spec, InputDistribution &distribution, std::string &error)
+{
+    distribution = InputDistribution();
+    const size_t equals = spec.find('=');
+    const size_t open = spec.find('(');
+    if (equals == std::string_view::npos || open == std::string_view::npos || open < equals || spec.back() != ')') {
+        error = "expected field=distribution(parameters) in \"" + std::string(spec) + "\"";
+        return false;
+    }
+    distribution.field = roomFieldIndex(spec.substr(0, equals));
+    if (distribution.field < 0) {
+        error = "unknown field \"" + std::string(spec.substr(0, equals)) + "\"";
+        return false;
+    }
+
+    const std::string_view name = spec.substr(equals + 1, open - equals - 1);
+    std::string_view list = spec.substr(open + 1, spec.size() - open - 2);
+    std::vector<double> parameters;
+    while (!list.empty() || parameters.empty()) {
+        const size_t comma = list.find(',');
+        double value;
+        if (!parseNumber(list.substr(0, comma), value)) {
+            error = "bad parameters in \"" + std::string(spec) + "\"";
+            return false;
+        }
+        parameters.push_back(value);
+        list = comma == std::string_view::npos ? std::string_view() : list.substr(comma + 1);
+    }
+
+    size_t expected = 2;
+    if (name == "uniform") {
+        distribution.kind = DistributionKind::Uniform;
+    } else if (name == "normal") {
+        distribution.kind = DistributionKind::Normal;
+    } else if (name == "triangular") {
+        distribution.kind = DistributionKind::Triangular;
+        expected = 3;
+    } else if (name == "lognormal") {
+        distribution.kind = DistributionKind::LogNormal;
+    } else {
+        error = "unknown distribution \"" + std::string(name) + "\"";
+        return false;
+    }
+    if (parameters.size() != expected) {
+        error = "\"" + std::string(name) + "\" takes " + std::to_string(expected) + " parameters";
+        return false;
+    }
+
+    distribution.a = parameters[0];
+    distribution.b = parameters[expected - 1];
+    if (expected == 3)
+        distribution.c = parameters[1];
+    if (distribution.kind == DistributionKind::Normal && distribution.b < 0)
+        error = "standard deviation must not be negative";
+    else if (distribution.kind == DistributionKind::LogNormal && (distribution.a <= 0 || distribution.b < 1))
+        error = "lognormal needs a positive median and a geometric sd of at least 1";
+    else if (distribution.kind == DistributionKind::Triangular
+             && !(distribution.a <= distribution.c && distribution.c <= distribution.b))
+        error = "triangular needs low <= mode <= high";
+    else
+        return true;
+    return false;
+}
+
+void philoxUniforms(uint64_t seed, uint64_t room, uint32_t stream, uint64_t first, size_t count,
+                    double *u1, double *u2)
+{
+    for (size_t base = 0; base < count; base += PhiloxLanes) {
+        uint32_t c0[PhiloxLanes], c1[PhiloxLanes], c2[PhiloxLanes], c3[PhiloxLanes];
+        for (size_t l = 0; l < PhiloxLanes; ++l) {
+            const uint64_t index = first + base + l;
+            c0[l] = uint32_t(index);
+            c1[l] = uint32_t(index >> 32);
+            c2[l] = uint32_t(room);
+            c3[l] = stream;
+        }
+
+        uint32_t key0 = uint32_t(seed);
+        uint32_t key1 = uint32_t(seed >> 32);
+        for (int round = 0; round < 10; ++round) {
+            for (size_t l = 0; l < PhiloxLanes; ++l) {
+                const uint64_t product0 = uint64_t(0xD2511F53) * c0[l];
+                const uint64_t product1 = uint64_t(0xCD9E8D57) * c2[l];
+                const uint32_t next0 = uint32_t(product1 >> 32) ^ c1[l] ^ key0;
+                const uint32_t next2 = uint32_t(product0 >> 32) ^ c3[l] ^ key1;
+                c1[l] = uint32_t(product1);
+                c3[l] = uint32_t(product0);
+                c0[l] = next0;
+                c2[l] = next2;
+            }
+            key0 += 0x9E3779B9;
+            key1 += 0xBB67AE85;
+        }
+
+        const size_t lanes = std::min(PhiloxLanes, count - base);
+        for (size_t l = 0; l < lanes; ++l) {
+            u1[base + l] = toUniform(c0[l], c1[l]);
+            u2[base + l] = toUniform(c2[l], c3[l]);
+        }
+    }
+}
+
+MonteCarloResult runMonteCarlo(const RoomInput &input, uint64_t room,
+                               const std::vector<InputDistribution> &distributions,
+                               const MonteCarloOptions &options)
+{
+    MonteCarloResult result;
+    const RoomLoads design = calculateRoomLoads(input);
+    result.coolingUnits = options.coolingUnits >= 0 ? options.coolingUnits : design.coolingUnits;
+    result.heatingUnits = options.heatingUnits >= 0 ? options.heatingUnits : design.heatingUnits;
+    result.samples = options.samples;
+    if (options.samples == 0)
+        return result;
+
+    std::vector<int> columns;
+    bool allDirect = true;
+    for (const InputDistribution &distribution : distributions) {
+        columns.push_back(directColumn(distribution.field));
+        allDirect = allDirect && columns.back() >= 0;
+    }
+    RoomBatch baseRow;
+    baseRow.append(input);
+
+    std::vector<float> peakCooling(options.samples);
+    std::vector<float> peakHeating(options.samples);
+    std::atomic<uint64_t> coolingCovered{0};
+    std::atomic<uint64_t> heatingCovered{0};
+    std::atomic<bool> cancelled{false};
+
+    auto runBlock = [&](uint64_t first, size_t count) {
+        thread_local SampleScratch scratch;
+        scratch.values.resize(distributions.size());
+        for (size_t d = 0; d < distributions.size(); ++d) {
+            scratch.values[d].resize(SampleBlock);
+            philoxUniforms(options.seed, room, uint32_t(d), first, count, scratch.u1.data(), scratch.u2.data());
+            sample(distributions[d], scratch.u1.data(), scratch.u2.data(), count, scratch.values[d].data());
+        }
+
+        RoomBatch &rooms = scratch.rooms;
+        rooms.clear();
+        if (allDirect) {
+            for (int c = 0; c < RoomBatch::ColumnCount; ++c)
+                rooms.columns[c].assign(count, baseRow.columns[c][0]);
+            for (size_t d = 0; d < distributions.size(); ++d)
+                std::copy(scratch.values[d].begin(), scratch.values[d].begin() + count, rooms.columns[columns[d]].begin());
+        } else {
+            RoomInput sampled = input;
+            for (size_t i = 0; i < count; ++i) {
+                for (size_t d = 0; d < distributions.size(); ++d)
+                    setRoomFieldValue(sampled, distributions[d].field, scratch.values[d][i]);
+                rooms.append(sampled);
+            }
+        }
+
+        LoadBatch &loads = scratch.loads;
+        calculateLoadBatch(rooms, loads);
+        uint64_t coolingOk = 0;
+        uint64_t heatingOk = 0;
+        for (size_t i = 0; i < count; ++i) {
+            peakCooling[first + i] = static_cast<float>(loads.columns[LoadBatch::PeakCoolingWatt][i]);
+            peakHeating[first + i] = static_cast<float>(loads.columns[LoadBatch::PeakHeatingWatt][i]);
+            coolingOk += loads.coolingUnits[i] <= result.coolingUnits;
+            heatingOk += loads.heatingUnits[i] <= result.heatingUnits;
+        }
+        coolingCovered.fetch_add(coolingOk, std::memory_order_relaxed);
+        heatingCovered.fetch_add(heatingOk, std::memory_order_relaxed);
+    };
+
+    {
+        WorkPool pool(options.threads);
+        // A few large tasks per thread; each works through its range a block at a time
+        const uint64_t blocks = (options.samples + SampleBlock - 1) / SampleBlock;
+        const uint64_t tasks = std::min<uint64_t>(blocks, 4 * uint64_t(pool.threadCount()));
+        for (uint64_t task = 0; task < tasks; ++task) {
+            pool.submit([&, task]() {
+                for (uint64_t block = blocks * task / tasks; block < blocks * (task + 1) / tasks; ++block) {
+                    if (options.cancel && options.cancel->load(std::memory_order_relaxed)) {
+                        cancelled.store(true);
+                        return;
+                    }
+                    const uint64_t first = block * SampleBlock;
+                    runBlock(first, static_cast<size_t>(std::min<uint64_t>(SampleBlock, options.samples - first)));
+                }
+            });
+        }
+        pool.wait();
+    }
+    if (cancelled.load()) {
+        result.cancelled = true;
+        return result;
+    }
+
+    const double samples = double(options.samples);
+    result.coolingUnitsEnough = coolingCovered.load() / samples;
+    result.heatingUnitsEnough = heatingCovered.load() / samples;
+
+    size_t rank = 0;
+    result.peakCoolingP50 = percentile(peakCooling, 0, 0.50, rank);
+    result.peakCoolingP90 = percentile(peakCooling, rank, 0.90, rank);
+    result.peakCoolingP99 = percentile(peakCooling, rank, 0.99, rank);
+    result.peakHeatingP50 = percentile(peakHeating, 0, 0.50, rank);
+    result.peakHeatingP90 = percentile(peakHeating, rank, 0.90, rank);
+    result.peakHeatingP99 = percentile(peakHeating, rank, 0.99, rank);
+    return result;
+}
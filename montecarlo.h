@@ -0,0 +1,69 @@
+#ifndef MONTECARLO_H
+#define MONTECARLO_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "loadcalc.h"
+
+// Monte Carlo uncertainty analysis: inputs that were guessed on survey are
+// drawn from distributions and every sample goes through the batch kernel.
+// Random numbers come from a counter-based generator (Philox4x32-10) keyed by
+// the seed, so sample i of room r gets the same inputs whatever the thread count.
+
+enum class DistributionKind { Uniform, Normal, Triangular, LogNormal };
+
+struct InputDistribution
+{
+    int field = -1; // roomFieldIndex()
+    DistributionKind kind = DistributionKind::Uniform;
+    double a = 0; // uniform/triangular: low,  normal: mean,  lognormal: median
+    double b = 0; // uniform/triangular: high, normal: standard deviation, lognormal: geometric sd
+    double c = 0; // triangular: most likely
+};
+
+// Parses "field=uniform(low,high)", "field=normal(mean,sd)",
+// "field=triangular(low,mode,high)" or "field=lognormal(median,gsd)".
+// Normal samples are clamped at the field's roomFieldLowest(), so a size or a
+// load never goes negative while a temperature can.
+bool parseDistribution(std::string_view spec, InputDistribution &distribution, std::string &error);
+
+struct MonteCarloOptions
+{
+    uint64_t samples = 1000000;
+    uint64_t seed = 1;
+    unsigned threads = 0; // 0 = one per hardware thread
+    int coolingUnits = -1; // unit counts to test; -1 uses the room's own design count
+    int heatingUnits = -1;
+    const std::atomic<bool> *cancel = nullptr;
+};
+
+struct MonteCarloResult
+{
+    double peakCoolingP50 = 0;
+    double peakCoolingP90 = 0;
+    double peakCoolingP99 = 0;
+    double peakHeatingP50 = 0;
+    double peakHeatingP90 = 0;
+    double peakHeatingP99 = 0;
+    int coolingUnits = 0;          // count tested
+    double coolingUnitsEnough = 0; // share of samples it covers
+    int heatingUnits = 0;
+    double heatingUnitsEnough = 0;
+    uint64_t samples = 0;
+    bool cancelled = false;
+};
+
+// room is the room's position in the input, mixed into the random stream so rooms differ
+MonteCarloResult runMonteCarlo(const RoomInput &input, uint64_t room,
+                               const std::vector<InputDistribution> &distributions,
+                               const MonteCarloOptions &options);
+
+// Uniform doubles in [0, 1) for samples [first, first + count) of one stream
+void philoxUniforms(uint64_t seed, uint64_t room, uint32_t stream, uint64_t first, size_t count,
+                    double *u1, double *u2);
+
+#endif // MONTECARLO_H
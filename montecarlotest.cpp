@@ -0,0 +1,79 @@
+// Checks of the Monte Carlo percentiles against the deterministic design loads.
+//
+//   btucalc_montecarlo_test
+//
+// Prints each failed check and exits with status 1 if there was any.
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "loadcalc.h"
+#include "montecarlo.h"
+
+namespace {
+
+int failures = 0;
+
+void check(bool ok, const char *what, double got, double want)
+{
+    if (ok)
+        return;
+    std::printf("%s: got %.2f, expected %.2f\n", what, got, want);
+    ++failures;
+}
+
+bool near(double got, double want, double tolerance)
+{
+    return std::fabs(got - want) <= tolerance * std::fabs(want);
+}
+
+MonteCarloResult run(const RoomInput &room, const char *spec)
+{
+    InputDistribution distribution;
+    std::string error;
+    if (!parseDistribution(spec, distribution, error)) {
+        std::printf("%s: %s\n", spec, error.c_str());
+        ++failures;
+        return MonteCarloResult();
+    }
+    MonteCarloOptions options;
+    options.samples = 200000;
+    options.seed = 7;
+    return runMonteCarlo(room, 0, {distribution}, options);
+}
+
+} // namespace
+
+
+int main()
+{
+    RoomInput room;
+    room.length = 5;
+    room.width = 4;
+    room.height = 2.4;
+    room.southWindowArea = 2;
+    room.occupants = 2;
+    room.externalTemp = -3;
+    const RoomLoads design = calculateRoomLoads(room);
+
+    // Heating is linear in the outside temperature, so the median draw gives the design peak.
+    // Temperatures below zero must not be clamped to it.
+    const MonteCarloResult frost = run(room, "externalTemp=normal(-3,1)");
+    check(near(frost.peakHeatingP50, design.peakHeatingWatt, 0.002), "externalTemp=normal(-3,1) heating P50",
+          frost.peakHeatingP50, design.peakHeatingWatt);
+    check(frost.peakHeatingP90 > frost.peakHeatingP50, "externalTemp=normal(-3,1) heating P90 above P50",
+          frost.peakHeatingP90, frost.peakHeatingP50);
+
+    // Draws of a size or a load stop at zero; occupants of normal(0,1) are zero half the time
+    const MonteCarloResult empty = run(room, "occupants=normal(0,1)");
+    RoomInput nobody = room;
+    nobody.occupants = 0;
+    const double unoccupied = calculateRoomLoads(nobody).peakCoolingWatt;
+    check(near(empty.peakCoolingP50, unoccupied, 0.002), "occupants=normal(0,1) cooling P50", empty.peakCoolingP50,
+          unoccupied);
+
+    std::printf("%d failed checks\n", failures);
+    return failures ? 1 : 0;
+}
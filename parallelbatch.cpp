@@ -0,0 +1,245 @@
+#include "parallelbatch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "arrowwriter.h"
+#include "loadbatch.h"
+#include "resultcache.h"
+#include "workpool.h"
+
+namespace {
+
+// Rooms calculated per kernel call; small enough that the columns stay in cache
+const size_t KernelChunkSize = 4096;
+
+struct Block
+{
+    size_t sequence = 0;
+    size_t firstLine = 0;
+    std::vector<char> text;
+    std::string output;
+    std::vector<std::string> ids; // with loads, in place of output for columnar results
+    std::vector<RoomLoads> loads;
+    std::string errors;
+    size_t rooms = 0;
+    size_t rejected = 0;
+};
+
+// Per worker scratch space, reused across blocks
+struct WorkerScratch
+{
+    std::vector<RoomRecord> records = std::vector<RoomRecord>(KernelChunkSize);
+    size_t used = 0; // records in the chunk; only those not cached are in rooms
+    RoomBatch rooms;
+    LoadBatch loads;
+
+    // With a cache, per record
+    std::vector<RoomKey> keys = std::vector<RoomKey>(KernelChunkSize);
+    std::vector<char> cached = std::vector<char>(KernelChunkSize);
+    std::vector<RoomLoads> cachedLoads = std::vector<RoomLoads>(KernelChunkSize);
+    std::vector<std::string> cachedColumns = std::vector<std::string>(KernelChunkSize);
+    std::string columns;
+};
+
+void processBlock(Block &block, RecordParser parser, const ResultFormatter &formatter, ResultCache *cache,
+                  bool columnar)
+{
+    thread_local WorkerScratch scratch;
+    block.output.clear();
+    block.ids.clear();
+    block.loads.clear();
+    block.errors.clear();
+    block.rooms = 0;
+    block.rejected = 0;
+
+    auto calculateChunk = [&]() {
+        calculateLoadBatch(scratch.rooms, scratch.loads);
+        if (columnar) {
+            size_t calculated = 0;
+            for (size_t i = 0; i < scratch.used; ++i) {
+                const bool cached = cache && scratch.cached[i];
+                block.loads.push_back(cached ? scratch.cachedLoads[i] : scratch.loads.at(calculated++));
+                if (cache && !cached)
+                    cache->insert(scratch.keys[i], block.loads.back());
+                block.ids.push_back(std::move(scratch.records[i].id));
+            }
+        } else if (!cache) {
+            for (size_t i = 0; i < scratch.used; ++i)
+                formatter.append(block.output, scratch.records[i], scratch.loads.at(i));
+        } else {
+            size_t calculated = 0;
+            for (size_t i = 0; i < scratch.used; ++i) {
+                formatter.appendId(block.output, scratch.records[i]);
+                if (scratch.cached[i] && !scratch.cachedColumns[i].empty()) {
+                    block.output += scratch.cachedColumns[i];
+                    continue;
+                }
+                const RoomLoads loads = scratch.cached[i] ? scratch.cachedLoads[i] : scratch.loads.at(calculated++);
+                scratch.columns.clear();
+                formatter.appendColumns(scratch.columns, loads);
+                block.output += scratch.columns;
+                cache->insert(scratch.keys[i], loads, formatter.recordFormat(), &scratch.columns);
+            }
+        }
+        block.rooms += scratch.used;
+        scratch.used = 0;
+        scratch.rooms.clear();
+    };
+
+    char *cursor = block.text.data();
+    char *end = cursor + block.text.size();
+    char *lineBegin = nullptr;
+    char *lineEnd = nullptr;
+    size_t line = block.firstLine;
+    for (; takeLine(cursor, end, lineBegin, lineEnd); ++line) {
+        if (std::all_of(lineBegin, lineEnd, [](char c) { return c == ' ' || c == '\t'; }))
+            continue;
+        const size_t slot = scratch.used;
+        RoomRecord &record = scratch.records[slot];
+        if (parser.parse(lineBegin, lineEnd, line, record) != ReadStatus::Ok) {
+            block.errors += parser.error();
+            block.errors += '\n';
+            ++block.rejected;
+            continue;
+        }
+        if (cache) {
+            scratch.keys[slot] = roomKey(record.input);
+            scratch.cached[slot] = cache->find(scratch.keys[slot], scratch.cachedLoads[slot], formatter.recordFormat(),
+                                               columnar ? nullptr : &scratch.cachedColumns[slot]);
+        }
+        if (!cache || !scratch.cached[slot])
+            scratch.rooms.append(record.input);
+        if (++scratch.used == KernelChunkSize)
+            calculateChunk();
+    }
+    calculateChunk();
+}
+
+} // namespace
+
+
+BatchRunStats runParallelBatch(std::FILE *input, RecordFormat inputFormat,
+                               std::FILE *output, RecordFormat outputFormat,
+                               const BatchRunOptions &options, std::FILE *errors)
+{
+    BatchRunStats stats;
+    const auto started = std::chrono::steady_clock::now();
+
+    RecordReader reader(input, inputFormat);
+    if (!reader.readHeader()) {
+        std::fprintf(errors, "%s\n", reader.error().c_str());
+        stats.ok = false;
+        return stats;
+    }
+    const RecordParser parser = reader.recordParser();
+    const ResultFormatter formatter(outputFormat);
+
+    WorkPool pool(options.threads);
+    stats.threads = pool.threadCount();
+    const size_t maxInFlight = options.maxBlocksInFlight ? options.maxBlocksInFlight : 4 * size_t(stats.threads);
+
+    std::mutex mutex;
+    std::condition_variable blockFinished;
+    std::condition_variable blockWritten;
+    std::map<size_t, std::unique_ptr<Block>> finished;
+    std::vector<std::unique_ptr<Block>> spare;
+    size_t inFlight = 0;
+    size_t blocksRead = 0;
+    bool readingDone = false;
+
+    std::thread writer([&]() {
+        std::string header;
+        if (!options.arrow)
+            formatter.appendHeader(header);
+        if (std::fwrite(header.data(), 1, header.size(), output) != header.size())
+            stats.writeFailed = true;
+
+        for (size_t next = 0;; ++next) {
+            std::unique_ptr<Block> block;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                blockFinished.wait(lock, [&] { return finished.count(next) || (readingDone && next == blocksRead); });
+                if (!finished.count(next))
+                    break;
+                block = std::move(finished[next]);
+                finished.erase(next);
+            }
+
+            if (std::fwrite(block->output.data(), 1, block->output.size(), output) != block->output.size())
+                stats.writeFailed = true;
+            for (size_t i = 0; i < block->ids.size(); ++i)
+                options.arrow->write(block->ids[i], block->loads[i]);
+            if (!block->errors.empty())
+                std::fputs(block->errors.c_str(), errors);
+            stats.rooms += block->rooms;
+            stats.rejected += block->rejected;
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                --inFlight;
+                spare.push_back(std::move(block));
+            }
+            blockWritten.notify_one();
+        }
+        if (std::fflush(output) != 0)
+            stats.writeFailed = true;
+    });
+
+    while (true) {
+        std::unique_ptr<Block> block;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            blockWritten.wait(lock, [&] { return inFlight < maxInFlight; });
+            if (!spare.empty()) {
+                block = std::move(spare.back());
+                spare.pop_back();
+            }
+        }
+        if (!block)
+            block = std::make_unique<Block>();
+
+        if (!reader.readBlock(block->text, block->firstLine, options.blockBytes))
+            break;
+
+        block->sequence = blocksRead;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++blocksRead;
+            ++inFlight;
+            stats.peakBlocksInFlight = std::max(stats.peakBlocksInFlight, inFlight);
+        }
+
+        Block *raw = block.release();
+        pool.submit([&, raw]() {
+            std::unique_ptr<Block> owned(raw);
+            processBlock(*owned, parser, formatter, options.cache, options.arrow != nullptr);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                finished[owned->sequence] = std::move(owned);
+            }
+            blockFinished.notify_one();
+        });
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        readingDone = true;
+    }
+    blockFinished.notify_one();
+    writer.join();
+    pool.wait();
+
+    stats.blocks = blocksRead;
+    stats.steals = pool.stealCount();
+    stats.inputBytes = reader.bytesRead();
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    return stats;
+}
@@ -0,0 +1,45 @@
+#ifndef PARALLELBATCH_H
+#define PARALLELBATCH_H
+
+#include <cstdint>
+#include <cstdio>
+
+#include "batchio.h"
+
+class ArrowResultWriter;
+class ResultCache;
+
+// Multi-threaded batch run: the input is cut into blocks of whole lines, workers
+// parse, calculate and format each block, and a writer thread emits the blocks
+// in input order. Only a fixed number of blocks may be in flight, so a slow
+// output stream holds back reading instead of buffering without limit.
+
+struct BatchRunOptions
+{
+    unsigned threads = 0; // 0 = one per hardware thread
+    size_t blockBytes = 1 << 20;
+    size_t maxBlocksInFlight = 0; // 0 = four per thread
+    ResultCache *cache = nullptr; // rooms found here are neither calculated nor formatted again
+    ArrowResultWriter *arrow = nullptr; // takes the results as columns instead of output; finished by the caller
+};
+
+struct BatchRunStats
+{
+    bool ok = true;
+    bool writeFailed = false;
+    unsigned threads = 0;
+    size_t rooms = 0;
+    size_t rejected = 0;
+    size_t blocks = 0;
+    size_t steals = 0;
+    size_t peakBlocksInFlight = 0;
+    uint64_t inputBytes = 0;
+    double seconds = 0;
+};
+
+// Parse errors are written to errors, in input order
+BatchRunStats runParallelBatch(std::FILE *input, RecordFormat inputFormat,
+                               std::FILE *output, RecordFormat outputFormat,
+                               const BatchRunOptions &options, std::FILE *errors);
+
+#endif // PARALLELBATCH_H
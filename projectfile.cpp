@@ -0,0 +1,727 @@
+#include "projectfile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iterator>
+#include <system_error>
+#include <unordered_map>
+
+namespace {
+
+const char FileMagic[4] = {'B', 'T', 'U', 'P'};
+const uint32_t FileVersion = 1;
+const size_t WriteBlock = 1 << 20;
+
+enum class RecordType : uint32_t { Room = 1, Removed, Index, Trailer, Draft, Last = Draft };
+
+struct FileHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t reserved;
+};
+
+// Starts every record; payloads are padded to a multiple of 8 bytes
+struct RecordHeader
+{
+    uint32_t type;
+    uint32_t length; // payload bytes
+    uint32_t checksum; // FNV-1a of the payload
+    uint32_t reserved;
+};
+
+// Payload of the record that ends every complete save
+struct TrailerData
+{
+    uint64_t indexOffset; // 0 until an index has been written
+    uint64_t indexEnd; // records from here on are newer than the index
+    uint64_t staleBytes;
+    uint64_t rooms;
+};
+
+// Index payload: this, followed by an IndexEntry per room in project order
+struct IndexData
+{
+    uint64_t rooms;
+    uint64_t draftOffset;
+    uint64_t nextKey;
+    uint64_t reserved;
+};
+
+struct IndexEntry
+{
+    uint64_t key;
+    uint64_t offset;
+};
+
+const uint64_t TrailerBytes = sizeof(RecordHeader) + sizeof(TrailerData);
+const uint64_t RemovedBytes = sizeof(RecordHeader) + sizeof(uint64_t);
+const uint64_t NoOffset = ~uint64_t(0);
+
+// Stored results, in RoomLoads order; the unit counts are stored as doubles too
+const struct
+{
+    double RoomLoads::*value;
+    int RoomLoads::*count;
+} loadFields[] = {
+    {&RoomLoads::roomWatt, nullptr},
+    {&RoomLoads::windowCoolWatt, nullptr},
+    {&RoomLoads::occupantWatt, nullptr},
+    {&RoomLoads::equipmentWatt, nullptr},
+    {&RoomLoads::lightingWatt, nullptr},
+    {&RoomLoads::totalCoolingWatt, nullptr},
+    {&RoomLoads::peakCoolingWatt, nullptr},
+    {nullptr, &RoomLoads::coolingUnits},
+    {&RoomLoads::wallWatt, nullptr},
+    {&RoomLoads::windowHeatWatt, nullptr},
+    {&RoomLoads::ceilingWatt, nullptr},
+    {&RoomLoads::floorWatt, nullptr},
+    {&RoomLoads::transmissionWatt, nullptr},
+    {&RoomLoads::ventWatt, nullptr},
+    {&RoomLoads::leakWatt, nullptr},
+    {&RoomLoads::totalHeatingWatt, nullptr},
+    {&RoomLoads::peakHeatingWatt, nullptr},
+    {nullptr, &RoomLoads::heatingUnits},
+};
+
+std::string ProjectRoom::*const roomTexts[] = {
+    &ProjectRoom::name,
+    &ProjectRoom::lightType,
+    &ProjectRoom::wallMaterial,
+    &ProjectRoom::windowMaterial,
+    &ProjectRoom::ceilingMaterial,
+    &ProjectRoom::floorMaterial,
+};
+
+// Export column names of roomTexts after the id
+const char *const selectionNames[] = {"lightType", "wallMaterial", "windowMaterial", "ceilingMaterial", "floorMaterial"};
+
+uint32_t checksum(const char *data, size_t size)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; ++i)
+        hash = (hash ^ uint8_t(data[i])) * 16777619u;
+    return hash;
+}
+
+// Input fields are stored in batchio's field order, so new fields go at the end
+int roomFieldTotal()
+{
+    static const int total = [] {
+        int count = 0;
+        while (roomFieldName(count))
+            ++count;
+        return count;
+    }();
+    return total;
+}
+
+template <class T>
+void appendValue(std::vector<char> &out, const T &value)
+{
+    const char *bytes = reinterpret_cast<const char *>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+size_t beginRecord(std::vector<char> &out)
+{
+    const size_t start = out.size();
+    out.resize(start + sizeof(RecordHeader));
+    return start;
+}
+
+void endRecord(std::vector<char> &out, size_t start, RecordType type)
+{
+    out.resize(start + (out.size() - start + 7) / 8 * 8);
+    RecordHeader header = {};
+    header.type = uint32_t(type);
+    header.length = uint32_t(out.size() - start - sizeof(RecordHeader));
+    header.checksum = checksum(out.data() + start + sizeof(RecordHeader), header.length);
+    std::memcpy(out.data() + start, &header, sizeof(header));
+}
+
+void appendRoom(std::vector<char> &out, RecordType type, uint64_t key, const ProjectRoom &room)
+{
+    const size_t start = beginRecord(out);
+    appendValue(out, key);
+    appendValue(out, uint32_t(roomFieldTotal()));
+    appendValue(out, uint32_t(std::size(loadFields)));
+    for (int field = 0; field < roomFieldTotal(); ++field)
+        appendValue(out, roomFieldValue(room.input, field));
+    for (const auto &field : loadFields)
+        appendValue(out, field.value ? room.loads.*field.value : double(room.loads.*field.count));
+    for (std::string ProjectRoom::*text : roomTexts) {
+        appendValue(out, uint32_t((room.*text).size()));
+        out.insert(out.end(), (room.*text).begin(), (room.*text).end());
+    }
+    endRecord(out, start, type);
+}
+
+void appendTrailer(std::vector<char> &out, const TrailerData &trailer)
+{
+    const size_t start = beginRecord(out);
+    appendValue(out, trailer);
+    endRecord(out, start, RecordType::Trailer);
+}
+
+// Bounds checked reads from a record payload
+struct PayloadReader
+{
+    const char *p;
+    const char *end;
+    bool ok = true;
+
+    template <class T>
+    T read()
+    {
+        T value{};
+        if (size_t(end - p) < sizeof(T)) {
+            ok = false;
+            return value;
+        }
+        std::memcpy(&value, p, sizeof(T));
+        p += sizeof(T);
+        return value;
+    }
+
+    std::string readString()
+    {
+        const uint32_t length = read<uint32_t>();
+        if (!ok || size_t(end - p) < length) {
+            ok = false;
+            return std::string();
+        }
+        std::string text(p, length);
+        p += length;
+        return text;
+    }
+};
+
+bool decodeRoom(const char *payload, size_t length, ProjectRoom &room)
+{
+    PayloadReader reader{payload, payload + length};
+    reader.read<uint64_t>(); // key
+    const uint32_t fields = reader.read<uint32_t>();
+    const uint32_t results = reader.read<uint32_t>();
+    room = ProjectRoom();
+    for (uint32_t field = 0; field < fields && reader.ok; ++field) {
+        // Unset areas are NaN; fields from a newer version are skipped
+        const double value = reader.read<double>();
+        if (!std::isnan(value))
+            setRoomFieldValue(room.input, int(field), value);
+    }
+    for (uint32_t result = 0; result < results && reader.ok; ++result) {
+        const double value = reader.read<double>();
+        if (result >= std::size(loadFields))
+            continue;
+        if (loadFields[result].value)
+            room.loads.*loadFields[result].value = value;
+        else
+            room.loads.*loadFields[result].count = int(value);
+    }
+    for (std::string ProjectRoom::*text : roomTexts)
+        room.*text = reader.readString();
+    return reader.ok;
+}
+
+// Reads the header of a record lying wholly before end and checks its payload
+bool readRecord(const char *base, uint64_t end, uint64_t offset, RecordHeader &header)
+{
+    if (offset < sizeof(FileHeader) || offset > end || end - offset < sizeof(RecordHeader))
+        return false;
+    std::memcpy(&header, base + offset, sizeof(header));
+    return header.type >= uint32_t(RecordType::Room) && header.type <= uint32_t(RecordType::Last)
+           && header.length % 8 == 0 && header.length <= end - offset - sizeof(RecordHeader)
+           && checksum(base + offset + sizeof(RecordHeader), header.length) == header.checksum;
+}
+
+uint64_t recordKey(const char *base, uint64_t offset)
+{
+    uint64_t key;
+    std::memcpy(&key, base + offset + sizeof(RecordHeader), sizeof(key));
+    return key;
+}
+
+} // namespace
+
+
+bool ProjectFile::open(const std::string &path, std::string &error)
+{
+    clear();
+    auto fail = [&](const char *reason) {
+        clear();
+        error = path + ": " + reason;
+        return false;
+    };
+
+    // Rooms are decoded as they are asked for, in no particular order
+    if (!mapped.open(path, MappedFile::Access::Random))
+        return fail("cannot open the file");
+    const char *base = mapped.data();
+    const uint64_t size = mapped.size();
+    FileHeader header;
+    if (size < sizeof(header))
+        return fail("not a project file");
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, FileMagic, sizeof(FileMagic)) != 0)
+        return fail("not a project file");
+    if (header.version != FileVersion)
+        return fail("saved by an unsupported version");
+
+    // A complete save ends with a trailer. After a crash part way through a save,
+    // walk the log for the last complete one; the next save overwrites the rest.
+    auto isTrailer = [](const RecordHeader &record) {
+        return record.type == uint32_t(RecordType::Trailer) && record.length == sizeof(TrailerData);
+    };
+    RecordHeader record;
+    uint64_t trailerOffset = 0;
+    if (size >= sizeof(FileHeader) + TrailerBytes && readRecord(base, size, size - TrailerBytes, record)
+        && isTrailer(record)) {
+        trailerOffset = size - TrailerBytes;
+    } else {
+        for (uint64_t offset = sizeof(FileHeader); readRecord(base, size, offset, record);
+             offset += sizeof(RecordHeader) + record.length) {
+            if (isTrailer(record))
+                trailerOffset = offset;
+        }
+        if (!trailerOffset)
+            return fail("no complete save in the file");
+    }
+    TrailerData trailer;
+    std::memcpy(&trailer, base + trailerOffset + sizeof(RecordHeader), sizeof(trailer));
+    fileEnd = trailerOffset + TrailerBytes;
+    indexOffset = trailer.indexOffset;
+    indexEnd = trailer.indexEnd;
+    stale = trailer.staleBytes;
+
+    if (indexOffset) {
+        if (!readRecord(base, fileEnd, indexOffset, record) || record.type != uint32_t(RecordType::Index)
+            || record.length < sizeof(IndexData))
+            return fail("the room index is damaged");
+        IndexData index;
+        const char *payload = base + indexOffset + sizeof(RecordHeader);
+        std::memcpy(&index, payload, sizeof(index));
+        if ((record.length - sizeof(IndexData)) / sizeof(IndexEntry) < index.rooms)
+            return fail("the room index is damaged");
+        entries.resize(index.rooms);
+        for (uint64_t i = 0; i < index.rooms; ++i) {
+            IndexEntry entry;
+            std::memcpy(&entry, payload + sizeof(IndexData) + i * sizeof(IndexEntry), sizeof(entry));
+            entries[i] = {entry.key, entry.offset, -1};
+        }
+        draftOffset = index.draftOffset;
+        nextKey = index.nextKey;
+    }
+
+    // Records saved since the index replace or remove what it lists
+    std::unordered_map<uint64_t, size_t> positions;
+    bool positionsBuilt = false;
+    bool removedAny = false;
+    for (uint64_t offset = indexEnd ? indexEnd : sizeof(FileHeader); offset < trailerOffset;
+         offset += sizeof(RecordHeader) + record.length) {
+        if (!readRecord(base, trailerOffset, offset, record))
+            return fail("a saved room is damaged");
+        const RecordType type = RecordType(record.type);
+        if (type == RecordType::Trailer || type == RecordType::Index)
+            continue;
+        if (record.length < sizeof(uint64_t))
+            return fail("a saved room is damaged");
+        ++tailRecords;
+        if (type == RecordType::Draft) {
+            draftOffset = offset;
+            continue;
+        }
+        if (!positionsBuilt) {
+            positions.reserve(entries.size());
+            for (size_t i = 0; i < entries.size(); ++i)
+                positions.emplace(entries[i].key, i);
+            positionsBuilt = true;
+        }
+        const uint64_t key = recordKey(base, offset);
+        auto found = positions.find(key);
+        if (type == RecordType::Room) {
+            if (found != positions.end()) {
+                entries[found->second].offset = offset;
+            } else {
+                positions.emplace(key, entries.size());
+                entries.push_back({key, offset, -1});
+            }
+            nextKey = std::max(nextKey, key + 1);
+            ++openTail;
+        } else if (found != positions.end()) {
+            entries[found->second].offset = NoOffset;
+            positions.erase(found);
+            removedAny = true;
+        }
+    }
+    if (removedAny) {
+        entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                     [](const Entry &entry) { return entry.offset == NoOffset; }),
+                      entries.end());
+    }
+
+    filePath = path;
+    return true;
+}
+
+void ProjectFile::clear()
+{
+    filePath.clear();
+    mapped.close();
+    entries.clear();
+    pendingRooms.clear();
+    removedKeys.clear();
+    pendingDraft = ProjectRoom();
+    draftPending = false;
+    draftOffset = 0;
+    nextKey = 1;
+    fileEnd = 0;
+    indexOffset = 0;
+    indexEnd = 0;
+    tailRecords = 0;
+    stale = 0;
+    openTail = 0;
+    changed = false;
+}
+
+bool ProjectFile::room(size_t index, ProjectRoom &room) const
+{
+    if (index >= entries.size())
+        return false;
+    const Entry &entry = entries[index];
+    if (entry.pending >= 0) {
+        room = pendingRooms[entry.pending];
+        return true;
+    }
+    return decode(entry.offset, room);
+}
+
+bool ProjectFile::decode(uint64_t offset, ProjectRoom &room) const
+{
+    RecordHeader record;
+    return mapped.isOpen() && readRecord(mapped.data(), fileEnd, offset, record)
+           && (record.type == uint32_t(RecordType::Room) || record.type == uint32_t(RecordType::Draft))
+           && decodeRoom(mapped.data() + offset + sizeof(RecordHeader), record.length, room);
+}
+
+uint64_t ProjectFile::recordBytes(uint64_t offset) const
+{
+    RecordHeader record;
+    if (!offset || !mapped.isOpen() || offset > fileEnd || fileEnd - offset < sizeof(record))
+        return 0;
+    std::memcpy(&record, mapped.data() + offset, sizeof(record));
+    return sizeof(record) + record.length;
+}
+
+void ProjectFile::add(const ProjectRoom &room)
+{
+    entries.push_back({nextKey++, 0, int(pendingRooms.size())});
+    pendingRooms.push_back(room);
+    changed = true;
+}
+
+void ProjectFile::update(size_t index, const ProjectRoom &room)
+{
+    if (index >= entries.size())
+        return;
+    Entry &entry = entries[index];
+    if (entry.pending >= 0) {
+        pendingRooms[entry.pending] = room;
+    } else {
+        entry.pending = int(pendingRooms.size());
+        pendingRooms.push_back(room);
+    }
+    changed = true;
+}
+
+void ProjectFile::remove(size_t index)
+{
+    if (index >= entries.size())
+        return;
+    const Entry &entry = entries[index];
+    if (entry.offset) {
+        removedKeys.push_back(entry.key);
+        stale += recordBytes(entry.offset);
+    }
+    entries.erase(entries.begin() + index);
+    changed = true;
+}
+
+bool ProjectFile::draft(ProjectRoom &room) const
+{
+    if (draftPending) {
+        room = pendingDraft;
+        return true;
+    }
+    return draftOffset && decode(draftOffset, room);
+}
+
+void ProjectFile::setDraft(const ProjectRoom &room)
+{
+    pendingDraft = room;
+    draftPending = true;
+    changed = true;
+}
+
+bool ProjectFile::remap(std::string &error)
+{
+    if (mapped.open(filePath, MappedFile::Access::Random))
+        return true;
+    error = "Cannot reopen " + filePath;
+    return false;
+}
+
+bool ProjectFile::save(std::string &error)
+{
+    if (filePath.empty()) {
+        error = "The project has not been saved to a file yet";
+        return false;
+    }
+    if (!changed)
+        return true;
+
+    // Everything but the live rooms, the draft, the latest index and the final
+    // trailer counts as stale, as saveAs() would leave it out
+    std::vector<char> out;
+    uint64_t newStale = stale + TrailerBytes;
+    uint64_t newTail = tailRecords;
+    std::vector<std::pair<size_t, uint64_t>> moved;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        const Entry &entry = entries[i];
+        if (entry.pending < 0)
+            continue;
+        newStale += recordBytes(entry.offset);
+        moved.emplace_back(i, fileEnd + out.size());
+        appendRoom(out, RecordType::Room, entry.key, pendingRooms[entry.pending]);
+        ++newTail;
+    }
+    for (uint64_t key : removedKeys) {
+        const size_t start = beginRecord(out);
+        appendValue(out, key);
+        endRecord(out, start, RecordType::Removed);
+        newStale += RemovedBytes;
+        ++newTail;
+    }
+    uint64_t newDraft = draftOffset;
+    if (draftPending) {
+        newStale += recordBytes(draftOffset);
+        newDraft = fileEnd + out.size();
+        appendRoom(out, RecordType::Draft, 0, pendingDraft);
+        ++newTail;
+    }
+
+    // A fresh index once the rooms to replay on open would take noticeable time
+    uint64_t newIndex = indexOffset;
+    uint64_t newIndexEnd = indexEnd;
+    if (newTail > std::max<uint64_t>(256, entries.size() / 8)) {
+        newStale += recordBytes(indexOffset);
+        newIndex = fileEnd + out.size();
+        const size_t start = beginRecord(out);
+        appendValue(out, IndexData{entries.size(), newDraft, nextKey, 0});
+        auto next = moved.begin();
+        for (size_t i = 0; i < entries.size(); ++i) {
+            uint64_t offset = entries[i].offset;
+            if (next != moved.end() && next->first == i)
+                offset = (next++)->second;
+            appendValue(out, IndexEntry{entries[i].key, offset});
+        }
+        endRecord(out, start, RecordType::Index);
+        newIndexEnd = fileEnd + out.size();
+        newTail = 0;
+    }
+    appendTrailer(out, TrailerData{newIndex, newIndexEnd, newStale, entries.size()});
+
+    // Appending to a mapped file is not allowed everywhere, so let go of the mapping.
+    // A torn earlier save is cut off first so the log stays contiguous.
+    mapped.close();
+    std::error_code ec;
+    if (std::filesystem::file_size(filePath, ec) > fileEnd && !ec)
+        std::filesystem::resize_file(filePath, fileEnd, ec);
+    std::FILE *file = ec ? nullptr : std::fopen(filePath.c_str(), "ab");
+    bool ok = file && std::fwrite(out.data(), 1, out.size(), file) == out.size();
+    if (file)
+        ok = std::fclose(file) == 0 && ok;
+    if (!ok) {
+        std::filesystem::resize_file(filePath, fileEnd, ec);
+        std::string ignored;
+        remap(ignored);
+        error = "Could not write " + filePath;
+        return false;
+    }
+
+    for (const auto &entry : moved) {
+        entries[entry.first].offset = entry.second;
+        entries[entry.first].pending = -1;
+    }
+    pendingRooms.clear();
+    removedKeys.clear();
+    pendingDraft = ProjectRoom();
+    draftPending = false;
+    draftOffset = newDraft;
+    indexOffset = newIndex;
+    indexEnd = newIndexEnd;
+    tailRecords = newTail;
+    stale = newStale;
+    fileEnd += out.size();
+    changed = false;
+    return remap(error);
+}
+
+bool ProjectFile::saveAs(const std::string &path, std::string &error)
+{
+    // Written to a temporary name first so the old file survives a failure
+    const std::string temporaryPath = path + ".tmp";
+    std::FILE *file = std::fopen(temporaryPath.c_str(), "wb");
+    if (!file) {
+        error = "Cannot create " + temporaryPath;
+        return false;
+    }
+
+    std::vector<char> out;
+    uint64_t written = 0;
+    bool ok = true;
+    auto flush = [&]() {
+        ok = ok && std::fwrite(out.data(), 1, out.size(), file) == out.size();
+        written += out.size();
+        out.clear();
+    };
+
+    FileHeader header = {};
+    std::memcpy(header.magic, FileMagic, sizeof(FileMagic));
+    header.version = FileVersion;
+    appendValue(out, header);
+
+    std::vector<IndexEntry> index(entries.size());
+    ProjectRoom room;
+    for (size_t i = 0; i < entries.size() && ok; ++i) {
+        if (!this->room(i, room)) {
+            error = "Room " + std::to_string(i + 1) + " could not be read";
+            ok = false;
+            break;
+        }
+        index[i] = {entries[i].key, written + out.size()};
+        appendRoom(out, RecordType::Room, entries[i].key, room);
+        if (out.size() >= WriteBlock)
+            flush();
+    }
+    uint64_t newDraft = 0;
+    if (ok && draft(room)) {
+        newDraft = written + out.size();
+        appendRoom(out, RecordType::Draft, 0, room);
+    }
+    const uint64_t newIndex = written + out.size();
+    const size_t start = beginRecord(out);
+    appendValue(out, IndexData{entries.size(), newDraft, nextKey, 0});
+    for (const IndexEntry &entry : index)
+        appendValue(out, entry);
+    endRecord(out, start, RecordType::Index);
+    const uint64_t newIndexEnd = written + out.size();
+    appendTrailer(out, TrailerData{newIndex, newIndexEnd, 0, entries.size()});
+    if (ok)
+        flush();
+    ok = std::fclose(file) == 0 && ok;
+
+    // Windows cannot replace a file that is still mapped
+    std::error_code ec;
+    if (ok) {
+        mapped.close();
+        std::filesystem::rename(temporaryPath, path, ec);
+    }
+    if (!ok || ec) {
+        std::filesystem::remove(temporaryPath, ec);
+        if (error.empty())
+            error = "Could not write " + path;
+        if (!mapped.isOpen() && !filePath.empty()) {
+            std::string ignored;
+            remap(ignored);
+        }
+        return false;
+    }
+
+    for (size_t i = 0; i < entries.size(); ++i) {
+        entries[i].offset = index[i].offset;
+        entries[i].pending = -1;
+    }
+    pendingRooms.clear();
+    removedKeys.clear();
+    pendingDraft = ProjectRoom();
+    draftPending = false;
+    draftOffset = newDraft;
+    indexOffset = newIndex;
+    indexEnd = newIndexEnd;
+    tailRecords = 0;
+    stale = 0;
+    fileEnd = written;
+    filePath = path;
+    changed = false;
+    return remap(error);
+}
+
+bool ProjectFile::exportRooms(std::FILE *file, RecordFormat format, std::string &error) const
+{
+    const bool json = format == RecordFormat::JsonLines;
+    std::string out;
+    auto key = [&](const char *name) {
+        if (json) {
+            out += ",\"";
+            out += name;
+            out += "\":";
+        } else {
+            out += ',';
+        }
+    };
+    bool ok = true;
+    auto flush = [&]() {
+        ok = ok && std::fwrite(out.data(), 1, out.size(), file) == out.size();
+        out.clear();
+    };
+
+    if (!json) {
+        std::vector<const char *> columns;
+        for (int field = 0; roomFieldName(field); ++field)
+            columns.push_back(roomFieldName(field));
+        columns.insert(columns.end(), std::begin(selectionNames), std::end(selectionNames));
+        for (int result = 0; resultFieldName(result); ++result)
+            columns.push_back(resultFieldName(result));
+        out += "id";
+        for (const char *column : columns) {
+            out += ',';
+            out += column;
+        }
+        out += '\n';
+    }
+
+    ProjectRoom room;
+    for (size_t i = 0; i < entries.size() && ok; ++i) {
+        if (!this->room(i, room)) {
+            error = "Room " + std::to_string(i + 1) + " could not be read";
+            return false;
+        }
+        if (json)
+            out += "{\"id\":";
+        appendText(out, format, room.name);
+        for (int field = 0; roomFieldName(field); ++field) {
+            key(roomFieldName(field));
+            appendRoomField(out, format, room.input, field);
+        }
+        for (size_t text = 0; text < std::size(selectionNames); ++text) {
+            key(selectionNames[text]);
+            appendText(out, format, room.*roomTexts[text + 1]);
+        }
+        for (int result = 0; resultFieldName(result); ++result) {
+            key(resultFieldName(result));
+            appendExactNumber(out, format, resultFieldValue(room.loads, result));
+        }
+        out += json ? "}\n" : "\n";
+        if (out.size() >= WriteBlock)
+            flush();
+    }
+    flush();
+    if (!ok || std::fflush(file) != 0) {
+        error = "Could not write the export";
+        return false;
+    }
+    return true;
+}
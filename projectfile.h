@@ -0,0 +1,111 @@
+#ifndef PROJECTFILE_H
+#define PROJECTFILE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "batchio.h"
+#include "loadcalc.h"
+#include "mappedfile.h"
+
+// A survey of rooms with their inputs and results, saved as a binary project
+// file (.btup) that is memory-mapped on open and decoded one room at a time.
+//
+// The file is a log of checksummed records. save() appends only the rooms that
+// changed since the last save, then a small trailer, so its cost follows the
+// edit rather than the size of the project. Now and then save() also appends a
+// full index of room offsets; the trailer points at the latest one, so opening
+// reads that index plus whatever was appended after it. saveAs() writes a fresh
+// file without the records later saves have replaced.
+
+struct ProjectRoom
+{
+    std::string name;
+    RoomInput input;
+    RoomLoads loads;
+    std::string lightType;
+    std::string wallMaterial;
+    std::string windowMaterial;
+    std::string ceilingMaterial;
+    std::string floorMaterial;
+};
+
+class ProjectFile
+{
+public:
+    ProjectFile() = default;
+
+    ProjectFile(const ProjectFile &) = delete;
+    ProjectFile &operator=(const ProjectFile &) = delete;
+
+    // Maps an existing project. Leaves the project empty and unnamed on failure.
+    bool open(const std::string &path, std::string &error);
+
+    // Forgets every room and the file name; the next saveAs() names the project
+    void clear();
+
+    const std::string &path() const { return filePath; }
+    size_t size() const { return entries.size(); }
+
+    // Decodes one room, from memory if it changed since the last save, otherwise from the mapping
+    bool room(size_t index, ProjectRoom &room) const;
+
+    void add(const ProjectRoom &room);
+    void update(size_t index, const ProjectRoom &room);
+    void remove(size_t index);
+
+    // The room that was in the form at the last save, so it can be put back on open
+    bool draft(ProjectRoom &room) const;
+    void setDraft(const ProjectRoom &room);
+
+    bool hasChanges() const { return changed; }
+
+    // Appends the changes since the last save to the file. Fails for an unnamed project.
+    bool save(std::string &error);
+
+    // Writes every room to a new file with a full index and carries on with that file
+    bool saveAs(const std::string &path, std::string &error);
+
+    // Bytes of records that later saves have replaced, which saveAs() would drop
+    uint64_t staleBytes() const { return stale; }
+
+    // Rooms with their inputs, selections and results as CSV or JSON Lines. The
+    // input columns are the --batch ones, so the export can be calculated again.
+    bool exportRooms(std::FILE *file, RecordFormat format, std::string &error) const;
+
+    // Rooms appended after the index the file was opened with
+    size_t appendedOnOpen() const { return openTail; }
+
+private:
+    struct Entry
+    {
+        uint64_t key;
+        uint64_t offset; // of the latest saved record, 0 when never saved
+        int pending; // index into pendingRooms, -1 when unchanged since the last save
+    };
+
+    bool decode(uint64_t offset, ProjectRoom &room) const;
+    uint64_t recordBytes(uint64_t offset) const;
+    bool remap(std::string &error);
+
+    std::string filePath;
+    MappedFile mapped;
+    std::vector<Entry> entries;
+    std::vector<ProjectRoom> pendingRooms;
+    std::vector<uint64_t> removedKeys;
+    ProjectRoom pendingDraft;
+    bool draftPending = false;
+    uint64_t draftOffset = 0;
+    uint64_t nextKey = 1;
+    uint64_t fileEnd = 0; // end of the last complete save; anything after it is a torn write
+    uint64_t indexOffset = 0;
+    uint64_t indexEnd = 0;
+    uint64_t tailRecords = 0; // records appended since the index
+    uint64_t stale = 0;
+    size_t openTail = 0;
+    bool changed = false;
+};
+
+#endif // PROJECTFILE_H
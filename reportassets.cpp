@@ -0,0 +1,96 @@
+#include "reportassets.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QMutexLocker>
+#include <QPainter>
+#include <QResource>
+#include <QTransform>
+
+namespace {
+
+// images.rcc is installed beside the executable, or in the bundle's Resources on macOS
+bool registerImages()
+{
+    const QDir dir(QCoreApplication::applicationDirPath());
+    for (const QString &path : {dir.filePath("images.rcc"), dir.filePath("../Resources/images.rcc")}) {
+        if (QFile::exists(path) && QResource::registerResource(path))
+            return true;
+    }
+    qWarning("Report images (images.rcc) not found; reports are saved without logos");
+    return false;
+}
+
+} // namespace
+
+
+ReportAssets &ReportAssets::instance()
+{
+    static ReportAssets assets;
+    return assets;
+}
+
+ReportAssets::Sources ReportAssets::decodeSources()
+{
+    static const bool registered = registerImages();
+    Sources decoded;
+    if (!registered)
+        return decoded;
+    decoded.logo = QImage(":/Kam logo.jpg");
+    decoded.fgas = QImage(":/REFCOM Certified logo.png");
+    return decoded;
+}
+
+ReportAssets::PageImages ReportAssets::buildPageImages(Sources &sources, const QSize &pageSize, int dpi, int watermarkDpi)
+{
+    if (!sources.logo.isNull() && sources.rotatedLogo.isNull()) {
+        QTransform rotation;
+        rotation.rotate(60);
+        sources.rotatedLogo = sources.logo.transformed(rotation);
+    }
+
+    PageImages images;
+    const int logoHeight = pageSize.height() / 20;
+
+    if (!sources.rotatedLogo.isNull()) {
+        // Pre-fade the watermark onto white so the PDF gets one opaque image
+        // instead of a full page transparency group
+        QSize watermarkSize = pageSize;
+        if (watermarkDpi > 0 && watermarkDpi < dpi)
+            watermarkSize = pageSize * watermarkDpi / dpi;
+        QImage scaled = sources.rotatedLogo.scaled(watermarkSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+
+        images.watermark = QImage(watermarkSize, QImage::Format_RGB32);
+        images.watermark.fill(Qt::white);
+        QPainter painter(&images.watermark);
+        painter.setOpacity(0.2);
+        painter.drawImage(QPoint(0, 0), scaled);
+        painter.end();
+
+        images.cornerLogo = sources.logo.scaledToHeight(logoHeight, Qt::SmoothTransformation);
+    }
+
+    if (!sources.fgas.isNull())
+        images.fgasLogo = sources.fgas.scaledToHeight(logoHeight, Qt::SmoothTransformation);
+
+    return images;
+}
+
+ReportAssets::PageImages ReportAssets::pageImages(const QSize &pageSize, int dpi)
+{
+    QMutexLocker locker(&mutex);
+    if (!sourcesLoaded) {
+        sources = decodeSources();
+        sourcesLoaded = true;
+    }
+
+    const QString key = QString("%1x%2@%3").arg(pageSize.width()).arg(pageSize.height()).arg(dpi);
+    auto cached = pages.constFind(key);
+    if (cached != pages.constEnd())
+        return cached.value();
+
+    const PageImages images = buildPageImages(sources, pageSize, dpi, WatermarkDpi);
+    pages.insert(key, images);
+    return images;
+}
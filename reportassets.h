@@ -0,0 +1,51 @@
+#ifndef REPORTASSETS_H
+#define REPORTASSETS_H
+
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QSize>
+
+// Process-wide cache of the branding images drawn on report pages. Each source
+// image is decoded once, and the rotated watermark and scaled logos are built
+// once per page geometry and reused by every export (from any thread).
+class ReportAssets
+{
+public:
+    struct PageImages
+    {
+        QImage watermark; // already faded onto white, drawn stretched over the whole page
+        QImage cornerLogo;
+        QImage fgasLogo;
+    };
+
+    struct Sources
+    {
+        QImage logo;
+        QImage rotatedLogo; // made by buildPageImages() when missing
+        QImage fgas;
+    };
+
+    // Resolution pageImages() embeds the watermark at; it is faint, so this is plenty
+    static const int WatermarkDpi = 100;
+
+    static ReportAssets &instance();
+
+    PageImages pageImages(const QSize &pageSize, int dpi);
+
+    // The uncached steps behind pageImages(), also timed by the benchmarks:
+    // decoding the images from images.rcc, then rotating, scaling and fading them for a page.
+    // watermarkDpi 0 embeds the watermark at the full page resolution.
+    static Sources decodeSources();
+    static PageImages buildPageImages(Sources &sources, const QSize &pageSize, int dpi, int watermarkDpi);
+
+private:
+    ReportAssets() = default;
+
+    QMutex mutex;
+    bool sourcesLoaded = false;
+    Sources sources;
+    QHash<QString, PageImages> pages;
+};
+
+#endif // REPORTASSETS_H
@@ -0,0 +1,442 @@
+#include "reportwriter.h"
+#include "reportassets.h"
+#include "instrumentation.h"
+
+#include <QDate>
+#include <QFile>
+#include <QPainter>
+#include <QPdfWriter>
+
+#include <algorithm>
+#include <cmath>
+#include <optional>
+
+namespace {
+
+const int SummaryRowsPerPage = 40;
+
+QString number(double value)
+{
+    return QString::number(value, 'f', 2);
+}
+
+struct PageLayout
+{
+    int pageWidth;
+    int pageHeight;
+    int margin = 200;
+    int columnGap = 60;
+    int columnWidth;
+    int lineSpacing = 60;
+    int sectionSpacing = 160;
+
+    // Fonts
+    QFont titleFont = QFont("Arial", 14, QFont::Bold);
+    QFont headerFont = QFont("Arial", 11, QFont::Bold);
+    QFont contentFont = QFont("Arial", 10);
+    QFont footerFont = QFont("Arial", 8);
+
+    explicit PageLayout(const QSize &page)
+        : pageWidth(page.width())
+        , pageHeight(page.height())
+        , columnWidth((pageWidth - 2 * margin - columnGap) / 2)
+    {
+    }
+};
+
+// Branding, title and footer shared by every page
+void drawPageFrame(QPainter &painter, const PageLayout &layout, const ReportAssets::PageImages &images, const QString &title)
+{
+    const int pageWidth = layout.pageWidth;
+    const int pageHeight = layout.pageHeight;
+    const int margin = layout.margin;
+    const int lineSpacing = layout.lineSpacing;
+    const QFont &titleFont = layout.titleFont;
+    const QFont &headerFont = layout.headerFont;
+    const QFont &footerFont = layout.footerFont;
+
+    QPen pen(QColor(102, 46, 145));
+    painter.setPen(pen);
+
+    // Draw background logo and corner logo
+    if (!images.watermark.isNull()) {
+        painter.drawImage(QRect(0, 0, pageWidth, pageHeight), images.watermark);
+        painter.drawImage(QPoint(pageWidth-images.cornerLogo.width(), 0), images.cornerLogo);
+    }
+
+    // Draw F-Gas logo
+    if (!images.fgasLogo.isNull())
+        painter.drawImage(QPoint(0, 0), images.fgasLogo);
+
+
+    // --- Title ---
+    painter.setFont(titleFont);
+    painter.drawText(QRect(margin, margin / 2, pageWidth - 2 * margin, margin),
+                     Qt::AlignHCenter,
+                     title);
+
+    // --- Branding ---
+    int yTop = margin;
+    painter.setFont(headerFont);
+    painter.drawText(QRect(0, yTop, pageWidth, margin),
+                     Qt::AlignHCenter | Qt::AlignTop,
+                     "www.kam-surveys.co.uk | hello@kam-surveys.co.uk");
+
+    // --- Footer ---
+    painter.setFont(footerFont);
+    QString footer1 = "This BTU calculated based on the information gathered during the onsite survey of your property and is intended as a guide to help determine the";
+    QString footer2 = "appropriate air conditioning capacity for the space in question. Accurate sizing ensures optimal comfort, energy efficiency, and performance.";
+    QString footer3 = "For more tailored recommendations or to discuss your requirements further, please contact our team.";
+    QString footer5 = "KAM Engineering Ltd | Generated on: " + QDate::currentDate().toString("dd MMMM yyyy");
+
+    QRect footer1Rect(0, pageHeight - margin / 2 - 4*lineSpacing, pageWidth, lineSpacing);
+    painter.drawText(footer1Rect, Qt::AlignHCenter | Qt::AlignVCenter, footer1);
+
+    QRect footer2Rect(0, pageHeight - margin / 2 - 3*lineSpacing, pageWidth, lineSpacing);
+    painter.drawText(footer2Rect, Qt::AlignHCenter | Qt::AlignVCenter, footer2);
+
+    QRect footer3Rect(0, pageHeight - margin / 2 - 2*lineSpacing, pageWidth, lineSpacing);
+    painter.drawText(footer3Rect, Qt::AlignHCenter | Qt::AlignVCenter, footer3);
+
+    QRect footer5Rect(0, pageHeight - margin / 2 - 20, pageWidth, lineSpacing);
+    painter.drawText(footer5Rect, Qt::AlignHCenter | Qt::AlignVCenter, footer5);
+}
+
+void drawRoomPage(QPainter &painter, const PageLayout &layout, const RoomReport &room)
+{
+    const int pageWidth = layout.pageWidth;
+    const int margin = layout.margin;
+    const int columnGap = layout.columnGap;
+    const int columnWidth = layout.columnWidth;
+    const int lineSpacing = layout.lineSpacing;
+    const int sectionSpacing = layout.sectionSpacing;
+    const QFont &headerFont = layout.headerFont;
+    const QFont &contentFont = layout.contentFont;
+    const QFont &footerFont = layout.footerFont;
+
+    const RoomInput &input = room.input;
+    const RoomLoads &loads = room.loads;
+    const SurfaceAreas areas = resolveSurfaceAreas(input);
+
+    if (!room.name.isEmpty()) {
+        painter.setFont(headerFont);
+        painter.drawText(QRect(0, margin + sectionSpacing / 2, pageWidth, lineSpacing),
+                         Qt::AlignHCenter | Qt::AlignTop, room.name);
+    }
+
+    // --- Initialize Column Coordinates ---
+    const int yTop = margin;
+    int yLeft = yTop + sectionSpacing;
+    int yRight = yTop + sectionSpacing;
+    int yMain = yTop + 1.5 * sectionSpacing;
+    int xLeft = margin;
+    int xRight = margin + columnWidth + columnGap;
+
+    // Lambda for drawing label-value pair
+    auto writeLine = [&](int x, int &y, const QString &label, const QString &value, const QString &string3="", const QString &string4="", bool newLine=true) {
+        painter.setFont(contentFont);
+        painter.drawText(x, y, QString("%1: %2%3%4").arg(label, value, string3, string4));
+        if (newLine) {
+            y += lineSpacing;
+        }
+    };
+
+    painter.setFont(headerFont);
+    painter.drawText(xLeft, yMain, "Room Dimensions");
+    painter.drawText(xRight, yMain, "Surface Information");
+    yMain += lineSpacing;
+
+    painter.setFont(contentFont);
+    painter.drawText(xLeft, yMain, QString("%1: %2 m").arg("Length", number(input.length)));
+    painter.drawText(xRight, yMain, QString("%1: %2 m\u00B2").arg("Wall Surface Area", number(areas.wall)));
+    yMain += lineSpacing;
+
+    painter.setFont(footerFont);
+    painter.drawText(xRight, yMain, QString("   %1 - %2: %3 W/m\u00B2K").arg(room.wallMaterial, "U-Value", number(input.wallU)));
+    painter.setFont(contentFont);
+    painter.drawText(xLeft, yMain, QString("%1: %2 m").arg("Width", number(input.width)));
+    yMain += lineSpacing;
+
+    painter.drawText(xLeft, yMain, QString("%1: %2 m").arg("Height", number(input.height)));
+    painter.drawText(xRight, yMain, QString("%1: %2 m\u00B2").arg("Window Surface Area", number(areas.window)));
+    yMain += lineSpacing;
+
+    painter.setFont(footerFont);
+    painter.drawText(xRight, yMain, QString("   %1 - %2: %3 W/m\u00B2K").arg(room.windowMaterial, "U-Value", number(input.windowU)));
+    yMain += lineSpacing;
+
+    painter.setFont(headerFont);
+    painter.drawText(xLeft, yMain, "Window Areas & Shading");
+    painter.setFont(contentFont);
+    painter.drawText(xRight, yMain, QString("%1: %2 m\u00B2").arg("Ceiling Surface Area", number(areas.ceiling)));
+    yMain += lineSpacing;
+
+    painter.drawText(xLeft, yMain, QString("%1: %2 m\u00B2 - %3").arg("North Window Area", number(input.northWindowArea), input.northShaded ? "Shaded" : "Unshaded"));
+    painter.setFont(footerFont);
+    painter.drawText(xRight, yMain, QString("   %1 - %2: %3 W/m\u00B2K").arg(room.ceilingMaterial, "U-Value", number(input.ceilingU)));
+    yMain += lineSpacing;
+
+    painter.setFont(contentFont);
+    painter.drawText(xLeft, yMain, QString("%1: %2 m\u00B2 - %3").arg("East Window Area", number(input.eastWindowArea), input.eastShaded ? "Shaded" : "Unshaded"));
+    painter.drawText(xRight, yMain, QString("%1: %2 m\u00B2").arg("Floor Surface Area", number(areas.floor)));
+    yMain += lineSpacing;
+
+    painter.drawText(xLeft, yMain, QString("%1: %2 m\u00B2 - %3").arg("South Window Area", number(input.southWindowArea), input.southShaded ? "Shaded" : "Unshaded"));
+    painter.setFont(footerFont);
+    painter.drawText(xRight, yMain, QString("   %1 - %2: %3 W/m\u00B2K").arg(room.floorMaterial, "U-Value", number(input.floorU)));
+    yMain += lineSpacing;
+
+    painter.setFont(contentFont);
+    painter.drawText(xLeft, yMain, QString("%1: %2 m\u00B2 - %3").arg("West Window Area", number(input.westWindowArea), input.westShaded ? "Shaded" : "Unshaded"));
+    yMain += lineSpacing;
+
+    painter.setFont(footerFont);
+    painter.drawText(xLeft, yMain, input.latitude
+                         ? QString("   Solar Gains: %1\u00B0%2, g-Value %3")
+                               .arg(number(std::fabs(*input.latitude)), QString(*input.latitude < 0 ? "S" : "N"),
+                                    number(input.windowG))
+                         : QString("   Solar Gains: Rule of Thumb"));
+    painter.setFont(headerFont);
+    painter.drawText(xRight, yMain, QString("Temperature Conditions"));
+    yMain += lineSpacing;
+
+    painter.drawText(xLeft, yMain, QString("Internal Heat Loads"));
+    painter.setFont(contentFont);
+    painter.drawText(xRight, yMain, QString("%1: %2 \u00B0C").arg("Target Room Temperature", number(input.targetTemp)));
+    yMain += lineSpacing;
+
+    painter.drawText(xLeft, yMain, QString("%1: %2").arg("No. of Occupants", number(input.occupants)));
+    painter.drawText(xRight, yMain, QString("%1: %2 \u00B0C").arg("External Temperature", number(input.externalTemp)));
+    yMain += lineSpacing;
+
+    painter.drawText(xLeft, yMain, QString("%1: %2 W").arg("Equipment Load", number(input.equipmentWatt)));
+    yMain += lineSpacing;
+
+    painter.drawText(xLeft, yMain, QString("%1: %2 W - %3").arg("Lighting Load", number(input.lightingWatt), room.lightType));
+    painter.setFont(headerFont);
+    painter.drawText(xRight, yMain, QString("Air Flow Information"));
+    yMain += lineSpacing;
+
+    painter.setFont(contentFont);
+    painter.drawText(xRight, yMain, QString("%1: %2").arg("Ventilation (Desired) Air Replacements per Hour", number(input.ventilationAch)));
+    yMain += lineSpacing;
+
+    painter.drawText(xRight, yMain, QString("%1: %2").arg("Leakage (Undesired) Air Replacements per Hour", number(input.leakageAch)));
+    yMain += lineSpacing;
+
+    yMain += lineSpacing;
+
+    painter.setFont(headerFont);
+    painter.drawText(xLeft, yMain, QString("Cooling Unit Settings"));
+    painter.drawText(xRight, yMain, QString("Heating Unit Settings"));
+    yMain += lineSpacing;
+
+    painter.setFont(contentFont);
+    painter.drawText(xLeft, yMain, QString("%1: %2 %").arg("Peak Cooling Adjustment", number(input.coolAdjust)));
+    painter.drawText(xRight, yMain, QString("%1: %2 %").arg("Peak Heating Adjustment", number(input.heatAdjust)));
+    yMain += lineSpacing;
+
+    painter.drawText(xLeft, yMain, QString("%1: %2 W").arg("Cooling Capacity per Unit", number(input.coolCapacity)));
+    painter.drawText(xRight, yMain, QString("%1: %2 W").arg("Heating Capacity per Unit", number(input.heatCapacity)));
+
+
+    yLeft = yMain;
+    yRight = yMain;
+
+    yLeft += sectionSpacing;
+
+    // --- Cooling Summary (Left Column) ---
+    painter.setFont(headerFont);
+    painter.drawText(xLeft, yLeft, "Cooling Summary");
+    yLeft += lineSpacing;
+
+    writeLine(xLeft, yLeft, "Room Heat Load (W)", number(loads.roomWatt));
+    writeLine(xLeft, yLeft, "Window Heat Gain (W)", number(loads.windowCoolWatt));
+    writeLine(xLeft, yLeft, "Occupant Heat Gain (W)", number(loads.occupantWatt));
+    writeLine(xLeft, yLeft, "Equipment Load (W)", number(loads.equipmentWatt));
+    writeLine(xLeft, yLeft, "Lighting Load (W)", number(loads.lightingWatt));
+    writeLine(xLeft, yLeft, "Total Cooling Load (W)", number(loads.totalCoolingWatt));
+    writeLine(xLeft, yLeft, "Peak Cooling Load (W)", number(loads.peakCoolingWatt));
+    writeLine(xLeft, yLeft, "Cooling Units Required", number(loads.coolingUnits));
+
+    yRight += sectionSpacing;
+
+    // --- Heating Summary (Right Column) ---
+    painter.setFont(headerFont);
+    painter.drawText(xRight, yRight, "Heating Summary");
+    yRight += lineSpacing;
+
+    writeLine(xRight, yRight, "Wall Heat Loss (W)", number(loads.wallWatt));
+    writeLine(xRight, yRight, "Window Heat Loss (W)", number(loads.windowHeatWatt));
+    writeLine(xRight, yRight, "Ceiling Heat Loss (W)", number(loads.ceilingWatt));
+    writeLine(xRight, yRight, "Floor Heat Loss (W)", number(loads.floorWatt));
+    writeLine(xRight, yRight, "Transmission Loss (W)", number(loads.transmissionWatt));
+    writeLine(xRight, yRight, "Ventilation Loss (W)", number(loads.ventWatt));
+    writeLine(xRight, yRight, "Leakage Loss (W)", number(loads.leakWatt));
+    writeLine(xRight, yRight, "Total Heating Load (W)", number(loads.totalHeatingWatt));
+    writeLine(xRight, yRight, "Peak Heating Load (W)", number(loads.peakHeatingWatt));
+    writeLine(xRight, yRight, "Heating Units Required", number(loads.heatingUnits));
+}
+
+// Building totals first, then one row per room
+void drawSummaryPage(QPainter &painter, const PageLayout &layout, const QList<RoomReport> &rooms, int firstRow)
+{
+    const int margin = layout.margin;
+    const int lineSpacing = layout.lineSpacing;
+    const int sectionSpacing = layout.sectionSpacing;
+    const int tableWidth = layout.pageWidth - 2 * margin;
+    const int columns[] = {margin, margin + tableWidth * 40 / 100, margin + tableWidth * 55 / 100,
+                           margin + tableWidth * 70 / 100, margin + tableWidth * 85 / 100};
+    int y = margin + 1.5 * sectionSpacing;
+
+    if (firstRow == 0) {
+        double peakCooling = 0;
+        double peakHeating = 0;
+        int coolingUnits = 0;
+        int heatingUnits = 0;
+        for (const RoomReport &room : rooms) {
+            peakCooling += room.loads.peakCoolingWatt;
+            peakHeating += room.loads.peakHeatingWatt;
+            coolingUnits += room.loads.coolingUnits;
+            heatingUnits += room.loads.heatingUnits;
+        }
+
+        painter.setFont(layout.headerFont);
+        painter.drawText(margin, y, "Building Totals");
+        y += lineSpacing;
+        painter.setFont(layout.contentFont);
+        painter.drawText(margin, y, QString("%1: %2").arg("Rooms", QString::number(rooms.size())));
+        y += lineSpacing;
+        painter.drawText(margin, y, QString("%1: %2").arg("Peak Cooling Load (W)", number(peakCooling)));
+        painter.drawText(columns[2], y, QString("%1: %2").arg("Cooling Units Required", QString::number(coolingUnits)));
+        y += lineSpacing;
+        painter.drawText(margin, y, QString("%1: %2").arg("Peak Heating Load (W)", number(peakHeating)));
+        painter.drawText(columns[2], y, QString("%1: %2").arg("Heating Units Required", QString::number(heatingUnits)));
+        y += sectionSpacing;
+    }
+
+    painter.setFont(layout.headerFont);
+    painter.drawText(columns[0], y, "Room");
+    painter.drawText(columns[1], y, "Peak Cool (W)");
+    painter.drawText(columns[2], y, "Cool Units");
+    painter.drawText(columns[3], y, "Peak Heat (W)");
+    painter.drawText(columns[4], y, "Heat Units");
+    y += lineSpacing;
+
+    painter.setFont(layout.contentFont);
+    const int lastRow = std::min<int>(rooms.size(), firstRow + SummaryRowsPerPage - (firstRow == 0 ? 6 : 0));
+    for (int row = firstRow; row < lastRow; ++row) {
+        const RoomReport &room = rooms.at(row);
+        painter.drawText(columns[0], y, room.name);
+        painter.drawText(columns[1], y, number(room.loads.peakCoolingWatt));
+        painter.drawText(columns[2], y, QString::number(room.loads.coolingUnits));
+        painter.drawText(columns[3], y, number(room.loads.peakHeatingWatt));
+        painter.drawText(columns[4], y, QString::number(room.loads.heatingUnits));
+        y += lineSpacing;
+    }
+}
+
+// Rows shown on each summary page; the first page also carries the totals
+int summaryRows(int page)
+{
+    return page == 0 ? SummaryRowsPerPage - 6 : SummaryRowsPerPage;
+}
+
+} // namespace
+
+
+ReportWriter::ReportWriter(const QString &fileName, const QList<RoomReport> &rooms, bool withSummary,
+                           std::shared_ptr<std::atomic<bool>> cancelled)
+    : fileName(fileName)
+    , rooms(rooms)
+    , withSummary(withSummary)
+    , cancelled(std::move(cancelled))
+{
+}
+
+int ReportWriter::pageCount(int rooms, bool withSummary)
+{
+    int pages = rooms;
+    if (withSummary) {
+        int listed = 0;
+        for (int page = 0; page == 0 || listed < rooms; ++page) {
+            listed += summaryRows(page);
+            ++pages;
+        }
+    }
+    return pages;
+}
+
+void ReportWriter::drawRoomText(QPainter &painter, const QSize &pageSize, const RoomReport &room)
+{
+    const PageLayout layout(pageSize);
+    drawPageFrame(painter, layout, ReportAssets::PageImages(), "HVAC Load Calculation Report");
+    drawRoomPage(painter, layout, room);
+}
+
+void ReportWriter::render()
+{
+    static const int setupProbe = Instrumentation::probe("pdf.setup");
+    static const int assetsProbe = Instrumentation::probe("pdf.assets");
+    static const int pageProbe = Instrumentation::probe("pdf.page");
+    static const int writeProbe = Instrumentation::probe("pdf.write");
+
+    std::optional<ScopedTimer> setupTimer(std::in_place, setupProbe);
+    QPdfWriter writer(fileName);
+    writer.setPageSize(QPageSize::A4);
+    writer.setResolution(300);
+    writer.setCreator("KAM Engineering Ltd.");
+    QPainter painter(&writer);
+
+    const PageLayout layout(QSize(writer.width(), writer.height()));
+    setupTimer.reset();
+    ReportAssets::PageImages images;
+    {
+        ScopedTimer timer(assetsProbe);
+        images = ReportAssets::instance().pageImages(QSize(layout.pageWidth, layout.pageHeight), writer.resolution());
+    }
+    const int total = pageCount(rooms.size(), withSummary);
+    int done = 0;
+
+    auto startPage = [&](const QString &title) {
+        if (done > 0)
+            writer.newPage();
+        drawPageFrame(painter, layout, images, title);
+    };
+
+    // Checked before every page, summary pages included
+    bool completed = true;
+    auto keepGoing = [&]() {
+        completed = completed && !(cancelled && cancelled->load());
+        return completed;
+    };
+
+    if (withSummary) {
+        int row = 0;
+        for (int page = 0; (page == 0 || row < rooms.size()) && keepGoing(); ++page) {
+            ScopedTimer timer(pageProbe);
+            startPage("HVAC Load Calculation Report - Building Summary");
+            drawSummaryPage(painter, layout, rooms, row);
+            row += summaryRows(page);
+            emit progress(++done, total);
+        }
+    }
+
+    for (const RoomReport &room : rooms) {
+        if (!keepGoing())
+            break;
+        ScopedTimer timer(pageProbe);
+        startPage("HVAC Load Calculation Report");
+        drawRoomPage(painter, layout, room);
+        emit progress(++done, total);
+    }
+
+    {
+        // Font subsetting and compression happen as the PDF is closed
+        ScopedTimer timer(writeProbe);
+        painter.end();
+    }
+    if (!completed)
+        QFile::remove(fileName);
+    emit finished(completed, fileName);
+}
@@ -0,0 +1,59 @@
+#ifndef REPORTWRITER_H
+#define REPORTWRITER_H
+
+#include <QList>
+#include <QObject>
+#include <QSize>
+#include <QString>
+
+#include <atomic>
+#include <memory>
+
+#include "loadcalc.h"
+
+class QPainter;
+
+// Everything needed to print one room, taken from calculation results rather than widgets
+struct RoomReport
+{
+    QString name;
+    RoomInput input;
+    RoomLoads loads;
+    QString lightType;
+    QString wallMaterial;
+    QString windowMaterial;
+    QString ceilingMaterial;
+    QString floorMaterial;
+};
+
+// Renders rooms into one PDF: a page per room followed, for projects, by
+// building summary pages. Meant to run on a worker thread; cancel by setting
+// the shared flag from any thread.
+class ReportWriter : public QObject
+{
+    Q_OBJECT
+
+public:
+    ReportWriter(const QString &fileName, const QList<RoomReport> &rooms, bool withSummary,
+                 std::shared_ptr<std::atomic<bool>> cancelled);
+
+    static int pageCount(int rooms, bool withSummary);
+
+    // Lays out the text of one room page (frame without images) on any paint device
+    static void drawRoomText(QPainter &painter, const QSize &pageSize, const RoomReport &room);
+
+public slots:
+    void render();
+
+signals:
+    void progress(int pagesDone, int pageTotal);
+    void finished(bool completed, const QString &fileName);
+
+private:
+    QString fileName;
+    QList<RoomReport> rooms;
+    bool withSummary;
+    std::shared_ptr<std::atomic<bool>> cancelled;
+};
+
+#endif // REPORTWRITER_H
@@ -0,0 +1,362 @@
+#include "resultcache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include "mappedfile.h"
+#include "solargain.h"
+
+namespace {
+
+const char FileMagic[4] = {'B', 'T', 'U', 'C'};
+const uint32_t FileVersion = 1;
+const size_t ShardCount = 16;
+const size_t WriteBlock = 1 << 20;
+
+struct FileHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t keyValues;
+    uint32_t loadValues;
+    uint64_t fingerprint; // of the results of a few reference rooms
+    uint64_t entries;
+};
+
+// Saved results, in RoomLoads order
+const struct
+{
+    double RoomLoads::*value;
+    int RoomLoads::*count;
+} loadFields[] = {
+    {&RoomLoads::roomWatt, nullptr},
+    {&RoomLoads::windowCoolWatt, nullptr},
+    {&RoomLoads::occupantWatt, nullptr},
+    {&RoomLoads::equipmentWatt, nullptr},
+    {&RoomLoads::lightingWatt, nullptr},
+    {&RoomLoads::totalCoolingWatt, nullptr},
+    {&RoomLoads::peakCoolingWatt, nullptr},
+    {nullptr, &RoomLoads::coolingUnits},
+    {&RoomLoads::wallWatt, nullptr},
+    {&RoomLoads::windowHeatWatt, nullptr},
+    {&RoomLoads::ceilingWatt, nullptr},
+    {&RoomLoads::floorWatt, nullptr},
+    {&RoomLoads::transmissionWatt, nullptr},
+    {&RoomLoads::ventWatt, nullptr},
+    {&RoomLoads::leakWatt, nullptr},
+    {&RoomLoads::totalHeatingWatt, nullptr},
+    {&RoomLoads::peakHeatingWatt, nullptr},
+    {nullptr, &RoomLoads::heatingUnits},
+};
+
+const size_t EntryBytes = (RoomKey::Size + std::size(loadFields)) * sizeof(double);
+
+uint64_t mix(uint64_t hash)
+{
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+uint64_t bitsOf(double value)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+uint64_t keyHash(const double *values)
+{
+    uint64_t hash = 0x9e3779b97f4a7c15ull;
+    for (int i = 0; i < RoomKey::Size; ++i)
+        hash = (hash ^ bitsOf(values[i])) * 0x100000001b3ull + (hash >> 29);
+    return mix(hash);
+}
+
+// A calculation change shows up as different results for these rooms, which makes old files unusable
+uint64_t calculationFingerprint()
+{
+    static const uint64_t fingerprint = [] {
+        RoomInput plain;
+        plain.length = 4.5;
+        plain.width = 3.2;
+        plain.height = 2.4;
+        plain.southWindowArea = 1.8;
+        plain.occupants = 2;
+        plain.equipmentWatt = 250;
+        plain.lightingWatt = 60;
+        RoomInput unusual = plain;
+        unusual.eastShaded = true;
+        unusual.wallArea = 20;
+        unusual.coolUnits = OutputUnit::BTU;
+        unusual.heatUnits = OutputUnit::BTU;
+        unusual.externalTemp = -3;
+        RoomInput sunny = plain;
+        sunny.westWindowArea = 2.5;
+        sunny.latitude = 53.5;
+        sunny.windowG = 0.6;
+
+        uint64_t hash = RoomKey::Size;
+        for (const RoomInput &input : {RoomInput(), plain, unusual, sunny}) {
+            const RoomLoads loads = calculateRoomLoads(input);
+            for (const auto &field : loadFields)
+                hash = mix(hash ^ bitsOf(field.value ? loads.*field.value : double(loads.*field.count)));
+        }
+        return hash;
+    }();
+    return fingerprint;
+}
+
+} // namespace
+
+
+bool RoomKey::operator==(const RoomKey &other) const
+{
+    return hash == other.hash && std::memcmp(values, other.values, sizeof(values)) == 0;
+}
+
+RoomKey roomKey(const RoomInput &input)
+{
+    const SurfaceAreas areas = resolveSurfaceAreas(input);
+    const WindowGainFactors gains = windowGainFactors(input);
+    const double values[] = {
+        input.length, input.width, input.height,
+        input.northWindowArea, input.eastWindowArea, input.southWindowArea, input.westWindowArea,
+        double(input.northShaded), double(input.eastShaded), double(input.southShaded), double(input.westShaded),
+        gains.north, gains.east, gains.south, gains.west,
+        input.occupants, input.equipmentWatt, input.lightingWatt, input.lightingMult,
+        input.coolAdjust, input.coolCapacity, double(input.coolUnits),
+        areas.wall, areas.window, areas.ceiling, areas.floor,
+        input.wallU, input.windowU, input.ceilingU, input.floorU,
+        input.targetTemp, input.externalTemp, input.ventilationAch, input.leakageAch,
+        input.heatAdjust, input.heatCapacity, double(input.heatUnits),
+    };
+    static_assert(std::size(values) == RoomKey::Size, "RoomKey::Size must match the key's values");
+
+    RoomKey key;
+    std::memcpy(key.values, values, sizeof(values));
+    key.hash = keyHash(key.values);
+    return key;
+}
+
+struct ResultCache::Shard
+{
+    struct Entry
+    {
+        RoomKey key;
+        RoomLoads loads;
+        std::string text[2]; // result columns by RecordFormat
+    };
+
+    std::mutex mutex;
+    std::list<Entry> entries; // most recently used first
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> byHash;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+};
+
+ResultCache::ResultCache(size_t capacity)
+    : shards(new Shard[ShardCount])
+    , shardCapacity(std::max<size_t>(1, (capacity + ShardCount - 1) / ShardCount))
+{
+}
+
+ResultCache::~ResultCache() = default;
+
+ResultCache::Shard &ResultCache::shardOf(const RoomKey &key) const
+{
+    return shards[key.hash >> 60];
+}
+
+bool ResultCache::find(const RoomKey &key, RoomLoads &loads, RecordFormat format, std::string *text)
+{
+    Shard &shard = shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    const auto found = shard.byHash.find(key.hash);
+    if (found == shard.byHash.end() || !(found->second->key == key)) {
+        ++shard.misses;
+        return false;
+    }
+    ++shard.hits;
+    shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+    loads = found->second->loads;
+    if (text)
+        *text = found->second->text[int(format)];
+    return true;
+}
+
+void ResultCache::insert(const RoomKey &key, const RoomLoads &loads, RecordFormat format, const std::string *text)
+{
+    Shard &shard = shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    const auto found = shard.byHash.find(key.hash);
+    std::list<Shard::Entry>::iterator entry;
+    if (found != shard.byHash.end()) {
+        // Also replaces a different room that happens to share the hash
+        entry = found->second;
+        shard.entries.splice(shard.entries.begin(), shard.entries, entry);
+        if (!(entry->key == key)) {
+            entry->key = key;
+            entry->text[0].clear();
+            entry->text[1].clear();
+        }
+    } else {
+        if (shard.entries.size() >= shardCapacity) {
+            // Reuses the least recently used entry rather than freeing and allocating
+            entry = std::prev(shard.entries.end());
+            shard.byHash.erase(entry->key.hash);
+            shard.entries.splice(shard.entries.begin(), shard.entries, entry);
+            entry->text[0].clear();
+            entry->text[1].clear();
+            ++shard.evictions;
+        } else {
+            entry = shard.entries.emplace(shard.entries.begin());
+        }
+        entry->key = key;
+        shard.byHash.emplace(key.hash, entry);
+    }
+    entry->loads = loads;
+    if (text)
+        entry->text[int(format)] = *text;
+}
+
+ResultCacheStats ResultCache::stats() const
+{
+    ResultCacheStats total;
+    total.capacity = shardCapacity * ShardCount;
+    for (size_t s = 0; s < ShardCount; ++s) {
+        Shard &shard = shards[s];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        total.hits += shard.hits;
+        total.misses += shard.misses;
+        total.evictions += shard.evictions;
+        total.size += shard.entries.size();
+    }
+    return total;
+}
+
+bool ResultCache::load(const std::string &path, std::string &error)
+{
+    std::error_code ec;
+    if (!std::filesystem::exists(path, ec))
+        return true;
+
+    MappedFile file;
+    if (!file.open(path)) {
+        error = "Cannot open " + path;
+        return false;
+    }
+    FileHeader header;
+    if (file.size() < sizeof(header)) {
+        error = path + ": not a result cache";
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, FileMagic, sizeof(FileMagic)) != 0 || header.version != FileVersion) {
+        error = path + ": not a result cache";
+        return false;
+    }
+    // Results from a build that calculates differently are of no use, but the file is still ours to replace
+    if (header.keyValues != RoomKey::Size || header.loadValues != std::size(loadFields)
+        || header.fingerprint != calculationFingerprint())
+        return true;
+    if (header.entries > (file.size() - sizeof(header)) / EntryBytes) {
+        error = path + ": truncated";
+        return false;
+    }
+
+    // Entries are stored least recently used first, so inserting them in order restores the
+    // recency. Hashes are worked out again rather than stored, so they are free to change.
+    const char *p = file.data() + sizeof(header);
+    RoomKey key;
+    RoomLoads loads;
+    for (uint64_t i = 0; i < header.entries; ++i) {
+        std::memcpy(key.values, p, sizeof(key.values));
+        p += sizeof(key.values);
+        key.hash = keyHash(key.values);
+        for (const auto &field : loadFields) {
+            double value;
+            std::memcpy(&value, p, sizeof(value));
+            p += sizeof(value);
+            if (field.value)
+                loads.*field.value = value;
+            else
+                loads.*field.count = int(value);
+        }
+        insert(key, loads);
+    }
+    return true;
+}
+
+bool ResultCache::save(const std::string &path, std::string &error) const
+{
+    // Written to a temporary name first so the old file survives a failure
+    const std::string temporaryPath = path + ".tmp";
+    std::FILE *file = std::fopen(temporaryPath.c_str(), "wb");
+    if (!file) {
+        error = "Cannot create " + temporaryPath;
+        return false;
+    }
+
+    std::vector<char> out;
+    bool ok = true;
+    auto append = [&out](const void *data, size_t size) {
+        const char *bytes = static_cast<const char *>(data);
+        out.insert(out.end(), bytes, bytes + size);
+    };
+    auto flush = [&]() {
+        ok = ok && std::fwrite(out.data(), 1, out.size(), file) == out.size();
+        out.clear();
+    };
+
+    FileHeader header = {};
+    std::memcpy(header.magic, FileMagic, sizeof(FileMagic));
+    header.version = FileVersion;
+    header.keyValues = RoomKey::Size;
+    header.loadValues = uint32_t(std::size(loadFields));
+    header.fingerprint = calculationFingerprint();
+    append(&header, sizeof(header));
+
+    uint64_t entries = 0;
+    for (size_t s = 0; s < ShardCount && ok; ++s) {
+        Shard &shard = shards[s];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (auto entry = shard.entries.rbegin(); entry != shard.entries.rend(); ++entry) {
+            append(entry->key.values, sizeof(entry->key.values));
+            for (const auto &field : loadFields) {
+                const double value = field.value ? entry->loads.*field.value : double(entry->loads.*field.count);
+                append(&value, sizeof(value));
+            }
+            ++entries;
+            if (out.size() >= WriteBlock)
+                flush();
+        }
+    }
+    flush();
+    if (ok) {
+        header.entries = entries;
+        ok = std::fseek(file, 0, SEEK_SET) == 0 && std::fwrite(&header, sizeof(header), 1, file) == 1;
+    }
+    ok = std::fclose(file) == 0 && ok;
+
+    std::error_code ec;
+    if (ok)
+        std::filesystem::rename(temporaryPath, path, ec);
+    if (!ok || ec) {
+        std::filesystem::remove(temporaryPath, ec);
+        error = "Failed writing " + path;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,83 @@
+#ifndef RESULTCACHE_H
+#define RESULTCACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "batchio.h"
+#include "loadcalc.h"
+
+// Results of rooms already calculated, looked up by their inputs. Surveys repeat
+// the same layouts with the same defaults, so batch runs and repeat requests can
+// skip both the calculation and the formatting of the result columns.
+//
+// The cache is a bounded LRU split into shards with a lock each, so worker
+// threads rarely wait on one another. It can be saved to a file and loaded by a
+// later run; a file written by a build whose calculation gives different
+// results is not loaded.
+
+// Every input the calculation reads, with the surface areas and window gain
+// factors resolved as the calculation resolves them. Rooms are the same only if
+// every value has the same bits, so a hit always gives exactly what calculating
+// would.
+struct RoomKey
+{
+    static const int Size = 37;
+
+    double values[Size];
+    uint64_t hash;
+
+    bool operator==(const RoomKey &other) const;
+};
+
+RoomKey roomKey(const RoomInput &input);
+
+struct ResultCacheStats
+{
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    size_t size = 0;
+    size_t capacity = 0;
+
+    double hitRate() const { return hits + misses ? double(hits) / double(hits + misses) : 0.0; }
+};
+
+class ResultCache
+{
+public:
+    explicit ResultCache(size_t capacity);
+    ~ResultCache();
+
+    ResultCache(const ResultCache &) = delete;
+    ResultCache &operator=(const ResultCache &) = delete;
+
+    // Looks a room up and marks it recently used. When text is given it receives
+    // the result columns stored for format, or is cleared if none were stored.
+    bool find(const RoomKey &key, RoomLoads &loads, RecordFormat format = RecordFormat::Csv,
+              std::string *text = nullptr);
+
+    // Adds or refreshes a room, optionally with its result columns formatted for
+    // format. The least recently used room in the shard makes way when it is full.
+    void insert(const RoomKey &key, const RoomLoads &loads, RecordFormat format = RecordFormat::Csv,
+                const std::string *text = nullptr);
+
+    ResultCacheStats stats() const;
+
+    // A missing file, or one saved by a build whose calculation differs, loads as an
+    // empty cache; any other file fails. Formatted columns are not saved.
+    bool load(const std::string &path, std::string &error);
+    bool save(const std::string &path, std::string &error) const;
+
+private:
+    struct Shard;
+
+    Shard &shardOf(const RoomKey &key) const;
+
+    std::unique_ptr<Shard[]> shards;
+    size_t shardCapacity;
+};
+
+#endif // RESULTCACHE_H
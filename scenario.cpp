@@ -0,0 +1,229 @@
+#include "scenario.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "batchio.h"
+
+namespace {
+
+const int SlotCount = InputSnapshot::ChunkFields * InputSnapshot::ChunkCount;
+
+// Unset areas are NaN, and an unset area is the same as another
+bool sameValue(double a, double b)
+{
+    return a == b || (std::isnan(a) && std::isnan(b));
+}
+
+} // namespace
+
+
+InputSnapshot::InputSnapshot()
+    : InputSnapshot(RoomInput())
+{
+}
+
+InputSnapshot::InputSnapshot(const RoomInput &input)
+{
+    assert(!roomFieldName(SlotCount));
+    for (int c = 0; c < ChunkCount; ++c) {
+        std::shared_ptr<Chunk> chunk = std::make_shared<Chunk>();
+        for (int i = 0; i < ChunkFields; ++i)
+            chunk->values[i] = roomFieldValue(input, c * ChunkFields + i);
+        chunks[c] = std::move(chunk);
+    }
+}
+
+RoomInput InputSnapshot::input() const
+{
+    RoomInput input;
+    for (int field = 0; field < SlotCount; ++field) {
+        const double number = value(field);
+        // Leaves unset areas unset; the slots after the last field are NaN too
+        if (!std::isnan(number))
+            setRoomFieldValue(input, field, number);
+    }
+    return input;
+}
+
+double InputSnapshot::value(int field) const
+{
+    if (field < 0 || field >= SlotCount)
+        return std::nan("");
+    return chunks[field / ChunkFields]->values[field % ChunkFields];
+}
+
+InputSnapshot InputSnapshot::with(int field, double value) const
+{
+    if (!roomFieldName(field) || sameValue(this->value(field), value))
+        return *this;
+
+    InputSnapshot changed = *this;
+    std::shared_ptr<Chunk> chunk = std::make_shared<Chunk>(*chunks[field / ChunkFields]);
+    chunk->values[field % ChunkFields] = value;
+    changed.chunks[field / ChunkFields] = std::move(chunk);
+    return changed;
+}
+
+InputSnapshot InputSnapshot::with(const RoomInput &input) const
+{
+    InputSnapshot changed = *this;
+    for (int c = 0; c < ChunkCount; ++c) {
+        std::shared_ptr<Chunk> chunk;
+        for (int i = 0; i < ChunkFields; ++i) {
+            const double number = roomFieldValue(input, c * ChunkFields + i);
+            if (sameValue(chunks[c]->values[i], number))
+                continue;
+            if (!chunk)
+                chunk = std::make_shared<Chunk>(*chunks[c]);
+            chunk->values[i] = number;
+        }
+        if (chunk)
+            changed.chunks[c] = std::move(chunk);
+    }
+    return changed;
+}
+
+bool InputSnapshot::operator==(const InputSnapshot &other) const
+{
+    for (int c = 0; c < ChunkCount; ++c) {
+        if (chunks[c] == other.chunks[c])
+            continue;
+        for (int i = 0; i < ChunkFields; ++i) {
+            if (!sameValue(chunks[c]->values[i], other.chunks[c]->values[i]))
+                return false;
+        }
+    }
+    return true;
+}
+
+int InputSnapshot::onlyDifference(const InputSnapshot &other) const
+{
+    int field = -1;
+    for (int c = 0; c < ChunkCount; ++c) {
+        if (chunks[c] == other.chunks[c])
+            continue;
+        for (int i = 0; i < ChunkFields; ++i) {
+            if (sameValue(chunks[c]->values[i], other.chunks[c]->values[i]))
+                continue;
+            if (field >= 0)
+                return -1;
+            field = c * ChunkFields + i;
+        }
+    }
+    return field;
+}
+
+ScenarioSet::ScenarioSet(const std::string &name, const ScenarioState &state)
+{
+    scenarios.push_back({nextKey++, name, state, RoomLoads()});
+}
+
+const RoomLoads &ScenarioSet::loads(size_t index)
+{
+    Scenario &scenario = scenarios[index];
+    if (!scenario.calculated) {
+        scenario.loads = calculateRoomLoads(scenario.state.input.input());
+        scenario.calculated = true;
+    }
+    return scenario.loads;
+}
+
+void ScenarioSet::setActive(size_t index)
+{
+    if (index < scenarios.size())
+        activeIndex = index;
+}
+
+size_t ScenarioSet::duplicate(size_t index, const std::string &name)
+{
+    Scenario copy = scenarios[index];
+    copy.key = nextKey++;
+    copy.name = name;
+    scenarios.push_back(std::move(copy));
+    activeIndex = scenarios.size() - 1;
+    return activeIndex;
+}
+
+void ScenarioSet::rename(size_t index, const std::string &name)
+{
+    scenarios[index].name = name;
+}
+
+bool ScenarioSet::remove(size_t index)
+{
+    if (scenarios.size() < 2 || index >= scenarios.size())
+        return false;
+
+    const uint64_t key = scenarios[index].key;
+    scenarios.erase(scenarios.begin() + index);
+    auto removed = [key](const Step &step) { return step.key == key; };
+    undoSteps.erase(std::remove_if(undoSteps.begin(), undoSteps.end(), removed), undoSteps.end());
+    redoSteps.erase(std::remove_if(redoSteps.begin(), redoSteps.end(), removed), redoSteps.end());
+    if (activeIndex > index || activeIndex == scenarios.size())
+        --activeIndex;
+    return true;
+}
+
+bool ScenarioSet::edit(size_t index, const ScenarioState &state)
+{
+    Scenario &scenario = scenarios[index];
+    if (state.input == scenario.state.input && state.selections == scenario.state.selections)
+        return false;
+
+    const int field = state.selections == scenario.state.selections
+                          ? state.input.onlyDifference(scenario.state.input) : -1;
+    Step *last = undoSteps.empty() ? nullptr : &undoSteps.back();
+    if (last && redoSteps.empty() && last->key == scenario.key && field >= 0 && last->field == field) {
+        last->after = state;
+    } else {
+        undoSteps.push_back({scenario.key, scenario.state, state, field});
+        if (undoSteps.size() > HistoryLimit)
+            undoSteps.pop_front();
+    }
+    redoSteps.clear();
+    restore(index, state);
+    return true;
+}
+
+int ScenarioSet::undo()
+{
+    if (undoSteps.empty())
+        return -1;
+    Step step = std::move(undoSteps.back());
+    undoSteps.pop_back();
+    const int index = indexOf(step.key);
+    restore(index, step.before);
+    redoSteps.push_back(std::move(step));
+    return index;
+}
+
+int ScenarioSet::redo()
+{
+    if (redoSteps.empty())
+        return -1;
+    Step step = std::move(redoSteps.back());
+    redoSteps.pop_back();
+    const int index = indexOf(step.key);
+    restore(index, step.after);
+    undoSteps.push_back(std::move(step));
+    return index;
+}
+
+int ScenarioSet::indexOf(uint64_t key) const
+{
+    for (size_t i = 0; i < scenarios.size(); ++i) {
+        if (scenarios[i].key == key)
+            return int(i);
+    }
+    return -1;
+}
+
+void ScenarioSet::restore(size_t index, const ScenarioState &state)
+{
+    Scenario &scenario = scenarios[index];
+    if (state.input != scenario.state.input)
+        scenario.calculated = false;
+    scenario.state = state;
+}
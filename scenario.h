@@ -0,0 +1,143 @@
+#ifndef SCENARIO_H
+#define SCENARIO_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "catalog.h"
+#include "loadcalc.h"
+
+// Named alternatives for one room, such as "existing single glazing" against
+// "triple glazed plus insulated loft", kept side by side with undo and redo.
+//
+// A scenario's inputs are an InputSnapshot: the roomFieldIndex() fields as
+// numbers in a few fixed-size chunks that are never modified once made.
+// Changing a field copies its chunk only and shares the rest, so scenarios made
+// from one another and the steps of the undo history share nearly all of their
+// storage, and an edit costs the chunk it touches.
+
+class InputSnapshot
+{
+public:
+    static const int ChunkFields = 8;
+    static const int ChunkCount = 5; // room for every roomFieldIndex() field
+
+    InputSnapshot(); // RoomInput's defaults
+    explicit InputSnapshot(const RoomInput &input);
+
+    RoomInput input() const;
+    double value(int field) const; // roomFieldValue(), NaN for an unset area
+
+    InputSnapshot with(int field, double value) const;
+    // Equal to input, sharing the chunks whose fields input leaves as they are
+    InputSnapshot with(const RoomInput &input) const;
+
+    bool operator==(const InputSnapshot &other) const;
+    bool operator!=(const InputSnapshot &other) const { return !(*this == other); }
+
+    // The only field in which other differs, -1 when none or several do
+    int onlyDifference(const InputSnapshot &other) const;
+
+private:
+    struct Chunk
+    {
+        double values[ChunkFields];
+    };
+
+    std::array<std::shared_ptr<const Chunk>, ChunkCount> chunks;
+};
+
+// Catalog entries picked in the main window's combos, which the inputs only hold as values
+struct ScenarioSelections
+{
+    CatalogId light = NoCatalogId;
+    CatalogId wall = NoCatalogId;
+    CatalogId window = NoCatalogId;
+    CatalogId ceiling = NoCatalogId;
+    CatalogId floor = NoCatalogId;
+
+    bool operator==(const ScenarioSelections &other) const
+    {
+        return light == other.light && wall == other.wall && window == other.window && ceiling == other.ceiling
+               && floor == other.floor;
+    }
+};
+
+struct ScenarioState
+{
+    InputSnapshot input;
+    ScenarioSelections selections;
+};
+
+class ScenarioSet
+{
+public:
+    // Undo steps kept; the oldest are forgotten beyond this
+    static const size_t HistoryLimit = 10000;
+
+    explicit ScenarioSet(const std::string &name = "Scenario 1", const ScenarioState &state = ScenarioState());
+
+    size_t size() const { return scenarios.size(); }
+    const std::string &name(size_t index) const { return scenarios[index].name; }
+    const ScenarioState &state(size_t index) const { return scenarios[index].state; }
+
+    // Results of a scenario, calculated again only after its inputs change
+    const RoomLoads &loads(size_t index);
+
+    // The scenario the form edits
+    size_t active() const { return activeIndex; }
+    void setActive(size_t index);
+
+    // Adds a copy of a scenario, sharing all of its storage, and makes it the active one
+    size_t duplicate(size_t index, const std::string &name);
+    void rename(size_t index, const std::string &name);
+    // Fails for the last scenario. Undo steps of a removed scenario are dropped.
+    bool remove(size_t index);
+
+    // Replaces a scenario's state as one undo step. Edits of the same single field one
+    // after another (typing a number) make one step. False when nothing changed.
+    bool edit(size_t index, const ScenarioState &state);
+
+    bool canUndo() const { return !undoSteps.empty(); }
+    bool canRedo() const { return !redoSteps.empty(); }
+
+    // Steps back or forward through the edits; the index of the scenario changed, -1 when none
+    int undo();
+    int redo();
+
+    size_t undoDepth() const { return undoSteps.size(); }
+
+private:
+    struct Scenario
+    {
+        uint64_t key;
+        std::string name;
+        ScenarioState state;
+        RoomLoads loads;
+        bool calculated = false;
+    };
+
+    struct Step
+    {
+        uint64_t key;
+        ScenarioState before;
+        ScenarioState after;
+        int field; // the only input changed, -1 when several were or a selection was
+    };
+
+    int indexOf(uint64_t key) const;
+    void restore(size_t index, const ScenarioState &state);
+
+    std::vector<Scenario> scenarios;
+    std::deque<Step> undoSteps;
+    std::vector<Step> redoSteps;
+    size_t activeIndex = 0;
+    uint64_t nextKey = 1;
+};
+
+#endif // SCENARIO_H
@@ -0,0 +1,180 @@
+#include "scenariodialog.h"
+
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QInputDialog>
+#include <QLabel>
+#include <QLineEdit>
+#include <QPushButton>
+#include <QTableWidget>
+#include <QVBoxLayout>
+
+#include <cstring>
+
+#include "batchio.h"
+#include "scenario.h"
+
+namespace {
+
+// Captions of the resultFieldName() rows, in the same order
+const char *const resultCaptions[] = {
+    QT_TRANSLATE_NOOP("ScenarioDialog", "Room gain"),
+    QT_TRANSLATE_NOOP("ScenarioDialog", "Window gain"),
+    QT_TRANSLATE_NOOP("ScenarioDialog", "Occupant gain"),
+    QT_TRANSLATE_NOOP("ScenarioDialog", "Equipment gain"),
+    QT_TRANSLATE_NOOP("ScenarioDialog", "Lighting gain"),
+    QT_TRANSLATE_NOOP("ScenarioDialog", "Total cooling"),
+    QT_TRANSLATE_NOOP("ScenarioDialog", "Peak cooling"),
+    QT_TRANSLATE_NOOP("ScenarioDialog", "Cooling units"),
+    QT_TRANSLATE_NOOP("ScenarioDialog", "Wall loss"),
+    QT_TRANSLATE_NOOP("ScenarioDialog", "Window loss"),
+    QT_TRANSLATE_NOOP("ScenarioDialog", "Ceiling loss"),
+    QT_TRANSLATE_NOOP("ScenarioDialog", "Floor loss"),
+    QT_TRANSLATE_NOOP("ScenarioDialog", "Transmission loss"),
+    QT_TRANSLATE_NOOP("ScenarioDialog", "Ventilation loss"),
+    QT_TRANSLATE_NOOP("ScenarioDialog", "Leakage loss"),
+    QT_TRANSLATE_NOOP("ScenarioDialog", "Total heating"),
+    QT_TRANSLATE_NOOP("ScenarioDialog", "Peak heating"),
+    QT_TRANSLATE_NOOP("ScenarioDialog", "Heating units"),
+};
+
+const int ResultRows = int(sizeof(resultCaptions) / sizeof(resultCaptions[0]));
+
+// Unit counts are whole numbers; everything else is shown as in the form
+QString figure(double value, int row, bool signedValue)
+{
+    const bool units = std::strstr(resultFieldName(row), "UnitsHC") != nullptr;
+    QString text = QString::number(value, 'f', units ? 0 : 2);
+    return signedValue && value >= 0 ? "+" + text : text;
+}
+
+// Only touches an item when its text changes, so a refresh after each keystroke stays cheap
+void setCell(QTableWidget *table, int row, int column, const QString &text)
+{
+    QTableWidgetItem *item = table->item(row, column);
+    if (!item) {
+        item = new QTableWidgetItem(text);
+        item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+        table->setItem(row, column, item);
+    } else if (item->text() != text) {
+        item->setText(text);
+    }
+}
+
+} // namespace
+
+
+ScenarioDialog::ScenarioDialog(ScenarioSet *scenarios, QWidget *parent)
+    : QDialog(parent)
+    , scenarios(scenarios)
+{
+    setWindowTitle(tr("Scenarios"));
+    resize(760, 560);
+    QVBoxLayout *layout = new QVBoxLayout(this);
+
+    resultTable = new QTableWidget(ResultRows, 0, this);
+    QStringList captions;
+    for (const char *caption : resultCaptions)
+        captions.append(tr(caption));
+    resultTable->setVerticalHeaderLabels(captions);
+    resultTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    resultTable->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    layout->addWidget(resultTable, 1);
+
+    statusLabel = new QLabel(this);
+    layout->addWidget(statusLabel);
+
+    QHBoxLayout *buttons = new QHBoxLayout;
+    QPushButton *addButton = new QPushButton(tr("Copy as new scenario"), this);
+    QPushButton *renameButton = new QPushButton(tr("Rename..."), this);
+    removeButton = new QPushButton(tr("Remove"), this);
+    undoButton = new QPushButton(tr("Undo"), this);
+    redoButton = new QPushButton(tr("Redo"), this);
+    buttons->addWidget(addButton);
+    buttons->addWidget(renameButton);
+    buttons->addWidget(removeButton);
+    buttons->addStretch(1);
+    buttons->addWidget(undoButton);
+    buttons->addWidget(redoButton);
+    layout->addLayout(buttons);
+
+    connect(addButton, &QPushButton::clicked, this, &ScenarioDialog::addScenario);
+    connect(renameButton, &QPushButton::clicked, this, &ScenarioDialog::renameScenario);
+    connect(removeButton, &QPushButton::clicked, this, &ScenarioDialog::removeScenario);
+    connect(undoButton, &QPushButton::clicked, this, &ScenarioDialog::undoRequested);
+    connect(redoButton, &QPushButton::clicked, this, &ScenarioDialog::redoRequested);
+    connect(resultTable->horizontalHeader(), &QHeaderView::sectionDoubleClicked, this, [this](int column) {
+        if (size_t(column) == this->scenarios->active())
+            return;
+        this->scenarios->setActive(size_t(column));
+        emit activeChanged();
+        refresh();
+    });
+    refresh();
+}
+
+// Scenarios are only calculated again when their inputs changed, so this costs
+// the edited column plus the table's text comparisons
+void ScenarioDialog::refresh()
+{
+    const int columns = int(scenarios->size());
+    const int active = int(scenarios->active());
+    resultTable->setColumnCount(columns);
+    QStringList names;
+    for (int column = 0; column < columns; ++column) {
+        const QString name = QString::fromStdString(scenarios->name(column));
+        names.append(column == active ? tr("%1 (in form)").arg(name) : name);
+    }
+    resultTable->setHorizontalHeaderLabels(names);
+
+    const RoomLoads &baseline = scenarios->loads(0);
+    for (int column = 0; column < columns; ++column) {
+        const RoomLoads &loads = scenarios->loads(column);
+        for (int row = 0; row < ResultRows; ++row) {
+            const double value = resultFieldValue(loads, row);
+            QString text = figure(value, row, false);
+            if (column > 0)
+                text += " (" + figure(value - resultFieldValue(baseline, row), row, true) + ")";
+            setCell(resultTable, row, column, text);
+        }
+    }
+
+    removeButton->setEnabled(columns > 1);
+    undoButton->setEnabled(scenarios->canUndo());
+    redoButton->setEnabled(scenarios->canRedo());
+    statusLabel->setText(tr("Differences are from %1. %n undo step(s).", nullptr, int(scenarios->undoDepth()))
+                             .arg(QString::fromStdString(scenarios->name(0))));
+}
+
+void ScenarioDialog::addScenario()
+{
+    const size_t active = scenarios->active();
+    bool ok = false;
+    const QString name = QInputDialog::getText(this, tr("Copy as new scenario"), tr("Scenario name:"),
+                                               QLineEdit::Normal, tr("Scenario %1").arg(scenarios->size() + 1), &ok);
+    if (!ok)
+        return;
+    // The copy has the form's inputs, so the form stays as it is
+    scenarios->duplicate(active, name.toStdString());
+    refresh();
+}
+
+void ScenarioDialog::renameScenario()
+{
+    const size_t active = scenarios->active();
+    bool ok = false;
+    const QString name = QInputDialog::getText(this, tr("Rename scenario"), tr("Scenario name:"), QLineEdit::Normal,
+                                               QString::fromStdString(scenarios->name(active)), &ok);
+    if (!ok)
+        return;
+    scenarios->rename(active, name.toStdString());
+    refresh();
+}
+
+void ScenarioDialog::removeScenario()
+{
+    if (!scenarios->remove(scenarios->active()))
+        return;
+    emit activeChanged();
+    refresh();
+}
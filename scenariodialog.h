@@ -0,0 +1,46 @@
+#ifndef SCENARIODIALOG_H
+#define SCENARIODIALOG_H
+
+#include <QDialog>
+
+class QLabel;
+class QPushButton;
+class QTableWidget;
+class ScenarioSet;
+
+// The main window's scenarios side by side: one column each, one row per
+// result, every figure shown with its difference from the first scenario. The
+// main window calls refresh() after each recalculation, so the column being
+// edited follows the form as it is typed into. Double-clicking a column
+// header puts that scenario in the form.
+class ScenarioDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    ScenarioDialog(ScenarioSet *scenarios, QWidget *parent = nullptr);
+
+public slots:
+    void refresh();
+
+signals:
+    // The form has to show another scenario
+    void activeChanged();
+    void undoRequested();
+    void redoRequested();
+
+private slots:
+    void addScenario();
+    void renameScenario();
+    void removeScenario();
+
+private:
+    ScenarioSet *scenarios;
+    QTableWidget *resultTable;
+    QLabel *statusLabel;
+    QPushButton *removeButton;
+    QPushButton *undoButton;
+    QPushButton *redoButton;
+};
+
+#endif // SCENARIODIALOG_H
@@ -0,0 +1,273 @@
+#include "solargain.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+const double Pi = 3.14159265358979323846;
+const double Radian = Pi / 180;
+const double GroundReflectance = 0.2;
+const double Tropic = 23.45; // the largest solar declination
+const double UnshadedFactor = 1.4; // the shading multiplier applied to unshaded windows
+// Window areas are whole openings, of which frames and bars take about a quarter
+const double GlazedFraction = 0.75;
+// Sun through the glass warms the room's surfaces first and reaches the air over
+// the following hours, so the peak cooling load is only part of the peak gain
+// (the storage factor of a medium-weight room)
+const double StorageFactor = 0.6;
+
+const int LowestBand = -90;
+const int BandCount = 181;
+
+const int DaysInMonth[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+// ASHRAE clear-sky coefficients for each month: apparent extraterrestrial
+// irradiance (W/m2), atmospheric extinction and diffuse ratio
+const struct
+{
+    double a, b, c;
+} clearSky[12] = {
+    {1230, 0.142, 0.058}, {1215, 0.144, 0.060}, {1186, 0.156, 0.071}, {1136, 0.180, 0.097},
+    {1104, 0.196, 0.121}, {1088, 0.205, 0.134}, {1085, 0.207, 0.136}, {1107, 0.201, 0.122},
+    {1151, 0.177, 0.092}, {1192, 0.160, 0.073}, {1221, 0.149, 0.063}, {1233, 0.142, 0.057},
+};
+
+std::mutex buildMutex;
+std::unique_ptr<SolarTable> builtTables[BandCount];
+std::atomic<const SolarTable *> tables[BandCount];
+
+double total(const SolarIrradiance &sun)
+{
+    return sun.north + sun.east + sun.south + sun.west;
+}
+
+SolarIrradiance lesser(const SolarIrradiance &a, const SolarIrradiance &b)
+{
+    return {std::min(a.north, b.north), std::min(a.east, b.east), std::min(a.south, b.south), std::min(a.west, b.west)};
+}
+
+SolarIrradiance greater(const SolarIrradiance &a, const SolarIrradiance &b)
+{
+    return {std::max(a.north, b.north), std::max(a.east, b.east), std::max(a.south, b.south), std::max(a.west, b.west)};
+}
+
+bool noSunnier(const SolarIrradiance &sun, const SolarIrradiance &other)
+{
+    return sun.north <= other.north && sun.east <= other.east && sun.south <= other.south && sun.west <= other.west;
+}
+
+std::unique_ptr<SolarTable> buildTable(int latitude)
+{
+    std::unique_ptr<SolarTable> table(new SolarTable);
+    table->latitude = latitude;
+    table->hours.resize(HoursPerYear);
+
+    const double sinLatitude = std::sin(latitude * Radian);
+    const double cosLatitude = std::cos(latitude * Radian);
+    // Outside the tropics cooling peaks in the half of the year the sun spends
+    // over the site's hemisphere; the low winter sun is sunnier on equator-facing
+    // glass but is not what sizes the cooling
+    const bool tropical = std::fabs(double(latitude)) < Tropic;
+    std::vector<int> warmHours;
+
+    int day = 0;
+    for (int month = 0; month < 12; ++month) {
+        const auto &sky = clearSky[month];
+        for (int dayOfMonth = 0; dayOfMonth < DaysInMonth[month]; ++dayOfMonth, ++day) {
+            const double declination = Tropic * Radian * std::sin(2 * Pi * (284 + day + 1) / 365);
+            const double sinDeclination = std::sin(declination);
+            const double cosDeclination = std::cos(declination);
+            const bool warm = tropical || sinDeclination * latitude > 0;
+
+            for (int hour = 0; hour < 24; ++hour) {
+                const double hourAngle = (hour - 12) * 15 * Radian;
+                // Direction of the sun as east, north and up components
+                const double up = cosLatitude * cosDeclination * std::cos(hourAngle) + sinLatitude * sinDeclination;
+                const double east = -cosDeclination * std::sin(hourAngle);
+                const double north = cosLatitude * sinDeclination - sinLatitude * cosDeclination * std::cos(hourAngle);
+
+                SolarIrradiance &sun = table->hours[day * 24 + hour];
+                if (up <= 0)
+                    continue;
+                const double direct = sky.a * std::exp(-sky.b / up);
+                // A vertical surface sees half the sky and half the ground
+                const double diffuse = sky.c * direct / 2 + GroundReflectance * direct * (up + sky.c) / 2;
+                sun.north = diffuse + direct * std::max(0.0, north);
+                sun.east = diffuse + direct * std::max(0.0, east);
+                sun.south = diffuse + direct * std::max(0.0, -north);
+                sun.west = diffuse + direct * std::max(0.0, -east);
+                if (warm)
+                    warmHours.push_back(day * 24 + hour);
+            }
+        }
+    }
+
+    // In order of total irradiance an hour can only be outdone by one before it, and
+    // anything outdoing a dropped hour is itself kept or outdone by a kept one
+    std::stable_sort(warmHours.begin(), warmHours.end(), [&table](int a, int b) {
+        return total(table->hours[a]) > total(table->hours[b]);
+    });
+    std::vector<int> kept;
+    for (int hour : warmHours) {
+        const SolarIrradiance &sun = table->hours[hour];
+        const bool outdone = std::any_of(kept.begin(), kept.end(), [&](int other) {
+            return noSunnier(sun, table->hours[other]);
+        });
+        if (!outdone)
+            kept.push_back(hour);
+    }
+
+    // The same time of day on nearby days has the sun in nearly the same place,
+    // which keeps each node's bound close to the hours below it
+    std::sort(kept.begin(), kept.end(), [](int a, int b) {
+        return a % 24 != b % 24 ? a % 24 < b % 24 : a < b;
+    });
+    table->candidateHours = kept;
+    table->levels.emplace_back();
+    for (size_t i = 0; i < kept.size(); ++i) {
+        const SolarIrradiance &sun = table->hours[kept[i]];
+        table->levels.back().push_back(sun);
+        table->least = i ? lesser(table->least, sun) : sun;
+        table->most = greater(table->most, sun);
+    }
+    while (table->levels.back().size() > SolarTreeFanOut) {
+        const std::vector<SolarIrradiance> &below = table->levels.back();
+        std::vector<SolarIrradiance> level;
+        for (size_t i = 0; i < below.size(); ++i) {
+            if (i % SolarTreeFanOut == 0)
+                level.push_back(below[i]);
+            level.back() = greater(level.back(), below[i]);
+        }
+        table->levels.push_back(std::move(level));
+    }
+    return table;
+}
+
+struct Weights
+{
+    double north, east, south, west;
+
+    double gain(const SolarIrradiance &sun) const
+    {
+        return north * sun.north + east * sun.east + south * sun.south + west * sun.west;
+    }
+};
+
+// Best first through the bound tree, leaving out whatever cannot beat the peak so far
+struct PeakSearch
+{
+    const SolarTable &table;
+    const Weights &weights;
+    const SolarIrradiance *peak = nullptr;
+    double peakGain = -1;
+
+    // Looks at the up to SolarTreeFanOut siblings of a level starting at first
+    void visit(size_t level, size_t first)
+    {
+        const std::vector<SolarIrradiance> &entries = table.levels[level];
+        if (first >= entries.size())
+            return;
+        const size_t count = std::min<size_t>(SolarTreeFanOut, entries.size() - first);
+        double gains[SolarTreeFanOut];
+        for (size_t i = 0; i < count; ++i)
+            gains[i] = weights.gain(entries[first + i]);
+
+        if (level == 0) {
+            for (size_t i = 0; i < count; ++i) {
+                if (gains[i] > peakGain) {
+                    peakGain = gains[i];
+                    peak = &entries[first + i];
+                }
+            }
+            return;
+        }
+        for (size_t n = 0; n < count; ++n) {
+            size_t best = count;
+            for (size_t i = 0; i < count; ++i) {
+                if (gains[i] > peakGain && (best == count || gains[i] > gains[best]))
+                    best = i;
+            }
+            if (best == count)
+                return;
+            gains[best] = -1; // below any gain, so it is not picked again
+            visit(level - 1, (first + best) * SolarTreeFanOut);
+        }
+    }
+};
+
+int bandOf(double latitude)
+{
+    return int(std::lround(std::clamp(latitude, -90.0, 90.0))) - LowestBand;
+}
+
+WindowGainFactors scaled(const SolarIrradiance &sun, double g)
+{
+    // Gains are quoted for unshaded windows and shading keeps its rule-of-thumb ratio
+    const double scale = g * GlazedFraction * StorageFactor * WattBTU / UnshadedFactor;
+    return {sun.north * scale, sun.east * scale, sun.south * scale, sun.west * scale};
+}
+
+} // namespace
+
+
+const SolarTable &solarTable(double latitude)
+{
+    const int band = bandOf(latitude);
+    if (const SolarTable *table = tables[band].load(std::memory_order_acquire))
+        return *table;
+
+    std::lock_guard<std::mutex> lock(buildMutex);
+    if (!builtTables[band]) {
+        builtTables[band] = buildTable(band + LowestBand);
+        tables[band].store(builtTables[band].get(), std::memory_order_release);
+    }
+    return *builtTables[band];
+}
+
+WindowGainFactors windowGainFactors(const RoomInput &input)
+{
+    if (!input.latitude || !std::isfinite(*input.latitude))
+        return WindowGainFactors();
+
+    const SolarTable &table = solarTable(*input.latitude);
+    // The bounds only hold for weights of zero or more
+    auto weight = [](double area, bool shaded) { return std::max(0.0, area) * (shaded ? 1.0 : UnshadedFactor); };
+    const Weights weights = {
+        weight(input.northWindowArea, input.northShaded), weight(input.eastWindowArea, input.eastShaded),
+        weight(input.southWindowArea, input.southShaded), weight(input.westWindowArea, input.westShaded),
+    };
+    PeakSearch search{table, weights};
+    search.visit(table.levels.size() - 1, 0);
+    return scaled(search.peak ? *search.peak : SolarIrradiance(), input.windowG);
+}
+
+void windowGainRange(double lowLatitude, double highLatitude, double lowG, double highG,
+                     WindowGainFactors &least, WindowGainFactors &most)
+{
+    SolarIrradiance lowSun;
+    SolarIrradiance highSun;
+    bool first = true;
+    for (int band = bandOf(lowLatitude); band <= bandOf(highLatitude); ++band) {
+        const SolarTable &table = solarTable(band + LowestBand);
+        lowSun = first ? table.least : lesser(lowSun, table.least);
+        highSun = greater(highSun, table.most);
+        first = false;
+    }
+
+    // Products are monotonic in each factor even after rounding, so the corners bound them
+    const WindowGainFactors corners[] = {
+        scaled(lowSun, lowG), scaled(lowSun, highG), scaled(highSun, lowG), scaled(highSun, highG),
+    };
+    least = most = corners[0];
+    for (const WindowGainFactors &corner : corners) {
+        least = {std::min(least.north, corner.north), std::min(least.east, corner.east),
+                 std::min(least.south, corner.south), std::min(least.west, corner.west)};
+        most = {std::max(most.north, corner.north), std::max(most.east, corner.east),
+                std::max(most.south, corner.south), std::max(most.west, corner.west)};
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef SOLARGAIN_H
+#define SOLARGAIN_H
+
+#include <vector>
+
+#include "loadcalc.h"
+
+// Window cooling gains from the position of the sun rather than fixed factors
+// per orientation. For each 1 degree latitude band, the clear-sky irradiance on
+// north, east, south and west facing glass is worked out for every hour of the
+// year (ASHRAE clear-sky model, 20% ground reflectance) once, and the table is
+// shared by every room in that band. The gain per m2 of window is the
+// irradiance through its glazed part, times the glazing's g-value and the
+// share of it that shows up in the room's air by the peak hour.
+//
+// A room's peak is the warm-season hour at which its windows, weighted by area
+// and shading, take the most sun together. An hour that is no sunnier than some
+// other hour on every orientation can never be that peak, so each table keeps
+// only the remaining hours as candidates. Similar candidates are grouped into a
+// small tree whose nodes hold the most each orientation gets anywhere below them,
+// and the search per room passes over every node that cannot beat the best hour
+// found so far, so it typically looks at a few dozen entries.
+
+const int HoursPerYear = 8760;
+
+// W/m2 on vertical glass facing each way
+struct SolarIrradiance
+{
+    double north = 0;
+    double east = 0;
+    double south = 0;
+    double west = 0;
+};
+
+struct SolarTable
+{
+    int latitude = 0; // band centre, degrees north
+    std::vector<SolarIrradiance> hours; // HoursPerYear, hour 0 at midnight solar time on 1 January
+    std::vector<int> candidateHours; // the hours that can be a peak
+    // levels[0] holds the candidates' irradiance; each entry of a higher level
+    // bounds SolarTreeFanOut entries of the one below
+    std::vector<std::vector<SolarIrradiance>> levels;
+    SolarIrradiance least; // per orientation over the candidates, zero without any
+    SolarIrradiance most;
+};
+
+const int SolarTreeFanOut = 4;
+
+// The table for the band a latitude falls in, built on first use
+const SolarTable &solarTable(double latitude);
+
+// Cooling gain per m2 of window (BTU/h) facing each way, before the shading
+// multiplier. Without a latitude these are the rule-of-thumb factors.
+struct WindowGainFactors
+{
+    double north = 164;
+    double east = 625;
+    double south = 868;
+    double west = 625;
+};
+
+WindowGainFactors windowGainFactors(const RoomInput &input);
+
+// The least and most windowGainFactors() gives for any windows and shading, at
+// latitudes and g-values within the ranges given
+void windowGainRange(double lowLatitude, double highLatitude, double lowG, double highG,
+                     WindowGainFactors &least, WindowGainFactors &most);
+
+#endif // SOLARGAIN_H
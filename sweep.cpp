@@ -0,0 +1,495 @@
+#include "sweep.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iterator>
+#include <limits>
+#include <mutex>
+
+#include "batchio.h"
+#include "loadkernel.h"
+#include "solargain.h"
+#include "workpool.h"
+
+namespace {
+
+// Points handed to the sink at a time
+const size_t SinkBlock = 4096;
+
+// Tasks per thread, so that uneven branches still balance
+const uint64_t TasksPerThread = 16;
+
+// Bounds of a value over every option still open, run through the same
+// formulas as the batch kernel to bound the loads of a whole branch
+struct IntervalLanes
+{
+    static const size_t Width = 1;
+    double lo;
+    double hi;
+
+    static IntervalLanes hull(double a, double b, double c, double d)
+    {
+        return {std::min(std::min(a, b), std::min(c, d)), std::max(std::max(a, b), std::max(c, d))};
+    }
+
+    static IntervalLanes load(const double *p) { return {p[0], p[1]}; }
+    static IntervalLanes set(double x) { return {x, x}; }
+    void store(double *p) const { p[0] = lo; p[1] = hi; }
+    friend IntervalLanes operator+(IntervalLanes a, IntervalLanes b) { return {a.lo + b.lo, a.hi + b.hi}; }
+    friend IntervalLanes operator-(IntervalLanes a, IntervalLanes b) { return {a.lo - b.hi, a.hi - b.lo}; }
+    friend IntervalLanes operator*(IntervalLanes a, IntervalLanes b)
+    {
+        return hull(a.lo * b.lo, a.lo * b.hi, a.hi * b.lo, a.hi * b.hi);
+    }
+    friend IntervalLanes operator/(IntervalLanes a, IntervalLanes b)
+    {
+        if (b.lo <= 0 && b.hi >= 0)
+            return {-std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity()};
+        return hull(a.lo / b.lo, a.lo / b.hi, a.hi / b.lo, a.hi / b.hi);
+    }
+    static IntervalLanes abs(IntervalLanes a)
+    {
+        if (a.lo >= 0)
+            return a;
+        if (a.hi <= 0)
+            return {-a.hi, -a.lo};
+        return {0, std::max(-a.lo, a.hi)};
+    }
+    static IntervalLanes select(IntervalLanes flag, IntervalLanes a, IntervalLanes b)
+    {
+        if (flag.lo == flag.hi)
+            return flag.lo != 0 ? a : b;
+        return {std::min(a.lo, b.lo), std::max(a.hi, b.hi)};
+    }
+    static IntervalLanes positive(IntervalLanes a)
+    {
+        return {a.lo > 0 ? 1.0 : 0.0, a.hi > 0 ? 1.0 : 0.0};
+    }
+    // Only the lower bound is used. It is nudged down so rounding can never lift it past an integer.
+    static void storeCeil(int32_t *p, IntervalLanes a)
+    {
+        p[0] = std::isfinite(a.lo) ? static_cast<int32_t>(std::ceil(a.lo - std::fabs(a.lo) * 1e-12))
+                                   : std::numeric_limits<int32_t>::min();
+        p[1] = std::isfinite(a.hi) ? static_cast<int32_t>(std::ceil(a.hi)) : std::numeric_limits<int32_t>::max();
+    }
+};
+
+// a is at least as good as (units, cost) on both counts; exact ties go to the lower combination
+bool covers(const SweepPoint &a, int units, double cost, uint64_t combination)
+{
+    return a.units() <= units && a.cost <= cost
+           && (a.units() < units || a.cost < cost || a.combination <= combination);
+}
+
+// The front is kept ordered by units with strictly falling cost, so the only
+// point that can cover (units, cost) is the cheapest one with no more units
+bool frontCovers(const std::vector<SweepPoint> &front, int units, double cost, uint64_t combination)
+{
+    auto after = std::upper_bound(front.begin(), front.end(), units,
+                                  [](int u, const SweepPoint &p) { return u < p.units(); });
+    return after != front.begin() && covers(*(after - 1), units, cost, combination);
+}
+
+void addToFront(std::vector<SweepPoint> &front, const SweepPoint &point)
+{
+    if (frontCovers(front, point.units(), point.cost, point.combination))
+        return;
+    auto first = std::lower_bound(front.begin(), front.end(), point.units(),
+                                  [](const SweepPoint &p, int u) { return p.units() < u; });
+    auto last = first;
+    while (last != front.end() && covers(point, last->units(), last->cost, last->combination))
+        ++last;
+    front.insert(front.erase(first, last), point);
+}
+
+struct SweepPlan
+{
+    std::vector<std::vector<int>> order; // option indexes of each axis, cheapest first
+    std::vector<double> minValue;
+    std::vector<double> maxValue;
+    std::vector<double> minCostFrom;  // cheapest total for axes [d, n)
+    std::vector<uint64_t> gridFrom;   // combinations of axes [d, n)
+};
+
+class SweepSearch
+{
+public:
+    SweepSearch(const RoomInput &base, const std::vector<SweepAxis> &axes, const SweepPlan &plan,
+                const SweepOptions &options, const std::function<void(const std::vector<SweepPoint> &)> &flush)
+        : axes(axes)
+        , plan(plan)
+        , options(options)
+        , flush(flush)
+        , input(base)
+    {
+        pending.reserve(SinkBlock);
+    }
+
+    // Runs the branch below a fixed choice (by cost rank) on each of the first depth axes
+    void runBranch(uint64_t prefix, size_t depth)
+    {
+        std::vector<int> chosen(depth);
+        for (size_t d = depth; d-- > 0;) {
+            const uint64_t size = axes[d].options.size();
+            chosen[d] = plan.order[d][prefix % size];
+            prefix /= size;
+        }
+        // Summed in axis order, as visit() does, so costs do not depend on how the grid was split
+        uint64_t combination = 0;
+        double cost = 0;
+        for (size_t d = 0; d < depth; ++d) {
+            const SweepOption &option = axes[d].options[chosen[d]];
+            setRoomFieldValue(input, axes[d].field, option.value);
+            cost += option.cost;
+            combination = combination * axes[d].options.size() + chosen[d];
+        }
+        visit(depth, combination, cost);
+        flushPending();
+    }
+
+    bool cancelled() const { return stopped; }
+
+    std::vector<SweepPoint> front;
+    uint64_t evaluated = 0;
+    uint64_t skipped = 0;
+    uint64_t prunedBranches = 0;
+
+private:
+    void visit(size_t depth, uint64_t combination, double cost)
+    {
+        if (stopped)
+            return;
+        if (depth == axes.size()) {
+            evaluate(combination, cost);
+            return;
+        }
+        if (options.prune && depth + 1 < axes.size() && cannotImprove(depth, combination, cost)) {
+            ++prunedBranches;
+            skipped += plan.gridFrom[depth];
+            if (options.done)
+                options.done->fetch_add(plan.gridFrom[depth], std::memory_order_relaxed);
+            return;
+        }
+
+        const SweepAxis &axis = axes[depth];
+        const uint64_t size = axis.options.size();
+        for (int option : plan.order[depth]) {
+            const SweepOption &chosen = axis.options[option];
+            setRoomFieldValue(input, axis.field, chosen.value);
+            visit(depth + 1, combination * size + option, cost + chosen.cost);
+        }
+    }
+
+    void evaluate(uint64_t combination, double cost)
+    {
+        RoomLoads loads = calculateRoomLoads(input);
+        SweepPoint point;
+        point.combination = combination;
+        point.cost = cost;
+        point.coolingUnits = loads.coolingUnits;
+        point.heatingUnits = loads.heatingUnits;
+        point.peakCoolingWatt = loads.peakCoolingWatt;
+        point.peakHeatingWatt = loads.peakHeatingWatt;
+        addToFront(front, point);
+
+        ++evaluated;
+        pending.push_back(point);
+        if (pending.size() == SinkBlock)
+            flushPending();
+    }
+
+    void flushPending()
+    {
+        if (options.done)
+            options.done->fetch_add(pending.size(), std::memory_order_relaxed);
+        if (!pending.empty())
+            flush(pending);
+        pending.clear();
+        if (options.cancel && options.cancel->load(std::memory_order_relaxed))
+            stopped = true;
+    }
+
+    // True when an axis from depth on changes a field the peak sun hour depends on
+    bool movesSolarPeak(size_t depth) const
+    {
+        static const int fields[] = {
+            roomFieldIndex("northWindowArea"), roomFieldIndex("eastWindowArea"),
+            roomFieldIndex("southWindowArea"), roomFieldIndex("westWindowArea"),
+            roomFieldIndex("northShaded"), roomFieldIndex("eastShaded"),
+            roomFieldIndex("southShaded"), roomFieldIndex("westShaded"),
+            roomFieldIndex("latitude"),
+        };
+        for (size_t d = depth; d < axes.size(); ++d) {
+            if (std::find(std::begin(fields), std::end(fields), axes[d].field) != std::end(fields))
+                return true;
+        }
+        return false;
+    }
+
+    // True when no combination below this branch can get onto the front
+    bool cannotImprove(size_t depth, uint64_t combination, double cost)
+    {
+        RoomInput lowest = input;
+        RoomInput highest = input;
+        for (size_t d = depth; d < axes.size(); ++d) {
+            setRoomFieldValue(lowest, axes[d].field, plan.minValue[d]);
+            setRoomFieldValue(highest, axes[d].field, plan.maxValue[d]);
+        }
+        bounds.clear();
+        bounds.append(lowest);
+        bounds.append(highest);
+
+        double in[RoomBatch::ColumnCount][2];
+        for (int c = 0; c < RoomBatch::ColumnCount; ++c) {
+            in[c][0] = std::min(bounds.columns[c][0], bounds.columns[c][1]);
+            in[c][1] = std::max(bounds.columns[c][0], bounds.columns[c][1]);
+        }
+
+        // Estimated areas are not monotonic in the room size (windows come off the
+        // walls), so bound them from the dimensions rather than from the two rooms
+        typedef IntervalLanes I;
+        typedef RoomBatch R;
+        auto column = [&](R::Column c) { return I::load(in[c]); };
+        const I ceiling = column(R::Length) * column(R::Width);
+        const I window = column(R::NorthWindowArea) + column(R::EastWindowArea)
+                         + column(R::SouthWindowArea) + column(R::WestWindowArea);
+        const I wall = I::set(2) * column(R::Length) * column(R::Height)
+                       + I::set(2) * column(R::Width) * column(R::Height) - window;
+        if (!lowest.wallArea)
+            wall.store(in[R::WallArea]);
+        if (!lowest.windowArea)
+            window.store(in[R::WindowArea]);
+        if (!lowest.ceilingArea)
+            ceiling.store(in[R::CeilingArea]);
+        if (!lowest.floorArea)
+            ceiling.store(in[R::FloorArea]);
+
+        // The peak sun hour moves with the whole window layout, so solar gains are
+        // bounded by what any layout could get rather than by the two rooms
+        if (lowest.latitude && highest.latitude && movesSolarPeak(depth)) {
+            WindowGainFactors least;
+            WindowGainFactors most;
+            windowGainRange(std::min(*lowest.latitude, *highest.latitude), std::max(*lowest.latitude, *highest.latitude),
+                            std::min(lowest.windowG, highest.windowG), std::max(lowest.windowG, highest.windowG),
+                            least, most);
+            const double WindowGainFactors::*gains[] = {
+                &WindowGainFactors::north, &WindowGainFactors::east, &WindowGainFactors::south, &WindowGainFactors::west,
+            };
+            const R::Column columns[] = {R::NorthGain, R::EastGain, R::SouthGain, R::WestGain};
+            for (int o = 0; o < 4; ++o) {
+                in[columns[o]][0] = least.*gains[o];
+                in[columns[o]][1] = most.*gains[o];
+            }
+        }
+
+        double out[LoadBatch::ColumnCount][2];
+        int32_t coolingUnits[2];
+        int32_t heatingUnits[2];
+        KernelArgs args;
+        for (int c = 0; c < RoomBatch::ColumnCount; ++c)
+            args.in[c] = in[c];
+        for (int c = 0; c < LoadBatch::ColumnCount; ++c)
+            args.out[c] = out[c];
+        args.coolingUnits = coolingUnits;
+        args.heatingUnits = heatingUnits;
+        calculateLoadLanes<IntervalLanes>(args, 0);
+
+        const int leastUnits = coolingUnits[0] + heatingUnits[0];
+        const uint64_t firstCombination = combination * plan.gridFrom[depth];
+        // Leaves add their costs one at a time, so allow for rounding in the cheapest total
+        const double leastCost = cost + plan.minCostFrom[depth];
+        return frontCovers(front, leastUnits, leastCost - std::fabs(leastCost) * 1e-12, firstCombination);
+    }
+
+    const std::vector<SweepAxis> &axes;
+    const SweepPlan &plan;
+    const SweepOptions &options;
+    const std::function<void(const std::vector<SweepPoint> &)> &flush;
+    RoomInput input;
+    RoomBatch bounds;
+    std::vector<SweepPoint> pending;
+    bool stopped = false;
+};
+
+} // namespace
+
+
+bool parseSweepAxis(std::string_view spec, SweepAxis &axis, std::string &error)
+{
+    axis = SweepAxis();
+    const size_t equals = spec.find('=');
+    if (equals == std::string_view::npos) {
+        error = "expected field=options in \"" + std::string(spec) + "\"";
+        return false;
+    }
+    axis.field = roomFieldIndex(spec.substr(0, equals));
+    if (axis.field < 0) {
+        error = "unknown field \"" + std::string(spec.substr(0, equals)) + "\"";
+        return false;
+    }
+    std::string_view list = spec.substr(equals + 1);
+
+    auto splitCost = [&](std::string_view item, std::string_view &valueText, double &cost) {
+        const size_t at = item.find('@');
+        valueText = item.substr(0, at);
+        cost = 0;
+        return at == std::string_view::npos || parseNumber(item.substr(at + 1), cost);
+    };
+
+    // Range: min..max/step@costPerUnit
+    const size_t dots = list.find("..");
+    if (dots != std::string_view::npos && list.find(',') == std::string_view::npos) {
+        std::string_view range;
+        double rate = 0;
+        double low = 0;
+        double high = 0;
+        double step = 0;
+        const bool parsed = splitCost(list, range, rate);
+        const size_t slash = range.find('/');
+        if (!parsed || slash == std::string_view::npos || !parseNumber(range.substr(0, dots), low)
+            || !parseNumber(range.substr(dots + 2, slash - dots - 2), high)
+            || !parseNumber(range.substr(slash + 1), step) || step <= 0 || high < low) {
+            error = "expected min..max/step[@costPerUnit] in \"" + std::string(spec) + "\"";
+            return false;
+        }
+        const long long steps = std::llround(std::floor((high - low) / step + 1e-9));
+        if (steps >= 1 << 20) {
+            error = "too many steps in \"" + std::string(spec) + "\"";
+            return false;
+        }
+        for (long long i = 0; i <= steps; ++i) {
+            const double value = low + i * step;
+            axis.options.push_back({value, rate * (value - low), std::string()});
+        }
+        return true;
+    }
+
+    while (!list.empty()) {
+        const size_t comma = list.find(',');
+        std::string_view item = list.substr(0, comma);
+        list = comma == std::string_view::npos ? std::string_view() : list.substr(comma + 1);
+
+        SweepOption option{0, 0, std::string()};
+        std::string_view valueText;
+        const bool parsed = splitCost(item, valueText, option.cost);
+        const size_t colon = valueText.rfind(':');
+        if (colon != std::string_view::npos) {
+            option.label = std::string(valueText.substr(0, colon));
+            valueText.remove_prefix(colon + 1);
+        }
+        if (!parsed || !parseNumber(valueText, option.value)) {
+            error = "bad option \"" + std::string(item) + "\"";
+            return false;
+        }
+        axis.options.push_back(std::move(option));
+    }
+    if (axis.options.empty()) {
+        error = "no options in \"" + std::string(spec) + "\"";
+        return false;
+    }
+    return true;
+}
+
+void decodeCombination(const std::vector<SweepAxis> &axes, uint64_t combination, std::vector<int> &choices)
+{
+    choices.resize(axes.size());
+    for (size_t d = axes.size(); d-- > 0;) {
+        choices[d] = static_cast<int>(combination % axes[d].options.size());
+        combination /= axes[d].options.size();
+    }
+}
+
+uint64_t sweepCombinations(const std::vector<SweepAxis> &axes)
+{
+    const uint64_t limit = uint64_t(1) << 63;
+    uint64_t total = 1;
+    for (const SweepAxis &axis : axes) {
+        if (axis.options.empty() || total > limit / axis.options.size())
+            return 0;
+        total *= axis.options.size();
+    }
+    return total;
+}
+
+std::vector<SweepPoint> runSweep(const RoomInput &base, const std::vector<SweepAxis> &axes,
+                                 const SweepOptions &options, const SweepSink &sink, SweepStats &stats)
+{
+    const auto started = std::chrono::steady_clock::now();
+    stats = SweepStats();
+    stats.combinations = sweepCombinations(axes);
+    if (stats.combinations == 0)
+        return {};
+
+    SweepPlan plan;
+    const size_t depth = axes.size();
+    plan.order.resize(depth);
+    plan.minValue.resize(depth);
+    plan.maxValue.resize(depth);
+    plan.minCostFrom.assign(depth + 1, 0);
+    plan.gridFrom.assign(depth + 1, 1);
+    for (size_t d = 0; d < depth; ++d) {
+        const std::vector<SweepOption> &choices = axes[d].options;
+        std::vector<int> &order = plan.order[d];
+        for (size_t i = 0; i < choices.size(); ++i)
+            order.push_back(static_cast<int>(i));
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return choices[a].cost < choices[b].cost; });
+        plan.minValue[d] = plan.maxValue[d] = choices[0].value;
+        for (const SweepOption &choice : choices) {
+            plan.minValue[d] = std::min(plan.minValue[d], choice.value);
+            plan.maxValue[d] = std::max(plan.maxValue[d], choice.value);
+        }
+    }
+    for (size_t d = depth; d-- > 0;) {
+        plan.minCostFrom[d] = plan.minCostFrom[d + 1] + axes[d].options[plan.order[d][0]].cost;
+        plan.gridFrom[d] = plan.gridFrom[d + 1] * axes[d].options.size();
+    }
+
+    std::mutex sinkMutex;
+    const std::function<void(const std::vector<SweepPoint> &)> flush = [&](const std::vector<SweepPoint> &points) {
+        if (!sink)
+            return;
+        std::lock_guard<std::mutex> lock(sinkMutex);
+        sink(points.data(), points.size());
+    };
+
+    WorkPool pool(options.threads);
+
+    // Fix enough leading axes to give every thread several branches
+    size_t prefixDepth = 0;
+    uint64_t prefixes = 1;
+    while (prefixDepth < depth && prefixes < TasksPerThread * pool.threadCount())
+        prefixes *= axes[prefixDepth++].options.size();
+    const uint64_t tasks = std::min<uint64_t>(prefixes, TasksPerThread * pool.threadCount());
+
+    std::mutex frontMutex;
+    std::vector<SweepPoint> front;
+    for (uint64_t task = 0; task < tasks; ++task) {
+        pool.submit([&, task]() {
+            SweepSearch search(base, axes, plan, options, flush);
+            for (uint64_t prefix = prefixes * task / tasks; prefix < prefixes * (task + 1) / tasks; ++prefix) {
+                {
+                    std::lock_guard<std::mutex> lock(frontMutex);
+                    for (const SweepPoint &point : search.front)
+                        addToFront(front, point);
+                    search.front = front;
+                }
+                search.runBranch(prefix, prefixDepth);
+                if (search.cancelled())
+                    break;
+            }
+
+            std::lock_guard<std::mutex> lock(frontMutex);
+            for (const SweepPoint &point : search.front)
+                addToFront(front, point);
+            stats.evaluated += search.evaluated;
+            stats.skipped += search.skipped;
+            stats.prunedBranches += search.prunedBranches;
+            stats.cancelled = stats.cancelled || search.cancelled();
+        });
+    }
+    pool.wait();
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    return front;
+}
@@ -0,0 +1,82 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "loadcalc.h"
+
+// Parametric sweep over the cartesian grid of input options, looking for the
+// Pareto front of total unit count (cooling + heating) against upgrade cost.
+// Branches whose best possible unit count, bounded with interval arithmetic
+// over the remaining options, cannot beat the front at their lowest possible
+// cost are skipped without being evaluated.
+
+struct SweepOption
+{
+    double value;
+    double cost;
+    std::string label;
+};
+
+// One input varied by the sweep; field is a roomFieldIndex()
+struct SweepAxis
+{
+    int field = -1;
+    std::vector<SweepOption> options;
+};
+
+// Parses "field=value@cost,..." (each item may be prefixed with "label:") or
+// "field=min..max/step@costPerUnit", where each step costs costPerUnit times its
+// distance from min. Costs default to 0.
+bool parseSweepAxis(std::string_view spec, SweepAxis &axis, std::string &error);
+
+struct SweepPoint
+{
+    uint64_t combination = 0; // mixed radix index, first axis most significant
+    double cost = 0;
+    int coolingUnits = 0;
+    int heatingUnits = 0;
+    double peakCoolingWatt = 0;
+    double peakHeatingWatt = 0;
+
+    int units() const { return coolingUnits + heatingUnits; }
+};
+
+// Option index chosen on each axis for a combination
+void decodeCombination(const std::vector<SweepAxis> &axes, uint64_t combination, std::vector<int> &choices);
+
+// Number of grid points, 0 if there are more than fit in 63 bits
+uint64_t sweepCombinations(const std::vector<SweepAxis> &axes);
+
+struct SweepOptions
+{
+    unsigned threads = 0; // 0 = one per hardware thread
+    bool prune = true;    // false evaluates (and reports) every combination
+    const std::atomic<bool> *cancel = nullptr;
+    std::atomic<uint64_t> *done = nullptr; // combinations evaluated or skipped so far
+};
+
+struct SweepStats
+{
+    uint64_t combinations = 0;
+    uint64_t evaluated = 0;
+    uint64_t skipped = 0;
+    uint64_t prunedBranches = 0;
+    double seconds = 0;
+    bool cancelled = false;
+};
+
+// Receives evaluated points in blocks, one call at a time, in no particular order
+typedef std::function<void(const SweepPoint *points, size_t count)> SweepSink;
+
+// Returns the front ordered by unit count, cheapest first. Of several
+// combinations with the same units and cost, only one is kept.
+std::vector<SweepPoint> runSweep(const RoomInput &base, const std::vector<SweepAxis> &axes,
+                                 const SweepOptions &options, const SweepSink &sink, SweepStats &stats);
+
+#endif // SWEEP_H
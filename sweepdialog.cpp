@@ -0,0 +1,266 @@
+#include "sweepdialog.h"
+
+#include <QCheckBox>
+#include <QDoubleSpinBox>
+#include <QGridLayout>
+#include <QGroupBox>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QProgressBar>
+#include <QPushButton>
+#include <QTableWidget>
+#include <QThread>
+#include <QTimer>
+#include <QVBoxLayout>
+
+#include <algorithm>
+
+#include "batchio.h"
+
+namespace {
+
+enum OptionColumn { InputColumn, OptionColumn, ValueColumn, CostColumn };
+
+const int FieldRole = Qt::UserRole;
+const int ValueRole = Qt::UserRole + 1;
+
+} // namespace
+
+
+SweepDialog::SweepDialog(const RoomInput &room, const QList<SweepCatalog> &catalogs, QWidget *parent)
+    : QDialog(parent)
+    , room(room)
+{
+    setWindowTitle(tr("Sweep and optimise"));
+    resize(760, 720);
+    QVBoxLayout *layout = new QVBoxLayout(this);
+
+    // Catalog options, one row each, grouped by input
+    QGroupBox *optionBox = new QGroupBox(tr("Options to try (untick to leave out, cost of choosing each)"), this);
+    QVBoxLayout *optionLayout = new QVBoxLayout(optionBox);
+    optionTable = new QTableWidget(0, 4, optionBox);
+    optionTable->setHorizontalHeaderLabels({tr("Input"), tr("Option"), tr("Value"), tr("Cost")});
+    optionTable->horizontalHeader()->setSectionResizeMode(OptionColumn, QHeaderView::Stretch);
+    optionTable->verticalHeader()->hide();
+    for (const SweepCatalog &catalog : catalogs) {
+        for (const auto &entry : catalog.entries) {
+            const int row = optionTable->rowCount();
+            optionTable->insertRow(row);
+            QTableWidgetItem *input = new QTableWidgetItem(catalog.title);
+            input->setFlags(Qt::ItemIsEnabled | Qt::ItemIsUserCheckable);
+            input->setCheckState(Qt::Checked);
+            input->setData(FieldRole, catalog.field);
+            input->setData(ValueRole, entry.second);
+            optionTable->setItem(row, InputColumn, input);
+            QTableWidgetItem *option = new QTableWidgetItem(entry.first);
+            option->setFlags(Qt::ItemIsEnabled);
+            optionTable->setItem(row, OptionColumn, option);
+            QTableWidgetItem *value = new QTableWidgetItem(QString::number(entry.second, 'f', 2));
+            value->setFlags(Qt::ItemIsEnabled);
+            optionTable->setItem(row, ValueColumn, value);
+            optionTable->setItem(row, CostColumn, new QTableWidgetItem("0"));
+        }
+    }
+    optionLayout->addWidget(optionTable);
+    layout->addWidget(optionBox, 2);
+
+    // Equipment capacity ranges
+    QGroupBox *capacityBox = new QGroupBox(tr("Unit capacity (cost per W above the minimum)"), this);
+    QGridLayout *capacityLayout = new QGridLayout(capacityBox);
+    capacityLayout->addWidget(new QLabel(tr("Minimum (W)")), 0, 1);
+    capacityLayout->addWidget(new QLabel(tr("Maximum (W)")), 0, 2);
+    capacityLayout->addWidget(new QLabel(tr("Step (W)")), 0, 3);
+    capacityLayout->addWidget(new QLabel(tr("Cost per W")), 0, 4);
+    addCapacityRange(capacityLayout, 1, tr("Cooling capacity"), roomFieldIndex("coolCapacity"), room.coolCapacity);
+    addCapacityRange(capacityLayout, 2, tr("Heating capacity"), roomFieldIndex("heatCapacity"), room.heatCapacity);
+    layout->addWidget(capacityBox);
+
+    QHBoxLayout *runLayout = new QHBoxLayout;
+    runButton = new QPushButton(tr("Run sweep"), this);
+    cancelButton = new QPushButton(tr("Cancel"), this);
+    progressBar = new QProgressBar(this);
+    progressBar->setRange(0, 1000);
+    runLayout->addWidget(runButton);
+    runLayout->addWidget(cancelButton);
+    runLayout->addWidget(progressBar, 1);
+    layout->addLayout(runLayout);
+
+    statusLabel = new QLabel(this);
+    layout->addWidget(statusLabel);
+
+    frontTable = new QTableWidget(0, 0, this);
+    frontTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    frontTable->verticalHeader()->hide();
+    layout->addWidget(frontTable, 3);
+
+    progressTimer = new QTimer(this);
+    progressTimer->setInterval(100);
+
+    connect(runButton, &QPushButton::clicked, this, &SweepDialog::start);
+    connect(cancelButton, &QPushButton::clicked, this, &SweepDialog::cancel);
+    connect(progressTimer, &QTimer::timeout, this, &SweepDialog::showProgress);
+    setRunning(false);
+}
+
+SweepDialog::~SweepDialog()
+{
+    if (sweepThread) {
+        cancelled.store(true);
+        sweepThread->wait();
+        delete sweepThread;
+    }
+}
+
+void SweepDialog::addCapacityRange(QGridLayout *layout, int row, const QString &title, int field, double current)
+{
+    auto spinBox = [this](double value, double maximum) {
+        QDoubleSpinBox *box = new QDoubleSpinBox(this);
+        box->setRange(0, maximum);
+        box->setDecimals(2);
+        box->setValue(value);
+        return box;
+    };
+
+    CapacityRange range;
+    range.field = field;
+    range.enabled = new QCheckBox(title, this);
+    range.minimum = spinBox(current / 2, 1e6);
+    range.maximum = spinBox(current * 2, 1e6);
+    range.step = spinBox(std::max(current / 10, 1.0), 1e6);
+    range.costPerWatt = spinBox(0, 1e3);
+    layout->addWidget(range.enabled, row, 0);
+    layout->addWidget(range.minimum, row, 1);
+    layout->addWidget(range.maximum, row, 2);
+    layout->addWidget(range.step, row, 3);
+    layout->addWidget(range.costPerWatt, row, 4);
+    capacityRanges.append(range);
+}
+
+// Ticked rows become one axis per input, in table order
+std::vector<SweepAxis> SweepDialog::selectedAxes() const
+{
+    std::vector<SweepAxis> selected;
+    for (int row = 0; row < optionTable->rowCount(); ++row) {
+        const QTableWidgetItem *input = optionTable->item(row, InputColumn);
+        if (input->checkState() != Qt::Checked)
+            continue;
+        const int field = input->data(FieldRole).toInt();
+        if (selected.empty() || selected.back().field != field) {
+            selected.emplace_back();
+            selected.back().field = field;
+        }
+        SweepOption option;
+        option.value = input->data(ValueRole).toDouble();
+        option.cost = optionTable->item(row, CostColumn)->text().toDouble();
+        option.label = optionTable->item(row, OptionColumn)->text().toStdString();
+        selected.back().options.push_back(option);
+    }
+
+    for (const CapacityRange &range : capacityRanges) {
+        const double minimum = range.minimum->value();
+        const double maximum = range.maximum->value();
+        const double step = range.step->value();
+        if (!range.enabled->isChecked() || step <= 0 || maximum < minimum)
+            continue;
+        SweepAxis axis;
+        axis.field = range.field;
+        for (double value = minimum; value <= maximum + step * 1e-9; value += step)
+            axis.options.push_back({value, range.costPerWatt->value() * (value - minimum), std::string()});
+        selected.push_back(axis);
+    }
+    return selected;
+}
+
+void SweepDialog::setRunning(bool running)
+{
+    runButton->setEnabled(!running);
+    cancelButton->setEnabled(running);
+    optionTable->setEnabled(!running);
+    if (running)
+        progressTimer->start();
+    else
+        progressTimer->stop();
+}
+
+void SweepDialog::start()
+{
+    if (sweepThread)
+        return;
+
+    axes = selectedAxes();
+    const uint64_t combinations = sweepCombinations(axes);
+    if (axes.empty() || combinations == 0) {
+        statusLabel->setText(axes.empty() ? tr("Tick at least one option to sweep.") : tr("Too many combinations."));
+        return;
+    }
+
+    cancelled.store(false);
+    done.store(0);
+    progressBar->setValue(0);
+    statusLabel->setText(tr("Sweeping %1 combinations...").arg(combinations));
+    setRunning(true);
+
+    sweepThread = QThread::create([this]() {
+        SweepOptions options;
+        options.cancel = &cancelled;
+        options.done = &done;
+        front = runSweep(room, axes, options, SweepSink(), stats);
+    });
+    connect(sweepThread, &QThread::finished, this, &SweepDialog::showFront);
+    sweepThread->start();
+}
+
+void SweepDialog::cancel()
+{
+    cancelled.store(true);
+}
+
+void SweepDialog::showProgress()
+{
+    const uint64_t combinations = sweepCombinations(axes);
+    if (combinations > 0)
+        progressBar->setValue(static_cast<int>(1000.0 * done.load() / combinations));
+}
+
+void SweepDialog::showFront()
+{
+    sweepThread->deleteLater();
+    sweepThread = nullptr;
+    setRunning(false);
+    progressBar->setValue(stats.cancelled ? progressBar->value() : 1000);
+
+    QStringList headers = {tr("Units"), tr("Cost"), tr("Cooling Units"), tr("Heating Units")};
+    for (const SweepAxis &axis : axes)
+        headers << QString::fromLatin1(roomFieldName(axis.field));
+    frontTable->clear();
+    frontTable->setColumnCount(headers.size());
+    frontTable->setHorizontalHeaderLabels(headers);
+    frontTable->setRowCount(static_cast<int>(front.size()));
+
+    std::vector<int> choices;
+    for (int row = 0; row < frontTable->rowCount(); ++row) {
+        const SweepPoint &point = front[row];
+        decodeCombination(axes, point.combination, choices);
+        int column = 0;
+        frontTable->setItem(row, column++, new QTableWidgetItem(QString::number(point.units())));
+        frontTable->setItem(row, column++, new QTableWidgetItem(QString::number(point.cost, 'f', 2)));
+        frontTable->setItem(row, column++, new QTableWidgetItem(QString::number(point.coolingUnits)));
+        frontTable->setItem(row, column++, new QTableWidgetItem(QString::number(point.heatingUnits)));
+        for (size_t a = 0; a < axes.size(); ++a) {
+            const SweepOption &option = axes[a].options[choices[a]];
+            const QString text = option.label.empty() ? QString::number(option.value, 'f', 2)
+                                                      : QString::fromStdString(option.label);
+            frontTable->setItem(row, column++, new QTableWidgetItem(text));
+        }
+    }
+    frontTable->resizeColumnsToContents();
+
+    statusLabel->setText(tr("%1%2 of %3 combinations evaluated, %4 skipped by pruning, in %5 s. %6 on the front.")
+                             .arg(stats.cancelled ? tr("Cancelled. ") : QString())
+                             .arg(stats.evaluated)
+                             .arg(stats.combinations)
+                             .arg(stats.skipped)
+                             .arg(stats.seconds, 0, 'f', 2)
+                             .arg(front.size()));
+}
@@ -0,0 +1,84 @@
+#ifndef SWEEPDIALOG_H
+#define SWEEPDIALOG_H
+
+#include <QDialog>
+#include <QList>
+#include <QPair>
+#include <QString>
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "loadcalc.h"
+#include "sweep.h"
+
+class QCheckBox;
+class QDoubleSpinBox;
+class QGridLayout;
+class QLabel;
+class QProgressBar;
+class QPushButton;
+class QTableWidget;
+class QThread;
+class QTimer;
+
+// Named choices for one input, e.g. the wall materials offered in the main window
+struct SweepCatalog
+{
+    QString title;
+    int field; // roomFieldIndex()
+    QList<QPair<QString, double>> entries;
+};
+
+// Lets the user tick catalog options, give each a cost and set equipment
+// capacity ranges, then runs the sweep in the background and lists the
+// Pareto front of unit count against upgrade cost.
+class SweepDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    SweepDialog(const RoomInput &room, const QList<SweepCatalog> &catalogs, QWidget *parent = nullptr);
+    ~SweepDialog();
+
+private slots:
+    void start();
+    void cancel();
+    void showProgress();
+    void showFront();
+
+private:
+    struct CapacityRange
+    {
+        int field;
+        QCheckBox *enabled;
+        QDoubleSpinBox *minimum;
+        QDoubleSpinBox *maximum;
+        QDoubleSpinBox *step;
+        QDoubleSpinBox *costPerWatt;
+    };
+
+    void addCapacityRange(QGridLayout *layout, int row, const QString &title, int field, double current);
+    std::vector<SweepAxis> selectedAxes() const;
+    void setRunning(bool running);
+
+    RoomInput room;
+    QTableWidget *optionTable;
+    QList<CapacityRange> capacityRanges;
+    QTableWidget *frontTable;
+    QProgressBar *progressBar;
+    QLabel *statusLabel;
+    QPushButton *runButton;
+    QPushButton *cancelButton;
+    QTimer *progressTimer;
+
+    QThread *sweepThread = nullptr;
+    std::atomic<bool> cancelled{false};
+    std::atomic<uint64_t> done{0};
+    std::vector<SweepAxis> axes;
+    std::vector<SweepPoint> front;
+    SweepStats stats;
+};
+
+#endif // SWEEPDIALOG_H
@@ -0,0 +1,76 @@
+#ifndef UNITS_H
+#define UNITS_H
+
+// Strong unit types for the load calculation. Each quantity is its own type, so a
+// watt figure cannot be handed to something expecting BTU/h or an area passed as a
+// volume; everything is constexpr and compiles down to the same arithmetic as plain
+// doubles.
+
+constexpr double WattBTU = 3.412; // 1 watt = 3.412 BTU/hr
+constexpr double AirDensity = 1.225; // kg/m^3
+constexpr double AirSpecificHeat = 1006; // J/kg.K
+constexpr double FeetPerMetre = 3.2808399;
+constexpr double SecondsPerHour = 60*60;
+
+enum class OutputUnit { Watts, BTU };
+
+template <class Tag>
+class Quantity
+{
+public:
+    constexpr Quantity() = default;
+    constexpr explicit Quantity(double value) : amount(value) {}
+
+    constexpr double value() const { return amount; }
+
+    constexpr Quantity operator+(Quantity other) const { return Quantity(amount + other.amount); }
+    constexpr Quantity operator-(Quantity other) const { return Quantity(amount - other.amount); }
+    constexpr Quantity operator*(double factor) const { return Quantity(amount * factor); }
+    constexpr Quantity operator/(double divisor) const { return Quantity(amount / divisor); }
+    constexpr double operator/(Quantity other) const { return amount / other.amount; }
+
+    constexpr bool operator==(Quantity other) const { return amount == other.amount; }
+    constexpr bool operator<(Quantity other) const { return amount < other.amount; }
+
+private:
+    double amount = 0;
+};
+
+typedef Quantity<struct WattsTag> Watts;
+typedef Quantity<struct BtuPerHourTag> BtuPerHour;
+typedef Quantity<struct SquareMetresTag> SquareMetres;
+typedef Quantity<struct CubicMetresTag> CubicMetres;
+typedef Quantity<struct KelvinTag> Kelvin; // temperature differences
+typedef Quantity<struct AirChangesPerHourTag> AirChangesPerHour;
+
+constexpr BtuPerHour toBtuPerHour(Watts power) { return BtuPerHour(power.value() * WattBTU); }
+constexpr Watts toWatts(BtuPerHour power) { return Watts(power.value() / WattBTU); }
+
+// The cooling rules of thumb are per square foot
+constexpr double toSquareFeet(SquareMetres area) { return area.value() * FeetPerMetre * FeetPerMetre; }
+
+// Heat carried out by the air exchanged each hour, per kelvin of difference (W/K)
+constexpr double airExchangeCoefficient(AirChangesPerHour rate, CubicMetres volume)
+{
+    return AirDensity * AirSpecificHeat * (rate.value() / SecondsPerHour) * volume.value();
+}
+
+constexpr Watts airExchangeLoss(AirChangesPerHour rate, CubicMetres volume, Kelvin difference)
+{
+    return Watts(airExchangeCoefficient(rate, volume) * difference.value());
+}
+
+// The power type a unit choice is expressed in
+template <OutputUnit Unit> struct OutputQuantity;
+template <> struct OutputQuantity<OutputUnit::Watts> { typedef Watts Type; };
+template <> struct OutputQuantity<OutputUnit::BTU> { typedef BtuPerHour Type; };
+
+// Conversion between the two power types; converting to the same type is free
+template <class To> constexpr To convertPower(Watts power);
+template <class To> constexpr To convertPower(BtuPerHour power);
+template <> constexpr Watts convertPower<Watts>(Watts power) { return power; }
+template <> constexpr BtuPerHour convertPower<BtuPerHour>(Watts power) { return toBtuPerHour(power); }
+template <> constexpr Watts convertPower<Watts>(BtuPerHour power) { return toWatts(power); }
+template <> constexpr BtuPerHour convertPower<BtuPerHour>(BtuPerHour power) { return power; }
+
+#endif // UNITS_H
@@ -0,0 +1,221 @@
+#include "weather.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string_view>
+#include <system_error>
+
+#include "batchio.h"
+#include "mappedfile.h"
+
+namespace {
+
+const char CacheMagic[4] = {'B', 'T', 'U', 'W'};
+const uint32_t CacheVersion = 1;
+const int EpwHeaderLines = 8;
+const int EpwDryBulbField = 6;
+
+struct CacheHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t hours;
+    uint32_t reserved;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+};
+
+bool nextLine(const char *&cursor, const char *end, std::string_view &line)
+{
+    if (cursor >= end)
+        return false;
+    const char *newline = static_cast<const char *>(std::memchr(cursor, '\n', end - cursor));
+    const char *lineEnd = newline ? newline : end;
+    line = std::string_view(cursor, lineEnd - cursor);
+    if (!line.empty() && line.back() == '\r')
+        line.remove_suffix(1);
+    cursor = newline ? newline + 1 : end;
+    return true;
+}
+
+// Field of a comma separated line, empty when the line is shorter
+std::string_view field(std::string_view line, int index)
+{
+    for (; index > 0; --index) {
+        size_t comma = line.find(',');
+        if (comma == std::string_view::npos)
+            return {};
+        line.remove_prefix(comma + 1);
+    }
+    return line.substr(0, line.find(','));
+}
+
+std::string_view trimmedField(std::string_view text)
+{
+    while (!text.empty() && (text.front() == ' ' || text.front() == '\t' || text.front() == '"'))
+        text.remove_prefix(1);
+    while (!text.empty() && (text.back() == ' ' || text.back() == '\t' || text.back() == '"'))
+        text.remove_suffix(1);
+    return text;
+}
+
+bool isTemperatureColumn(std::string_view name)
+{
+    std::string lower;
+    for (char c : trimmedField(name))
+        lower += c >= 'A' && c <= 'Z' ? char(c - 'A' + 'a') : c;
+    return lower == "drybulb" || lower == "dry_bulb" || lower == "temperature" || lower == "temp";
+}
+
+bool blank(std::string_view line)
+{
+    return line.find_first_not_of(" \t,") == std::string_view::npos;
+}
+
+bool parseRows(const char *cursor, const char *end, size_t line, int column, WeatherYear &year, std::string &error)
+{
+    std::string_view text;
+    for (; nextLine(cursor, end, text); ++line) {
+        if (blank(text))
+            continue;
+        double value;
+        if (!parseNumber(trimmedField(field(text, column)), value)) {
+            error = "line " + std::to_string(line) + ": no temperature in column " + std::to_string(column + 1);
+            return false;
+        }
+        year.dryBulb.push_back(static_cast<float>(value));
+    }
+    if (year.dryBulb.empty()) {
+        error = "no hourly rows";
+        return false;
+    }
+    return true;
+}
+
+int64_t modificationTime(const std::filesystem::path &path, std::error_code &ec)
+{
+    return static_cast<int64_t>(std::filesystem::last_write_time(path, ec).time_since_epoch().count());
+}
+
+bool readCache(const std::string &cachePath, uint64_t sourceSize, int64_t sourceTime, WeatherYear &year)
+{
+    MappedFile cache;
+    if (!cache.open(cachePath) || cache.size() < sizeof(CacheHeader))
+        return false;
+    CacheHeader header;
+    std::memcpy(&header, cache.data(), sizeof(header));
+    if (std::memcmp(header.magic, CacheMagic, sizeof(CacheMagic)) != 0 || header.version != CacheVersion
+        || header.sourceSize != sourceSize || header.sourceTime != sourceTime || header.hours == 0
+        || cache.size() != sizeof(CacheHeader) + size_t(header.hours) * sizeof(float))
+        return false;
+
+    year.dryBulb.resize(header.hours);
+    std::memcpy(year.dryBulb.data(), cache.data() + sizeof(CacheHeader), header.hours * sizeof(float));
+    year.fromCache = true;
+    return true;
+}
+
+// Written to a temporary name first so a reader never sees half a cache
+void writeCache(const std::string &cachePath, uint64_t sourceSize, int64_t sourceTime, const WeatherYear &year)
+{
+    CacheHeader header = {};
+    std::memcpy(header.magic, CacheMagic, sizeof(CacheMagic));
+    header.version = CacheVersion;
+    header.hours = static_cast<uint32_t>(year.hours());
+    header.sourceSize = sourceSize;
+    header.sourceTime = sourceTime;
+
+    const std::string temporaryPath = cachePath + ".tmp";
+    std::FILE *file = std::fopen(temporaryPath.c_str(), "wb");
+    if (!file)
+        return;
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1
+              && std::fwrite(year.dryBulb.data(), sizeof(float), year.hours(), file) == year.hours();
+    ok = std::fclose(file) == 0 && ok;
+
+    std::error_code ec;
+    if (ok)
+        std::filesystem::rename(temporaryPath, cachePath, ec);
+    if (!ok || ec)
+        std::filesystem::remove(temporaryPath, ec);
+}
+
+} // namespace
+
+
+bool parseWeather(const char *begin, const char *end, WeatherYear &year, std::string &error)
+{
+    year.dryBulb.clear();
+    year.fromCache = false;
+    if (end - begin >= 3 && std::memcmp(begin, "\xEF\xBB\xBF", 3) == 0)
+        begin += 3;
+
+    const char *cursor = begin;
+    std::string_view first;
+    if (!nextLine(cursor, end, first)) {
+        error = "empty weather file";
+        return false;
+    }
+
+    if (first.substr(0, 8) == "LOCATION") {
+        std::string_view skipped;
+        for (int i = 1; i < EpwHeaderLines; ++i) {
+            if (!nextLine(cursor, end, skipped)) {
+                error = "truncated EPW header";
+                return false;
+            }
+        }
+        year.dryBulb.reserve(8784);
+        return parseRows(cursor, end, EpwHeaderLines + 1, EpwDryBulbField, year, error);
+    }
+
+    // CSV: a header naming the temperature column, or bare numbers in the first column
+    double value;
+    if (parseNumber(trimmedField(field(first, 0)), value))
+        return parseRows(begin, end, 1, 0, year, error);
+    std::string_view header = first;
+    for (int column = 0;; ++column) {
+        const size_t comma = header.find(',');
+        if (isTemperatureColumn(header.substr(0, comma)))
+            return parseRows(cursor, end, 2, column, year, error);
+        if (comma == std::string_view::npos)
+            break;
+        header.remove_prefix(comma + 1);
+    }
+    error = "no dryBulb or temperature column";
+    return false;
+}
+
+std::string weatherCachePath(const std::string &path)
+{
+    return path + ".btuw";
+}
+
+bool loadWeather(const std::string &path, WeatherYear &year, std::string &error, bool useCache)
+{
+    std::error_code ec;
+    const uint64_t sourceSize = std::filesystem::file_size(path, ec);
+    if (ec) {
+        error = "cannot open " + path;
+        return false;
+    }
+    const int64_t sourceTime = modificationTime(path, ec);
+    const std::string cachePath = weatherCachePath(path);
+    if (useCache && !ec && readCache(cachePath, sourceSize, sourceTime, year))
+        return true;
+
+    MappedFile source;
+    if (!source.open(path)) {
+        error = "cannot open " + path;
+        return false;
+    }
+    if (!parseWeather(source.data(), source.data() + source.size(), year, error)) {
+        error = path + ": " + error;
+        return false;
+    }
+    if (useCache && !ec)
+        writeCache(cachePath, sourceSize, sourceTime, year);
+    return true;
+}
@@ -0,0 +1,30 @@
+#ifndef WEATHER_H
+#define WEATHER_H
+
+#include <string>
+#include <vector>
+
+// Hourly outdoor conditions for annual simulation, read from an EnergyPlus
+// weather file (.epw) or a CSV with one row per hour. The parsed values are
+// cached next to the source file in a compact binary form (<file>.btuw) and
+// the cache is used while the source's size and modification time are unchanged.
+
+struct WeatherYear
+{
+    std::vector<float> dryBulb; // outdoor air temperature (°C), one per hour from 1 January 00:00
+    bool fromCache = false;
+
+    size_t hours() const { return dryBulb.size(); }
+};
+
+// Parses weather text. EPW files are recognised by their LOCATION header; CSV
+// files use a column named dryBulb, dry_bulb, temperature or temp, or the
+// first column when there is no header.
+bool parseWeather(const char *begin, const char *end, WeatherYear &year, std::string &error);
+
+// Memory-maps and parses path, going through the binary cache when useCache is set
+bool loadWeather(const std::string &path, WeatherYear &year, std::string &error, bool useCache = true);
+
+std::string weatherCachePath(const std::string &path);
+
+#endif // WEATHER_H
@@ -0,0 +1,95 @@
+#include "workpool.h"
+
+#include <algorithm>
+
+WorkPool::WorkPool(unsigned threadCount)
+{
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    for (unsigned i = 0; i < threadCount; ++i)
+        workers.push_back(std::make_unique<Worker>());
+    for (unsigned i = 0; i < threadCount; ++i)
+        threads.emplace_back(&WorkPool::run, this, i);
+}
+
+WorkPool::~WorkPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        stopping = true;
+    }
+    taskAvailable.notify_all();
+    for (auto &thread : threads)
+        thread.join();
+}
+
+void WorkPool::submit(std::function<void()> task)
+{
+    unsigned index = nextWorker.fetch_add(1, std::memory_order_relaxed) % workers.size();
+    {
+        std::lock_guard<std::mutex> lock(workers[index]->mutex);
+        workers[index]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        ++queued;
+        ++unfinished;
+    }
+    taskAvailable.notify_one();
+}
+
+void WorkPool::wait()
+{
+    std::unique_lock<std::mutex> lock(stateMutex);
+    allDone.wait(lock, [this] { return unfinished == 0; });
+}
+
+bool WorkPool::takeTask(unsigned index, std::function<void()> &task)
+{
+    {
+        Worker &own = *workers[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    for (size_t offset = 1; offset < workers.size(); ++offset) {
+        Worker &victim = *workers[(index + offset) % workers.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            steals.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkPool::run(unsigned index)
+{
+    std::function<void()> task;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(stateMutex);
+            taskAvailable.wait(lock, [this] { return queued > 0 || stopping; });
+            if (queued == 0 && stopping)
+                return;
+            --queued;
+        }
+
+        // A task is reserved for this worker, so one of the deques holds it
+        while (!takeTask(index, task))
+            std::this_thread::yield();
+        task();
+        task = nullptr;
+
+        std::lock_guard<std::mutex> lock(stateMutex);
+        if (--unfinished == 0)
+            allDone.notify_all();
+    }
+}
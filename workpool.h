@@ -0,0 +1,56 @@
+#ifndef WORKPOOL_H
+#define WORKPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed size thread pool with one task deque per worker. Workers take their own
+// newest task first and steal the oldest task from another worker when idle.
+class WorkPool
+{
+public:
+    // threads == 0 uses one thread per hardware thread
+    explicit WorkPool(unsigned threads = 0);
+    ~WorkPool();
+
+    WorkPool(const WorkPool &) = delete;
+    WorkPool &operator=(const WorkPool &) = delete;
+
+    void submit(std::function<void()> task);
+
+    // Blocks until every submitted task has finished
+    void wait();
+
+    unsigned threadCount() const { return static_cast<unsigned>(threads.size()); }
+    size_t stealCount() const { return steals.load(std::memory_order_relaxed); }
+
+private:
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void run(unsigned index);
+    bool takeTask(unsigned index, std::function<void()> &task);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    std::mutex stateMutex;
+    std::condition_variable taskAvailable;
+    std::condition_variable allDone;
+    size_t queued = 0;
+    size_t unfinished = 0;
+    bool stopping = false;
+    std::atomic<unsigned> nextWorker{0};
+    std::atomic<size_t> steals{0};
+};
+
+#endif // WORKPOOL_H